@@ -0,0 +1,1030 @@
+/*****************************************************************************
+ * benchmark.c
+ *****************************************************************************
+ * Copyright (C) 2017 L-SMASH project
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include "cli/cli.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "common/internal.h"
+#include "importer/importer.h"
+#include "codecs/nalu.h"
+#include "generator.h"
+
+#define eprintf( ... ) fprintf( stderr, __VA_ARGS__ )
+
+#define DEFAULT_REPEAT          5
+#define DEFAULT_FRAMES          1800        /* 1 minute at 29.97 fps */
+#define DEFAULT_TABLE_SAMPLES   1000000
+#define DEFAULT_RANDOM_ACCESSES 100000
+
+typedef struct
+{
+    lsmash_summary_t *summary;
+    uint32_t          timescale;    /* media timescale */
+    uint32_t          timebase;     /* multiplier to timestamps given by the importer */
+    uint32_t          last_delta;
+    uint32_t          sample_count;
+    lsmash_sample_t  *samples;      /* The data of each sample is allocated separately. */
+} bench_track_t;
+
+typedef struct
+{
+    /* options */
+    int         repeat;
+    uint32_t    frames;
+    uint32_t    video_bitrate;
+    uint32_t    audio_bitrate;
+    uint32_t    table_samples;
+    uint32_t    random_accesses;
+    const char *filter;
+    const char *workdir;
+    FILE       *out;
+    /* inputs prepared on demand */
+    int           generated[BENCH_STREAM_COUNT];
+    int           tracks_loaded;
+    bench_track_t track[2];         /* video and audio tracks muxed by the muxing benchmarks */
+    int           table_written;
+    int           fragments_written;
+} bench_t;
+
+typedef struct
+{
+    double   seconds;   /* elapsed time of the measured part */
+    uint64_t items;     /* number of processed items, e.g. samples */
+    uint64_t bytes;     /* number of processed bytes */
+} bench_result_t;
+
+typedef struct
+{
+    const char *name;
+    const char *description;
+    int (*run)( bench_t *bench, int arg, bench_result_t *result );
+    int         arg;
+} bench_case_t;
+
+static int bench_error( const char *message, ... )
+{
+    eprintf( "エラー: " );
+    va_list args;
+    va_start( args, message );
+    vfprintf( stderr, message, args );
+    va_end( args );
+    return -1;
+}
+
+#define ERROR_MSG( ... ) bench_error( __VA_ARGS__ )
+
+static double get_time( void )
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency( &frequency );
+    QueryPerformanceCounter( &counter );
+    return (double)counter.QuadPart / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void get_path( bench_t *bench, const char *name, char *path, size_t size )
+{
+    snprintf( path, size, "%s/%s", bench->workdir, name );
+}
+
+static void get_stream_path( bench_t *bench, bench_stream_type type, char *path, size_t size )
+{
+    char name[32];
+    snprintf( name, sizeof(name), "bench.%s", bench_get_stream_name( type ) );
+    get_path( bench, name, path, size );
+}
+
+static int prepare_stream( bench_t *bench, bench_stream_type type )
+{
+    if( bench->generated[type] )
+        return 0;
+    char path[1024];
+    get_stream_path( bench, type, path, sizeof(path) );
+    FILE *fp = lsmash_fopen( path, "wb" );
+    if( !fp )
+        return ERROR_MSG( "%sを作成できませんでした。\n", path );
+    bench_stream_param_t param;
+    param.frames  = bench->frames;
+    param.bitrate = (type == BENCH_STREAM_H264 || type == BENCH_STREAM_HEVC) ? bench->video_bitrate : bench->audio_bitrate;
+    param.seed    = type + 1;
+    int err = bench_generate_stream( fp, type, &param );
+    if( fclose( fp ) || err < 0 )
+        return ERROR_MSG( "%sの生成に失敗しました。\n", path );
+    bench->generated[type] = 1;
+    return 0;
+}
+
+/*---- importers ----*/
+static int run_import( bench_t *bench, int type, bench_result_t *result )
+{
+    if( prepare_stream( bench, type ) < 0 )
+        return -1;
+    char path[1024];
+    get_stream_path( bench, type, path, sizeof(path) );
+    double start = get_time();
+    lsmash_root_t *root = lsmash_create_root();
+    if( !root )
+        return ERROR_MSG( "ROOTの作成に失敗しました。\n" );
+    importer_t *importer = lsmash_importer_open( root, path, "auto" );
+    if( !importer )
+    {
+        lsmash_destroy_root( root );
+        return ERROR_MSG( "%sを読み込めませんでした。\n", path );
+    }
+    int ret;
+    result->items = 0;
+    result->bytes = 0;
+    while( 1 )
+    {
+        lsmash_sample_t *sample = NULL;
+        ret = lsmash_importer_get_access_unit( importer, 1, &sample );
+        if( ret < 0 || ret == 2 )
+        {
+            lsmash_delete_sample( sample );
+            break;
+        }
+        ++ result->items;
+        result->bytes += sample->length;
+        lsmash_delete_sample( sample );
+    }
+    lsmash_importer_close( importer );
+    lsmash_destroy_root( root );
+    result->seconds = get_time() - start;
+    return ret < 0 ? ERROR_MSG( "%sのアクセスユニットの取得に失敗しました。\n", path ) : 0;
+}
+
+/*---- NAL units ----*/
+#define NALU_RBSP_SIZE (16 * 1024)
+
+/* Fill an RBSP with random bytes where runs of zero bytes are frequent enough to require emulation prevention.
+ * The RBSP ends with rbsp_trailing_bits, followed by cabac_zero_words for some of them. */
+static uint64_t fill_rbsp( uint8_t *rbsp, uint64_t size, uint32_t *state )
+{
+    uint64_t i = 0;
+    while( i < size )
+    {
+        *state ^= *state << 13;
+        *state ^= *state >> 17;
+        *state ^= *state << 5;
+        if( (*state & 0x1f) == 0 )
+            /* a run of zero bytes, followed by any byte */
+            for( uint32_t run = (*state >> 5) % 5 + 2; run && i < size; run-- )
+                rbsp[i++] = 0x00;
+        else
+            rbsp[i++] = (*state >> 8) & ((*state & 0x20) ? 0x03 : 0xff);
+    }
+    rbsp[size - 1] = 0x80;
+    uint32_t cabac_zero_words = (*state >> 16) % 3;
+    for( uint32_t n = 0; n < cabac_zero_words; n++ )
+    {
+        rbsp[size++] = 0x00;
+        rbsp[size++] = 0x00;
+    }
+    return size;
+}
+
+/* Insert emulation prevention into RBSPs and remove it again, and check that the RBSPs come back as they were. */
+static int run_nalu_round_trip( bench_t *bench, int arg, bench_result_t *result )
+{
+    (void)arg;
+    lsmash_bs_t   *bs          = lsmash_bs_create();
+    lsmash_bits_t *bits        = lsmash_bits_adhoc_create();
+    uint8_t       *rbsp        = lsmash_malloc( NALU_RBSP_SIZE + 4 );
+    uint8_t       *rbsp_buffer = lsmash_malloc( 2 * NALU_RBSP_SIZE );
+    int            ret         = 0;
+    if( !bs || !bits || !rbsp || !rbsp_buffer )
+    {
+        ret = ERROR_MSG( "メモリの割付に失敗しました。\n" );
+        goto done;
+    }
+    uint32_t state = 1;
+    result->items   = 0;
+    result->bytes   = 0;
+    result->seconds = 0;
+    for( uint32_t i = 0; i < bench->frames; i++ )
+    {
+        uint64_t rbsp_size = fill_rbsp( rbsp, NALU_RBSP_SIZE, &state );
+        double start = get_time();
+        lsmash_bs_empty( bs );
+        lsmash_bits_empty( bits );
+        uint64_t imported_size;
+        if( nalu_export_ebsp_from_rbsp( bs, rbsp, rbsp_size ) < 0
+         || nalu_import_rbsp_from_ebsp( bits, rbsp_buffer, &imported_size,
+                                        lsmash_bs_get_buffer_data( bs ), lsmash_bs_get_valid_data_size( bs ) ) < 0 )
+        {
+            ret = ERROR_MSG( "エミュレーション防止の処理に失敗しました。\n" );
+            goto done;
+        }
+        result->seconds += get_time() - start;
+        /* Within the EBSP, two zero bytes are followed by no byte other than emulation_prevention_three_byte,
+         * and the last byte is not a zero byte. */
+        const uint8_t *ebsp     = lsmash_bs_get_buffer_data( bs );
+        const uint8_t *ebsp_end = ebsp + lsmash_bs_get_valid_data_size( bs );
+        if( lsmash_find_zero_pair( ebsp, ebsp_end, 0x00, 0x02 ) != ebsp_end || ebsp_end[-1] == 0x00 )
+        {
+            ret = ERROR_MSG( "RBSP%"PRIu32"から不正なEBSPが生成されました。\n", i );
+            goto done;
+        }
+        if( imported_size != rbsp_size
+         || memcmp( lsmash_bs_get_buffer_data( bits->bs ), rbsp, rbsp_size ) )
+        {
+            ret = ERROR_MSG( "RBSP%"PRIu32"が元に戻りませんでした。\n", i );
+            goto done;
+        }
+        ++ result->items;
+        result->bytes += rbsp_size;
+    }
+done:
+    lsmash_free( rbsp_buffer );
+    lsmash_free( rbsp );
+    lsmash_bits_adhoc_cleanup( bits );
+    lsmash_bs_cleanup( bs );
+    return ret;
+}
+
+/*---- muxing ----*/
+static void cleanup_track( bench_track_t *track )
+{
+    for( uint32_t i = 0; i < track->sample_count; i++ )
+        free( track->samples[i].data );
+    free( track->samples );
+    lsmash_cleanup_summary( track->summary );
+    memset( track, 0, sizeof(bench_track_t) );
+}
+
+/* Import a whole stream into memory so that the muxing benchmarks do not measure importers. */
+static int load_track( bench_t *bench, bench_stream_type type, bench_track_t *track )
+{
+    if( prepare_stream( bench, type ) < 0 )
+        return -1;
+    char path[1024];
+    get_stream_path( bench, type, path, sizeof(path) );
+    lsmash_root_t *root = lsmash_create_root();
+    if( !root )
+        return ERROR_MSG( "ROOTの作成に失敗しました。\n" );
+    importer_t *importer = lsmash_importer_open( root, path, "auto" );
+    if( !importer )
+    {
+        lsmash_destroy_root( root );
+        return ERROR_MSG( "%sを読み込めませんでした。\n", path );
+    }
+    int err = 0;
+    uint32_t alloc_count = 0;
+    track->summary = lsmash_duplicate_summary( importer, 1 );
+    while( track->summary )
+    {
+        lsmash_sample_t *sample = NULL;
+        int ret = lsmash_importer_get_access_unit( importer, 1, &sample );
+        if( ret < 0 || ret == 2 )
+        {
+            lsmash_delete_sample( sample );
+            err = ret < 0 ? ret : 0;
+            break;
+        }
+        if( track->sample_count == alloc_count )
+        {
+            alloc_count = alloc_count ? alloc_count * 2 : 1024;
+            lsmash_sample_t *samples = realloc( track->samples, alloc_count * sizeof(lsmash_sample_t) );
+            if( !samples )
+            {
+                lsmash_delete_sample( sample );
+                err = LSMASH_ERR_MEMORY_ALLOC;
+                break;
+            }
+            track->samples = samples;
+        }
+        lsmash_sample_t *copy = &track->samples[ track->sample_count ];
+        *copy = *sample;
+        copy->buffer = NULL;
+        copy->data   = malloc( sample->length ? sample->length : 1 );
+        if( copy->data )
+        {
+            memcpy( copy->data, sample->data, sample->length );
+            ++ track->sample_count;
+        }
+        lsmash_delete_sample( sample );
+        if( !copy->data )
+        {
+            err = LSMASH_ERR_MEMORY_ALLOC;
+            break;
+        }
+    }
+    track->last_delta = lsmash_importer_get_last_delta( importer, 1 );
+    lsmash_importer_close( importer );
+    lsmash_destroy_root( root );
+    if( !track->summary || err < 0 || track->sample_count == 0 )
+    {
+        cleanup_track( track );
+        return ERROR_MSG( "%sのサンプルの取得に失敗しました。\n", path );
+    }
+    if( track->summary->summary_type == LSMASH_SUMMARY_TYPE_VIDEO )
+    {
+        lsmash_video_summary_t *summary = (lsmash_video_summary_t *)track->summary;
+        track->timescale = summary->timescale;
+        track->timebase  = summary->timebase;
+    }
+    else
+    {
+        track->timescale = ((lsmash_audio_summary_t *)track->summary)->frequency;
+        track->timebase  = 1;
+    }
+    return 0;
+}
+
+static int prepare_tracks( bench_t *bench )
+{
+    if( bench->tracks_loaded )
+        return 0;
+    if( load_track( bench, BENCH_STREAM_H264, &bench->track[0] ) < 0
+     || load_track( bench, BENCH_STREAM_ADTS, &bench->track[1] ) < 0 )
+        return -1;
+    bench->tracks_loaded = 1;
+    return 0;
+}
+
+typedef enum
+{
+    MUX_MODE_NORMAL = 0,
+    MUX_MODE_MOOV_TO_FRONT,
+    MUX_MODE_FRAGMENTED,
+} mux_mode;
+
+typedef struct
+{
+    uint32_t track_ID;
+    uint32_t sample_entry;
+    uint32_t next_sample;   /* index of the next sample to be appended */
+} mux_track_t;
+
+static uint32_t get_sample_delta( bench_track_t *track, uint32_t index )
+{
+    return index + 1 < track->sample_count
+         ? track->samples[index + 1].dts - track->samples[index].dts
+         : track->last_delta;
+}
+
+static int set_up_mux_track( lsmash_root_t *root, bench_track_t *track, mux_track_t *out )
+{
+    lsmash_track_parameters_t track_param;
+    lsmash_initialize_track_parameters( &track_param );
+    track_param.mode = ISOM_TRACK_IN_MOVIE | ISOM_TRACK_IN_PREVIEW | ISOM_TRACK_ENABLED;
+    lsmash_media_parameters_t media_param;
+    lsmash_initialize_media_parameters( &media_param );
+    media_param.timescale = track->timescale;
+    if( track->summary->summary_type == LSMASH_SUMMARY_TYPE_VIDEO )
+    {
+        lsmash_video_summary_t *summary = (lsmash_video_summary_t *)track->summary;
+        out->track_ID = lsmash_create_track( root, ISOM_MEDIA_HANDLER_TYPE_VIDEO_TRACK );
+        track_param.display_width  = summary->width  << 16;
+        track_param.display_height = summary->height << 16;
+    }
+    else
+    {
+        out->track_ID = lsmash_create_track( root, ISOM_MEDIA_HANDLER_TYPE_AUDIO_TRACK );
+        media_param.roll_grouping = 1;
+    }
+    if( out->track_ID == 0
+     || lsmash_set_track_parameters( root, out->track_ID, &track_param ) < 0
+     || lsmash_set_media_parameters( root, out->track_ID, &media_param ) < 0 )
+        return -1;
+    out->sample_entry = lsmash_add_sample_entry( root, out->track_ID, track->summary );
+    out->next_sample  = 0;
+    return out->sample_entry ? 0 : -1;
+}
+
+static int flush_mux_tracks( bench_t *bench, lsmash_root_t *root, mux_track_t *out )
+{
+    for( int i = 0; i < 2; i++ )
+    {
+        bench_track_t *track = &bench->track[i];
+        uint32_t last_delta = out[i].next_sample ? get_sample_delta( track, out[i].next_sample - 1 ) : track->last_delta;
+        if( lsmash_flush_pooled_samples( root, out[i].track_ID, last_delta * track->timebase ) < 0 )
+            return -1;
+    }
+    return 0;
+}
+
+/* Mux the video and audio tracks in DTS order, and measure appending samples and finishing the movie separately. */
+static int mux_movie( bench_t *bench, mux_mode mode, double *append_time, double *finish_time, bench_result_t *result )
+{
+    if( prepare_tracks( bench ) < 0 )
+        return -1;
+    char path[1024];
+    get_path( bench, "mux.mp4", path, sizeof(path) );
+    lsmash_root_t *root = lsmash_create_root();
+    if( !root )
+        return ERROR_MSG( "ROOTの作成に失敗しました。\n" );
+    lsmash_file_parameters_t param;
+    if( lsmash_open_file( path, 0, &param ) < 0 )
+    {
+        lsmash_destroy_root( root );
+        return ERROR_MSG( "%sの作成に失敗しました。\n", path );
+    }
+    lsmash_brand_type brands[] = { ISOM_BRAND_TYPE_ISOM, ISOM_BRAND_TYPE_ISO6, ISOM_BRAND_TYPE_AVC1, ISOM_BRAND_TYPE_MP41 };
+    param.major_brand   = ISOM_BRAND_TYPE_ISOM;
+    param.brands        = brands;
+    param.brand_count   = sizeof(brands) / sizeof(brands[0]);
+    param.minor_version = 0;
+    if( mode == MUX_MODE_FRAGMENTED )
+        param.mode |= LSMASH_FILE_MODE_FRAGMENTED;
+    mux_track_t out[2];
+    lsmash_movie_parameters_t movie_param;
+    lsmash_initialize_movie_parameters( &movie_param );
+    if( !lsmash_set_file( root, &param )
+     || lsmash_set_movie_parameters( root, &movie_param ) < 0
+     || set_up_mux_track( root, &bench->track[0], &out[0] ) < 0
+     || set_up_mux_track( root, &bench->track[1], &out[1] ) < 0 )
+    {
+        ERROR_MSG( "%sの設定に失敗しました。\n", path );
+        goto fail;
+    }
+    result->items = 0;
+    result->bytes = 0;
+    double start = get_time();
+    if( mode == MUX_MODE_FRAGMENTED && lsmash_create_fragment_movie( root ) < 0 )
+    {
+        ERROR_MSG( "映像フラグメントの作成に失敗しました。\n" );
+        goto fail;
+    }
+    while( 1 )
+    {
+        /* Pick the track whose next sample is the earliest. */
+        int target = -1;
+        double target_dts = 0;
+        for( int i = 0; i < 2; i++ )
+        {
+            bench_track_t *track = &bench->track[i];
+            if( out[i].next_sample >= track->sample_count )
+                continue;
+            double dts = (double)track->samples[ out[i].next_sample ].dts / track->timescale * track->timebase;
+            if( target < 0 || dts < target_dts )
+            {
+                target     = i;
+                target_dts = dts;
+            }
+        }
+        if( target < 0 )
+            break;
+        bench_track_t   *track  = &bench->track[target];
+        lsmash_sample_t *source = &track->samples[ out[target].next_sample ];
+        /* Start a new movie fragment at each sync sample of the video track. */
+        if( mode == MUX_MODE_FRAGMENTED && target == 0 && out[0].next_sample
+         && (source->prop.ra_flags & ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC) )
+        {
+            if( flush_mux_tracks( bench, root, out ) < 0
+             || lsmash_create_fragment_movie( root ) < 0 )
+            {
+                ERROR_MSG( "映像フラグメントの作成に失敗しました。\n" );
+                goto fail;
+            }
+        }
+        lsmash_sample_t *sample = lsmash_create_pooled_sample( root, source->length );
+        if( !sample )
+        {
+            ERROR_MSG( "サンプルの割付に失敗しました。\n" );
+            goto fail;
+        }
+        memcpy( sample->data, source->data, source->length );
+        sample->dts   = source->dts * track->timebase;
+        sample->cts   = source->cts * track->timebase;
+        sample->prop  = source->prop;
+        sample->index = out[target].sample_entry;
+        if( lsmash_append_sample( root, out[target].track_ID, sample ) < 0 )
+        {
+            lsmash_delete_sample( sample );
+            ERROR_MSG( "サンプルのアペンドに失敗しました。\n" );
+            goto fail;
+        }
+        ++ out[target].next_sample;
+        ++ result->items;
+        result->bytes += source->length;
+    }
+    *append_time = get_time() - start;
+    start = get_time();
+    lsmash_adhoc_remux_t moov_to_front = { 4 * 1024 * 1024, NULL, NULL };
+    if( flush_mux_tracks( bench, root, out ) < 0
+     || lsmash_finish_movie( root, mode == MUX_MODE_MOOV_TO_FRONT ? &moov_to_front : NULL ) < 0 )
+    {
+        ERROR_MSG( "ムービーの完成に失敗しました。\n" );
+        goto fail;
+    }
+    lsmash_close_file( &param );
+    lsmash_destroy_root( root );
+    *finish_time = get_time() - start;
+    remove( path );
+    return 0;
+fail:
+    lsmash_close_file( &param );
+    lsmash_destroy_root( root );
+    remove( path );
+    return -1;
+}
+
+static int run_mux_append( bench_t *bench, int mode, bench_result_t *result )
+{
+    double append_time;
+    double finish_time;
+    if( mux_movie( bench, mode, &append_time, &finish_time, result ) < 0 )
+        return -1;
+    result->seconds = append_time;
+    return 0;
+}
+
+static int run_mux_finish( bench_t *bench, int mode, bench_result_t *result )
+{
+    double append_time;
+    double finish_time;
+    if( mux_movie( bench, mode, &append_time, &finish_time, result ) < 0 )
+        return -1;
+    result->seconds = finish_time;
+    return 0;
+}
+
+static int run_mux_whole( bench_t *bench, int mode, bench_result_t *result )
+{
+    double append_time;
+    double finish_time;
+    if( mux_movie( bench, mode, &append_time, &finish_time, result ) < 0 )
+        return -1;
+    result->seconds = append_time + finish_time;
+    return 0;
+}
+
+/*---- demuxing ----*/
+/* Write a movie with a huge sample table.
+ * Sample sizes vary, sync samples are sparse and composition is reordered so that every table has many entries.
+ * If 'fragmented' is set, the same samples are written into a movie fragment per sync sample instead. */
+static int prepare_table( bench_t *bench, int fragmented )
+{
+    int *written = fragmented ? &bench->fragments_written : &bench->table_written;
+    if( *written )
+        return 0;
+    if( prepare_tracks( bench ) < 0 )
+        return -1;
+    char path[1024];
+    get_path( bench, fragmented ? "fragments.mp4" : "table.mp4", path, sizeof(path) );
+    lsmash_root_t *root = lsmash_create_root();
+    if( !root )
+        return ERROR_MSG( "ROOTの作成に失敗しました。\n" );
+    int err = -1;
+    lsmash_file_parameters_t param;
+    if( lsmash_open_file( path, 0, &param ) < 0 )
+    {
+        lsmash_destroy_root( root );
+        return ERROR_MSG( "%sの作成に失敗しました。\n", path );
+    }
+    /* The ISO Base Media version 6 brand makes every track fragment have its base media decode time. */
+    lsmash_brand_type brands[] = { ISOM_BRAND_TYPE_ISOM, ISOM_BRAND_TYPE_AVC1, ISOM_BRAND_TYPE_ISO6 };
+    param.major_brand = ISOM_BRAND_TYPE_ISOM;
+    param.brands      = brands;
+    param.brand_count = fragmented ? 3 : 2;
+    if( fragmented )
+        param.mode |= LSMASH_FILE_MODE_FRAGMENTED;
+    lsmash_movie_parameters_t movie_param;
+    lsmash_initialize_movie_parameters( &movie_param );
+    mux_track_t out;
+    if( !lsmash_set_file( root, &param )
+     || lsmash_set_movie_parameters( root, &movie_param ) < 0
+     || set_up_mux_track( root, &bench->track[0], &out ) < 0 )
+        goto done;
+    static const uint32_t display_order[3] = { 2, 0, 1 };
+    for( uint32_t i = 0; i < bench->table_samples; i++ )
+    {
+        if( fragmented && i % 30 == 0
+         && ((i && lsmash_flush_pooled_samples( root, out.track_ID, 1001 ) < 0)
+          || lsmash_create_fragment_movie( root ) < 0) )
+            goto done;
+        lsmash_sample_t *sample = lsmash_create_pooled_sample( root, 8 + i % 7 );
+        if( !sample )
+            goto done;
+        memset( sample->data, 0, sample->length );
+        sample->dts   = (uint64_t)i * 1001;
+        sample->cts   = (uint64_t)(i - i % 3 + display_order[i % 3] + 1) * 1001;
+        sample->index = out.sample_entry;
+        sample->prop.ra_flags = (i % 30 == 0) ? ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC : ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE;
+        if( lsmash_append_sample( root, out.track_ID, sample ) < 0 )
+        {
+            lsmash_delete_sample( sample );
+            goto done;
+        }
+    }
+    if( lsmash_flush_pooled_samples( root, out.track_ID, 1001 ) < 0
+     || lsmash_finish_movie( root, NULL ) < 0 )
+        goto done;
+    err = 0;
+    *written = 1;
+done:
+    lsmash_close_file( &param );
+    lsmash_destroy_root( root );
+    return err < 0 ? ERROR_MSG( "%sの生成に失敗しました。\n", path ) : 0;
+}
+
+typedef struct
+{
+    lsmash_root_t           *root;
+    lsmash_file_parameters_t param;
+    uint32_t                 track_ID;
+    uint64_t                 file_size;
+} demux_t;
+
+static void close_table( demux_t *demux )
+{
+    lsmash_close_file( &demux->param );
+    lsmash_destroy_root( demux->root );
+}
+
+/* Open the movie written by prepare_table(). If 'lazy' is set, movie fragments are read on demand. */
+static int open_table( bench_t *bench, demux_t *demux, int fragmented, int lazy )
+{
+    if( prepare_table( bench, fragmented ) < 0 )
+        return -1;
+    char path[1024];
+    get_path( bench, fragmented ? "fragments.mp4" : "table.mp4", path, sizeof(path) );
+    demux->root = lsmash_create_root();
+    if( !demux->root )
+        return ERROR_MSG( "ROOTの作成に失敗しました。\n" );
+    if( lsmash_open_file( path, 1, &demux->param ) < 0 )
+    {
+        lsmash_destroy_root( demux->root );
+        return ERROR_MSG( "%sを開けませんでした。\n", path );
+    }
+    if( lazy )
+        demux->param.mode |= LSMASH_FILE_MODE_LAZY;
+    lsmash_file_t *file = lsmash_set_file( demux->root, &demux->param );
+    if( !file || lsmash_read_file( file, &demux->param ) < 0 )
+    {
+        close_table( demux );
+        return ERROR_MSG( "%sを読み込めませんでした。\n", path );
+    }
+    demux->track_ID = lsmash_get_track_ID( demux->root, 1 );
+    if( lsmash_construct_timeline( demux->root, demux->track_ID ) < 0 )
+    {
+        close_table( demux );
+        return ERROR_MSG( "タイムラインの構築に失敗しました。\n" );
+    }
+    return 0;
+}
+
+static int run_read_file( bench_t *bench, int arg, bench_result_t *result )
+{
+    if( prepare_table( bench, 0 ) < 0 )
+        return -1;
+    demux_t demux;
+    double start = get_time();
+    if( open_table( bench, &demux, 0, 0 ) < 0 )
+        return -1;
+    close_table( &demux );
+    result->seconds = get_time() - start;
+    result->items   = bench->table_samples;
+    result->bytes   = 0;
+    return 0;
+}
+
+/* Get samples in decoding order if 'random' is 0, or at random otherwise. */
+static int run_timeline( bench_t *bench, int random, bench_result_t *result )
+{
+    demux_t demux;
+    if( open_table( bench, &demux, 0, 0 ) < 0 )
+        return -1;
+    uint32_t count = random ? bench->random_accesses : bench->table_samples;
+    uint32_t state = 1;
+    result->items = 0;
+    result->bytes = 0;
+    double start = get_time();
+    for( uint32_t i = 1; i <= count; i++ )
+    {
+        uint32_t sample_number = i;
+        if( random )
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            sample_number = state % bench->table_samples + 1;
+        }
+        lsmash_sample_t *sample = lsmash_get_sample_from_media_timeline( demux.root, demux.track_ID, sample_number );
+        if( !sample )
+        {
+            close_table( &demux );
+            return ERROR_MSG( "サンプル%"PRIu32"の取得に失敗しました。\n", sample_number );
+        }
+        ++ result->items;
+        result->bytes += sample->length;
+        lsmash_delete_sample( sample );
+    }
+    result->seconds = get_time() - start;
+    close_table( &demux );
+    return 0;
+}
+
+/* Open the fragmented movie and seek to a time close to the end of it, i.e. get the samples from the preceding
+ * random accessible point to the sample at that time. If 'lazy' is set, only the movie fragments needed are read. */
+static int run_fragment_seek( bench_t *bench, int lazy, bench_result_t *result )
+{
+    if( prepare_table( bench, 1 ) < 0 )
+        return -1;
+    demux_t demux;
+    result->items = 0;
+    result->bytes = 0;
+    double start = get_time();
+    if( open_table( bench, &demux, 1, lazy ) < 0 )
+        return -1;
+    uint64_t dts = (uint64_t)(bench->table_samples - bench->table_samples / 10 - 1) * 1001;
+    uint32_t sample_number;
+    uint32_t rap_number;
+    if( lsmash_get_sample_number_by_dts_from_media_timeline( demux.root, demux.track_ID, dts, &sample_number ) < 0
+     || lsmash_get_closest_random_accessible_point_from_media_timeline( demux.root, demux.track_ID, sample_number, &rap_number ) < 0 )
+    {
+        close_table( &demux );
+        return ERROR_MSG( "シークに失敗しました。\n" );
+    }
+    for( uint32_t i = rap_number; i <= sample_number; i++ )
+    {
+        lsmash_sample_t *sample = lsmash_get_sample_from_media_timeline( demux.root, demux.track_ID, i );
+        if( !sample )
+        {
+            close_table( &demux );
+            return ERROR_MSG( "サンプル%"PRIu32"の取得に失敗しました。\n", i );
+        }
+        ++ result->items;
+        result->bytes += sample->length;
+        lsmash_delete_sample( sample );
+    }
+    close_table( &demux );
+    result->seconds = get_time() - start;
+    return 0;
+}
+
+static const bench_case_t bench_cases[] =
+{
+    { "import/h264",              "H.264/AVC Annex-Bのインポート",          run_import,     BENCH_STREAM_H264 },
+    { "import/hevc",              "H.265/HEVC Annex-Bのインポート",         run_import,     BENCH_STREAM_HEVC },
+    { "import/adts",              "ADTS AACのインポート",                   run_import,     BENCH_STREAM_ADTS },
+    { "import/ac3",               "AC-3のインポート",                       run_import,     BENCH_STREAM_AC3  },
+    { "import/lpcm",              "WAVE LPCMのインポート",                  run_import,     BENCH_STREAM_LPCM },
+    { "nalu/ebsp-round-trip",     "エミュレーション防止の挿入と除去",       run_nalu_round_trip, 0 },
+    { "mux/append",               "映像と音声のサンプルのアペンド",         run_mux_append, MUX_MODE_NORMAL },
+    { "mux/finish",               "ムービーの完成",                         run_mux_finish, MUX_MODE_NORMAL },
+    { "mux/finish-moov-to-front", "ムービーヘッダを先頭に移動するムービーの完成", run_mux_finish, MUX_MODE_MOOV_TO_FRONT },
+    { "mux/fragmented",           "映像フラグメントの出力",                 run_mux_whole,  MUX_MODE_FRAGMENTED },
+    { "demux/read-file",          "巨大なサンプルテーブルの読み込み",       run_read_file,  0 },
+    { "demux/timeline-sequential","タイムラインからの全サンプルの取得",     run_timeline,   0 },
+    { "demux/timeline-random",    "タイムラインからのランダムアクセス",     run_timeline,   1 },
+    { "demux/fragment-seek",      "映像フラグメントを開いてシーク",         run_fragment_seek, 0 },
+    { "demux/fragment-seek-lazy", "映像フラグメントを遅延読み込みで開いてシーク", run_fragment_seek, 1 },
+    { NULL, NULL, NULL, 0 }
+};
+
+static int compare_seconds( const void *a, const void *b )
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Output the result of a benchmark as a line of JSON. The throughput is based on the median. */
+static int run_case( bench_t *bench, const bench_case_t *bench_case )
+{
+    double *seconds = malloc( bench->repeat * sizeof(double) );
+    if( !seconds )
+        return ERROR_MSG( "メモリの割付に失敗しました。\n" );
+    bench_result_t result = { 0 };
+    eprintf( "計測中: %s\n", bench_case->name );
+    for( int i = 0; i < bench->repeat; i++ )
+    {
+        if( bench_case->run( bench, bench_case->arg, &result ) < 0 )
+        {
+            free( seconds );
+            return ERROR_MSG( "%sに失敗しました。\n", bench_case->name );
+        }
+        seconds[i] = result.seconds;
+    }
+    qsort( seconds, bench->repeat, sizeof(double), compare_seconds );
+    double median = bench->repeat & 1
+                  ? seconds[ bench->repeat / 2 ]
+                  : (seconds[ bench->repeat / 2 - 1 ] + seconds[ bench->repeat / 2 ]) / 2;
+    double per_second = median > 0 ? 1 / median : 0;
+    fprintf( bench->out,
+             "{\"type\":\"result\",\"name\":\"%s\",\"runs\":%d,\"items\":%"PRIu64",\"bytes\":%"PRIu64","
+             "\"best_seconds\":%.9f,\"median_seconds\":%.9f,\"worst_seconds\":%.9f,"
+             "\"items_per_second\":%.3f,\"bytes_per_second\":%.3f}\n",
+             bench_case->name, bench->repeat, result.items, result.bytes,
+             seconds[0], median, seconds[ bench->repeat - 1 ],
+             result.items * per_second, result.bytes * per_second );
+    fflush( bench->out );
+    free( seconds );
+    return 0;
+}
+
+static void cleanup_bench( bench_t *bench )
+{
+    char path[1024];
+    for( int i = 0; i < BENCH_STREAM_COUNT; i++ )
+        if( bench->generated[i] )
+        {
+            get_stream_path( bench, i, path, sizeof(path) );
+            remove( path );
+        }
+    if( bench->table_written )
+    {
+        get_path( bench, "table.mp4", path, sizeof(path) );
+        remove( path );
+    }
+    if( bench->fragments_written )
+    {
+        get_path( bench, "fragments.mp4", path, sizeof(path) );
+        remove( path );
+    }
+    cleanup_track( &bench->track[0] );
+    cleanup_track( &bench->track[1] );
+    if( bench->out && bench->out != stdout )
+        fclose( bench->out );
+}
+
+static void display_help( void )
+{
+    eprintf( "\n"
+             "L-SMASH benchmark rev%s  %s\n"
+             "\n"
+             "使用法: benchmark [option]...\n"
+             "  オプション:\n"
+             "    --help                      ヘルプを表示\n"
+             "    --list                      ベンチマークの一覧を表示\n"
+             "    --filter <string>           名前に<string>を含むベンチマークのみを実行\n"
+             "    --repeat <integer>          各ベンチマークの反復回数 [%d]\n"
+             "    --frames <integer>          生成するストリームの映像フレーム数 [%d]\n"
+             "                                音声ストリームは同じ長さで生成されます。\n"
+             "    --video-bitrate <integer>   生成する映像ストリームの平均ビットレート(kbps) [4000]\n"
+             "    --audio-bitrate <integer>   生成する音声ストリームの平均ビットレート(kbps)\n"
+             "                                [ADTS: 128, AC-3: 192] LPCMには適用されません。\n"
+             "    --table-samples <integer>   巨大なサンプルテーブルのサンプル数 [%d]\n"
+             "    --random-accesses <integer> ランダムアクセスの回数 [%d]\n"
+             "    --workdir <string>          作業用ディレクトリ [.]\n"
+             "    --output <string>           結果の出力先 [標準出力]\n"
+             "    --generate <type> <string>  合成ストリームをファイルに生成して終了\n"
+             "                                <type>は264, 265, aac, ac3, wavのいずれか\n"
+             "  結果は各行がJSONオブジェクトの形式で出力されます。\n"
+             "  スループットは計測時間の中央値に基づきます。\n",
+             LSMASH_REV, LSMASH_GIT_HASH, DEFAULT_REPEAT, DEFAULT_FRAMES, DEFAULT_TABLE_SAMPLES, DEFAULT_RANDOM_ACCESSES );
+}
+
+static int generate_stream( bench_t *bench, const char *type_name, const char *path )
+{
+    int type = bench_get_stream_type( type_name );
+    if( type < 0 )
+        return ERROR_MSG( "不明なストリームの種類です: %s\n", type_name );
+    FILE *fp = lsmash_fopen( path, "wb" );
+    if( !fp )
+        return ERROR_MSG( "%sを作成できませんでした。\n", path );
+    bench_stream_param_t param;
+    param.frames  = bench->frames;
+    param.bitrate = (type == BENCH_STREAM_H264 || type == BENCH_STREAM_HEVC) ? bench->video_bitrate : bench->audio_bitrate;
+    param.seed    = type + 1;
+    int err = bench_generate_stream( fp, type, &param );
+    if( fclose( fp ) || err < 0 )
+        return ERROR_MSG( "%sの生成に失敗しました。\n", path );
+    return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+    bench_t bench = { 0 };
+    bench.repeat          = DEFAULT_REPEAT;
+    bench.frames          = DEFAULT_FRAMES;
+    bench.table_samples   = DEFAULT_TABLE_SAMPLES;
+    bench.random_accesses = DEFAULT_RANDOM_ACCESSES;
+    bench.workdir         = ".";
+    bench.out             = stdout;
+    lsmash_get_mainargs( &argc, &argv );
+    const char *output        = NULL;
+    const char *generate_type = NULL;
+    const char *generate_path = NULL;
+    for( int i = 1; i < argc; i++ )
+    {
+#define GET_VALUE( value ) \
+        if( ++i >= argc ) \
+        { \
+            display_help(); \
+            return ERROR_MSG( "%sには値が必要です。\n", argv[i - 1] ); \
+        } \
+        value = argv[i]
+        const char *value;
+        if( !strcasecmp( argv[i], "--help" ) )
+        {
+            display_help();
+            return 0;
+        }
+        else if( !strcasecmp( argv[i], "--list" ) )
+        {
+            for( const bench_case_t *bench_case = bench_cases; bench_case->name; bench_case++ )
+                printf( "%-28s %s\n", bench_case->name, bench_case->description );
+            return 0;
+        }
+        else if( !strcasecmp( argv[i], "--filter" ) )
+        {
+            GET_VALUE( bench.filter );
+        }
+        else if( !strcasecmp( argv[i], "--repeat" ) )
+        {
+            GET_VALUE( value );
+            bench.repeat = atoi( value );
+        }
+        else if( !strcasecmp( argv[i], "--frames" ) )
+        {
+            GET_VALUE( value );
+            bench.frames = atoi( value );
+        }
+        else if( !strcasecmp( argv[i], "--video-bitrate" ) )
+        {
+            GET_VALUE( value );
+            bench.video_bitrate = atoi( value );
+        }
+        else if( !strcasecmp( argv[i], "--audio-bitrate" ) )
+        {
+            GET_VALUE( value );
+            bench.audio_bitrate = atoi( value );
+        }
+        else if( !strcasecmp( argv[i], "--table-samples" ) )
+        {
+            GET_VALUE( value );
+            bench.table_samples = atoi( value );
+        }
+        else if( !strcasecmp( argv[i], "--random-accesses" ) )
+        {
+            GET_VALUE( value );
+            bench.random_accesses = atoi( value );
+        }
+        else if( !strcasecmp( argv[i], "--workdir" ) )
+        {
+            GET_VALUE( bench.workdir );
+        }
+        else if( !strcasecmp( argv[i], "--output" ) )
+        {
+            GET_VALUE( output );
+        }
+        else if( !strcasecmp( argv[i], "--generate" ) )
+        {
+            GET_VALUE( generate_type );
+            GET_VALUE( generate_path );
+        }
+        else
+        {
+            display_help();
+            return ERROR_MSG( "不明なオプションです: %s\n", argv[i] );
+        }
+#undef GET_VALUE
+    }
+    if( bench.repeat <= 0 || bench.frames == 0 || bench.table_samples == 0 )
+        return ERROR_MSG( "無効な値が指定されました。\n" );
+    if( generate_type )
+        return generate_stream( &bench, generate_type, generate_path ) < 0 ? -1 : 0;
+    if( output && !(bench.out = lsmash_fopen( output, "w" )) )
+        return ERROR_MSG( "%sを作成できませんでした。\n", output );
+    fprintf( bench.out,
+             "{\"type\":\"config\",\"version\":\"%d.%d.%d\",\"rev\":\"%s\",\"hash\":\"%s\",\"runs\":%d,"
+             "\"frames\":%"PRIu32",\"video_bitrate\":%"PRIu32",\"aac_bitrate\":%"PRIu32",\"ac3_bitrate\":%"PRIu32","
+             "\"table_samples\":%"PRIu32",\"random_accesses\":%"PRIu32"}\n",
+             LSMASH_VERSION_MAJOR, LSMASH_VERSION_MINOR, LSMASH_VERSION_MICRO, LSMASH_REV, LSMASH_GIT_HASH, bench.repeat,
+             bench.frames,
+             bench_get_stream_bitrate( BENCH_STREAM_H264, bench.video_bitrate ),
+             bench_get_stream_bitrate( BENCH_STREAM_ADTS, bench.audio_bitrate ),
+             bench_get_stream_bitrate( BENCH_STREAM_AC3,  bench.audio_bitrate ),
+             bench.table_samples, bench.random_accesses );
+    int ret = 0;
+    for( const bench_case_t *bench_case = bench_cases; bench_case->name; bench_case++ )
+        if( (!bench.filter || strstr( bench_case->name, bench.filter ))
+         && (ret = run_case( &bench, bench_case )) < 0 )
+            break;
+    cleanup_bench( &bench );
+    return ret < 0 ? -1 : 0;
+}
@@ -0,0 +1,600 @@
+/*****************************************************************************
+ * generator.c
+ *****************************************************************************
+ * Copyright (C) 2017 L-SMASH project
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include "common/osdep.h" /* must be placed first */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsmash.h"
+#include "generator.h"
+
+#define VIDEO_WIDTH          1280
+#define VIDEO_HEIGHT         720
+#define VIDEO_TIMESCALE      30000
+#define VIDEO_TIMEBASE       1001
+#define VIDEO_GOP_LENGTH     30
+#define VIDEO_IDR_WEIGHT     4      /* size of an IDR picture relative to the other pictures */
+#define AUDIO_FREQUENCY      48000
+#define AUDIO_CHANNELS       2
+
+static const char *stream_names[BENCH_STREAM_COUNT] = { "264", "265", "aac", "ac3", "wav" };
+
+static const uint32_t default_bitrates[BENCH_STREAM_COUNT] = { 4000, 4000, 128, 192, 0 };
+
+static const uint32_t ac3_nominal_bitrates[] =
+    {
+        32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 576, 640
+    };
+
+/* Pick the nearest nominal bitrate not exceeding the requested one. */
+static int get_ac3_bitrate_index( uint32_t bitrate )
+{
+    int index = 0;
+    while( index + 1 < sizeof(ac3_nominal_bitrates) / sizeof(ac3_nominal_bitrates[0])
+        && ac3_nominal_bitrates[index + 1] <= bitrate )
+        ++index;
+    return index;
+}
+
+int bench_get_stream_type( const char *name )
+{
+    for( int i = 0; i < BENCH_STREAM_COUNT; i++ )
+        if( !strcmp( name, stream_names[i] ) )
+            return i;
+    return -1;
+}
+
+const char *bench_get_stream_name( bench_stream_type type )
+{
+    return type < BENCH_STREAM_COUNT ? stream_names[type] : NULL;
+}
+
+typedef struct
+{
+    FILE     *fp;
+    uint32_t  random;       /* state of the pseudo random number generator */
+    uint8_t  *rbsp;         /* buffer of a unit to be written */
+    uint8_t  *ebsp;         /* buffer of a NAL unit with emulation prevention */
+    uint32_t  alloc_size;   /* allocated size of 'rbsp' */
+    uint32_t  pos;          /* number of completed bytes in 'rbsp' */
+    uint32_t  byte;         /* pending bits */
+    int       bits;         /* number of pending bits */
+} generator_t;
+
+static uint32_t get_random( generator_t *gen )
+{
+    /* xorshift32 */
+    uint32_t x = gen->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return gen->random = x;
+}
+
+/* Get a size varying randomly within +/-25% around the average. */
+static uint32_t get_random_size( generator_t *gen, uint32_t average )
+{
+    uint32_t range = average / 2;
+    return average - average / 4 + (range ? get_random( gen ) % range : 0);
+}
+
+static int reserve_unit( generator_t *gen, uint32_t size )
+{
+    gen->pos  = 0;
+    gen->byte = 0;
+    gen->bits = 0;
+    if( size <= gen->alloc_size )
+        return 0;
+    uint8_t *rbsp = realloc( gen->rbsp, size );
+    if( !rbsp )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    gen->rbsp = rbsp;
+    /* The worst case of emulation prevention inserts a byte per two bytes. */
+    uint8_t *ebsp = realloc( gen->ebsp, size / 2 * 3 + 3 );
+    if( !ebsp )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    gen->ebsp       = ebsp;
+    gen->alloc_size = size;
+    return 0;
+}
+
+static void put_bits( generator_t *gen, int n, uint32_t value )
+{
+    for( int i = n - 1; i >= 0; i-- )
+    {
+        gen->byte = (gen->byte << 1) | ((value >> i) & 1);
+        if( ++gen->bits == 8 )
+        {
+            gen->rbsp[ gen->pos++ ] = gen->byte;
+            gen->byte = 0;
+            gen->bits = 0;
+        }
+    }
+}
+
+static void put_ue( generator_t *gen, uint32_t value )
+{
+    int length = 0;
+    while( (uint64_t)(value + 1) >> (length + 1) )
+        ++length;
+    put_bits( gen, length, 0 );
+    put_bits( gen, length + 1, value + 1 );
+}
+
+static void put_se( generator_t *gen, int32_t value )
+{
+    put_ue( gen, value > 0 ? 2 * (uint32_t)value - 1 : 2 * (uint32_t)-value );
+}
+
+/* Put random bytes after aligning with 'bit' like cabac_alignment_one_bit and byte_alignment(). */
+static void put_payload( generator_t *gen, int bit, uint32_t size )
+{
+    while( gen->bits )
+        put_bits( gen, 1, bit );
+    for( uint32_t i = 0; i < size; i++ )
+        gen->rbsp[ gen->pos++ ] = get_random( gen ) % 255 + 1;
+}
+
+static void put_trailing_bits( generator_t *gen )
+{
+    put_bits( gen, 1, 1 );
+    while( gen->bits )
+        put_bits( gen, 1, 0 );
+}
+
+static int write_unit( generator_t *gen )
+{
+    return fwrite( gen->rbsp, 1, gen->pos, gen->fp ) == gen->pos ? 0 : LSMASH_ERR_NAMELESS;
+}
+
+static int write_nal_unit( generator_t *gen, const uint8_t *header, uint32_t header_size )
+{
+    static const uint8_t start_code[4] = { 0x00, 0x00, 0x00, 0x01 };
+    uint32_t size  = 0;
+    int      zeros = 0;
+    for( uint32_t i = 0; i < gen->pos; i++ )
+    {
+        uint8_t byte = gen->rbsp[i];
+        if( zeros >= 2 && byte <= 0x03 )
+        {
+            gen->ebsp[ size++ ] = 0x03;     /* emulation_prevention_three_byte */
+            zeros = 0;
+        }
+        gen->ebsp[ size++ ] = byte;
+        zeros = byte ? 0 : zeros + 1;
+    }
+    if( fwrite( start_code, 1, 4, gen->fp ) != 4
+     || fwrite( header, 1, header_size, gen->fp ) != header_size
+     || fwrite( gen->ebsp, 1, size, gen->fp ) != size )
+        return LSMASH_ERR_NAMELESS;
+    return 0;
+}
+
+/* Get the size of each picture so that the average bitrate matches. */
+static void get_picture_sizes( uint32_t bitrate, uint32_t *idr_size, uint32_t *other_size )
+{
+    uint64_t gop_size = (uint64_t)bitrate * 1000 / 8 * VIDEO_GOP_LENGTH * VIDEO_TIMEBASE / VIDEO_TIMESCALE;
+    *other_size = gop_size / (VIDEO_IDR_WEIGHT + VIDEO_GOP_LENGTH - 1) + 1;
+    *idr_size   = *other_size * VIDEO_IDR_WEIGHT;
+}
+
+static int generate_h264( generator_t *gen, const bench_stream_param_t *param, uint32_t bitrate )
+{
+    uint32_t idr_size;
+    uint32_t other_size;
+    get_picture_sizes( bitrate, &idr_size, &other_size );
+    int err;
+    for( uint32_t i = 0; i < param->frames; i++ )
+    {
+        uint32_t frame_num = i % VIDEO_GOP_LENGTH;
+        int      idr       = (frame_num == 0);
+        if( idr )
+        {
+            /* seq_parameter_set_rbsp() of Constrained Baseline profile with POC type 2, i.e. no reordering */
+            if( (err = reserve_unit( gen, 64 )) < 0 )
+                return err;
+            put_bits( gen, 8, 66 );                 /* profile_idc */
+            put_bits( gen, 8, 0xC0 );               /* constraint_set0_flag and constraint_set1_flag */
+            put_bits( gen, 8, 31 );                 /* level_idc */
+            put_ue( gen, 0 );                       /* seq_parameter_set_id */
+            put_ue( gen, 0 );                       /* log2_max_frame_num_minus4 */
+            put_ue( gen, 2 );                       /* pic_order_cnt_type */
+            put_ue( gen, 1 );                       /* max_num_ref_frames */
+            put_bits( gen, 1, 0 );                  /* gaps_in_frame_num_value_allowed_flag */
+            put_ue( gen, VIDEO_WIDTH  / 16 - 1 );   /* pic_width_in_mbs_minus1 */
+            put_ue( gen, VIDEO_HEIGHT / 16 - 1 );   /* pic_height_in_map_units_minus1 */
+            put_bits( gen, 1, 1 );                  /* frame_mbs_only_flag */
+            put_bits( gen, 1, 1 );                  /* direct_8x8_inference_flag */
+            put_bits( gen, 1, 0 );                  /* frame_cropping_flag */
+            put_bits( gen, 1, 1 );                  /* vui_parameters_present_flag */
+            put_bits( gen, 4, 0 );                  /* aspect_ratio_info_present_flag, overscan_info_present_flag,
+                                                     * video_signal_type_present_flag and chroma_loc_info_present_flag */
+            put_bits( gen, 1, 1 );                  /* timing_info_present_flag */
+            put_bits( gen, 32, VIDEO_TIMEBASE );    /* num_units_in_tick */
+            put_bits( gen, 32, VIDEO_TIMESCALE * 2 );   /* time_scale */
+            put_bits( gen, 1, 1 );                  /* fixed_frame_rate_flag */
+            put_bits( gen, 3, 0 );                  /* nal_hrd_parameters_present_flag, vcl_hrd_parameters_present_flag
+                                                     * and pic_struct_present_flag */
+            put_bits( gen, 1, 1 );                  /* bitstream_restriction_flag */
+            put_bits( gen, 1, 1 );                  /* motion_vectors_over_pic_boundaries_flag */
+            put_ue( gen, 0 );                       /* max_bytes_per_pic_denom */
+            put_ue( gen, 0 );                       /* max_bits_per_mb_denom */
+            put_ue( gen, 16 );                      /* log2_max_mv_length_horizontal */
+            put_ue( gen, 16 );                      /* log2_max_mv_length_vertical */
+            put_ue( gen, 0 );                       /* max_num_reorder_frames */
+            put_ue( gen, 1 );                       /* max_dec_frame_buffering */
+            put_trailing_bits( gen );
+            if( (err = write_nal_unit( gen, (const uint8_t []){ 0x67 }, 1 )) < 0 )
+                return err;
+            /* pic_parameter_set_rbsp() */
+            if( (err = reserve_unit( gen, 64 )) < 0 )
+                return err;
+            put_ue( gen, 0 );                       /* pic_parameter_set_id */
+            put_ue( gen, 0 );                       /* seq_parameter_set_id */
+            put_bits( gen, 2, 0 );                  /* entropy_coding_mode_flag and bottom_field_pic_order_in_frame_present_flag */
+            put_ue( gen, 0 );                       /* num_slice_groups_minus1 */
+            put_ue( gen, 0 );                       /* num_ref_idx_l0_default_active_minus1 */
+            put_ue( gen, 0 );                       /* num_ref_idx_l1_default_active_minus1 */
+            put_bits( gen, 3, 0 );                  /* weighted_pred_flag and weighted_bipred_idc */
+            put_se( gen, 0 );                       /* pic_init_qp_minus26 */
+            put_se( gen, 0 );                       /* pic_init_qs_minus26 */
+            put_se( gen, 0 );                       /* chroma_qp_index_offset */
+            put_bits( gen, 1, 1 );                  /* deblocking_filter_control_present_flag */
+            put_bits( gen, 2, 0 );                  /* constrained_intra_pred_flag and redundant_pic_cnt_present_flag */
+            put_trailing_bits( gen );
+            if( (err = write_nal_unit( gen, (const uint8_t []){ 0x68 }, 1 )) < 0 )
+                return err;
+        }
+        /* slice_layer_without_partitioning_rbsp() */
+        uint32_t payload_size = idr ? get_random_size( gen, idr_size ) : get_random_size( gen, other_size );
+        if( (err = reserve_unit( gen, payload_size + 64 )) < 0 )
+            return err;
+        put_ue( gen, 0 );                           /* first_mb_in_slice */
+        put_ue( gen, idr ? 7 : 5 );                 /* slice_type: I or P */
+        put_ue( gen, 0 );                           /* pic_parameter_set_id */
+        put_bits( gen, 4, frame_num % 16 );         /* frame_num */
+        if( idr )
+            put_ue( gen, (i / VIDEO_GOP_LENGTH) & 1 );  /* idr_pic_id */
+        else
+        {
+            put_bits( gen, 1, 0 );                  /* num_ref_idx_active_override_flag */
+            put_bits( gen, 1, 0 );                  /* ref_pic_list_modification_flag_l0 */
+        }
+        if( idr )
+            put_bits( gen, 2, 0 );                  /* no_output_of_prior_pics_flag and long_term_reference_flag */
+        else
+            put_bits( gen, 1, 0 );                  /* adaptive_ref_pic_marking_mode_flag */
+        put_se( gen, 0 );                           /* slice_qp_delta */
+        put_ue( gen, 1 );                           /* disable_deblocking_filter_idc */
+        put_payload( gen, 1, payload_size );
+        put_trailing_bits( gen );
+        if( (err = write_nal_unit( gen, (const uint8_t []){ idr ? 0x65 : 0x41 }, 1 )) < 0 )
+            return err;
+    }
+    return 0;
+}
+
+static void put_hevc_profile_tier_level( generator_t *gen )
+{
+    put_bits( gen, 2, 0 );                          /* general_profile_space */
+    put_bits( gen, 1, 0 );                          /* general_tier_flag */
+    put_bits( gen, 5, 1 );                          /* general_profile_idc: Main */
+    put_bits( gen, 32, 0x60000000 );                /* general_profile_compatibility_flag[1] and [2] */
+    put_bits( gen, 4, 0x9 );                        /* general_progressive_source_flag and general_frame_only_constraint_flag */
+    put_bits( gen, 32, 0 );                         /* general_reserved_zero_43bits and general_inbld_flag */
+    put_bits( gen, 12, 0 );
+    put_bits( gen, 8, 93 );                         /* general_level_idc: 3.1 */
+}
+
+static int generate_hevc( generator_t *gen, const bench_stream_param_t *param, uint32_t bitrate )
+{
+    uint32_t idr_size;
+    uint32_t other_size;
+    get_picture_sizes( bitrate, &idr_size, &other_size );
+    int err;
+    for( uint32_t i = 0; i < param->frames; i++ )
+    {
+        uint32_t poc = i % VIDEO_GOP_LENGTH;
+        int      idr = (poc == 0);
+        if( idr )
+        {
+            /* video_parameter_set_rbsp() */
+            if( (err = reserve_unit( gen, 64 )) < 0 )
+                return err;
+            put_bits( gen, 4, 0 );                  /* vps_video_parameter_set_id */
+            put_bits( gen, 2, 3 );                  /* vps_base_layer_internal_flag and vps_base_layer_available_flag */
+            put_bits( gen, 6, 0 );                  /* vps_max_layers_minus1 */
+            put_bits( gen, 3, 0 );                  /* vps_max_sub_layers_minus1 */
+            put_bits( gen, 1, 1 );                  /* vps_temporal_id_nesting_flag */
+            put_bits( gen, 16, 0xFFFF );            /* vps_reserved_0xffff_16bits */
+            put_hevc_profile_tier_level( gen );
+            put_bits( gen, 1, 1 );                  /* vps_sub_layer_ordering_info_present_flag */
+            put_ue( gen, 1 );                       /* vps_max_dec_pic_buffering_minus1 */
+            put_ue( gen, 0 );                       /* vps_max_num_reorder_pics */
+            put_ue( gen, 0 );                       /* vps_max_latency_increase_plus1 */
+            put_bits( gen, 6, 0 );                  /* vps_max_layer_id */
+            put_ue( gen, 0 );                       /* vps_num_layer_sets_minus1 */
+            put_bits( gen, 1, 1 );                  /* vps_timing_info_present_flag */
+            put_bits( gen, 32, VIDEO_TIMEBASE );    /* vps_num_units_in_tick */
+            put_bits( gen, 32, VIDEO_TIMESCALE );   /* vps_time_scale */
+            put_bits( gen, 1, 0 );                  /* vps_poc_proportional_to_timing_flag */
+            put_ue( gen, 0 );                       /* vps_num_hrd_parameters */
+            put_bits( gen, 1, 0 );                  /* vps_extension_flag */
+            put_trailing_bits( gen );
+            if( (err = write_nal_unit( gen, (const uint8_t []){ 32 << 1, 1 }, 2 )) < 0 )
+                return err;
+            /* seq_parameter_set_rbsp() */
+            if( (err = reserve_unit( gen, 64 )) < 0 )
+                return err;
+            put_bits( gen, 4, 0 );                  /* sps_video_parameter_set_id */
+            put_bits( gen, 3, 0 );                  /* sps_max_sub_layers_minus1 */
+            put_bits( gen, 1, 1 );                  /* sps_temporal_id_nesting_flag */
+            put_hevc_profile_tier_level( gen );
+            put_ue( gen, 0 );                       /* sps_seq_parameter_set_id */
+            put_ue( gen, 1 );                       /* chroma_format_idc */
+            put_ue( gen, VIDEO_WIDTH );             /* pic_width_in_luma_samples */
+            put_ue( gen, VIDEO_HEIGHT );            /* pic_height_in_luma_samples */
+            put_bits( gen, 1, 0 );                  /* conformance_window_flag */
+            put_ue( gen, 0 );                       /* bit_depth_luma_minus8 */
+            put_ue( gen, 0 );                       /* bit_depth_chroma_minus8 */
+            put_ue( gen, 4 );                       /* log2_max_pic_order_cnt_lsb_minus4 */
+            put_bits( gen, 1, 1 );                  /* sps_sub_layer_ordering_info_present_flag */
+            put_ue( gen, 1 );                       /* sps_max_dec_pic_buffering_minus1 */
+            put_ue( gen, 0 );                       /* sps_max_num_reorder_pics */
+            put_ue( gen, 0 );                       /* sps_max_latency_increase_plus1 */
+            put_ue( gen, 0 );                       /* log2_min_luma_coding_block_size_minus3 */
+            put_ue( gen, 3 );                       /* log2_diff_max_min_luma_coding_block_size */
+            put_ue( gen, 0 );                       /* log2_min_luma_transform_block_size_minus2 */
+            put_ue( gen, 3 );                       /* log2_diff_max_min_luma_transform_block_size */
+            put_ue( gen, 0 );                       /* max_transform_hierarchy_depth_inter */
+            put_ue( gen, 0 );                       /* max_transform_hierarchy_depth_intra */
+            put_bits( gen, 4, 0 );                  /* scaling_list_enabled_flag, amp_enabled_flag,
+                                                     * sample_adaptive_offset_enabled_flag and pcm_enabled_flag */
+            put_ue( gen, 1 );                       /* num_short_term_ref_pic_sets */
+            put_ue( gen, 1 );                       /* num_negative_pics */
+            put_ue( gen, 0 );                       /* num_positive_pics */
+            put_ue( gen, 0 );                       /* delta_poc_s0_minus1 */
+            put_bits( gen, 1, 1 );                  /* used_by_curr_pic_s0_flag */
+            put_bits( gen, 3, 0 );                  /* long_term_ref_pics_present_flag, sps_temporal_mvp_enabled_flag
+                                                     * and strong_intra_smoothing_enabled_flag */
+            put_bits( gen, 1, 1 );                  /* vui_parameters_present_flag */
+            put_bits( gen, 8, 0 );                  /* aspect_ratio_info_present_flag, overscan_info_present_flag,
+                                                     * video_signal_type_present_flag, chroma_loc_info_present_flag,
+                                                     * neutral_chroma_indication_flag, field_seq_flag,
+                                                     * frame_field_info_present_flag and default_display_window_flag */
+            put_bits( gen, 1, 1 );                  /* vui_timing_info_present_flag */
+            put_bits( gen, 32, VIDEO_TIMEBASE );    /* vui_num_units_in_tick */
+            put_bits( gen, 32, VIDEO_TIMESCALE );   /* vui_time_scale */
+            put_bits( gen, 1, 0 );                  /* vui_poc_proportional_to_timing_flag */
+            put_bits( gen, 1, 1 );                  /* vui_hrd_parameters_present_flag */
+            /* hrd_parameters() to signal a constant frame rate */
+            put_bits( gen, 2, 0 );                  /* nal_hrd_parameters_present_flag and vcl_hrd_parameters_present_flag */
+            put_bits( gen, 1, 1 );                  /* fixed_pic_rate_general_flag */
+            put_ue( gen, 0 );                       /* elemental_duration_in_tc_minus1 */
+            put_ue( gen, 0 );                       /* cpb_cnt_minus1 */
+            put_bits( gen, 1, 0 );                  /* bitstream_restriction_flag */
+            put_bits( gen, 1, 0 );                  /* sps_extension_present_flag */
+            put_trailing_bits( gen );
+            if( (err = write_nal_unit( gen, (const uint8_t []){ 33 << 1, 1 }, 2 )) < 0 )
+                return err;
+            /* pic_parameter_set_rbsp() */
+            if( (err = reserve_unit( gen, 64 )) < 0 )
+                return err;
+            put_ue( gen, 0 );                       /* pps_pic_parameter_set_id */
+            put_ue( gen, 0 );                       /* pps_seq_parameter_set_id */
+            put_bits( gen, 7, 0 );                  /* dependent_slice_segments_enabled_flag, output_flag_present_flag,
+                                                     * num_extra_slice_header_bits, sign_data_hiding_enabled_flag
+                                                     * and cabac_init_present_flag */
+            put_ue( gen, 0 );                       /* num_ref_idx_l0_default_active_minus1 */
+            put_ue( gen, 0 );                       /* num_ref_idx_l1_default_active_minus1 */
+            put_se( gen, 0 );                       /* init_qp_minus26 */
+            put_bits( gen, 3, 0 );                  /* constrained_intra_pred_flag, transform_skip_enabled_flag
+                                                     * and cu_qp_delta_enabled_flag */
+            put_se( gen, 0 );                       /* pps_cb_qp_offset */
+            put_se( gen, 0 );                       /* pps_cr_qp_offset */
+            put_bits( gen, 10, 0 );                 /* pps_slice_chroma_qp_offsets_present_flag, weighted_pred_flag,
+                                                     * weighted_bipred_flag, transquant_bypass_enabled_flag,
+                                                     * tiles_enabled_flag, entropy_coding_sync_enabled_flag,
+                                                     * pps_loop_filter_across_slices_enabled_flag,
+                                                     * deblocking_filter_control_present_flag,
+                                                     * pps_scaling_list_data_present_flag and lists_modification_present_flag */
+            put_ue( gen, 0 );                       /* log2_parallel_merge_level_minus2 */
+            put_bits( gen, 2, 0 );                  /* slice_segment_header_extension_present_flag and pps_extension_present_flag */
+            put_trailing_bits( gen );
+            if( (err = write_nal_unit( gen, (const uint8_t []){ 34 << 1, 1 }, 2 )) < 0 )
+                return err;
+        }
+        /* slice_segment_layer_rbsp() */
+        uint32_t payload_size = idr ? get_random_size( gen, idr_size ) : get_random_size( gen, other_size );
+        if( (err = reserve_unit( gen, payload_size + 64 )) < 0 )
+            return err;
+        put_bits( gen, 1, 1 );                      /* first_slice_segment_in_pic_flag */
+        if( idr )
+            put_bits( gen, 1, 0 );                  /* no_output_of_prior_pics_flag */
+        put_ue( gen, 0 );                           /* slice_pic_parameter_set_id */
+        put_ue( gen, idr ? 2 : 1 );                 /* slice_type: I or P */
+        if( !idr )
+        {
+            put_bits( gen, 8, poc );                /* slice_pic_order_cnt_lsb */
+            put_bits( gen, 1, 1 );                  /* short_term_ref_pic_set_sps_flag */
+            put_bits( gen, 1, 0 );                  /* num_ref_idx_active_override_flag */
+            put_ue( gen, 0 );                       /* five_minus_max_num_merge_cand */
+        }
+        put_se( gen, 0 );                           /* slice_qp_delta */
+        put_bits( gen, 1, 1 );                      /* byte_alignment() */
+        put_payload( gen, 0, payload_size );
+        put_trailing_bits( gen );
+        if( (err = write_nal_unit( gen, (const uint8_t []){ (idr ? 19 : 1) << 1, 1 }, 2 )) < 0 )
+            return err;
+    }
+    return 0;
+}
+
+/* Get the number of audio frames lasting as long as the video frames. */
+static uint32_t get_audio_frame_count( uint32_t video_frames, uint32_t samples_per_frame )
+{
+    uint64_t samples = (uint64_t)video_frames * VIDEO_TIMEBASE * AUDIO_FREQUENCY / VIDEO_TIMESCALE;
+    return (samples + samples_per_frame - 1) / samples_per_frame;
+}
+
+static int generate_adts( generator_t *gen, const bench_stream_param_t *param, uint32_t bitrate )
+{
+    uint32_t average_size = (uint64_t)bitrate * 1000 / 8 * 1024 / AUDIO_FREQUENCY;
+    uint32_t frame_count  = get_audio_frame_count( param->frames, 1024 );
+    for( uint32_t i = 0; i < frame_count; i++ )
+    {
+        uint32_t payload_size = get_random_size( gen, average_size );
+        uint32_t frame_length = payload_size + 7 < 0x1FFF ? payload_size + 7 : 0x1FFF;
+        int err = reserve_unit( gen, frame_length );
+        if( err < 0 )
+            return err;
+        /* adts_fixed_header() and adts_variable_header() without CRC */
+        put_bits( gen, 12, 0xFFF );                 /* syncword */
+        put_bits( gen, 1, 0 );                      /* ID: MPEG-4 */
+        put_bits( gen, 2, 0 );                      /* layer */
+        put_bits( gen, 1, 1 );                      /* protection_absent */
+        put_bits( gen, 2, 1 );                      /* profile_ObjectType: AAC LC */
+        put_bits( gen, 4, 3 );                      /* sampling_frequency_index: 48000Hz */
+        put_bits( gen, 1, 0 );                      /* private_bit */
+        put_bits( gen, 3, AUDIO_CHANNELS );         /* channel_configuration */
+        put_bits( gen, 4, 0 );                      /* original_copy, home, copyright_identification_bit
+                                                     * and copyright_identification_start */
+        put_bits( gen, 13, frame_length );          /* aac_frame_length */
+        put_bits( gen, 11, 0x7FF );                 /* adts_buffer_fullness */
+        put_bits( gen, 2, 0 );                      /* number_of_raw_data_blocks_in_frame */
+        put_payload( gen, 0, frame_length - 7 );
+        if( (err = write_unit( gen )) < 0 )
+            return err;
+    }
+    return 0;
+}
+
+static int generate_ac3( generator_t *gen, const bench_stream_param_t *param, uint32_t bitrate )
+{
+    int index = get_ac3_bitrate_index( bitrate );
+    uint32_t frame_size  = ac3_nominal_bitrates[index] * 4;    /* bytes per syncframe at 48kHz */
+    uint32_t frame_count = get_audio_frame_count( param->frames, 1536 );
+    for( uint32_t i = 0; i < frame_count; i++ )
+    {
+        int err = reserve_unit( gen, frame_size );
+        if( err < 0 )
+            return err;
+        /* syncinfo() */
+        put_bits( gen, 16, 0x0B77 );                /* syncword */
+        put_bits( gen, 16, 0 );                     /* crc1 */
+        put_bits( gen, 2, 0 );                      /* fscod: 48kHz */
+        put_bits( gen, 6, index * 2 );              /* frmsizecod */
+        /* bsi() for 2/0 mode */
+        put_bits( gen, 5, 8 );                      /* bsid */
+        put_bits( gen, 3, 0 );                      /* bsmod */
+        put_bits( gen, 3, 2 );                      /* acmod */
+        put_bits( gen, 2, 0 );                      /* dsurmod */
+        put_bits( gen, 1, 0 );                      /* lfeon */
+        put_bits( gen, 5, 31 );                     /* dialnorm */
+        put_bits( gen, 3, 0 );                      /* compre, langcode and audprodie */
+        put_bits( gen, 2, 1 );                      /* copyrightb and origbs */
+        put_bits( gen, 3, 0 );                      /* timecod1e, timecod2e and addbsie */
+        put_payload( gen, 0, frame_size - 9 );
+        if( (err = write_unit( gen )) < 0 )
+            return err;
+    }
+    return 0;
+}
+
+static int generate_lpcm( generator_t *gen, const bench_stream_param_t *param )
+{
+    uint32_t block_align = AUDIO_CHANNELS * 2;
+    uint64_t samples     = (uint64_t)param->frames * VIDEO_TIMEBASE * AUDIO_FREQUENCY / VIDEO_TIMESCALE;
+    if( samples * block_align > UINT32_MAX - 36 )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    uint32_t data_size = samples * block_align;
+    int err = reserve_unit( gen, 64 * 1024 );
+    if( err < 0 )
+        return err;
+    /* RIFF header and 'fmt ' chunk of WAVE_FORMAT_PCM in little endian */
+    const uint32_t header[] =
+        {
+            0x46464952, 36 + data_size, 0x45564157,                     /* 'RIFF', size, 'WAVE' */
+            0x20746D66, 16, (AUDIO_CHANNELS << 16) | 1, AUDIO_FREQUENCY,/* 'fmt ', size, nChannels and wFormatTag, nSamplesPerSec */
+            AUDIO_FREQUENCY * block_align, (16 << 16) | block_align,    /* nAvgBytesPerSec, wBitsPerSample and nBlockAlign */
+            0x61746164, data_size                                       /* 'data', size */
+        };
+    for( int i = 0; i < sizeof(header) / sizeof(header[0]); i++ )
+        put_bits( gen, 32, ((header[i] & 0xFF) << 24) | ((header[i] & 0xFF00) << 8)
+                         | ((header[i] >> 8) & 0xFF00) | (header[i] >> 24) );
+    if( (err = write_unit( gen )) < 0 )
+        return err;
+    for( uint32_t remain = data_size; remain; )
+    {
+        uint32_t size = remain < gen->alloc_size ? remain : gen->alloc_size;
+        reserve_unit( gen, size );
+        put_payload( gen, 0, size );
+        if( (err = write_unit( gen )) < 0 )
+            return err;
+        remain -= size;
+    }
+    return 0;
+}
+
+uint32_t bench_get_stream_bitrate( bench_stream_type type, uint32_t bitrate )
+{
+    if( type >= BENCH_STREAM_COUNT )
+        return 0;
+    if( type == BENCH_STREAM_LPCM )
+        return AUDIO_FREQUENCY * AUDIO_CHANNELS * 16 / 1000;
+    if( bitrate == 0 )
+        bitrate = default_bitrates[type];
+    if( type == BENCH_STREAM_AC3 )
+        bitrate = ac3_nominal_bitrates[ get_ac3_bitrate_index( bitrate ) ];
+    return bitrate;
+}
+
+int bench_generate_stream( FILE *fp, bench_stream_type type, const bench_stream_param_t *param )
+{
+    if( !fp || !param || type >= BENCH_STREAM_COUNT )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    generator_t gen = { 0 };
+    gen.fp     = fp;
+    gen.random = param->seed ? param->seed : 1;
+    uint32_t bitrate = param->bitrate ? param->bitrate : default_bitrates[type];
+    int err;
+    switch( type )
+    {
+        case BENCH_STREAM_H264 :
+            err = generate_h264( &gen, param, bitrate );
+            break;
+        case BENCH_STREAM_HEVC :
+            err = generate_hevc( &gen, param, bitrate );
+            break;
+        case BENCH_STREAM_ADTS :
+            err = generate_adts( &gen, param, bitrate );
+            break;
+        case BENCH_STREAM_AC3 :
+            err = generate_ac3( &gen, param, bitrate );
+            break;
+        default :
+            err = generate_lpcm( &gen, param );
+            break;
+    }
+    free( gen.rbsp );
+    free( gen.ebsp );
+    return err;
+}
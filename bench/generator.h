@@ -0,0 +1,64 @@
+/*****************************************************************************
+ * generator.h
+ *****************************************************************************
+ * Copyright (C) 2017 L-SMASH project
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#ifndef BENCH_GENERATOR_H
+#define BENCH_GENERATOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Synthetic elementary streams
+ * Every stream has valid headers which the importers parse, and random payloads.
+ * Video streams are 1280x720 at 30000/1001 fps with an IDR picture every 30 pictures.
+ * Audio streams are 48kHz stereo and last as long as the video stream with the same number of frames. */
+typedef enum
+{
+    BENCH_STREAM_H264 = 0,
+    BENCH_STREAM_HEVC,
+    BENCH_STREAM_ADTS,
+    BENCH_STREAM_AC3,
+    BENCH_STREAM_LPCM,
+    BENCH_STREAM_COUNT
+} bench_stream_type;
+
+typedef struct
+{
+    uint32_t frames;    /* number of video frames which determines the duration of the stream */
+    uint32_t bitrate;   /* average bitrate in kbit/s
+                         * 0 means the default of each type. This is ignored for LPCM. */
+    uint32_t seed;      /* seed of the random payloads */
+} bench_stream_param_t;
+
+/* Get the type of a stream by its name, which is also used as the file extension.
+ * Return a negative value if not found. */
+int bench_get_stream_type( const char *name );
+
+const char *bench_get_stream_name( bench_stream_type type );
+
+/* Get the average bitrate in kbit/s which a stream of a given type is generated at for a requested bitrate.
+ * 0 as the requested bitrate means the default of the type. */
+uint32_t bench_get_stream_bitrate( bench_stream_type type, uint32_t bitrate );
+
+/* Write a stream into a given file.
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int bench_generate_stream( FILE *fp, bench_stream_type type, const bench_stream_param_t *param );
+
+#endif
@@ -52,7 +52,216 @@ static void display_help( void )
              "    --version      バージョン情報を表示\n"
              "    --box          ボックス構造をダンプ\n"
              "    --chapter      チャプターリストを展開\n"
-             "    --timestamp    メディアのタイムスタンプをダンプ\n" );
+             "    --timestamp    メディアのタイムスタンプをダンプ\n"
+             "    --timestamp-format <文字列>\n"
+             "                   タイムスタンプの出力形式を指定し、タイムスタンプをダンプ [text]\n"
+             "                     - text   : 人が読むためのテキスト\n"
+             "                     - csv    : track_ID,timescale,dts,cts の行\n"
+             "                     - ndjson : 1サンプルにつき1行のJSONオブジェクト\n"
+             "                     - packed : track_ID, timescale (各32ビット), DTS, CTS (各64ビット)\n"
+             "                                をリトルエンディアンで並べた24バイトのレコード\n" );
+}
+
+typedef enum
+{
+    TIMESTAMP_FORMAT_TEXT = 0,
+    TIMESTAMP_FORMAT_CSV,
+    TIMESTAMP_FORMAT_NDJSON,
+    TIMESTAMP_FORMAT_PACKED,
+} timestamp_format;
+
+/* Timestamps are formatted into this buffer and written out when it fills up
+ * so that dumping millions of samples doesn't spend most of the time in stdio. */
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+#define TIMESTAMP_BATCH_SIZE 4096
+
+typedef struct
+{
+    FILE   *stream;
+    int     error;
+    size_t  pos;
+    uint8_t data[OUTPUT_BUFFER_SIZE];
+} output_buffer_t;
+
+static void output_flush( output_buffer_t *out )
+{
+    if( out->pos && fwrite( out->data, 1, out->pos, out->stream ) != out->pos )
+        out->error = 1;
+    out->pos = 0;
+}
+
+/* Make room for 'size' bytes, which shall be much smaller than the buffer size. */
+static uint8_t *output_reserve( output_buffer_t *out, size_t size )
+{
+    if( out->pos + size > OUTPUT_BUFFER_SIZE )
+        output_flush( out );
+    return &out->data[ out->pos ];
+}
+
+static void output_string( output_buffer_t *out, const char *string )
+{
+    size_t length = strlen( string );
+    memcpy( output_reserve( out, length ), string, length );
+    out->pos += length;
+}
+
+static void output_uint64( output_buffer_t *out, uint64_t value )
+{
+    char digits[20];
+    int  n = 0;
+    do
+    {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while( value );
+    uint8_t *p = output_reserve( out, n );
+    for( int i = 0; i < n; i++ )
+        p[i] = digits[n - 1 - i];
+    out->pos += n;
+}
+
+static void output_le( output_buffer_t *out, uint64_t value, int size )
+{
+    uint8_t *p = output_reserve( out, size );
+    for( int i = 0; i < size; i++ )
+        p[i] = (value >> (8 * i)) & 0xff;
+    out->pos += size;
+}
+
+static void output_track_timestamps
+(
+    output_buffer_t   *out,
+    timestamp_format   format,
+    uint32_t           track_ID,
+    uint32_t           timescale,
+    uint32_t           timeline_shift,
+    lsmash_media_ts_t *ts,
+    uint32_t           count
+)
+{
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        uint64_t dts = ts[i].dts;
+        uint64_t cts = ts[i].cts + timeline_shift;
+        switch( format )
+        {
+            case TIMESTAMP_FORMAT_TEXT :
+                output_string( out, "DTS = " );
+                output_uint64( out, dts );
+                output_string( out, ", CTS = " );
+                output_uint64( out, cts );
+                output_string( out, "\n" );
+                break;
+            case TIMESTAMP_FORMAT_CSV :
+                output_uint64( out, track_ID );
+                output_string( out, "," );
+                output_uint64( out, timescale );
+                output_string( out, "," );
+                output_uint64( out, dts );
+                output_string( out, "," );
+                output_uint64( out, cts );
+                output_string( out, "\n" );
+                break;
+            case TIMESTAMP_FORMAT_NDJSON :
+                output_string( out, "{\"track_ID\":" );
+                output_uint64( out, track_ID );
+                output_string( out, ",\"timescale\":" );
+                output_uint64( out, timescale );
+                output_string( out, ",\"dts\":" );
+                output_uint64( out, dts );
+                output_string( out, ",\"cts\":" );
+                output_uint64( out, cts );
+                output_string( out, "}\n" );
+                break;
+            case TIMESTAMP_FORMAT_PACKED :
+                output_le( out, track_ID,  4 );
+                output_le( out, timescale, 4 );
+                output_le( out, dts,       8 );
+                output_le( out, cts,       8 );
+                break;
+        }
+    }
+}
+
+/* Return NULL if successful.
+ * Return an error message otherwise. */
+static const char *dump_timestamps( lsmash_root_t *root, timestamp_format format )
+{
+    output_buffer_t   *out = lsmash_malloc( sizeof(output_buffer_t) );
+    lsmash_media_ts_t *ts  = lsmash_malloc( TIMESTAMP_BATCH_SIZE * sizeof(lsmash_media_ts_t) );
+    if( !out || !ts )
+    {
+        lsmash_free( out );
+        lsmash_free( ts );
+        return "出力バッファの割り当てに失敗しました。\n";
+    }
+    out->stream = stdout;
+    out->error  = 0;
+    out->pos    = 0;
+#ifdef _WIN32
+    /* Binary records shall not be altered by the newline conversion in text mode. */
+    if( format == TIMESTAMP_FORMAT_PACKED )
+        _setmode( _fileno( stdout ), _O_BINARY );
+#endif
+    if( format == TIMESTAMP_FORMAT_CSV )
+        output_string( out, "track_ID,timescale,dts,cts\n" );
+    const char *message = NULL;
+    lsmash_movie_parameters_t movie_param;
+    lsmash_initialize_movie_parameters( &movie_param );
+    lsmash_get_movie_parameters( root, &movie_param );
+    uint32_t num_tracks = movie_param.number_of_tracks;
+    for( uint32_t track_number = 1; track_number <= num_tracks && !out->error; track_number++ )
+    {
+        uint32_t track_ID = lsmash_get_track_ID( root, track_number );
+        if( !track_ID )
+        {
+            message = "track_IDの取得に失敗しました。\n";
+            break;
+        }
+        lsmash_media_parameters_t media_param;
+        lsmash_initialize_media_parameters( &media_param );
+        if( lsmash_get_media_parameters( root, track_ID, &media_param ) )
+        {
+            message = "メディアパラメータの取得に失敗しました。\n";
+            break;
+        }
+        /* The iterator reads the sample tables directly without constructing the media timeline. */
+        uint32_t timeline_shift;
+        lsmash_media_ts_iterator_t *iterator = lsmash_create_media_ts_iterator( root, track_ID );
+        if( !iterator
+         || lsmash_get_composition_to_decode_shift_from_media_ts_iterator( iterator, &timeline_shift ) )
+        {
+            lsmash_destroy_media_ts_iterator( iterator );
+            message = "タイムスタンプを取得できませんでした。\n";
+            break;
+        }
+        if( format == TIMESTAMP_FORMAT_TEXT )
+        {
+            output_string( out, "track_ID: " );
+            output_uint64( out, track_ID );
+            output_string( out, "\nメディアタイムスケール: " );
+            output_uint64( out, media_param.timescale );
+            output_string( out, "\n" );
+        }
+        int count;
+        while( (count = lsmash_get_next_media_timestamps( iterator, ts, TIMESTAMP_BATCH_SIZE )) > 0 )
+            output_track_timestamps( out, format, track_ID, media_param.timescale, timeline_shift, ts, count );
+        lsmash_destroy_media_ts_iterator( iterator );
+        if( count < 0 )
+        {
+            message = "タイムスタンプを取得できませんでした。\n";
+            break;
+        }
+        if( format == TIMESTAMP_FORMAT_TEXT )
+            output_string( out, "\n" );
+    }
+    output_flush( out );
+    fflush( out->stream );
+    if( !message && out->error )
+        message = "タイムスタンプを出力できませんでした。\n";
+    lsmash_free( out );
+    lsmash_free( ts );
+    return message;
 }
 
 static int boxdumper_error
@@ -90,27 +299,51 @@ int main( int argc, char *argv[] )
     }
     int dump_box = 1;
     int chapter = 0;
+    timestamp_format ts_format = TIMESTAMP_FORMAT_TEXT;
     char *filename;
     lsmash_get_mainargs( &argc, &argv );
-    if( argc > 2 )
+    for( int i = 1; i < argc - 1; i++ )
     {
-        if( !strcasecmp( argv[1], "--box" ) )
+        if( !strcasecmp( argv[i], "--box" ) )
             DO_NOTHING;
-        else if( !strcasecmp( argv[1], "--chapter" ) )
+        else if( !strcasecmp( argv[i], "--chapter" ) )
             chapter = 1;
-        else if( !strcasecmp( argv[1], "--timestamp" ) )
+        else if( !strcasecmp( argv[i], "--timestamp" ) )
             dump_box = 0;
+        else if( !strcasecmp( argv[i], "--timestamp-format" ) && i + 2 < argc )
+        {
+            static const struct
+            {
+                const char      *name;
+                timestamp_format format;
+            } format_table[] =
+                {
+                    { "text",   TIMESTAMP_FORMAT_TEXT   },
+                    { "csv",    TIMESTAMP_FORMAT_CSV    },
+                    { "ndjson", TIMESTAMP_FORMAT_NDJSON },
+                    { "packed", TIMESTAMP_FORMAT_PACKED },
+                    { NULL,     TIMESTAMP_FORMAT_TEXT   }
+                };
+            ++i;
+            int j;
+            for( j = 0; format_table[j].name; j++ )
+                if( !strcasecmp( argv[i], format_table[j].name ) )
+                    break;
+            if( !format_table[j].name )
+            {
+                display_help();
+                return -1;
+            }
+            ts_format = format_table[j].format;
+            dump_box  = 0;
+        }
         else
         {
             display_help();
             return -1;
         }
-        filename = argv[2];
-    }
-    else
-    {
-        filename = argv[1];
     }
+    filename = argv[argc - 1];
     /* Open the input file. */
     lsmash_root_t *root = lsmash_create_root();
     if( !root )
@@ -123,6 +356,9 @@ int main( int argc, char *argv[] )
         return BOXDUMPER_ERR( "入力ファイルを開けませんでした。\n" );
     if( dump_box )
         file_param.mode |= LSMASH_FILE_MODE_DUMP;
+    else if( !chapter )
+        /* Movie fragments are not parsed since the timestamps are read from their track runs directly. */
+        file_param.mode |= LSMASH_FILE_MODE_LAZY;
     lsmash_file_t *file = lsmash_set_file( root, &file_param );
     if( !file )
         return BOXDUMPER_ERR( "ROOTにファイルを追加できませんでした。\n" );
@@ -141,40 +377,9 @@ int main( int argc, char *argv[] )
     }
     else
     {
-        lsmash_movie_parameters_t movie_param;
-        lsmash_initialize_movie_parameters( &movie_param );
-        lsmash_get_movie_parameters( root, &movie_param );
-        uint32_t num_tracks = movie_param.number_of_tracks;
-        for( uint32_t track_number = 1; track_number <= num_tracks; track_number++ )
-        {
-            uint32_t track_ID = lsmash_get_track_ID( root, track_number );
-            if( !track_ID )
-                return BOXDUMPER_ERR( "track_IDの取得に失敗しました。\n" );
-            lsmash_media_parameters_t media_param;
-            lsmash_initialize_media_parameters( &media_param );
-            if( lsmash_get_media_parameters( root, track_ID, &media_param ) )
-                return BOXDUMPER_ERR( "メディアパラメータの取得に失敗しました。\n" );
-            if( lsmash_construct_timeline( root, track_ID ) )
-                return BOXDUMPER_ERR( "タイムラインの構築に失敗しました。\n" );
-            uint32_t timeline_shift;
-            if( lsmash_get_composition_to_decode_shift_from_media_timeline( root, track_ID, &timeline_shift ) )
-                return BOXDUMPER_ERR( "タイムスタンプを取得できませんでした。\n" );
-            lsmash_media_ts_list_t ts_list;
-            if( lsmash_get_media_timestamps( root, track_ID, &ts_list ) )
-                return BOXDUMPER_ERR( "タイムスタンプを取得できませんでした。\n" );
-            fprintf( stdout, "track_ID: %"PRIu32"\n", track_ID );
-            fprintf( stdout, "メディアタイムスケール: %"PRIu32"\n", media_param.timescale );
-            lsmash_media_ts_t *ts_array = ts_list.timestamp;
-            if( !ts_array )
-            {
-                fprintf( stdout, "\n" );
-                continue;
-            }
-            for( uint32_t i = 0; i < ts_list.sample_count; i++ )
-                fprintf( stdout, "DTS = %"PRIu64", CTS = %"PRIu64"\n", ts_array[i].dts, ts_array[i].cts + timeline_shift );
-            lsmash_free( ts_array );
-            fprintf( stdout, "\n" );
-        }
+        const char *message = dump_timestamps( root, ts_format );
+        if( message )
+            return BOXDUMPER_ERR( message );
     }
     lsmash_destroy_root( root );
     return 0;
@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <errno.h>
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -60,6 +61,20 @@ int lsmash_write_lsmash_indicator( lsmash_root_t *root )
     return lsmash_write_top_level_box( free_box );
 }
 
+int parse_size_option( const char *arg, uint64_t *size )
+{
+    /* Reject anything strtoull() would silently accept, such as a sign, garbage after the digits or an overflow. */
+    if( !arg || *arg < '0' || *arg > '9' )
+        return -1;
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull( arg, &end, 10 );
+    if( errno || *end != '\0' )
+        return -1;
+    *size = value;
+    return 0;
+}
+
 /*** Dry Run tools ***/
 
 typedef struct
@@ -103,6 +118,15 @@ static int64_t dry_seek( void *opaque, int64_t offset, int whence )
     return stream->pos;
 }
 
+static int64_t dry_shift( void *opaque, uint64_t offset, uint64_t shift )
+{
+    dry_run_stream_t *stream = (dry_run_stream_t *)opaque;
+    if( stream->size < offset )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    stream->size += shift;
+    return stream->size;
+}
+
 int dry_open_file
 (
     const char               *filename,
@@ -155,6 +179,17 @@ int dry_open_file
     return 0;
 }
 
+int dry_set_file_callbacks
+(
+    lsmash_file_t            *file,
+    lsmash_file_parameters_t *param
+)
+{
+    if( !file || !param )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    return lsmash_set_file_shift( file, param->seek ? dry_shift : NULL );
+}
+
 int dry_close_file
 (
     lsmash_file_parameters_t *param
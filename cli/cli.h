@@ -41,6 +41,13 @@
 
 int lsmash_write_lsmash_indicator( lsmash_root_t *root );
 
+/* Parse a non-negative decimal integer taking the whole string.
+ * Return 0 if successful, or -1 if the string is not such an integer or is out of range. */
+int parse_size_option( const char *arg, uint64_t *size );
+
+/* Max number of buffers queued for the background writer by --write-queue */
+#define MAX_WRITE_QUEUE_LENGTH 1024
+
 int dry_open_file
 (
     const char               *filename,
@@ -48,6 +55,13 @@ int dry_open_file
     lsmash_file_parameters_t *param
 );
 
+/* Set the optional callbacks of a file added by lsmash_set_file() with the parameters given by dry_open_file(). */
+int dry_set_file_callbacks
+(
+    lsmash_file_t            *file,
+    lsmash_file_parameters_t *param
+);
+
 int dry_close_file
 (
     lsmash_file_parameters_t *param
@@ -65,7 +65,10 @@ typedef struct
     int      optimize_pd;
     int      timeline_shift;
     int      compact_size_table;
+    int      streaming;
     uint32_t interleave;
+    uint32_t write_queue_length;
+    uint64_t moov_space;
     uint32_t movie_timescale;
     uint32_t num_of_brands;
     uint32_t brands[MAX_NUM_OF_BRANDS];
@@ -115,14 +118,15 @@ typedef struct
 
 typedef struct
 {
-    input_option_t opt;
-    lsmash_root_t *root;
-    char          *file_name;
-    importer_t    *importer;
-    input_track_t  track[MAX_NUM_OF_TRACKS];
-    uint32_t       num_of_tracks;
-    uint32_t       num_of_active_tracks;
-    uint32_t       current_track_number;
+    input_option_t       opt;
+    lsmash_root_t       *root;
+    char                *file_name;
+    importer_t          *importer;
+    importer_pipeline_t *pipeline;
+    input_track_t        track[MAX_NUM_OF_TRACKS];
+    uint32_t             num_of_tracks;
+    uint32_t             num_of_active_tracks;
+    uint32_t             current_track_number;
 } input_t;
 
 typedef struct
@@ -178,8 +182,9 @@ static void cleanup_muxer( muxer_t *muxer )
     if( !muxer )
         return;
     output_t *output = &muxer->output;
-    lsmash_close_file( &output->file.param );
+    /* The root must be destroyed first since the background writer may still be writing into the file. */
     lsmash_destroy_root( output->root );
+    lsmash_close_file( &output->file.param );
     if( output->file.movie.track )
     {
         for( uint32_t i = 0; i < output->file.movie.num_of_tracks; i++ )
@@ -192,6 +197,8 @@ static void cleanup_muxer( muxer_t *muxer )
     for( uint32_t i = 0; i < muxer->num_of_inputs; i++ )
     {
         input_t *input = &muxer->input[i];
+        /* The pipeline must be stopped first since its worker may still be parsing the input. */
+        lsmash_importer_stop_pipeline( input->pipeline );
         lsmash_importer_close( input->importer );
         for( uint32_t j = 0; j < input->num_of_tracks; j++ )
             lsmash_cleanup_summary( input->track[j].summary );
@@ -244,7 +251,11 @@ static void display_help( void )
              "    --help                    ヘルプを表示\n"
              "    --version                 バージョン情報を表示\n"
              "    --optimize-pd             進行的ダウンロードに最適化\n"
+             "    --moov-space <整数>       ムービーヘッダのための領域をファイルの先頭にバイト単位で予約\n"
+             "                              ムービーヘッダが収まる場合、メディアデータを移動しません。\n"
              "    --interleave <整数>    ミリ秒インターリーブのために時間間隔を指定\n"
+             "    --write-queue <整数>      バックグラウンドで書き出すバッファの最大数を指定\n"
+             "                              0の場合、バックグラウンドでは書き出しません。(既定値: 0, 最大値: 1024)\n"
              "    --file-format <文字列>    出力形式を指定\n"
              "                              コンマ区切りにより複数の形式を指定可能\n"
              "                              最初のものは最良のものとして認識される\n"
@@ -261,6 +272,9 @@ static void display_help( void )
              "                              このオプションはトラックオプションにより上書きされます。\n"
              "    --compact-size-table      可能ならサンプルサイズテーブルを圧縮\n"
              "    --movie-timescale <整数>  映像のタイムスケールを指定\n"
+             "    --streaming               入力ストリームを事前解析せずに1回の読み込みで取り込む\n"
+             "                              H.264/HEVCではパイプや標準入力(-i -)からの入力が可能になります。\n"
+             "                              VC-1はパイプや標準入力から取り込めません。\n"
              "出力形式:\n"
              "    mp4, mov, 3gp, 3g2, m4a, m4v\n"
              "\n"
@@ -279,8 +293,8 @@ static void display_help( void )
              "                              メディアストリーム内でこれを変更しないでください。\n"
              "トラックオプションの使用方法:\n"
              "    -i input?[track_option1],[track_option2]...\n"
-             "\n"
-             "iTunes メタデータ:\n"
+             "\n" );
+    eprintf( "iTunes メタデータ:\n"
              "    --album-name <文字列>     アルバム名\n"
              "    --artist <文字列>         アーティスト\n"
              "    --comment <文字列>        ユーザーコメント\n"
@@ -479,6 +493,21 @@ static int parse_global_options( int argc, char **argv, muxer_t *muxer )
                 return ERROR_MSG( "--interleaveオプションが2回指定されました。\n" );
             opt->interleave = atoi( argv[i] );
         }
+        else if( !strcasecmp( argv[i], "--write-queue" ) )
+        {
+            CHECK_NEXT_ARG;
+            uint64_t queue_length;
+            if( parse_size_option( argv[i], &queue_length ) < 0
+             || queue_length > MAX_WRITE_QUEUE_LENGTH )
+                return ERROR_MSG( "%s は --write-queue に対し不正です。\n", argv[i] );
+            opt->write_queue_length = queue_length;
+        }
+        else if( !strcasecmp( argv[i], "--moov-space" ) )
+        {
+            CHECK_NEXT_ARG;
+            if( parse_size_option( argv[i], &opt->moov_space ) < 0 )
+                return ERROR_MSG( "%s は --moov-space に対し不正です。\n", argv[i] );
+        }
         else if( !strcasecmp( argv[i], "--file-format" ) )
         {
             CHECK_NEXT_ARG;
@@ -525,6 +554,8 @@ static int parse_global_options( int argc, char **argv, muxer_t *muxer )
             opt->timeline_shift = 1;
         else if( !strcasecmp( argv[i], "compact-size-table" ) )
             opt->compact_size_table = 1;
+        else if( !strcasecmp( argv[i], "--streaming" ) )
+            opt->streaming = 1;
         else if( !strcasecmp( argv[i], "--chapter" ) )
         {
             CHECK_NEXT_ARG;
@@ -745,7 +776,9 @@ static int open_input_files( muxer_t *muxer )
         if( !root )
             return ERROR_MSG( "入力ファイルのROOTの作成に失敗しました。\n" );
         input->root = root;
-        input->importer = lsmash_importer_open( root, input->file_name, "auto" );
+        input->importer = opt->streaming
+                        ? lsmash_importer_open_stream( root, input->file_name, "auto" )
+                        : lsmash_importer_open       ( root, input->file_name, "auto" );
         if( !input->importer )
             return ERROR_MSG( "入力ファイルを開けませんでした。\n" );
         input->num_of_tracks = lsmash_importer_get_track_count( input->importer );
@@ -894,6 +927,9 @@ static int prepare_output( muxer_t *muxer )
     out_file->fh = lsmash_set_file( output->root, file_param );
     if( !out_file->fh )
         return ERROR_MSG( "出力ファイルをROOTに追加できませんでした。\n" );
+    if( opt->write_queue_length
+     && lsmash_set_file_write_queue_length( out_file->fh, opt->write_queue_length ) < 0 )
+        return ERROR_MSG( "書き込みキューの設定に失敗しました。\n" );
     /* Initialize movie */
     lsmash_movie_parameters_t movie_param;
     lsmash_initialize_movie_parameters( &movie_param );
@@ -906,6 +942,9 @@ static int prepare_output( muxer_t *muxer )
         return ERROR_MSG( "著作権表示をすべての映像に付加できませんでした。\n" );
     if( set_itunes_metadata( output, opt ) )
         return ERROR_MSG( "iTunesメタデータの設定に失敗しました。\n" );
+    if( opt->moov_space
+     && lsmash_reserve_movie_size( output->root, opt->moov_space ) )
+        return ERROR_MSG( "ムービーヘッダのための領域の予約に失敗しました。\n" );
     out_movie->current_track_number = 1;
     for( uint32_t current_input_number = 1; current_input_number <= muxer->num_of_inputs; current_input_number++ )
     {
@@ -1075,6 +1114,8 @@ static void set_reference_chapter_track( output_t *output, option_t *opt )
     lsmash_create_reference_chapter_track( output->root, opt->chap_track, opt->chap_file );
 }
 
+#define PIPELINE_QUEUE_LENGTH 16
+
 static int do_mux( muxer_t *muxer )
 {
 #define LSMASH_MAX( a, b ) ((a) > (b) ? (a) : (b))
@@ -1083,6 +1124,16 @@ static int do_mux( muxer_t *muxer )
     output_t       *output    = &muxer->output;
     output_movie_t *out_movie = &output->file.movie;
     set_reference_chapter_track( output, opt );
+    /* Parse every input on its own thread so that parsing one doesn't wait for the others. */
+    for( uint32_t i = 0; i < muxer->num_of_inputs; i++ )
+    {
+        input_t *input = &muxer->input[i];
+        if( input->num_of_active_tracks == 0 )
+            continue;
+        input->pipeline = lsmash_importer_start_pipeline( input->importer, PIPELINE_QUEUE_LENGTH );
+        if( !input->pipeline )
+            return ERROR_MSG( "インポートパイプラインの開始に失敗しました。\n" );
+    }
     double   largest_dts = 0;
     uint32_t current_input_number = 1;
     uint32_t num_consecutive_sample_skip = 0;
@@ -1099,8 +1150,8 @@ static int do_mux( muxer_t *muxer )
             /* Get a new sample data if the track doesn't hold any one. */
             if( !sample )
             {
-                /* lsmash_importer_get_access_unit() returns 1 if there're any changes in stream's properties. */
-                int ret = lsmash_importer_get_access_unit( input->importer, input->current_track_number, &sample );
+                /* lsmash_importer_pipeline_get_access_unit() returns 1 if there're any changes in stream's properties. */
+                int ret = lsmash_importer_pipeline_get_access_unit( input->pipeline, input->current_track_number, &sample );
                 if( ret == LSMASH_ERR_MEMORY_ALLOC )
                     return ERROR_MSG( "バッファの確保に失敗しました。\n" );
                 else if( ret <= -1 )
@@ -1115,7 +1166,7 @@ static int do_mux( muxer_t *muxer )
                     /* Add a new sample entry if no duplications within the output track. */
                     int got_new_sample_entry = 1;
                     input_track_t *in_track = &input->track[input->current_track_number - 1];
-                    lsmash_summary_t *summary = lsmash_duplicate_summary( input->importer, input->current_track_number );
+                    lsmash_summary_t *summary = lsmash_importer_pipeline_take_summary( input->pipeline, input->current_track_number );
                     uint32_t summary_count = lsmash_count_summary( output->root, out_track->track_ID );
                     for( uint32_t desc_index = 1; desc_index <= summary_count; desc_index++ )
                     {
@@ -1149,7 +1200,7 @@ static int do_mux( muxer_t *muxer )
                     lsmash_delete_sample( sample );
                     sample = NULL;
                     out_track->active = 0;
-                    out_track->last_delta = lsmash_importer_get_last_delta( input->importer, input->current_track_number );
+                    out_track->last_delta = lsmash_importer_pipeline_get_last_delta( input->pipeline, input->current_track_number );
                     if( out_track->last_delta == 0 )
                         ERROR_MSG( "最終サンプルデルタの取得に失敗しました。\n" );
                     out_track->last_delta *= out_track->timebase;
@@ -36,6 +36,8 @@ typedef struct
     uint32_t                 *summary_remap;
     uint64_t                  skip_dt_interval;
     uint64_t                  last_sample_dts;
+    uint32_t                  frag_chunk_sample_count;  /* number of samples in the current chunk of the movie fragment */
+    double                    frag_chunk_first_dts;     /* DTS of the first sample in the current chunk in seconds */
     lsmash_track_parameters_t track_param;
     lsmash_media_parameters_t media_param;
 } output_track_t;
@@ -124,8 +126,9 @@ typedef struct
 
 typedef struct
 {
-    lsmash_root_t *root;
-    input_file_t   file;
+    lsmash_root_t       *root;
+    lsmash_prefetcher_t *prefetcher;
+    input_file_t         file;
 } input_t;
 
 typedef struct
@@ -153,11 +156,16 @@ typedef struct
     uint16_t             default_language;
     uint64_t             max_chunk_size;
     uint32_t             max_chunk_duration_in_ms;
+    uint32_t             write_queue_length;
+    uint64_t             moov_space;
+    int                  auto_moov_space;
     uint32_t             frag_base_track;
     uint32_t             subseg_per_seg;
     int                  dash;
     int                  compact_size_table;
     double               min_frag_duration;
+    uint32_t             frag_chunk_samples;
+    uint32_t             frag_chunk_duration_in_ms;
     int                  dry_run;
 } remuxer_t;
 
@@ -171,6 +179,8 @@ static void cleanup_input_movie( input_t *input )
 {
     if( !input )
         return;
+    lsmash_destroy_prefetcher( input->prefetcher );
+    input->prefetcher = NULL;
     input_movie_t *in_movie = &input->file.movie;
     if( in_movie->itunes_metadata )
     {
@@ -213,6 +223,9 @@ static void cleanup_output_movie( output_t *output )
             lsmash_free( out_movie->track[i].summary_remap );
         lsmash_freep( &out_movie->track );
     }
+    /* The root must be destroyed first since the background writer may still be writing into the files. */
+    lsmash_destroy_root( output->root );
+    output->root = NULL;
     if( !(output->file.seg_param.mode & LSMASH_FILE_MODE_INITIALIZATION) )
     {
         lsmash_freep( &output->file.seg_param.brands );
@@ -222,8 +235,6 @@ static void cleanup_output_movie( output_t *output )
     lsmash_freep( &output->file.param.brands );
     if( output->file.close )
         output->file.close( &output->file.param );
-    lsmash_destroy_root( output->root );
-    output->root = NULL;
 }
 
 static void cleanup_remuxer( remuxer_t *remuxer )
@@ -317,12 +328,28 @@ static void display_help( void )
              "  --max-chunk-size <整数>\n"
              "      チャンクの最大サイズをバイト単位で指定\n"
              "      このオプションが指定されなかった場合、自動的に4*1024*1024になります。\n"
-             "  --fragment <整数>\n"
+             "  --write-queue <整数>\n"
+             "      バックグラウンドで書き出すバッファの最大数を1024以下で指定\n"
+             "      このオプションが指定されなかった場合、または0の場合、書き出しはリマックスと同じスレッドで行われます。\n"
+             "  --moov-space <整数/auto>\n"
+             "      ムービーヘッダのための領域をファイルの先頭にバイト単位で予約\n"
+             "      ムービーヘッダが収まる場合、メディアデータを移動しません。\n"
+             "      autoの場合、入力トラックのサンプル数から見積もります。\n" );
+    eprintf( "  --fragment <整数>\n"
              "      ランダムアクセス可能ポイントごとの断片化を有効化\n"
              "      断片化のもととなるトラックを設定します。\n"
              "  --min-frag-duration <float>\n"
              "      フラグメントを許容する最小時間を指定\n"
              "      --fragment が使用されている必要があります。\n"
+             "  --frag-chunk-samples <整数>\n"
+             "      フラグメントをチャンクに分割する最大サンプル数を指定\n"
+             "      各チャンクはムービーフラグメントボックスとメディアデータボックスの対として直ちに書き出されます。\n"
+             "      いずれかのトラックが上限に達すると、全トラックのチャンクが書き出されます。\n"
+             "      --fragment が使用されている必要があります。\n"
+             "  --frag-chunk-duration <整数>\n"
+             "      フラグメントをチャンクに分割する最大時間をミリ秒単位で指定\n"
+             "      いずれかのトラックが上限に達すると、全トラックのチャンクが書き出されます。\n"
+             "      --fragment が使用されている必要があります。\n"
              "  --dash <整数>\n"
              "      DASH ISOBMFF-basedメディア分割を有効化\n"
              "      セグメントごとのサブセグメント数を指定します。\n"
@@ -568,6 +595,12 @@ static int get_movie( input_t *input, char *input_name )
             WARNING_MSG( "タイムラインの構築に失敗しました。\n" );
             continue;
         }
+        /* Read samples chunk by chunk since they are fetched in decoding order. */
+        if( lsmash_set_read_ahead_chunk_count_in_media_timeline( input->root, in_track[i].track_ID, 1 ) )
+        {
+            WARNING_MSG( "先読みの設定に失敗しました。\n" );
+            continue;
+        }
         if( lsmash_get_last_sample_delta_from_media_timeline( input->root, in_track[i].track_ID, &in_track[i].last_sample_delta ) )
         {
             WARNING_MSG( "最終サンプルデルタの取得に失敗しました。\n" );
@@ -761,6 +794,29 @@ static int parse_cli_option( int argc, char **argv, remuxer_t *remuxer )
             if( remuxer->max_chunk_size == 0 )
                 FAILED_PARSE_CLI_OPTION( "%s は --max-chunk-size に対し不正です。\n", argv[i] );
         }
+        else if( !strcasecmp( argv[i], "--write-queue" ) )
+        {
+            if( ++i == argc )
+                FAILED_PARSE_CLI_OPTION( "--write-queue には引数が必須です。\n" );
+            uint64_t queue_length;
+            if( parse_size_option( argv[i], &queue_length ) < 0
+             || queue_length > MAX_WRITE_QUEUE_LENGTH )
+                FAILED_PARSE_CLI_OPTION( "%s は --write-queue に対し不正です。\n", argv[i] );
+            remuxer->write_queue_length = queue_length;
+        }
+        else if( !strcasecmp( argv[i], "--moov-space" ) )
+        {
+            if( ++i == argc )
+                FAILED_PARSE_CLI_OPTION( "--moov-space には引数が必須です。\n" );
+            if( !strcasecmp( argv[i], "auto" ) )
+                remuxer->auto_moov_space = 1;
+            else
+            {
+                if( parse_size_option( argv[i], &remuxer->moov_space ) < 0
+                 || remuxer->moov_space == 0 )
+                    FAILED_PARSE_CLI_OPTION( "%s は --moov-space に対し不正です。\n", argv[i] );
+            }
+        }
         else if( !strcasecmp( argv[i], "--fragment" ) )
         {
             if( ++i == argc )
@@ -779,6 +835,30 @@ static int parse_cli_option( int argc, char **argv, remuxer_t *remuxer )
             else if( remuxer->frag_base_track == 0 )
                 FAILED_PARSE_CLI_OPTION( "--min-frag-duration の使用には --fragment が設定されている必要があります。\n" );
         }
+        else if( !strcasecmp( argv[i], "--frag-chunk-samples" ) )
+        {
+            if( ++i == argc )
+                FAILED_PARSE_CLI_OPTION( "--frag-chunk-samples には引数が必須です。\n" );
+            uint64_t limit;
+            if( parse_size_option( argv[i], &limit ) < 0
+             || limit == 0 || limit > UINT32_MAX )
+                FAILED_PARSE_CLI_OPTION( "%s は --frag-chunk-samples に対し不正です。\n", argv[i] );
+            else if( remuxer->frag_base_track == 0 )
+                FAILED_PARSE_CLI_OPTION( "--frag-chunk-samples の使用には --fragment が設定されている必要があります。\n" );
+            remuxer->frag_chunk_samples = limit;
+        }
+        else if( !strcasecmp( argv[i], "--frag-chunk-duration" ) )
+        {
+            if( ++i == argc )
+                FAILED_PARSE_CLI_OPTION( "--frag-chunk-duration には引数が必須です。\n" );
+            uint64_t limit;
+            if( parse_size_option( argv[i], &limit ) < 0
+             || limit == 0 || limit > UINT32_MAX )
+                FAILED_PARSE_CLI_OPTION( "%s は --frag-chunk-duration に対し不正です。\n", argv[i] );
+            else if( remuxer->frag_base_track == 0 )
+                FAILED_PARSE_CLI_OPTION( "--frag-chunk-duration の使用には --fragment が設定されている必要があります。\n" );
+            remuxer->frag_chunk_duration_in_ms = limit;
+        }
         else if( !strcasecmp( argv[i], "--dash" ) )
         {
             if( ++i == argc )
@@ -1059,6 +1139,12 @@ static int set_movie_parameters( remuxer_t *remuxer )
     out_file->fh = lsmash_set_file( output->root, &out_file->param );
     if( !out_file->fh )
         return ERROR_MSG( "ROOTに出力ファイルを追加できませんでした。\n" );
+    if( remuxer->dry_run
+     && dry_set_file_callbacks( out_file->fh, &out_file->param ) < 0 )
+        return ERROR_MSG( "出力ファイルのコールバックの設定に失敗しました。\n" );
+    if( remuxer->write_queue_length
+     && lsmash_set_file_write_queue_length( out_file->fh, remuxer->write_queue_length ) < 0 )
+        return ERROR_MSG( "書き込みキューの設定に失敗しました。\n" );
     out_file->seg_param = out_file->param;
     /* Check whether a reference chapter track is allowed or not. */
     if( remuxer->chap_file )
@@ -1176,6 +1262,38 @@ static void exclude_invalid_output_track( output_t *output, output_track_t *out_
     in_track->active = 0;
 }
 
+/* Estimate the size of the movie header from the number of samples to be remuxed.
+ * Each sample takes at most about 24 bytes in the sample tables, i.e. the entries of stts, ctts, stsz and stss.
+ * The rest of the tables and the other boxes are covered by the margin per track and per movie. */
+static uint64_t estimate_moov_space( remuxer_t *remuxer )
+{
+    uint64_t size = 4096;
+    for( int i = 0; i < remuxer->num_input; i++ )
+    {
+        input_movie_t *in_movie = &remuxer->input[i].file.movie;
+        for( uint32_t j = 0; j < in_movie->num_tracks; j++ )
+        {
+            input_track_t *in_track = &in_movie->track[j];
+            if( !in_track->active )
+                continue;
+            uint32_t sample_count = lsmash_get_sample_count_in_media_timeline( remuxer->input[i].root, in_track->track_ID );
+            size += (uint64_t)sample_count * 24 + 4096;
+        }
+    }
+    return size;
+}
+
+static void reserve_moov_space( remuxer_t *remuxer )
+{
+    if( remuxer->frag_base_track
+     || (remuxer->moov_space == 0 && !remuxer->auto_moov_space) )
+        return;
+    uint64_t moov_space = remuxer->auto_moov_space ? estimate_moov_space( remuxer ) : remuxer->moov_space;
+    /* If failed, the whole media data is moved when finishing as usual. */
+    if( lsmash_reserve_movie_size( remuxer->output->root, moov_space ) < 0 )
+        WARNING_MSG( "ムービーヘッダのための領域の予約に失敗しました。\n" );
+}
+
 static int prepare_output( remuxer_t *remuxer )
 {
     input_t        *input     = remuxer->input;
@@ -1292,11 +1410,13 @@ static int prepare_output( remuxer_t *remuxer )
             out_track->current_sample_number = 1;
             out_track->skip_dt_interval      = 0;
             out_track->last_sample_dts       = 0;
+            out_track->frag_chunk_sample_count = 0;
             ++ out_movie->current_track_number;
         }
     }
     if( out_movie->num_tracks == 0 )
         return ERROR_MSG( "出力映像の生成に失敗しました。\n" );
+    reserve_moov_space( remuxer );
     out_movie->current_track_number = 1;
     output->current_seg_number = 1;
     return 0;
@@ -1324,7 +1444,9 @@ static int flush_movie_fragment( remuxer_t *remuxer )
             if( !in_track->active )
                 continue;
             output_track_t *out_track = &out_movie->track[out_current_track_number - 1];
-            if( !in_track->reach_end_of_media_timeline )
+            /* The last sample may have been appended before the end of the media timeline is detected. */
+            if( !in_track->reach_end_of_media_timeline
+             && in_track->current_sample_number <= lsmash_get_sample_count_in_media_timeline( in->root, in_track->track_ID ) )
             {
                 lsmash_sample_t sample;
                 if( lsmash_get_sample_info_from_media_timeline( in->root, in_track->track_ID, in_track->current_sample_number, &sample ) < 0 )
@@ -1343,6 +1465,35 @@ static int flush_movie_fragment( remuxer_t *remuxer )
     return 0;
 }
 
+static void reset_fragment_chunks( output_movie_t *out_movie )
+{
+    for( uint32_t i = 0; i < out_movie->num_tracks; i++ )
+        out_movie->track[i].frag_chunk_sample_count = 0;
+}
+
+/* The chunks are delimited here instead of by the library since the library can delimit only a chunk of a single track.
+ * Return 1 if the current chunk shall be flushed before appending a sample of a given DTS into a given track. */
+static int is_fragment_chunk_full( remuxer_t *remuxer, output_track_t *out_track, double dts )
+{
+    if( out_track->frag_chunk_sample_count == 0 )
+        return 0;
+    if( remuxer->frag_chunk_samples
+     && out_track->frag_chunk_sample_count >= remuxer->frag_chunk_samples )
+        return 1;
+    return remuxer->frag_chunk_duration_in_ms
+        && (dts - out_track->frag_chunk_first_dts) * 1e3 >= remuxer->frag_chunk_duration_in_ms;
+}
+
+static int flush_fragment_chunk( remuxer_t *remuxer )
+{
+    if( flush_movie_fragment( remuxer ) < 0 )
+        return -1;
+    if( lsmash_create_fragment_chunk( remuxer->output->root ) < 0 )
+        return ERROR_MSG( "映像フラグメントのチャンクの作成に失敗しました。\n" );
+    reset_fragment_chunks( &remuxer->output->file.movie );
+    return 0;
+}
+
 static int moov_to_front_callback( void *param, uint64_t written_movie_size, uint64_t total_movie_size )
 {
     static uint32_t progress_pos = 0;
@@ -1438,6 +1589,12 @@ static int switch_segment( remuxer_t *remuxer )
     lsmash_file_t *segment = lsmash_set_file( output->root, &seg_param );
     if( !segment )
         return ERROR_MSG( "ROOTにセグメント出力ファイルを追加できませんでした。\n" );
+    if( remuxer->dry_run
+     && dry_set_file_callbacks( segment, &seg_param ) < 0 )
+        return ERROR_MSG( "セグメント出力ファイルのコールバックの設定に失敗しました。\n" );
+    if( remuxer->write_queue_length
+     && lsmash_set_file_write_queue_length( segment, remuxer->write_queue_length ) < 0 )
+        return ERROR_MSG( "書き込みキューの設定に失敗しました。\n" );
     /* Switch to the next segment.
      * After switching, close the previous segment if the previous is not the initialization segment. */
     if( lsmash_switch_media_segment( output->root, segment, &moov_to_front ) < 0 )
@@ -1491,6 +1648,31 @@ static void adjust_timestamp( output_track_t *out_track, lsmash_sample_t *sample
     }
 }
 
+#define PREFETCH_QUEUE_LENGTH 64
+
+static int start_prefetchers( remuxer_t *remuxer )
+{
+    /* Read samples of each input file by its own thread so that inputs are read in parallel. */
+    for( int i = 0; i < remuxer->num_input; i++ )
+    {
+        input_t       *input    = &remuxer->input[i];
+        input_movie_t *in_movie = &input->file.movie;
+        input->prefetcher = lsmash_create_prefetcher( input->root, PREFETCH_QUEUE_LENGTH );
+        if( !input->prefetcher )
+            return ERROR_MSG( "先読みスレッドの作成に失敗しました。\n" );
+        for( uint32_t j = 0; j < in_movie->num_tracks; j++ )
+        {
+            input_track_t *in_track = &in_movie->track[j];
+            if( in_track->active
+             && lsmash_add_prefetch_track( input->prefetcher, in_track->track_ID, in_track->current_sample_number ) )
+                return ERROR_MSG( "先読みするトラックの追加に失敗しました。\n" );
+        }
+        if( lsmash_start_prefetcher( input->prefetcher ) )
+            return ERROR_MSG( "先読みスレッドの開始に失敗しました。\n" );
+    }
+    return 0;
+}
+
 static int do_remux( remuxer_t *remuxer )
 {
 #define LSMASH_MAX( a, b ) ((a) > (b) ? (a) : (b))
@@ -1498,6 +1680,8 @@ static int do_remux( remuxer_t *remuxer )
     output_t       *output    = remuxer->output;
     output_movie_t *out_movie = &output->file.movie;
     set_reference_chapter_track( remuxer );
+    if( start_prefetchers( remuxer ) )
+        return -1;
     double   largest_dts                 = 0;   /* in seconds */
     double   frag_base_dts               = 0;   /* in seconds */
     uint32_t input_movie_number          = 1;
@@ -1531,7 +1715,11 @@ static int do_remux( remuxer_t *remuxer )
             /* Get a new sample data if the track doesn't hold any one. */
             if( !sample )
             {
-                sample = lsmash_get_sample_from_media_timeline( in->root, in_track->track_ID, in_track->current_sample_number );
+                if( lsmash_get_prefetched_sample( in->prefetcher, in_track->track_ID, &sample ) < 0 )
+                {
+                    ERROR_MSG( "サンプルの入手に失敗しました。\n" );
+                    break;
+                }
                 if( sample )
                 {
                     output_track_t *out_track = &out_movie->track[ out_movie->current_track_number - 1 ];
@@ -1542,25 +1730,11 @@ static int do_remux( remuxer_t *remuxer )
                 }
                 else
                 {
-                    if( lsmash_check_sample_existence_in_media_timeline( in->root, in_track->track_ID, in_track->current_sample_number ) )
-                    {
-                        ERROR_MSG( "サンプルの入手に失敗しました。\n" );
-                        break;
-                    }
-                    lsmash_sample_t sample_info = { 0 };
-                    if( lsmash_get_sample_info_from_media_timeline( in->root, in_track->track_ID, in_track->current_sample_number, &sample_info ) < 0 )
-                    {
-                        /* No more appendable samples in this track. */
-                        in_track->sample = NULL;
-                        in_track->reach_end_of_media_timeline = 1;
-                        if( --num_active_input_tracks == 0 )
-                            break;      /* end of muxing */
-                    }
-                    else
-                    {
-                        ERROR_MSG( "サンプルの入手に失敗しました。\n" );
-                        break;
-                    }
+                    /* No more appendable samples in this track. */
+                    in_track->sample = NULL;
+                    in_track->reach_end_of_media_timeline = 1;
+                    if( --num_active_input_tracks == 0 )
+                        break;      /* end of muxing */
                 }
             }
             if( sample )
@@ -1599,6 +1773,7 @@ static int do_remux( remuxer_t *remuxer )
                             ERROR_MSG( "映像フラグメントの作成に失敗しました。\n" );
                             break;
                         }
+                        reset_fragment_chunks( out_movie );
                         pending_flush_fragments = 0;
                     }
                 }
@@ -1633,12 +1808,21 @@ static int do_remux( remuxer_t *remuxer )
                         uint64_t sample_size     = sample->length;      /* sample might be deleted internally after appending. */
                         uint64_t last_sample_dts = sample->dts;         /* same as above */
                         uint32_t sample_index    = sample->index;       /* same as above */
+                        /* Flush the chunks of all the tracks if this track reaches the limit of a chunk. */
+                        if( is_fragment_chunk_full( remuxer, out_track, in_track->dts )
+                         && flush_fragment_chunk( remuxer ) < 0 )
+                        {
+                            lsmash_delete_sample( sample );
+                            return -1;
+                        }
                         /* Append a sample into output movie. */
                         if( lsmash_append_sample( output->root, out_track->track_ID, sample ) < 0 )
                         {
                             lsmash_delete_sample( sample );
                             return ERROR_MSG( "サンプルをアペンドできませんでした。\n" );
                         }
+                        if( out_track->frag_chunk_sample_count++ == 0 )
+                            out_track->frag_chunk_first_dts = in_track->dts;
                         largest_dts                       = LSMASH_MAX( largest_dts, in_track->dts );
                         in_track->sample                  = NULL;
                         in_track->current_sample_number  += 1;
@@ -1806,6 +1990,8 @@ int main( int argc, char *argv[] )
         .dash                     = 0,
         .compact_size_table       = 0,
         .min_frag_duration        = 0.0,
+        .frag_chunk_samples       = 0,
+        .frag_chunk_duration_in_ms = 0,
         .dry_run                  = 0
     };
     if( parse_cli_option( argc, argv, &remuxer ) )
@@ -108,6 +108,7 @@ typedef struct
     uint32_t empty_delay_num;
     uint32_t empty_delay_den;
     int      dts_compression;
+    int      in_place;
 } opt_t;
 
 static void cleanup_root( root_t *h )
@@ -261,7 +262,7 @@ static int get_summaries( root_t *input, track_t *track )
     return 0;
 }
 
-static int get_movie( root_t *input, char *input_name )
+static int get_movie( root_t *input, char *input_name, int in_place )
 {
     if( !strcmp( input_name, "-" ) )
         return ERROR_MSG( "標準入力はサポートされていません。\n" );
@@ -269,7 +270,7 @@ static int get_movie( root_t *input, char *input_name )
     if( !input->root )
         return ERROR_MSG( "入力ファイルのROOT作成に失敗しました。\n" );
     file_t *in_file = &input->file;
-    if( lsmash_open_file( input_name, 1, &in_file->param ) < 0 )
+    if( lsmash_open_file( input_name, in_place ? 2 : 1, &in_file->param ) < 0 )
         return ERROR_MSG( "入力ファイルのオープンに失敗しました。\n" );
     in_file->fh = lsmash_set_file( input->root, &in_file->param );
     if( !in_file->fh )
@@ -342,7 +343,9 @@ static int get_movie( root_t *input, char *input_name )
         track[i].active                = 1;
         track[i].current_sample_number = 1;
     }
-    lsmash_destroy_children( lsmash_file_as_box( in_file->fh ) );
+    /* The boxes are kept when rewriting the movie in place since they are written back into the input file. */
+    if( !in_place )
+        lsmash_destroy_children( lsmash_file_as_box( in_file->fh ) );
     return 0;
 }
 
@@ -868,6 +871,56 @@ static int check_white_brand( lsmash_brand_type brand )
     return 0;
 }
 
+static int edit_timeline_map( lsmash_root_t *root, uint32_t track_ID, timecode_t *timecode, opt_t *opt )
+{
+    uint32_t movie_timescale = lsmash_get_movie_timescale( root );
+    uint32_t media_timescale = lsmash_get_media_timescale( root, track_ID );
+    uint64_t empty_delay     = timecode->empty_delay + (uint64_t)((double)((uint64_t)opt->empty_delay_num * media_timescale) / opt->empty_delay_den + 0.5);
+    uint64_t duration        = timecode->duration + empty_delay;
+    if( lsmash_delete_explicit_timeline_map( root, track_ID ) )
+        return ERROR_MSG( "明示的タイムラインマップの削除に失敗しました。\n" );
+    if( empty_delay )
+    {
+        lsmash_edit_t empty_edit;
+        empty_edit.duration   = ((double)empty_delay / media_timescale) * movie_timescale;
+        empty_edit.start_time = ISOM_EDIT_MODE_EMPTY;
+        empty_edit.rate       = ISOM_EDIT_MODE_NORMAL;
+        if( lsmash_create_explicit_timeline_map( root, track_ID, empty_edit ) )
+            return ERROR_MSG( "空の継続時間の生成に失敗しました。\n" );
+        duration  = ((double)duration / media_timescale) * movie_timescale;
+        duration -= empty_edit.duration;
+    }
+    else
+        duration  = ((double)duration / media_timescale) * movie_timescale;
+    lsmash_edit_t edit;
+    edit.duration   = duration;
+    edit.start_time = timecode->composition_delay + (uint64_t)((double)((uint64_t)opt->skip_duration_num * media_timescale) / opt->skip_duration_den + 0.5);
+    edit.rate       = ISOM_EDIT_MODE_NORMAL;
+    if( lsmash_create_explicit_timeline_map( root, track_ID, edit ) )
+        return ERROR_MSG( "明示的タイムラインマップの作成に失敗しました。\n" );
+    return 0;
+}
+
+static int rewrite_movie_in_place( root_t *input, timecode_t *timecode, opt_t *opt, int edit_map )
+{
+    track_t *in_track = &input->file.movie.track[ opt->track_number - 1 ];
+    /* Only the timescale of the media may be changed by the timeline editing.
+     * The sample groupings are left as they are. */
+    lsmash_media_parameters_t media_param = in_track->media_param;
+    media_param.roll_grouping              = 0;
+    media_param.rap_grouping               = 0;
+    media_param.compact_sample_size_table  = 0;
+    media_param.no_sample_dependency_table = 1;
+    if( lsmash_set_media_parameters( input->root, in_track->track_ID, &media_param ) )
+        return ERROR_MSG( "メディアパラメータの設定に失敗しました。\n" );
+    if( edit_map
+     && edit_timeline_map( input->root, in_track->track_ID, timecode, opt ) )
+        return ERROR_MSG( "タイムラインマップの編集に失敗しました。\n" );
+    if( lsmash_rewrite_movie( input->root ) )
+        return ERROR_MSG( "ムービーの書き換えに失敗しました。\n" );
+    return 0;
+}
+
 static int moov_to_front_callback( void *param, uint64_t written_movie_size, uint64_t total_movie_size )
 {
     eprintf( "ファイナライズ中: [%5.2lf%%]\r", ((double)written_movie_size / total_movie_size) * 100.0 );
@@ -889,6 +942,7 @@ static void display_help( void )
     display_version();
     eprintf( "\n"
              "使用方法: timelineeditor [オプション] 入力 出力\n"
+             "          timelineeditor --in-place [オプション] 入力\n"
              "  オプション:\n"
              "    --help                       ヘルプを表示\n"
              "    --version                    バージョン情報を表示\n"
@@ -899,7 +953,9 @@ static void display_help( void )
              "    --skip            <rational> 任意の単位でメディアプレゼンテーションの開始をスキップ\n"
              "    --delay           <rational> 任意の単位でメディアプレゼンテーション前の空白クリップを挿入\n"
              "    --dts-compression            DTSハックで構成ディレイを削除します\n"
-             "                                 自動的にメディアタイムベースとタイムスケールを数倍にします\n" );
+             "                                 自動的にメディアタイムベースとタイムスケールを数倍にします\n"
+             "    --in-place                   出力ファイルを作らず、入力ファイルのmoovボックスのみを書き換えます\n"
+             "                                 サンプルデータは移動しません\n" );
 }
 
 int main( int argc, char *argv[] )
@@ -937,12 +993,21 @@ int main( int argc, char *argv[] )
         .skip_duration_den = 1,
         .empty_delay_num   = 0,
         .empty_delay_den   = 1,
-        .dts_compression   = 0
+        .dts_compression   = 0,
+        .in_place          = 0
     };
     /* Parse options. */
     lsmash_get_mainargs( &argc, &argv );
+    /* In-place rewriting takes no output file, so the number of trailing arguments depends on it. */
+    for( int i = 1; i < argc - 1; i++ )
+        if( !strcasecmp( argv[i], "--in-place" ) )
+        {
+            opt.in_place = 1;
+            break;
+        }
+    int num_files = opt.in_place ? 1 : 2;
     int argn = 1;
-    while( argn < argc - 2 )
+    while( argn < argc - num_files )
     {
         if( !strcasecmp( argv[argn], "--track" ) )
         {
@@ -1001,17 +1066,33 @@ int main( int argc, char *argv[] )
             opt.dts_compression = 1;
             ++argn;
         }
+        else if( !strcasecmp( argv[argn], "--in-place" ) )
+            ++argn;
         else
             return TIMELINEEDITOR_ERR( "不正なオプションです。\n" );
     }
-    if( argn > argc - 2 )
+    if( argn > argc - num_files )
         return TIMELINEEDITOR_ERR( "不正な引数です。\n" );
     /* Get input movies. */
-    if( get_movie( &input, argv[argn++] ) )
+    if( get_movie( &input, argv[argn++], opt.in_place ) )
         return TIMELINEEDITOR_ERR( "入力ムービーの取得に失敗しました。\n" );
     movie_t *in_movie = &input.file.movie;
     if( opt.track_number && (opt.track_number > in_movie->num_tracks) )
         return TIMELINEEDITOR_ERR( "トラック番号が不正です。\n" );
+    if( opt.in_place )
+    {
+        /* Edit timeline and write the movie back into the input file. */
+        if( !in_movie->track[ opt.track_number - 1 ].active )
+            return TIMELINEEDITOR_ERR( "トラック番号が不正です。\n" );
+        if( edit_media_timeline( &input, &timecode, &opt ) )
+            return TIMELINEEDITOR_ERR( "タイムラインの編集に失敗しました。\n" );
+        if( rewrite_movie_in_place( &input, &timecode, &opt, argc > 3 ) )
+            return TIMELINEEDITOR_ERR( "入力ムービーの書き換えに失敗しました。\n" );
+        cleanup_root( io.input );
+        cleanup_timecode( io.timecode );
+        eprintf( "タイムライン編集が完了しました!                                                    \n" );
+        return 0;
+    }
     /* Create output movie. */
     file_t *out_file = &output.file;
     output.root = lsmash_create_root();
@@ -1204,36 +1285,9 @@ int main( int argc, char *argv[] )
         if( lsmash_copy_timeline_map( output.root, out_movie->track[i].track_ID, input.root, in_movie->track[i].track_ID ) )
             return TIMELINEEDITOR_ERR( "タイムラインマップのコピーに失敗しました。\n" );
     /* Edit timeline map. */
-    if( argc > 3 )
-    {
-        track_t *out_track       = &out_movie->track[ opt.track_number - 1 ];
-        uint32_t track_ID        = out_track->track_ID;
-        uint32_t movie_timescale = lsmash_get_movie_timescale( output.root );
-        uint32_t media_timescale = lsmash_get_media_timescale( output.root, track_ID );
-        uint64_t empty_delay     = timecode.empty_delay + (uint64_t)((double)((uint64_t)opt.empty_delay_num * media_timescale) / opt.empty_delay_den + 0.5);
-        uint64_t duration        = timecode.duration + empty_delay;
-        if( lsmash_delete_explicit_timeline_map( output.root, track_ID ) )
-            return TIMELINEEDITOR_ERR( "明示的タイムラインマップの削除に失敗しました。\n" );
-        if( empty_delay )
-        {
-            lsmash_edit_t empty_edit;
-            empty_edit.duration   = ((double)empty_delay / media_timescale) * movie_timescale;
-            empty_edit.start_time = ISOM_EDIT_MODE_EMPTY;
-            empty_edit.rate       = ISOM_EDIT_MODE_NORMAL;
-            if( lsmash_create_explicit_timeline_map( output.root, track_ID, empty_edit ) )
-                return TIMELINEEDITOR_ERR( "空の継続時間の生成に失敗しました。\n" );
-            duration  = ((double)duration / media_timescale) * movie_timescale;
-            duration -= empty_edit.duration;
-        }
-        else
-            duration  = ((double)duration / media_timescale) * movie_timescale;
-        lsmash_edit_t edit;
-        edit.duration   = duration;
-        edit.start_time = timecode.composition_delay + (uint64_t)((double)((uint64_t)opt.skip_duration_num * media_timescale) / opt.skip_duration_den + 0.5);
-        edit.rate       = ISOM_EDIT_MODE_NORMAL;
-        if( lsmash_create_explicit_timeline_map( output.root, track_ID, edit ) )
-            return TIMELINEEDITOR_ERR( "明示的タイムラインマップの作成に失敗しました。\n" );
-    }
+    if( argc > 3
+     && edit_timeline_map( output.root, out_movie->track[ opt.track_number - 1 ].track_ID, &timecode, &opt ) )
+        return TIMELINEEDITOR_ERR( "タイムラインマップの編集に失敗しました。\n" );
     /* Finish muxing. */
     lsmash_adhoc_remux_t moov_to_front;
     moov_to_front.func = moov_to_front_callback;
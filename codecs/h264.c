@@ -204,25 +204,8 @@ uint64_t h264_find_next_start_code
     if( long_start_code >= 0 && h264_check_nalu_header( bs, nuh, long_start_code ) == 0 )
     {
         *start_code_length = long_start_code ? NALU_LONG_START_CODE_LENGTH : NALU_SHORT_START_CODE_LENGTH;
-        uint64_t distance = *start_code_length + nuh->length;
         /* Find the start code of the next NALU and get the distance from the start code of the latest NALU. */
-        if( !lsmash_bs_is_end( bs, distance + NALU_SHORT_START_CODE_LENGTH ) )
-        {
-            uint32_t sync_bytes = lsmash_bs_show_be24( bs, distance );
-            while( 0x000001 != sync_bytes )
-            {
-                if( lsmash_bs_is_end( bs, ++distance + NALU_SHORT_START_CODE_LENGTH ) )
-                {
-                    distance = lsmash_bs_get_remaining_buffer_size( bs );
-                    break;
-                }
-                sync_bytes <<= 8;
-                sync_bytes  |= lsmash_bs_show_byte( bs, distance + NALU_SHORT_START_CODE_LENGTH - 1 );
-                sync_bytes  &= 0xFFFFFF;
-            }
-        }
-        else
-            distance = lsmash_bs_get_remaining_buffer_size( bs );
+        uint64_t distance = lsmash_bs_find_start_code_prefix( bs, *start_code_length + nuh->length );
         /* Any NALU has no consecutive zero bytes at the end. */
         while( 0x00 == lsmash_bs_show_byte( bs, distance - 1 ) )
         {
@@ -589,6 +572,31 @@ static int h264_parse_sps_minimally
     return bits->bs->error ? LSMASH_ERR_NAMELESS : 0;
 }
 
+/* Get MaxDpbFrames from the level limits in Table A-1. */
+static uint32_t h264_get_max_dpb_frames
+(
+    h264_sps_t *sps
+)
+{
+    static const struct
+    {
+        uint8_t  level_idc;
+        uint32_t MaxDpbMbs;
+    } level_limits[] =
+        {
+            {  9,    396 }, { 10,    396 }, { 11,    900 }, { 12,   2376 }, { 13,   2376 },
+            { 20,   2376 }, { 21,   4752 }, { 22,   8100 }, { 30,   8100 }, { 31,  18000 },
+            { 32,  20480 }, { 40,  32768 }, { 41,  32768 }, { 42,  34816 }, { 50, 110400 },
+            { 51, 184320 }, { 52, 184320 }, { 60, 696320 }, { 61, 696320 }, { 62, 696320 },
+            {  0,      0 }
+        };
+    uint64_t FrameSizeInMbs = sps->PicSizeInMapUnits * (2 - sps->frame_mbs_only_flag);
+    for( int i = 0; level_limits[i].level_idc; i++ )
+        if( level_limits[i].level_idc == sps->level_idc && FrameSizeInMbs )
+            return LSMASH_MIN( level_limits[i].MaxDpbMbs / FrameSizeInMbs, 16 );
+    return 16;
+}
+
 int h264_parse_sps
 (
     h264_info_t *info,
@@ -696,6 +704,13 @@ int h264_parse_sps
         sps->cropped_width  -= (frame_crop_left_offset + frame_crop_right_offset)  * CropUnitX;
         sps->cropped_height -= (frame_crop_top_offset  + frame_crop_bottom_offset) * CropUnitY;
     }
+    /* max_num_reorder_frames is inferred unless present in the VUI. */
+    if( (sps->constraint_set_flags & 0x10)
+     && (sps->profile_idc == 44  || sps->profile_idc == 86  || sps->profile_idc == 100
+      || sps->profile_idc == 110 || sps->profile_idc == 122 || sps->profile_idc == 244) )
+        sps->max_num_reorder_frames = 0;    /* intra profiles */
+    else
+        sps->max_num_reorder_frames = h264_get_max_dpb_frames( sps );
     if( lsmash_bits_get( bits, 1 ) )    /* vui_parameters_present_flag */
     {
         /* vui_parameters() */
@@ -786,7 +801,7 @@ int h264_parse_sps
             nalu_get_exp_golomb_ue( bits );     /* max_bits_per_mb_denom */
             nalu_get_exp_golomb_ue( bits );     /* log2_max_mv_length_horizontal */
             nalu_get_exp_golomb_ue( bits );     /* log2_max_mv_length_vertical */
-            nalu_get_exp_golomb_ue( bits );     /* max_num_reorder_frames */
+            sps->max_num_reorder_frames = nalu_get_exp_golomb_ue( bits );
             nalu_get_exp_golomb_ue( bits );     /* max_dec_frame_buffering */
         }
     }
@@ -945,7 +960,8 @@ int h264_parse_sei
     int err = nalu_import_rbsp_from_ebsp( bits, rbsp_buffer, &rbsp_size, ebsp, ebsp_size );
     if( err < 0 )
         return err;
-    uint8_t *rbsp_start = rbsp_buffer;
+    /* The RBSP is not always copied into 'rbsp_buffer', so refer to the one imported into the bitstream. */
+    uint8_t *rbsp_start = lsmash_bs_get_buffer_data_end( bits->bs ) - rbsp_size;
     uint64_t rbsp_pos = 0;
     do
     {
@@ -111,6 +111,7 @@ typedef struct
     int32_t  offset_for_ref_frame[255];
     int64_t  ExpectedDeltaPerPicOrderCntCycle;
     uint32_t max_num_ref_frames;
+    uint32_t max_num_reorder_frames;
     uint32_t MaxFrameNum;
     uint32_t log2_max_pic_order_cnt_lsb;
     uint32_t MaxPicOrderCntLsb;
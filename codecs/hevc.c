@@ -251,25 +251,8 @@ uint64_t hevc_find_next_start_code
     if( long_start_code >= 0 && hevc_check_nalu_header( bs, nuh, long_start_code ) == 0 )
     {
         *start_code_length = long_start_code ? NALU_LONG_START_CODE_LENGTH : NALU_SHORT_START_CODE_LENGTH;
-        uint64_t distance = *start_code_length + nuh->length;
         /* Find the start code of the next NALU and get the distance from the start code of the latest NALU. */
-        if( !lsmash_bs_is_end( bs, distance + NALU_SHORT_START_CODE_LENGTH ) )
-        {
-            uint32_t sync_bytes = lsmash_bs_show_be24( bs, distance );
-            while( 0x000001 != sync_bytes )
-            {
-                if( lsmash_bs_is_end( bs, ++distance + NALU_SHORT_START_CODE_LENGTH ) )
-                {
-                    distance = lsmash_bs_get_remaining_buffer_size( bs );
-                    break;
-                }
-                sync_bytes <<= 8;
-                sync_bytes  |= lsmash_bs_show_byte( bs, distance + NALU_SHORT_START_CODE_LENGTH - 1 );
-                sync_bytes  &= 0xFFFFFF;
-            }
-        }
-        else
-            distance = lsmash_bs_get_remaining_buffer_size( bs );
+        uint64_t distance = lsmash_bs_find_start_code_prefix( bs, *start_code_length + nuh->length );
         /* Any NALU has no consecutive zero bytes at the end. */
         while( 0x00 == lsmash_bs_show_byte( bs, distance - 1 ) )
         {
@@ -878,7 +861,8 @@ static int hevc_parse_sps_minimally
     for( int i = sub_layer_ordering_info_present_flag ? 0 : sps->max_sub_layers_minus1; i <= sps->max_sub_layers_minus1; i++ )
     {
         nalu_get_exp_golomb_ue( bits );  /* max_dec_pic_buffering_minus1[i] */
-        nalu_get_exp_golomb_ue( bits );  /* max_num_reorder_pics        [i] */
+        uint64_t max_num_reorder_pics = nalu_get_exp_golomb_ue( bits );
+        sps->max_num_reorder_pics = LSMASH_MIN( max_num_reorder_pics, 16 );
         nalu_get_exp_golomb_ue( bits );  /* max_latency_increase_plus1  [i] */
     }
     uint64_t log2_min_luma_coding_block_size_minus3   = nalu_get_exp_golomb_ue( bits );
@@ -1271,7 +1255,8 @@ int hevc_parse_sei
     int err = nalu_import_rbsp_from_ebsp( bits, rbsp_buffer, &rbsp_size, ebsp, ebsp_size );
     if( err < 0 )
         return err;
-    uint8_t *rbsp_start = rbsp_buffer;
+    /* The RBSP is not always copied into 'rbsp_buffer', so refer to the one imported into the bitstream. */
+    uint8_t *rbsp_start = lsmash_bs_get_buffer_data_end( bits->bs ) - rbsp_size;
     uint64_t rbsp_pos = 0;
     do
     {
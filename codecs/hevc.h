@@ -176,6 +176,7 @@ typedef struct
     uint8_t       bit_depth_luma_minus8;
     uint8_t       bit_depth_chroma_minus8;
     uint8_t       log2_max_pic_order_cnt_lsb;
+    uint8_t       max_num_reorder_pics;     /* for the highest sub-layer */
     uint8_t       num_short_term_ref_pic_sets;
     uint8_t       long_term_ref_pics_present_flag;
     uint8_t       num_long_term_ref_pics_sps;
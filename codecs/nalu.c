@@ -59,26 +59,27 @@ void isom_remove_dcr_ps
     lsmash_free( ps );
 }
 
-/* Convert EBSP (Encapsulated Byte Sequence Packets) to RBSP (Raw Byte Sequence Packets). */
+/* Convert EBSP (Encapsulated Byte Sequence Packets) to RBSP (Raw Byte Sequence Packets).
+ * 'epb' points at the first emulation prevention sequence 0x000003 in the EBSP. */
 static uint8_t *nalu_remove_emulation_prevention
 (
-    uint8_t *src,
-    uint64_t src_length,
-    uint8_t *dst
+    uint8_t       *src,
+    const uint8_t *epb,
+    uint8_t       *src_end,
+    uint8_t       *dst
 )
 {
-    uint8_t *src_end = src + src_length;
-    while( src < src_end )
-        if( ((src + 2) < src_end) && !src[0] && !src[1] && (src[2] == 0x03) )
-        {
-            /* 0x000003 -> 0x0000 */
-            *dst++ = *src++;
-            *dst++ = *src++;
-            src++;  /* Skip emulation_prevention_three_byte (0x03). */
-        }
-        else
-            *dst++ = *src++;
-    return dst;
+    while( epb < src_end )
+    {
+        /* 0x000003 -> 0x0000 */
+        size_t length = epb + 2 - src;
+        memcpy( dst, src, length );
+        dst += length;
+        src += length + 1;  /* Skip emulation_prevention_three_byte (0x03). */
+        epb  = lsmash_find_emulation_prevention( src, src_end );
+    }
+    memcpy( dst, src, src_end - src );
+    return dst + (src_end - src);
 }
 
 int nalu_import_rbsp_from_ebsp
@@ -90,14 +91,49 @@ int nalu_import_rbsp_from_ebsp
     uint64_t       ebsp_size
 )
 {
+    uint8_t       *ebsp_end = ebsp + ebsp_size;
+    const uint8_t *epb      = lsmash_find_emulation_prevention( ebsp, ebsp_end );
+    if( epb == ebsp_end )
+    {
+        /* No emulation_prevention_three_byte is present. The EBSP is the RBSP as it is. */
+        *rbsp_size = ebsp_size;
+        return lsmash_bits_import_data( bits, ebsp, ebsp_size );
+    }
     uint8_t *rbsp_start = rbsp_buffer;
-    uint8_t *rbsp_end   = nalu_remove_emulation_prevention( ebsp, ebsp_size, rbsp_buffer );
+    uint8_t *rbsp_end   = nalu_remove_emulation_prevention( ebsp, epb, ebsp_end, rbsp_buffer );
     *rbsp_size = (uint64_t)(rbsp_end - rbsp_start);
     if( *rbsp_size > ebsp_size )
         return LSMASH_ERR_INVALID_DATA;
     return lsmash_bits_import_data( bits, rbsp_start, *rbsp_size );
 }
 
+int nalu_export_ebsp_from_rbsp
+(
+    lsmash_bs_t *bs,
+    uint8_t     *rbsp,
+    uint64_t     rbsp_size
+)
+{
+    uint8_t *src     = rbsp;
+    uint8_t *src_end = rbsp + rbsp_size;
+    /* Within the EBSP, any two consecutive zero bytes shall not be followed by a byte in the range 0x00-0x03. */
+    for( const uint8_t *pos = lsmash_find_zero_pair( src, src_end, 0x00, 0x03 );
+         pos < src_end;
+         pos = lsmash_find_zero_pair( src, src_end, 0x00, 0x03 ) )
+    {
+        uint32_t length = pos + 2 - src;
+        lsmash_bs_put_bytes( bs, length, src );
+        lsmash_bs_put_byte( bs, 0x03 );     /* emulation_prevention_three_byte */
+        src += length;
+    }
+    lsmash_bs_put_bytes( bs, src_end - src, src );
+    /* When the last byte of the RBSP is 0x00, which can only occur when the RBSP ends in a cabac_zero_word,
+     * a final byte equal to 0x03 is appended to the end of the data. */
+    if( rbsp_size && src_end[-1] == 0x00 )
+        lsmash_bs_put_byte( bs, 0x03 );
+    return bs->error ? LSMASH_ERR_NAMELESS : 0;
+}
+
 int nalu_check_more_rbsp_data
 (
     lsmash_bits_t *bits
@@ -233,18 +269,6 @@ uint64_t nalu_find_first_start_code
     return first_sc_head_pos;
 }
 
-uint64_t nalu_get_codeNum
-(
-    lsmash_bits_t *bits
-)
-{
-    uint32_t leadingZeroBits = 0;
-    for( int b = 0; !b; leadingZeroBits++ )
-        b = lsmash_bits_get( bits, 1 );
-    --leadingZeroBits;
-    return ((uint64_t)1 << leadingZeroBits) - 1 + lsmash_bits_get( bits, leadingZeroBits );
-}
-
 int nalu_update_bitrate( isom_stbl_t *stbl, isom_mdhd_t *mdhd, uint32_t sample_description_index )
 {
     isom_visual_entry_t *sample_entry = (isom_visual_entry_t *)lsmash_list_get_entry_data( &stbl->stsd->list, sample_description_index );
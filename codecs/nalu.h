@@ -56,6 +56,14 @@ int nalu_import_rbsp_from_ebsp
     uint64_t       ebsp_size
 );
 
+/* Convert RBSP to EBSP by inserting emulation_prevention_three_byte where required, and write it into the bytestream. */
+int nalu_export_ebsp_from_rbsp
+(
+    lsmash_bs_t *bs,
+    uint8_t     *rbsp,
+    uint64_t     rbsp_size
+);
+
 int nalu_check_more_rbsp_data
 (
     lsmash_bits_t *bits
@@ -94,36 +102,12 @@ uint64_t nalu_find_first_start_code
     lsmash_bs_t *bs
 );
 
-uint64_t nalu_get_codeNum
-(
-    lsmash_bits_t *bits
-);
-
-static inline uint64_t nalu_decode_exp_golomb_ue
-(
-    uint64_t codeNum
-)
-{
-    return codeNum;
-}
-
-static inline int64_t nalu_decode_exp_golomb_se
-(
-    uint64_t codeNum
-)
-{
-    if( codeNum & 1 )
-        return (int64_t)((codeNum >> 1) + 1);
-    return -1 * (int64_t)(codeNum >> 1);
-}
-
 static inline uint64_t nalu_get_exp_golomb_ue
 (
     lsmash_bits_t *bits
 )
 {
-    uint64_t codeNum = nalu_get_codeNum( bits );
-    return nalu_decode_exp_golomb_ue( codeNum );
+    return lsmash_bits_get_ue( bits );
 }
 
 static inline uint64_t nalu_get_exp_golomb_se
@@ -131,8 +115,7 @@ static inline uint64_t nalu_get_exp_golomb_se
     lsmash_bits_t *bits
 )
 {
-    uint64_t codeNum = nalu_get_codeNum( bits );
-    return nalu_decode_exp_golomb_se( codeNum );
+    return lsmash_bits_get_se( bits );
 }
 
 static inline int nalu_check_next_short_start_code
@@ -145,24 +145,8 @@ uint64_t vc1_find_next_start_code_prefix
      && 0x000001 == lsmash_bs_show_be24( bs, 0 ) )
     {
         *bdu_type = lsmash_bs_show_byte( bs, VC1_START_CODE_PREFIX_LENGTH );
-        length = VC1_START_CODE_LENGTH;
         /* Find the start code of the next EBDU and get the length of the latest EBDU. */
-        int no_more = lsmash_bs_is_end( bs, length + VC1_START_CODE_LENGTH - 1 );
-        if( !no_more )
-        {
-            uint32_t sync_bytes = lsmash_bs_show_be24( bs, length );
-            while( 0x000001 != sync_bytes )
-            {
-                no_more = lsmash_bs_is_end( bs, ++length + VC1_START_CODE_LENGTH - 1 );
-                if( no_more )
-                    break;
-                sync_bytes <<= 8;
-                sync_bytes  |= lsmash_bs_show_byte( bs, length + VC1_START_CODE_PREFIX_LENGTH - 1 );
-                sync_bytes  &= 0xFFFFFF;
-            }
-        }
-        if( no_more )
-            length = lsmash_bs_get_remaining_buffer_size( bs );
+        length = lsmash_bs_find_start_code_prefix( bs, VC1_START_CODE_LENGTH );
         /* Any EBDU has no consecutive zero bytes at the end. */
         while( 0x00 == lsmash_bs_show_byte( bs, length - 1 ) )
         {
@@ -206,27 +190,32 @@ static inline uint8_t vc1_get_vlc( lsmash_bits_t *bits, int length )
     return value;
 }
 
-/* Convert EBDU (Encapsulated Byte Data Unit) to RBDU (Raw Byte Data Unit). */
-static uint8_t *vc1_remove_emulation_prevention( uint8_t *src, uint64_t src_length, uint8_t *dst )
+/* Convert EBDU (Encapsulated Byte Data Unit) to RBDU (Raw Byte Data Unit).
+ * 'epb' points at the first emulation prevention sequence 0x000003 in the EBDU. */
+static uint8_t *vc1_remove_emulation_prevention( uint8_t *src, const uint8_t *epb, uint8_t *src_end, uint8_t *dst )
 {
-    uint8_t *src_end = src + src_length;
-    while( src < src_end )
-        if( ((src + 2) < src_end) && !src[0] && !src[1] && (src[2] == 0x03) )
-        {
-            /* 0x000003 -> 0x0000 */
-            *dst++ = *src++;
-            *dst++ = *src++;
-            src++;  /* Skip emulation_prevention_three_byte (0x03). */
-        }
-        else
-            *dst++ = *src++;
-    return dst;
+    while( epb < src_end )
+    {
+        /* 0x000003 -> 0x0000 */
+        size_t length = epb + 2 - src;
+        memcpy( dst, src, length );
+        dst += length;
+        src += length + 1;  /* Skip emulation_prevention_three_byte (0x03). */
+        epb  = lsmash_find_emulation_prevention( src, src_end );
+    }
+    memcpy( dst, src, src_end - src );
+    return dst + (src_end - src);
 }
 
 static int vc1_import_rbdu_from_ebdu( lsmash_bits_t *bits, uint8_t *rbdu_buffer, uint8_t *ebdu, uint64_t ebdu_size )
 {
+    uint8_t       *ebdu_end = ebdu + ebdu_size;
+    const uint8_t *epb      = lsmash_find_emulation_prevention( ebdu, ebdu_end );
+    if( epb == ebdu_end )
+        /* No emulation prevention byte is present. The EBDU is the RBDU as it is. */
+        return lsmash_bits_import_data( bits, ebdu, ebdu_size );
     uint8_t *rbdu_start  = rbdu_buffer;
-    uint8_t *rbdu_end    = vc1_remove_emulation_prevention( ebdu, ebdu_size, rbdu_buffer );
+    uint8_t *rbdu_end    = vc1_remove_emulation_prevention( ebdu, epb, ebdu_end, rbdu_buffer );
     uint64_t rbdu_length = rbdu_end - rbdu_start;
     return lsmash_bits_import_data( bits, rbdu_start, rbdu_length );
 }
@@ -118,6 +118,26 @@ void lsmash_bits_put( lsmash_bits_t *bits, uint32_t width, uint64_t value )
     }
 }
 
+static inline uint64_t lsmash_bits_load_be64( const uint8_t *p )
+{
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32)
+         | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) | ((uint64_t)p[6] <<  8) |  (uint64_t)p[7];
+}
+
+/* Get the next 64 bits, that is, the residual bits in the cache followed by the bits of the next bytes, without consuming them.
+ * Return 0 if less than 8 bytes remain in the buffer. */
+static inline int lsmash_bits_show_64( lsmash_bits_t *bits, uint64_t *window )
+{
+    lsmash_bs_t *bs = bits->bs;
+    if( bs->error || lsmash_bs_get_remaining_buffer_size( bs ) < sizeof(uint64_t) )
+        return 0;
+    *window = lsmash_bits_load_be64( lsmash_bs_get_buffer_data( bs ) );
+    if( bits->store )
+        *window = ((uint64_t)lsmash_bits_mask_lsb8( bits->cache, bits->store ) << (64 - bits->store))
+                | (*window >> bits->store);
+    return 1;
+}
+
 uint64_t lsmash_bits_get( lsmash_bits_t *bits, uint32_t width )
 {
     debug_if( !bits || !width )
@@ -131,6 +151,25 @@ uint64_t lsmash_bits_get( lsmash_bits_t *bits, uint32_t width )
             bits->store -= width;
             return lsmash_bits_mask_lsb8( bits->cache >> bits->store, width );
         }
+    }
+    lsmash_bs_t *bs = bits->bs;
+    uint32_t required = width - bits->store;
+    if( required <= 56 && !bs->error && lsmash_bs_get_remaining_buffer_size( bs ) >= sizeof(uint64_t) )
+    {
+        /* Take all of bits required from the next 8 bytes on the buffer at once.
+         * The last byte touched becomes the cache as if it were read by the byte unit operation. */
+        uint8_t *data  = lsmash_bs_get_buffer_data( bs );
+        uint32_t bytes = (required + BITS_IN_BYTE - 1) / BITS_IN_BYTE;
+        value = ((uint64_t)lsmash_bits_mask_lsb8( bits->cache, bits->store ) << required)
+              | (lsmash_bits_load_be64( data ) >> (64 - required));
+        bs->buffer.pos   += bytes;
+        bs->buffer.count += bytes;
+        bits->store = bytes * BITS_IN_BYTE - required;
+        bits->cache = data[bytes - 1];
+        return value;
+    }
+    if( bits->store )
+    {
         /* fill value's leading bits with cache's residual. */
         value = lsmash_bits_mask_lsb8( bits->cache, bits->store );
         width -= bits->store;
@@ -156,6 +195,39 @@ uint64_t lsmash_bits_get( lsmash_bits_t *bits, uint32_t width )
     return value;
 }
 
+/* Exp-Golomb codes
+ * A codeword consists of leadingZeroBits zero bits, a one bit and leadingZeroBits bits of suffix,
+ * and codeNum = 2^leadingZeroBits - 1 + suffix, which equals to the codeword read as a binary number minus 1. */
+uint64_t lsmash_bits_get_ue( lsmash_bits_t *bits )
+{
+    debug_if( !bits )
+        return 0;
+    uint64_t window;
+    if( lsmash_bits_show_64( bits, &window ) && (window >> 32) )
+    {
+        /* The whole codeword is within the next 64 bits. */
+        int leadingZeroBits = lsmash_count_leading_zeros64( window );
+        return lsmash_bits_get( bits, 2 * leadingZeroBits + 1 ) - 1;
+    }
+    uint32_t leadingZeroBits = 0;
+    while( !lsmash_bits_get( bits, 1 ) )
+        if( ++leadingZeroBits >= 64 || bits->bs->eob || bits->bs->error )
+        {
+            /* No codeword can be read any more. Zeros are returned after the end of the buffer. */
+            bits->bs->error = 1;
+            return 0;
+        }
+    return ((uint64_t)1 << leadingZeroBits) - 1 + lsmash_bits_get( bits, leadingZeroBits );
+}
+
+int64_t lsmash_bits_get_se( lsmash_bits_t *bits )
+{
+    uint64_t codeNum = lsmash_bits_get_ue( bits );
+    if( codeNum & 1 )
+        return (int64_t)((codeNum >> 1) + 1);
+    return -1 * (int64_t)(codeNum >> 1);
+}
+
 void *lsmash_bits_export_data( lsmash_bits_t *bits, uint32_t *length )
 {
     lsmash_bits_put_align( bits );
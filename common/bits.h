@@ -35,6 +35,8 @@ void lsmash_bits_put_align( lsmash_bits_t *bits );
 void lsmash_bits_get_align( lsmash_bits_t *bits );
 void lsmash_bits_put( lsmash_bits_t *bits, uint32_t width, uint64_t value );
 uint64_t lsmash_bits_get( lsmash_bits_t *bits, uint32_t width );
+uint64_t lsmash_bits_get_ue( lsmash_bits_t *bits );
+int64_t lsmash_bits_get_se( lsmash_bits_t *bits );
 void *lsmash_bits_export_data( lsmash_bits_t *bits, uint32_t *length );
 int lsmash_bits_import_data( lsmash_bits_t *bits, void *data, uint32_t length );
 
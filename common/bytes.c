@@ -46,10 +46,292 @@ static void bs_buffer_free( lsmash_bs_t *bs )
     bs->buffer.pos   = 0;
 }
 
+/*---- background writer ----*/
+typedef struct
+{
+    uint8_t *data;
+    size_t   size;      /* valid data size */
+    size_t   alloc;     /* total buffer size */
+} bs_writer_buffer_t;
+
+struct lsmash_bs_writer_tag
+{
+    void               *stream;
+    int               (*write)( void *opaque, uint8_t *buf, int size );
+    lsmash_thread_t    *thread;
+    lsmash_mutex_t     *mutex;
+    lsmash_cond_t      *queued;         /* signaled when a buffer is queued or the worker is requested to stop */
+    lsmash_cond_t      *written;        /* signaled when a queued buffer is written */
+    uint32_t            queue_length;   /* maximum number of queued buffers */
+    uint32_t            head;           /* index of the oldest buffer in the queue */
+    uint32_t            count;          /* number of queued buffers including the one being written */
+    uint32_t            spare_count;    /* number of written buffers kept for reuse */
+    bs_writer_buffer_t *queue;          /* ring buffer of buffers to be written */
+    bs_writer_buffer_t *spare;          /* written buffers to be returned to the bytestream */
+    int                 error;          /* the first error on writing */
+    int                 stop;
+};
+
+static void *bs_writer_main( void *arg )
+{
+    lsmash_bs_writer_t *writer = (lsmash_bs_writer_t *)arg;
+    lsmash_mutex_lock( writer->mutex );
+    while( 1 )
+    {
+        while( writer->count == 0 && !writer->stop )
+            lsmash_cond_wait( writer->queued, writer->mutex );
+        if( writer->count == 0 )
+            break;
+        /* Only this thread removes buffers from the queue, so the head buffer can be written without the lock. */
+        bs_writer_buffer_t buffer = writer->queue[ writer->head ];
+        int error = writer->error;
+        lsmash_mutex_unlock( writer->mutex );
+        /* Once an error occurs, the following buffers are just discarded since the stream is broken anyway. */
+        if( !error && writer->write( writer->stream, buffer.data, (int)buffer.size ) != (int)buffer.size )
+            error = LSMASH_ERR_NAMELESS;
+        lsmash_mutex_lock( writer->mutex );
+        writer->error = error;
+        writer->head  = (writer->head + 1) % writer->queue_length;
+        --writer->count;
+        writer->spare[ writer->spare_count++ ] = buffer;
+        lsmash_cond_broadcast( writer->written );
+    }
+    lsmash_mutex_unlock( writer->mutex );
+    return NULL;
+}
+
+static void bs_writer_destroy( lsmash_bs_writer_t *writer )
+{
+    if( writer->spare )
+        for( uint32_t i = 0; i < writer->spare_count; i++ )
+            lsmash_free( writer->spare[i].data );
+    lsmash_free( writer->spare );
+    lsmash_free( writer->queue );
+    lsmash_cond_destroy( writer->written );
+    lsmash_cond_destroy( writer->queued );
+    lsmash_mutex_destroy( writer->mutex );
+    lsmash_free( writer );
+}
+
+int lsmash_bs_enable_async_write( lsmash_bs_t *bs, uint32_t queue_length )
+{
+    if( !bs || bs->writer || !bs->stream || !bs->write || !bs->buffer.internal || queue_length == 0 )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    lsmash_bs_writer_t *writer = lsmash_malloc_zero( sizeof(lsmash_bs_writer_t) );
+    if( !writer )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    writer->stream       = bs->stream;
+    writer->write        = bs->write;
+    writer->queue_length = queue_length;
+    writer->mutex        = lsmash_mutex_create();
+    writer->queued       = lsmash_cond_create();
+    writer->written      = lsmash_cond_create();
+    /* The queued and spare buffers never exceed 'queue_length' in total. */
+    writer->queue        = lsmash_malloc( queue_length * sizeof(bs_writer_buffer_t) );
+    writer->spare        = lsmash_malloc( queue_length * sizeof(bs_writer_buffer_t) );
+    if( !writer->mutex || !writer->queued || !writer->written || !writer->queue || !writer->spare )
+    {
+        bs_writer_destroy( writer );
+        return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    writer->thread = lsmash_thread_create( bs_writer_main, writer );
+    if( !writer->thread )
+    {
+        bs_writer_destroy( writer );
+        return LSMASH_ERR_NAMELESS;
+    }
+    bs->writer = writer;
+    return 0;
+}
+
+int lsmash_bs_sync( lsmash_bs_t *bs )
+{
+    if( !bs || !bs->writer )
+        return 0;
+    lsmash_bs_writer_t *writer = bs->writer;
+    lsmash_mutex_lock( writer->mutex );
+    while( writer->count )
+        lsmash_cond_wait( writer->written, writer->mutex );
+    int err = writer->error;
+    lsmash_mutex_unlock( writer->mutex );
+    if( err < 0 )
+        bs->error = 1;
+    return err;
+}
+
+int lsmash_bs_disable_async_write( lsmash_bs_t *bs )
+{
+    if( !bs || !bs->writer )
+        return 0;
+    lsmash_bs_writer_t *writer = bs->writer;
+    lsmash_mutex_lock( writer->mutex );
+    writer->stop = 1;
+    lsmash_cond_signal( writer->queued );
+    lsmash_mutex_unlock( writer->mutex );
+    /* The worker exits after writing all queued buffers. */
+    lsmash_thread_join( writer->thread );
+    int err = writer->error;
+    if( err < 0 )
+        bs->error = 1;
+    bs_writer_destroy( writer );
+    bs->writer = NULL;
+    return err;
+}
+
+/* Queue the valid data on the buffer, and take a written buffer instead if available. */
+static int bs_writer_queue( lsmash_bs_t *bs )
+{
+    lsmash_bs_writer_t *writer = bs->writer;
+    lsmash_mutex_lock( writer->mutex );
+    while( writer->count == writer->queue_length && !writer->error )
+        lsmash_cond_wait( writer->written, writer->mutex );
+    int err = writer->error;
+    if( err == 0 )
+    {
+        bs_writer_buffer_t *buffer = &writer->queue[ (writer->head + writer->count) % writer->queue_length ];
+        buffer->data  = bs->buffer.data;
+        buffer->size  = bs->buffer.store;
+        buffer->alloc = bs->buffer.alloc;
+        ++writer->count;
+        if( writer->spare_count )
+        {
+            buffer = &writer->spare[ --writer->spare_count ];
+            bs->buffer.data  = buffer->data;
+            bs->buffer.alloc = buffer->alloc;
+        }
+        else
+        {
+            bs->buffer.data  = NULL;
+            bs->buffer.alloc = 0;
+        }
+        lsmash_cond_signal( writer->queued );
+    }
+    lsmash_mutex_unlock( writer->mutex );
+    return err;
+}
+/*---- ----*/
+
+/*---- held data ----*/
+struct lsmash_bs_hold_tag
+{
+    uint8_t *data;              /* the held data on memory */
+    size_t   size;              /* the size of the held data on memory */
+    size_t   alloc;             /* the allocated size of 'data' */
+    size_t   max_memory_size;   /* the maximum size of the held data on memory */
+    FILE    *spill;             /* the temporary file holding the whole data after exceeding 'max_memory_size' */
+};
+
+static void bs_hold_destroy( lsmash_bs_hold_t *hold )
+{
+    if( !hold )
+        return;
+    if( hold->spill )
+        fclose( hold->spill );
+    lsmash_free( hold->data );
+    lsmash_free( hold );
+}
+
+static int bs_hold_write( lsmash_bs_hold_t *hold, const uint8_t *buf, size_t size )
+{
+    if( !hold->spill && size > hold->max_memory_size - hold->size )
+    {
+        /* Move the data held on memory into a temporary file, and hold the subsequent data there. */
+        hold->spill = tmpfile();
+        if( !hold->spill
+         || fwrite( hold->data, 1, hold->size, hold->spill ) != hold->size )
+            return LSMASH_ERR_NAMELESS;
+        lsmash_freep( &hold->data );
+        hold->size  = 0;
+        hold->alloc = 0;
+    }
+    if( hold->spill )
+        return fwrite( buf, 1, size, hold->spill ) == size ? 0 : LSMASH_ERR_NAMELESS;
+    if( hold->size + size > hold->alloc )
+    {
+        size_t alloc = LSMASH_MIN( LSMASH_MAX( 2 * hold->alloc, hold->size + size ), hold->max_memory_size );
+        uint8_t *data = lsmash_realloc( hold->data, alloc );
+        if( !data )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        hold->data  = data;
+        hold->alloc = alloc;
+    }
+    memcpy( hold->data + hold->size, buf, size );
+    hold->size += size;
+    return 0;
+}
+
+int lsmash_bs_hold_data( lsmash_bs_t *bs, size_t max_memory_size )
+{
+    if( !bs || bs->hold || !bs->unseekable || !bs->stream || !bs->write )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    /* The data on the buffer precedes the held data. */
+    int err = lsmash_bs_flush_buffer( bs );
+    if( err < 0 )
+        return err;
+    lsmash_bs_hold_t *hold = lsmash_malloc_zero( sizeof(lsmash_bs_hold_t) );
+    if( !hold )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    hold->max_memory_size = max_memory_size;
+    bs->hold = hold;
+    return 0;
+}
+
+int lsmash_bs_release_held_data( lsmash_bs_t *bs, const uint8_t *data, size_t size )
+{
+    if( !bs || !bs->hold )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    /* Stop holding. Data written from here goes to the stream. */
+    int err = lsmash_bs_flush_buffer( bs );
+    lsmash_bs_hold_t *hold = bs->hold;
+    bs->hold = NULL;
+    if( err < 0 )
+        goto fail;
+    for( size_t done = 0; done < size; )
+    {
+        size_t write_size = LSMASH_MIN( size - done, INT_MAX );
+        if( (err = lsmash_bs_write_data( bs, data + done, write_size )) < 0 )
+            goto fail;
+        done += write_size;
+    }
+    if( hold->spill )
+    {
+        /* Copy the held data from the temporary file through a buffer as large as allowed to be held on memory. */
+        size_t buffer_size = LSMASH_MIN( LSMASH_MAX( hold->max_memory_size, 1 ), INT_MAX );
+        uint8_t *buffer = lsmash_malloc( buffer_size );
+        if( !buffer )
+        {
+            err = LSMASH_ERR_MEMORY_ALLOC;
+            goto fail;
+        }
+        rewind( hold->spill );
+        size_t read_size;
+        while( (read_size = fread( buffer, 1, buffer_size, hold->spill )) > 0 )
+            if( (err = lsmash_bs_write_data( bs, buffer, read_size )) < 0 )
+                break;
+        if( err == 0 && ferror( hold->spill ) )
+            err = LSMASH_ERR_NAMELESS;
+        lsmash_free( buffer );
+    }
+    else
+        for( size_t done = 0; done < hold->size; )
+        {
+            size_t write_size = LSMASH_MIN( hold->size - done, INT_MAX );
+            if( (err = lsmash_bs_write_data( bs, hold->data + done, write_size )) < 0 )
+                break;
+            done += write_size;
+        }
+fail:
+    bs_hold_destroy( hold );
+    return err;
+}
+/*---- ----*/
+
 void lsmash_bs_cleanup( lsmash_bs_t *bs )
 {
     if( !bs )
         return;
+    lsmash_bs_disable_async_write( bs );
+    bs_hold_destroy( bs->hold );
     bs_buffer_free( bs );
     lsmash_free( bs );
 }
@@ -73,18 +355,44 @@ int lsmash_bs_set_empty_stream( lsmash_bs_t *bs, uint8_t *data, size_t size )
     bs->buffer.pos        = 0;
     bs->buffer.max_size   = 0;  /* make no sense */
     bs->buffer.count      = 0;
-    bs->read  = NULL;
-    bs->write = NULL;
-    bs->seek  = NULL;
+    bs->read   = NULL;
+    bs->write  = NULL;
+    bs->seek   = NULL;
+    bs->writev = NULL;
+    bs->shift  = NULL;
+    return 0;
+}
+
+int lsmash_bs_set_mapped_stream( lsmash_bs_t *bs, uint8_t *data, size_t size )
+{
+    if( !bs || !data )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    bs_buffer_free( bs );
+    bs->mapped     = 1;
+    bs->eof        = 1;         /* no more read from the stream since the whole stream is on the buffer */
+    bs->eob        = 0;         /* readable on the buffer */
+    bs->error      = 0;
+    bs->unseekable = 0;         /* seekable on the buffer */
+    bs->written    = size;
+    bs->offset     = size;      /* behave as if the poiter of the stream is at the end */
+    bs->buffer.unseekable = 0;
+    bs->buffer.internal   = 0;  /* must not be allocated internally */
+    bs->buffer.data       = data;
+    bs->buffer.store      = size;
+    bs->buffer.alloc      = size;
+    bs->buffer.pos        = 0;
+    bs->buffer.count      = 0;
     return 0;
 }
 
 void lsmash_bs_empty( lsmash_bs_t *bs )
 {
-    if( !bs )
+    if( !bs || bs->mapped )
         return;
+    /* Only the valid data needs to be cleared. Clearing the whole allocation on every call is costly
+     * since an adhoc bitstream for parsing NAL units is emptied after each parse. */
     if( bs->buffer.data )
-        memset( bs->buffer.data, 0, bs->buffer.alloc );
+        memset( bs->buffer.data, 0, bs->buffer.store );
     bs->buffer.store = 0;
     bs->buffer.pos   = 0;
 }
@@ -151,10 +459,13 @@ static uint64_t bs_estimate_seek_offset( lsmash_bs_t *bs, int64_t offset, int wh
 /* TODO: Support offset > INT64_MAX */
 int64_t lsmash_bs_write_seek( lsmash_bs_t *bs, int64_t offset, int whence )
 {
-    if( bs->unseekable )
+    if( bs->unseekable || bs->hold )
         return LSMASH_ERR_NAMELESS;
     if( whence != SEEK_SET && whence != SEEK_CUR && whence != SEEK_END )
         return LSMASH_ERR_FUNCTION_PARAM;
+    int err = lsmash_bs_sync( bs );
+    if( err < 0 )
+        return err;
     /* Try to seek the stream. */
     int64_t ret = bs->seek( bs->stream, offset, whence );
     if( ret < 0 )
@@ -172,6 +483,13 @@ int64_t lsmash_bs_read_seek( lsmash_bs_t *bs, int64_t offset, int whence )
         return LSMASH_ERR_FUNCTION_PARAM;
     if( whence == SEEK_CUR )
         offset -= lsmash_bs_get_remaining_buffer_size( bs );
+    if( bs->mapped )
+    {
+        /* Any position in the stream is on the buffer. */
+        bs->buffer.pos = bs_estimate_seek_offset( bs, offset, whence );
+        bs->eob        = 0;
+        return lsmash_bs_get_stream_pos( bs );
+    }
     /* Check whether we can seek on the buffer. */
     if( !bs->buffer.unseekable )
     {
@@ -179,7 +497,9 @@ int64_t lsmash_bs_read_seek( lsmash_bs_t *bs, int64_t offset, int whence )
         uint64_t dst_offset = bs_estimate_seek_offset( bs, offset, whence );
         uint64_t offset_s = bs->offset - bs->buffer.store;
         uint64_t offset_e = bs->offset;
-        if( bs->unseekable || (dst_offset >= offset_s && dst_offset < offset_e) )
+        /* The end of the buffer is the current position of the stream, so seeking there needs no stream seek.
+         * This matters for streams such as pipes, which cannot be seeked. */
+        if( bs->unseekable || (dst_offset >= offset_s && dst_offset <= offset_e) )
         {
             /* OK, we can. So, seek on the buffer. */
             bs->buffer.pos = dst_offset - offset_s;
@@ -189,6 +509,9 @@ int64_t lsmash_bs_read_seek( lsmash_bs_t *bs, int64_t offset, int whence )
     }
     if( bs->unseekable )
         return LSMASH_ERR_NAMELESS;
+    int err = lsmash_bs_sync( bs );
+    if( err < 0 )
+        return err;
     /* Try to seek the stream. */
     int64_t ret = bs->seek( bs->stream, offset, whence );
     if( ret < 0 )
@@ -204,6 +527,8 @@ int64_t lsmash_bs_read_seek( lsmash_bs_t *bs, int64_t offset, int whence )
 
 void lsmash_bs_dispose_past_data( lsmash_bs_t *bs )
 {
+    if( bs->mapped )
+        return;
     /* Move remainder bytes. */
     assert( bs->buffer.store >= bs->buffer.pos );
     size_t remainder = lsmash_bs_get_remaining_buffer_size( bs );
@@ -305,8 +630,31 @@ int lsmash_bs_flush_buffer( lsmash_bs_t *bs )
     if( bs->buffer.store == 0
      || (bs->stream && bs->write && !bs->buffer.data) )
         return 0;
-    if( bs->error
-     || (bs->stream && bs->write && bs->write( bs->stream, lsmash_bs_get_buffer_data_start( bs ), bs->buffer.store ) != bs->buffer.store) )
+    if( bs->hold )
+    {
+        /* The held data is counted when written into the stream actually. */
+        int err = bs->error ? LSMASH_ERR_NAMELESS : bs_hold_write( bs->hold, lsmash_bs_get_buffer_data_start( bs ), bs->buffer.store );
+        if( err < 0 )
+        {
+            bs_buffer_free( bs );
+            bs->error = 1;
+            return err;
+        }
+        bs->buffer.store = 0;
+        return 0;
+    }
+    if( bs->writer && !bs->error )
+    {
+        int err = bs_writer_queue( bs );
+        if( err < 0 )
+        {
+            bs_buffer_free( bs );
+            bs->error = 1;
+            return err;
+        }
+    }
+    else if( bs->error
+          || (bs->stream && bs->write && bs->write( bs->stream, lsmash_bs_get_buffer_data_start( bs ), bs->buffer.store ) != bs->buffer.store) )
     {
         bs_buffer_free( bs );
         bs->error = 1;
@@ -327,7 +675,14 @@ int lsmash_bs_write_data( lsmash_bs_t *bs, const uint8_t *buf, size_t size )
         return LSMASH_ERR_FUNCTION_PARAM;
     if( !buf || size == 0 )
         return 0;
-    if( bs->error || !bs->stream )
+    if( bs->hold && !bs->error )
+    {
+        int err = bs_hold_write( bs->hold, buf, size );
+        if( err < 0 )
+            bs->error = 1;
+        return err;
+    }
+    if( bs->error || !bs->stream || lsmash_bs_sync( bs ) < 0 )
     {
         bs_buffer_free( bs );
         bs->error = 1;
@@ -339,6 +694,98 @@ int lsmash_bs_write_data( lsmash_bs_t *bs, const uint8_t *buf, size_t size )
     return write_size != size ? LSMASH_ERR_NAMELESS : 0;
 }
 
+#define BS_MAX_IO_VECTORS 64
+
+int lsmash_bs_write_vector( lsmash_bs_t *bs, const lsmash_io_vector_t *vec, int count )
+{
+    if( !bs || count < 0 || (count && !vec) )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    if( bs->writer || !bs->writev || bs->hold )
+    {
+        /* The background writer takes the buffer over, so the data must be copied onto it.
+         * Without the vectored write, the valid data on the buffer is followed by direct writes of each buffer. */
+        int err;
+        if( bs->writer )
+            for( int i = 0; i < count; i++ )
+            {
+                if( vec[i].size > UINT32_MAX )
+                    return LSMASH_ERR_FUNCTION_PARAM;
+                lsmash_bs_put_bytes( bs, vec[i].size, vec[i].data );
+            }
+        if( (err = lsmash_bs_flush_buffer( bs )) < 0 )
+            return err;
+        if( !bs->writer )
+            for( int i = 0; i < count; i++ )
+                for( uint64_t done = 0; done < vec[i].size; )
+                {
+                    size_t size = LSMASH_MIN( vec[i].size - done, INT_MAX );
+                    if( (err = lsmash_bs_write_data( bs, vec[i].data + done, size )) < 0 )
+                        return err;
+                    done += size;
+                }
+        return 0;
+    }
+    if( bs->error || !bs->stream )
+    {
+        bs_buffer_free( bs );
+        bs->error = 1;
+        return LSMASH_ERR_NAMELESS;
+    }
+    /* Write at most BS_MAX_IO_VECTORS buffers at a time. The valid data on the buffer leads the first batch. */
+    lsmash_io_vector_t batch[BS_MAX_IO_VECTORS];
+    int i = 0;
+    do
+    {
+        int      n     = 0;
+        uint64_t total = 0;
+        if( i == 0 && bs->buffer.store && bs->buffer.data )
+        {
+            batch[n].data = lsmash_bs_get_buffer_data_start( bs );
+            batch[n].size = bs->buffer.store;
+            total += batch[n++].size;
+        }
+        for( ; i < count && n < BS_MAX_IO_VECTORS; i++ )
+            if( vec[i].size )
+            {
+                batch[n] = vec[i];
+                total += batch[n++].size;
+            }
+        if( n == 0 )
+            continue;
+        int64_t write_size = bs->writev( bs->stream, batch, n );
+        if( write_size > 0 )
+        {
+            bs->written += write_size;
+            bs->offset  += write_size;
+        }
+        if( write_size != total )
+        {
+            bs_buffer_free( bs );
+            bs->error = 1;
+            return LSMASH_ERR_NAMELESS;
+        }
+        bs->buffer.store = 0;
+    } while( i < count );
+    return 0;
+}
+
+int lsmash_bs_shift_data( lsmash_bs_t *bs, uint64_t offset, uint64_t shift )
+{
+    if( !bs )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    if( !bs->shift || bs->unseekable )
+        return LSMASH_ERR_PATCH_WELCOME;
+    int err;
+    if( (err = lsmash_bs_flush_buffer( bs )) < 0
+     || (err = lsmash_bs_sync( bs ))         < 0 )
+        return err;
+    int64_t size = bs->shift( bs->stream, offset, shift );
+    if( size < 0 )
+        return size;
+    bs->written = LSMASH_MAX( bs->written, (uint64_t)size );
+    return 0;
+}
+
 void *lsmash_bs_export_data( lsmash_bs_t *bs, uint32_t *length )
 {
     if( !bs || !bs->buffer.data || bs->buffer.store == 0 || bs->error )
@@ -368,6 +815,8 @@ static void bs_fill_buffer( lsmash_bs_t *bs )
         if( bs->error )
             return;
     }
+    if( lsmash_bs_sync( bs ) < 0 )
+        return;
     /* Read bytes from the stream to fill the buffer. */
     lsmash_bs_dispose_past_data( bs );
     while( bs->buffer.alloc > bs->buffer.store )
@@ -640,8 +1089,14 @@ int lsmash_bs_read( lsmash_bs_t *bs, uint32_t size )
         return LSMASH_ERR_FUNCTION_PARAM;
     if( size == 0 )
         return 0;
+    if( bs->mapped )
+    {
+        /* All data is already on the buffer. */
+        bs->eof = 1;
+        return 0;
+    }
     bs_alloc( bs, bs->buffer.store + size );
-    if( bs->error || !bs->stream )
+    if( bs->error || !bs->stream || lsmash_bs_sync( bs ) < 0 )
     {
         bs->error = 1;
         return LSMASH_ERR_NAMELESS;
@@ -669,7 +1124,16 @@ int lsmash_bs_read_data( lsmash_bs_t *bs, uint8_t *buf, size_t *size )
         return LSMASH_ERR_FUNCTION_PARAM;
     if( !buf || *size == 0 )
         return 0;
-    if( bs->error || !bs->stream )
+    if( bs->mapped )
+    {
+        *size = LSMASH_MIN( *size, lsmash_bs_get_remaining_buffer_size( bs ) );
+        memcpy( buf, lsmash_bs_get_buffer_data( bs ), *size );
+        bs->buffer.pos += *size;
+        if( *size == 0 )
+            bs->eob = 1;
+        return 0;
+    }
+    if( bs->error || !bs->stream || lsmash_bs_sync( bs ) < 0 )
     {
         bs->error = 1;
         return LSMASH_ERR_NAMELESS;
@@ -705,3 +1169,34 @@ int lsmash_bs_import_data( lsmash_bs_t *bs, void *data, uint32_t length )
     bs->buffer.store += length;
     return 0;
 }
+
+uint64_t lsmash_bs_find_start_code_prefix( lsmash_bs_t *bs, uint64_t offset )
+{
+    while( 1 )
+    {
+        uint64_t remainder = lsmash_bs_get_remaining_buffer_size( bs );
+        if( offset + 3 < remainder )
+        {
+            /* Scan the buffered data in bulk. The last byte is excluded since a start code prefix must be
+             * followed by at least one byte. */
+            const uint8_t *data = lsmash_bs_get_buffer_data( bs );
+            const uint8_t *end  = data + remainder - 1;
+            const uint8_t *p    = lsmash_find_start_code_prefix( data + offset, end );
+            if( p < end )
+                return p - data;
+            /* A start code prefix might straddle the end of the buffered data. */
+            offset = remainder - 3;
+        }
+        if( bs->eof || bs->error )
+            return remainder;
+        /* Read more bytes from the stream. If the buffer is full of unread data, grow it. */
+        bs_fill_buffer( bs );
+        if( !bs->eof && !bs->error && lsmash_bs_get_remaining_buffer_size( bs ) == remainder )
+        {
+            bs_alloc( bs, 2 * bs->buffer.alloc );
+            bs_fill_buffer( bs );
+        }
+        if( bs->error )
+            return lsmash_bs_get_remaining_buffer_size( bs );
+    }
+}
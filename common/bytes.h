@@ -23,6 +23,9 @@
 /*---- bytestream ----*/
 #define BS_MAX_DEFAULT_READ_SIZE (4 * 1024 * 1024)
 
+typedef struct lsmash_bs_writer_tag lsmash_bs_writer_t;
+typedef struct lsmash_bs_hold_tag   lsmash_bs_hold_t;
+
 typedef struct
 {
     int      unseekable;    /* If set to 1, the buffer is unseekable. */
@@ -43,13 +46,18 @@ typedef struct
     uint8_t         eob;            /* if set to 1, we cannot read more bytes from the stream and the buffer until any seek. */
     uint8_t         error;          /* If set to 1, any error is detected. */
     uint8_t         unseekable;     /* If set to 1, the stream is unseekable. */
+    uint8_t         mapped;         /* If set to 1, the whole stream is mapped on the buffer, and any read and seek is done on the buffer. */
     uint64_t        written;        /* the number of bytes written into 'stream' already */
     uint64_t        offset;         /* the current position in the 'stream'
                                      * the number of bytes from the beginning */
     lsmash_buffer_t buffer;
+    lsmash_bs_writer_t *writer;     /* background writer if enabled */
+    lsmash_bs_hold_t   *hold;       /* data held instead of being written into 'stream' if holding */
     int     (*read) ( void *opaque, uint8_t *buf, int size );
     int     (*write)( void *opaque, uint8_t *buf, int size );
     int64_t (*seek) ( void *opaque, int64_t offset, int whence );
+    int64_t (*writev)( void *opaque, const lsmash_io_vector_t *vec, int count );
+    int64_t (*shift) ( void *opaque, uint64_t offset, uint64_t shift );
 } lsmash_bs_t;
 
 static inline void lsmash_bs_reset_counter( lsmash_bs_t *bs )
@@ -102,6 +110,7 @@ static inline size_t lsmash_bs_get_valid_data_size( lsmash_bs_t *bs )
 lsmash_bs_t *lsmash_bs_create( void );
 void lsmash_bs_cleanup( lsmash_bs_t *bs );
 int lsmash_bs_set_empty_stream( lsmash_bs_t *bs, uint8_t *data, size_t size );
+int lsmash_bs_set_mapped_stream( lsmash_bs_t *bs, uint8_t *data, size_t size );
 void lsmash_bs_empty( lsmash_bs_t *bs );
 int64_t lsmash_bs_write_seek( lsmash_bs_t *bs, int64_t offset, int whence );
 int64_t lsmash_bs_read_seek( lsmash_bs_t *bs, int64_t offset, int whence );
@@ -122,8 +131,34 @@ void lsmash_bs_put_le16( lsmash_bs_t *bs, uint16_t value );
 void lsmash_bs_put_le32( lsmash_bs_t *bs, uint32_t value );
 int lsmash_bs_flush_buffer( lsmash_bs_t *bs );
 int lsmash_bs_write_data( lsmash_bs_t *bs, const uint8_t *buf, size_t size );
+/* Write the valid data on the buffer and then the data in 'count' buffers described by 'vec' into the stream.
+ * The given buffers are written without being copied onto the buffer unless the background writer is enabled. */
+int lsmash_bs_write_vector( lsmash_bs_t *bs, const lsmash_io_vector_t *vec, int count );
+/* Move the data from 'offset' to the end of the stream forward by 'shift' bytes through the stream itself.
+ * The position in the stream is unspecified after the move, so seek before any subsequent operation.
+ * Return LSMASH_ERR_PATCH_WELCOME without moving anything if the stream does not support it. */
+int lsmash_bs_shift_data( lsmash_bs_t *bs, uint64_t offset, uint64_t shift );
 void *lsmash_bs_export_data( lsmash_bs_t *bs, uint32_t *length );
 
+/* Hand the buffer over to a background thread writing into the stream at every flush instead of writing it there.
+ * Up to 'queue_length' buffers can be queued. Flushing waits until the queue has room.
+ * Any seek, read and direct write on the stream waits until all queued buffers are written.
+ * The stream must be kept open until lsmash_bs_cleanup() or lsmash_bs_disable_async_write() is called. */
+int lsmash_bs_enable_async_write( lsmash_bs_t *bs, uint32_t queue_length );
+/* Wait until all queued buffers are written, and then stop the background writer.
+ * Return the first error which the background writer encountered if any. */
+int lsmash_bs_disable_async_write( lsmash_bs_t *bs );
+/* Wait until all queued buffers are written.
+ * Return the first error which the background writer encountered if any. */
+int lsmash_bs_sync( lsmash_bs_t *bs );
+
+/* Hold all the data written into the unseekable stream afterward instead of writing it there.
+ * Up to 'max_memory_size' bytes are held on memory, and the whole data is moved into a temporary file beyond that.
+ * This allows data determined later to be placed before the held data without seeking the stream. */
+int lsmash_bs_hold_data( lsmash_bs_t *bs, size_t max_memory_size );
+/* Stop holding, and write the 'size' bytes of 'data' and then the held data into the stream. */
+int lsmash_bs_release_held_data( lsmash_bs_t *bs, const uint8_t *data, size_t size );
+
 /*---- bytestream reader ----*/
 uint8_t lsmash_bs_show_byte( lsmash_bs_t *bs, uint32_t offset );
 uint16_t lsmash_bs_show_be16( lsmash_bs_t *bs, uint32_t offset );
@@ -149,6 +184,11 @@ int lsmash_bs_read( lsmash_bs_t *bs, uint32_t size );
 int lsmash_bs_read_data( lsmash_bs_t *bs, uint8_t *buf, size_t *size );
 int lsmash_bs_import_data( lsmash_bs_t *bs, void *data, uint32_t length );
 
+/* Return the offset of the first start code prefix 0x000001 at or after the given offset.
+ * Only a prefix followed by at least one byte is found, that is, the start code is complete.
+ * Return the remaining buffer size if no start code prefix is found until the end of the stream. */
+uint64_t lsmash_bs_find_start_code_prefix( lsmash_bs_t *bs, uint64_t offset );
+
 /* Check if the given offset reaches both EOF of the stream and the end of the buffer. */
 static inline int lsmash_bs_is_end( lsmash_bs_t *bs, uint32_t offset )
 {
@@ -161,3 +201,20 @@ static inline int lsmash_bs_is_error( lsmash_bs_t *bs )
 {
     return bs->error;
 }
+
+/*---- start code and emulation prevention scanner ----*/
+/* Return the pointer to the first three-byte sequence 0x0000XX, where min <= XX <= max, lying entirely within [buf, end).
+ * Return 'end' if not found. */
+const uint8_t *lsmash_find_zero_pair( const uint8_t *buf, const uint8_t *end, uint8_t min, uint8_t max );
+
+/* start code prefix 0x000001 */
+static inline const uint8_t *lsmash_find_start_code_prefix( const uint8_t *buf, const uint8_t *end )
+{
+    return lsmash_find_zero_pair( buf, end, 0x01, 0x01 );
+}
+
+/* emulation prevention sequence 0x000003 */
+static inline const uint8_t *lsmash_find_emulation_prevention( const uint8_t *buf, const uint8_t *end )
+{
+    return lsmash_find_zero_pair( buf, end, 0x03, 0x03 );
+}
@@ -35,5 +35,6 @@
 #include "bits.h"
 #include "multibuf.h"
 #include "list.h"
+#include "thread.h"
 
 #endif
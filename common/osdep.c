@@ -20,12 +20,27 @@
 
 /* This file is available under an ISC license. */
 
+#ifdef __linux__
+#define _DEFAULT_SOURCE     /* for syscall() */
+#endif
+
 #include "internal.h" /* must be placed first */
 
 #include <stdlib.h>
 
 #ifdef _WIN32
 #include <windows.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
 #endif
 
 #ifdef _WIN32
@@ -63,5 +78,127 @@ FILE *lsmash_win32_fopen( const char *name, const char *mode )
     return fp;
 }
 
+void *lsmash_map_file( FILE *fp, uint64_t *size )
+{
+    HANDLE file = (HANDLE)_get_osfhandle( _fileno( fp ) );
+    LARGE_INTEGER file_size;
+    if( file == INVALID_HANDLE_VALUE
+     || GetFileType( file ) != FILE_TYPE_DISK
+     || !GetFileSizeEx( file, &file_size )
+     || file_size.QuadPart <= 0
+     || (uint64_t)file_size.QuadPart > SIZE_MAX )
+        return NULL;
+    HANDLE mapping = CreateFileMappingW( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    if( !mapping )
+        return NULL;
+    /* The view keeps the mapping alive after closing the handle. */
+    void *data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    CloseHandle( mapping );
+    if( !data )
+        return NULL;
+    *size = file_size.QuadPart;
+    return data;
+}
+
+void lsmash_unmap_file( void *data, uint64_t size )
+{
+    UnmapViewOfFile( data );
+}
+
+int64_t lsmash_get_file_modification_time( FILE *fp )
+{
+    HANDLE file = (HANDLE)_get_osfhandle( _fileno( fp ) );
+    FILETIME time;
+    if( file == INVALID_HANDLE_VALUE
+     || GetFileType( file ) != FILE_TYPE_DISK
+     || !GetFileTime( file, NULL, NULL, &time ) )
+        return 0;
+    return (int64_t)(((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime);
+}
+
+#else
+
+void *lsmash_map_file( FILE *fp, uint64_t *size )
+{
+    struct stat st;
+    int fd = fileno( fp );
+    if( fd < 0
+     || fstat( fd, &st ) != 0
+     || !S_ISREG( st.st_mode )
+     || st.st_size <= 0
+     || (uint64_t)st.st_size > SIZE_MAX )
+        return NULL;
+    void *data = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    if( data == MAP_FAILED )
+        return NULL;
+    *size = st.st_size;
+    return data;
+}
+
+void lsmash_unmap_file( void *data, uint64_t size )
+{
+    munmap( data, size );
+}
+
+int64_t lsmash_get_file_modification_time( FILE *fp )
+{
+    struct stat st;
+    int fd = fileno( fp );
+    if( fd < 0
+     || fstat( fd, &st ) != 0
+     || !S_ISREG( st.st_mode ) )
+        return 0;
+#ifdef __linux__
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    return (int64_t)st.st_mtime;
+#endif
+}
+
+#if defined( __linux__ ) && defined( SYS_copy_file_range )
+int64_t lsmash_shift_file_data( FILE *fp, uint64_t offset, uint64_t shift )
+{
+    struct stat st;
+    int fd = fileno( fp );
+    /* The data is copied in pieces not larger than the shift, so a tiny shift would end up with too many system calls. */
+    if( shift < 4096
+     || shift > INT64_MAX
+     || fd < 0
+     || fstat( fd, &st ) != 0
+     || !S_ISREG( st.st_mode )
+     || (uint64_t)st.st_size < offset )
+        return LSMASH_ERR_PATCH_WELCOME;
+    /* The source and the destination must not overlap in a file, so the data is copied backward piece by piece. */
+    uint64_t end   = st.st_size;
+    uint64_t pos   = end;
+    uint64_t piece = LSMASH_MIN( shift, 1 << 30 );
+    while( pos > offset )
+    {
+        uint64_t size = LSMASH_MIN( piece, pos - offset );
+        int64_t  src  = pos - size;
+        int64_t  dst  = src + shift;
+        pos -= size;
+        while( size )
+        {
+            long ret = syscall( SYS_copy_file_range, fd, &src, fd, &dst, (size_t)size, 0u );
+            if( ret <= 0 )
+            {
+                if( ret < 0 && errno == EINTR )
+                    continue;
+                /* Let the caller move the data in another way if nothing was moved yet. */
+                return pos + size == end ? LSMASH_ERR_PATCH_WELCOME : LSMASH_ERR_IO;
+            }
+            size -= ret;
+        }
+    }
+    return end + shift;
+}
+#else
+int64_t lsmash_shift_file_data( FILE *fp, uint64_t offset, uint64_t shift )
+{
+    return LSMASH_ERR_PATCH_WELCOME;
+}
+#endif
+
 #endif
 
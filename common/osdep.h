@@ -58,4 +58,25 @@
    int lsmash_string_from_wchar( int cp, const wchar_t *from, char **to );
 #endif
 
+#include <stdio.h>
+#include <stdint.h>
+/* Map a whole regular file opened for reading into memory as read-only.
+ * Return the address of the mapped region and set its size to 'size' if successful.
+ * Return NULL otherwise. */
+void *lsmash_map_file( FILE *fp, uint64_t *size );
+void lsmash_unmap_file( void *data, uint64_t size );
+
+/* Get the last modification time of a regular file in an unspecified unit, which is comparable only between the same system.
+ * Return 0 if unavailable. */
+int64_t lsmash_get_file_modification_time( FILE *fp );
+
+#ifndef _WIN32
+/* Move the data from 'offset' to the end of a regular file forward by 'shift' bytes inside the kernel.
+ * The file size grows by 'shift' bytes and the contents of the range of 'shift' bytes from 'offset' are unspecified.
+ * Return the resulting file size if successful.
+ * Return LSMASH_ERR_PATCH_WELCOME if the system does not support it and nothing was moved.
+ * Return the other negative value otherwise. */
+int64_t lsmash_shift_file_data( FILE *fp, uint64_t offset, uint64_t shift );
+#endif
+
 #endif
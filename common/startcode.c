@@ -0,0 +1,152 @@
+/*****************************************************************************
+ * startcode.c
+ *****************************************************************************
+ * Copyright (C) 2017 L-SMASH project
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include "internal.h" /* must be placed first */
+
+/* Vector variants are selected by the target architecture.
+ * SSE2 is a part of the baseline of x86_64. AVX2 is used if the compiler targets it, or, with GCC and Clang,
+ * if the running CPU supports it. NEON is a part of the baseline of AArch64. */
+#if defined( __SSE2__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 2)
+#define SC_SSE2
+#include <emmintrin.h>
+#if defined( __AVX2__ )
+#define SC_AVX2
+#include <immintrin.h>
+#elif (defined( __x86_64__ ) || defined( __i386__ )) \
+   && (defined( __clang__ ) || (defined( __GNUC__ ) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SC_AVX2
+#define SC_AVX2_RUNTIME
+#define SC_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#elif defined( __aarch64__ ) && defined( __ARM_NEON )
+#define SC_NEON
+#include <arm_neon.h>
+#endif
+
+#ifndef SC_AVX2_TARGET
+#define SC_AVX2_TARGET
+#endif
+
+/* All scanners look for a zero byte pair followed by a byte in the range [min, max].
+ * 'span' is max - min. A byte is in the range if the byte minus min does not exceed span in unsigned arithmetic. */
+static const uint8_t *find_zero_pair_c( const uint8_t *p, const uint8_t *end, uint8_t min, uint8_t span )
+{
+    /* Look at the third byte first. Unless it is zero or in the range, no sequence can begin at any of
+     * the three bytes, which allows us to skip most of the bytes without checking the others. */
+    while( p + 2 < end )
+    {
+        if( p[2] && (uint8_t)(p[2] - min) > span )
+            p += 3;
+        else if( p[1] )
+            p += 2;
+        else if( p[0] || (uint8_t)(p[2] - min) > span )
+            p += 1;
+        else
+            return p;
+    }
+    return end;
+}
+
+/* Each vector variant compares the bytes at three consecutive offsets at once so that every position in
+ * the vector is tested against the whole sequence, and leaves the exact position in the vector, as well as
+ * the tail shorter than a vector, to the scalar scanner. */
+#ifdef SC_SSE2
+static const uint8_t *find_zero_pair_sse2( const uint8_t *p, const uint8_t *end, uint8_t min, uint8_t span )
+{
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i vmin  = _mm_set1_epi8( (char)min );
+    const __m128i vspan = _mm_set1_epi8( (char)span );
+    while( end - p >= 16 + 2 )
+    {
+        __m128i b0 = _mm_loadu_si128( (const __m128i *)(p    ) );
+        __m128i b1 = _mm_loadu_si128( (const __m128i *)(p + 1) );
+        __m128i b2 = _mm_loadu_si128( (const __m128i *)(p + 2) );
+        __m128i in_range = _mm_cmpeq_epi8( _mm_subs_epu8( _mm_sub_epi8( b2, vmin ), vspan ), zero );
+        __m128i match = _mm_and_si128( _mm_and_si128( _mm_cmpeq_epi8( b0, zero ),
+                                                      _mm_cmpeq_epi8( b1, zero ) ), in_range );
+        if( _mm_movemask_epi8( match ) )
+            break;
+        p += 16;
+    }
+    return find_zero_pair_c( p, end, min, span );
+}
+#endif
+
+#ifdef SC_AVX2
+static SC_AVX2_TARGET const uint8_t *find_zero_pair_avx2( const uint8_t *p, const uint8_t *end, uint8_t min, uint8_t span )
+{
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i vmin  = _mm256_set1_epi8( (char)min );
+    const __m256i vspan = _mm256_set1_epi8( (char)span );
+    while( end - p >= 32 + 2 )
+    {
+        __m256i b0 = _mm256_loadu_si256( (const __m256i *)(p    ) );
+        __m256i b1 = _mm256_loadu_si256( (const __m256i *)(p + 1) );
+        __m256i b2 = _mm256_loadu_si256( (const __m256i *)(p + 2) );
+        __m256i in_range = _mm256_cmpeq_epi8( _mm256_subs_epu8( _mm256_sub_epi8( b2, vmin ), vspan ), zero );
+        __m256i match = _mm256_and_si256( _mm256_and_si256( _mm256_cmpeq_epi8( b0, zero ),
+                                                            _mm256_cmpeq_epi8( b1, zero ) ), in_range );
+        if( _mm256_movemask_epi8( match ) )
+            break;
+        p += 32;
+    }
+    return find_zero_pair_c( p, end, min, span );
+}
+#endif
+
+#ifdef SC_NEON
+static const uint8_t *find_zero_pair_neon( const uint8_t *p, const uint8_t *end, uint8_t min, uint8_t span )
+{
+    const uint8x16_t zero  = vdupq_n_u8( 0 );
+    const uint8x16_t vmin  = vdupq_n_u8( min );
+    const uint8x16_t vspan = vdupq_n_u8( span );
+    while( end - p >= 16 + 2 )
+    {
+        uint8x16_t in_range = vcleq_u8( vsubq_u8( vld1q_u8( p + 2 ), vmin ), vspan );
+        uint8x16_t match = vandq_u8( vandq_u8( vceqq_u8( vld1q_u8( p     ), zero ),
+                                               vceqq_u8( vld1q_u8( p + 1 ), zero ) ), in_range );
+        if( vmaxvq_u8( match ) )
+            break;
+        p += 16;
+    }
+    return find_zero_pair_c( p, end, min, span );
+}
+#endif
+
+const uint8_t *lsmash_find_zero_pair( const uint8_t *buf, const uint8_t *end, uint8_t min, uint8_t max )
+{
+    if( !buf || buf >= end || min > max )
+        return end;
+    uint8_t span = max - min;
+#if defined( SC_AVX2 ) && !defined( SC_AVX2_RUNTIME )
+    return find_zero_pair_avx2( buf, end, min, span );
+#elif defined( SC_AVX2 )
+    if( __builtin_cpu_supports( "avx2" ) )
+        return find_zero_pair_avx2( buf, end, min, span );
+    return find_zero_pair_sse2( buf, end, min, span );
+#elif defined( SC_SSE2 )
+    return find_zero_pair_sse2( buf, end, min, span );
+#elif defined( SC_NEON )
+    return find_zero_pair_neon( buf, end, min, span );
+#else
+    return find_zero_pair_c( buf, end, min, span );
+#endif
+}
@@ -0,0 +1,272 @@
+/*****************************************************************************
+ * thread.c
+ *****************************************************************************
+ * Copyright (C) 2017 L-SMASH project
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include "internal.h" /* must be placed first */
+
+#ifdef _WIN32
+/* Condition variables are available since Windows Vista. */
+#if !defined( _WIN32_WINNT ) || _WIN32_WINNT < 0x0600
+#undef  _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef _WIN32
+
+struct lsmash_thread_tag
+{
+    HANDLE handle;
+    void *(*func)( void *arg );
+    void  *arg;
+    void  *ret;
+};
+
+struct lsmash_mutex_tag
+{
+    CRITICAL_SECTION cs;
+};
+
+struct lsmash_cond_tag
+{
+    CONDITION_VARIABLE cv;
+};
+
+static unsigned __stdcall thread_start( void *arg )
+{
+    lsmash_thread_t *thread = (lsmash_thread_t *)arg;
+    thread->ret = thread->func( thread->arg );
+    return 0;
+}
+
+lsmash_thread_t *lsmash_thread_create( void *(*func)( void *arg ), void *arg )
+{
+    lsmash_thread_t *thread = lsmash_malloc_zero( sizeof(lsmash_thread_t) );
+    if( !thread )
+        return NULL;
+    thread->func   = func;
+    thread->arg    = arg;
+    thread->handle = (HANDLE)_beginthreadex( NULL, 0, thread_start, thread, 0, NULL );
+    if( !thread->handle )
+    {
+        lsmash_free( thread );
+        return NULL;
+    }
+    return thread;
+}
+
+void *lsmash_thread_join( lsmash_thread_t *thread )
+{
+    if( !thread )
+        return NULL;
+    WaitForSingleObject( thread->handle, INFINITE );
+    CloseHandle( thread->handle );
+    void *ret = thread->ret;
+    lsmash_free( thread );
+    return ret;
+}
+
+lsmash_mutex_t *lsmash_mutex_create( void )
+{
+    lsmash_mutex_t *mutex = lsmash_malloc( sizeof(lsmash_mutex_t) );
+    if( !mutex )
+        return NULL;
+    InitializeCriticalSection( &mutex->cs );
+    return mutex;
+}
+
+void lsmash_mutex_destroy( lsmash_mutex_t *mutex )
+{
+    if( !mutex )
+        return;
+    DeleteCriticalSection( &mutex->cs );
+    lsmash_free( mutex );
+}
+
+void lsmash_mutex_lock( lsmash_mutex_t *mutex )
+{
+    EnterCriticalSection( &mutex->cs );
+}
+
+void lsmash_mutex_unlock( lsmash_mutex_t *mutex )
+{
+    LeaveCriticalSection( &mutex->cs );
+}
+
+lsmash_cond_t *lsmash_cond_create( void )
+{
+    lsmash_cond_t *cond = lsmash_malloc( sizeof(lsmash_cond_t) );
+    if( !cond )
+        return NULL;
+    InitializeConditionVariable( &cond->cv );
+    return cond;
+}
+
+void lsmash_cond_destroy( lsmash_cond_t *cond )
+{
+    lsmash_free( cond );
+}
+
+void lsmash_cond_wait( lsmash_cond_t *cond, lsmash_mutex_t *mutex )
+{
+    SleepConditionVariableCS( &cond->cv, &mutex->cs, INFINITE );
+}
+
+void lsmash_cond_signal( lsmash_cond_t *cond )
+{
+    WakeConditionVariable( &cond->cv );
+}
+
+void lsmash_cond_broadcast( lsmash_cond_t *cond )
+{
+    WakeAllConditionVariable( &cond->cv );
+}
+
+uint32_t lsmash_atomic_increment( volatile uint32_t *value )
+{
+    return InterlockedIncrement( (volatile LONG *)value );
+}
+
+uint32_t lsmash_atomic_decrement( volatile uint32_t *value )
+{
+    return InterlockedDecrement( (volatile LONG *)value );
+}
+
+#else
+
+struct lsmash_thread_tag
+{
+    pthread_t handle;
+};
+
+struct lsmash_mutex_tag
+{
+    pthread_mutex_t handle;
+};
+
+struct lsmash_cond_tag
+{
+    pthread_cond_t handle;
+};
+
+lsmash_thread_t *lsmash_thread_create( void *(*func)( void *arg ), void *arg )
+{
+    lsmash_thread_t *thread = lsmash_malloc( sizeof(lsmash_thread_t) );
+    if( !thread )
+        return NULL;
+    if( pthread_create( &thread->handle, NULL, func, arg ) )
+    {
+        lsmash_free( thread );
+        return NULL;
+    }
+    return thread;
+}
+
+void *lsmash_thread_join( lsmash_thread_t *thread )
+{
+    if( !thread )
+        return NULL;
+    void *ret = NULL;
+    pthread_join( thread->handle, &ret );
+    lsmash_free( thread );
+    return ret;
+}
+
+lsmash_mutex_t *lsmash_mutex_create( void )
+{
+    lsmash_mutex_t *mutex = lsmash_malloc( sizeof(lsmash_mutex_t) );
+    if( !mutex )
+        return NULL;
+    if( pthread_mutex_init( &mutex->handle, NULL ) )
+    {
+        lsmash_free( mutex );
+        return NULL;
+    }
+    return mutex;
+}
+
+void lsmash_mutex_destroy( lsmash_mutex_t *mutex )
+{
+    if( !mutex )
+        return;
+    pthread_mutex_destroy( &mutex->handle );
+    lsmash_free( mutex );
+}
+
+void lsmash_mutex_lock( lsmash_mutex_t *mutex )
+{
+    pthread_mutex_lock( &mutex->handle );
+}
+
+void lsmash_mutex_unlock( lsmash_mutex_t *mutex )
+{
+    pthread_mutex_unlock( &mutex->handle );
+}
+
+lsmash_cond_t *lsmash_cond_create( void )
+{
+    lsmash_cond_t *cond = lsmash_malloc( sizeof(lsmash_cond_t) );
+    if( !cond )
+        return NULL;
+    if( pthread_cond_init( &cond->handle, NULL ) )
+    {
+        lsmash_free( cond );
+        return NULL;
+    }
+    return cond;
+}
+
+void lsmash_cond_destroy( lsmash_cond_t *cond )
+{
+    if( !cond )
+        return;
+    pthread_cond_destroy( &cond->handle );
+    lsmash_free( cond );
+}
+
+void lsmash_cond_wait( lsmash_cond_t *cond, lsmash_mutex_t *mutex )
+{
+    pthread_cond_wait( &cond->handle, &mutex->handle );
+}
+
+void lsmash_cond_signal( lsmash_cond_t *cond )
+{
+    pthread_cond_signal( &cond->handle );
+}
+
+void lsmash_cond_broadcast( lsmash_cond_t *cond )
+{
+    pthread_cond_broadcast( &cond->handle );
+}
+
+uint32_t lsmash_atomic_increment( volatile uint32_t *value )
+{
+    return __sync_add_and_fetch( value, 1 );
+}
+
+uint32_t lsmash_atomic_decrement( volatile uint32_t *value )
+{
+    return __sync_sub_and_fetch( value, 1 );
+}
+
+#endif
@@ -0,0 +1,44 @@
+/*****************************************************************************
+ * thread.h
+ *****************************************************************************
+ * Copyright (C) 2017 L-SMASH project
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+/*---- thread ----*/
+/* Thin wrappers of POSIX threads or Win32 threads.
+ * Every object is allocated on heap so that no platform header is needed here. */
+typedef struct lsmash_thread_tag lsmash_thread_t;
+typedef struct lsmash_mutex_tag  lsmash_mutex_t;
+typedef struct lsmash_cond_tag   lsmash_cond_t;
+
+lsmash_thread_t *lsmash_thread_create( void *(*func)( void *arg ), void *arg );
+void *lsmash_thread_join( lsmash_thread_t *thread );
+
+lsmash_mutex_t *lsmash_mutex_create( void );
+void lsmash_mutex_destroy( lsmash_mutex_t *mutex );
+void lsmash_mutex_lock( lsmash_mutex_t *mutex );
+void lsmash_mutex_unlock( lsmash_mutex_t *mutex );
+
+lsmash_cond_t *lsmash_cond_create( void );
+void lsmash_cond_destroy( lsmash_cond_t *cond );
+void lsmash_cond_wait( lsmash_cond_t *cond, lsmash_mutex_t *mutex );
+void lsmash_cond_signal( lsmash_cond_t *cond );
+void lsmash_cond_broadcast( lsmash_cond_t *cond );
+
+/* Atomically increment or decrement a value and return the result. */
+uint32_t lsmash_atomic_increment( volatile uint32_t *value );
+uint32_t lsmash_atomic_decrement( volatile uint32_t *value );
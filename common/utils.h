@@ -127,25 +127,36 @@ static inline uint32_t lsmash_count_bits
     return (bits & 0x0000ffff) + ((bits >> 16) & 0x0000ffff);
 }
 
-static inline size_t lsmash_floor_log2
+/* Count the number of the leading zero bits of a non-zero value. */
+static inline int lsmash_count_leading_zeros64
 (
     uint64_t value
 )
 {
-    assert( value >= 1 );
+    assert( value != 0 );
 #if defined(__GNUC__) && (__GNUC__ >= 4 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4))  /* GCC >= 3.4 */
-    return (sizeof(uint64_t) - 1) - __builtin_clzll( value );
+    return __builtin_clzll( value );
 #else
-    size_t s = 0;
-    while( value )
-    {
-        value >>= 1;
-        ++s;
-    }
-    return s - 1;
+    int n = 0;
+    if( !(value >> 32) ) { n += 32; value <<= 32; }
+    if( !(value >> 48) ) { n += 16; value <<= 16; }
+    if( !(value >> 56) ) { n +=  8; value <<=  8; }
+    if( !(value >> 60) ) { n +=  4; value <<=  4; }
+    if( !(value >> 62) ) { n +=  2; value <<=  2; }
+    if( !(value >> 63) ) { n +=  1; }
+    return n;
 #endif
 }
 
+static inline size_t lsmash_floor_log2
+(
+    uint64_t value
+)
+{
+    assert( value >= 1 );
+    return 63 - lsmash_count_leading_zeros64( value );
+}
+
 static inline size_t lsmash_ceil_log2
 (
     uint64_t value
@@ -0,0 +1,2 @@
+#define LSMASH_REV "31"
+#define LSMASH_GIT_HASH "44b59ee"
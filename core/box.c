@@ -72,7 +72,7 @@ void isom_init_box_common_orig
     isom_set_box_writer( box );
 }
 
-static void isom_reorder_tail_box( isom_box_t *parent )
+void isom_reorder_tail_box( isom_box_t *parent )
 {
     /* Reorder the appended box by 'precedence'. */
     lsmash_entry_t *x = parent->extensions.tail;
@@ -538,6 +538,16 @@ lsmash_entry_t *isom_get_entry_of_box
 #define DEFINE_SIMPLE_LIST_BOX_IN_LIST_REMOVER( func_name, box_name ) \
         DEFINE_SIMPLE_BOX_REMOVER_TEMPLATE( REMOVE_LIST_BOX_IN_LIST, box_name )
 
+#define REMOVE_TABLE_BOX( box_name )          \
+    do                                        \
+    {                                         \
+        lsmash_free( box_name->entries );     \
+        REMOVE_BOX( box_name );               \
+    } while( 0 )
+
+#define DEFINE_SIMPLE_TABLE_BOX_REMOVER( func_name, box_name ) \
+        DEFINE_SIMPLE_BOX_REMOVER_TEMPLATE( REMOVE_TABLE_BOX, box_name )
+
 static void isom_remove_predefined_box( void *opaque_box )
 {
     isom_box_t *box = (isom_box_t *)opaque_box;
@@ -597,6 +607,35 @@ void isom_remove_box_by_itself( void *opaque_box )
     isom_remove_extension_box( box );
 }
 
+/* Sample tables may have entries as many as samples, so their entries are stored in growable arrays
+ * instead of lists to avoid per-entry allocations.
+ * Return the array that can hold 'additional_count' entries in addition to 'entry_count' entries,
+ * or NULL on failure, in which case the original array is left untouched. */
+void *isom_reserve_table_entries
+(
+    void     *entries,
+    uint32_t *alloc_count,
+    uint32_t  entry_count,
+    uint32_t  additional_count,
+    size_t    entry_size
+)
+{
+    uint64_t required_count = (uint64_t)entry_count + additional_count;
+    if( required_count <= *alloc_count )
+        return entries;
+    if( required_count > UINT32_MAX )
+        return NULL;
+    uint64_t new_alloc = LSMASH_MAX( 2 * (uint64_t)*alloc_count, 16 );
+    new_alloc = LSMASH_MIN( LSMASH_MAX( new_alloc, required_count ), UINT32_MAX );
+    if( new_alloc > SIZE_MAX / entry_size )
+        return NULL;
+    void *temp = lsmash_realloc( entries, new_alloc * entry_size );
+    if( !temp )
+        return NULL;
+    *alloc_count = new_alloc;
+    return temp;
+}
+
 void isom_remove_unknown_box( isom_unknown_box_t *unknown_box )
 {
     lsmash_free( unknown_box->unknown_field );
@@ -641,6 +680,7 @@ static void isom_remove_trak( isom_trak_t *trak )
         lsmash_list_destroy( trak->cache->roll.pool );
         lsmash_free( trak->cache->rap );
         lsmash_free( trak->cache->fragment );
+        lsmash_free( trak->cache->bitrate.entries );
         lsmash_free( trak->cache );
     }
     REMOVE_BOX_IN_LIST( trak );
@@ -916,15 +956,21 @@ void isom_remove_sample_description( isom_sample_entry_t *sample )
         }
 }
 
-DEFINE_SIMPLE_LIST_BOX_REMOVER( isom_remove_stts, stts )
-DEFINE_SIMPLE_LIST_BOX_REMOVER( isom_remove_ctts, ctts )
+DEFINE_SIMPLE_TABLE_BOX_REMOVER( isom_remove_stts, stts )
+DEFINE_SIMPLE_TABLE_BOX_REMOVER( isom_remove_ctts, ctts )
 DEFINE_SIMPLE_BOX_REMOVER( isom_remove_cslg, cslg )
-DEFINE_SIMPLE_LIST_BOX_REMOVER( isom_remove_stsc, stsc )
-DEFINE_SIMPLE_LIST_BOX_REMOVER( isom_remove_stsz, stsz )
-DEFINE_SIMPLE_LIST_BOX_REMOVER( isom_remove_stz2, stz2 )
+DEFINE_SIMPLE_TABLE_BOX_REMOVER( isom_remove_stsc, stsc )
+DEFINE_SIMPLE_TABLE_BOX_REMOVER( isom_remove_stsz, stsz )
+DEFINE_SIMPLE_TABLE_BOX_REMOVER( isom_remove_stz2, stz2 )
 DEFINE_SIMPLE_LIST_BOX_REMOVER( isom_remove_stss, stss )
 DEFINE_SIMPLE_LIST_BOX_REMOVER( isom_remove_stps, stps )
-DEFINE_SIMPLE_LIST_BOX_REMOVER( isom_remove_stco, stco )
+
+static void isom_remove_stco( isom_stco_t *stco )
+{
+    /* Both of the members of the union point to the same array. */
+    lsmash_free( stco->entries.stco );
+    REMOVE_BOX( stco );
+}
 
 static void isom_remove_sdtp( isom_sdtp_t *sdtp )
 {
@@ -1056,16 +1102,9 @@ static void isom_remove_styp( isom_styp_t *styp )
 }
 
 #define isom_remove_elst_entry lsmash_free
-#define isom_remove_stts_entry lsmash_free
-#define isom_remove_ctts_entry lsmash_free
-#define isom_remove_stsz_entry lsmash_free
-#define isom_remove_stz2_entry lsmash_free
 #define isom_remove_stss_entry lsmash_free
 #define isom_remove_stps_entry lsmash_free
 #define isom_remove_sdtp_entry lsmash_free
-#define isom_remove_stsc_entry lsmash_free
-#define isom_remove_stco_entry lsmash_free
-#define isom_remove_co64_entry lsmash_free
 #define isom_remove_sgpd_entry lsmash_free
 #define isom_remove_sbgp_entry lsmash_free
 #define isom_remove_trun_entry lsmash_free
@@ -1500,25 +1539,25 @@ DEFINE_SIMPLE_SAMPLE_EXTENSION_ADDER( isom_add_tims, tims, hint,   ISOM_BOX_TYPE
 DEFINE_SIMPLE_SAMPLE_EXTENSION_ADDER( isom_add_tsro, tsro, hint,   ISOM_BOX_TYPE_TSRO, LSMASH_BOX_PRECEDENCE_ISOM_TSRO, 0, isom_hint_entry_t )
 DEFINE_SIMPLE_SAMPLE_EXTENSION_ADDER( isom_add_tssy, tssy, hint,   ISOM_BOX_TYPE_TSSY, LSMASH_BOX_PRECEDENCE_ISOM_TSSY, 0, isom_hint_entry_t )
 
-DEFINE_SIMPLE_LIST_BOX_ADDER( isom_add_stts, stts, stbl, ISOM_BOX_TYPE_STTS, LSMASH_BOX_PRECEDENCE_ISOM_STTS )
-DEFINE_SIMPLE_LIST_BOX_ADDER( isom_add_ctts, ctts, stbl, ISOM_BOX_TYPE_CTTS, LSMASH_BOX_PRECEDENCE_ISOM_CTTS )
+DEFINE_SIMPLE_BOX_ADDER     ( isom_add_stts, stts, stbl, ISOM_BOX_TYPE_STTS, LSMASH_BOX_PRECEDENCE_ISOM_STTS )
+DEFINE_SIMPLE_BOX_ADDER     ( isom_add_ctts, ctts, stbl, ISOM_BOX_TYPE_CTTS, LSMASH_BOX_PRECEDENCE_ISOM_CTTS )
 DEFINE_SIMPLE_BOX_ADDER     ( isom_add_cslg, cslg, stbl, ISOM_BOX_TYPE_CSLG, LSMASH_BOX_PRECEDENCE_ISOM_CSLG )
-DEFINE_SIMPLE_LIST_BOX_ADDER( isom_add_stsc, stsc, stbl, ISOM_BOX_TYPE_STSC, LSMASH_BOX_PRECEDENCE_ISOM_STSC )
-DEFINE_SIMPLE_BOX_ADDER     ( isom_add_stsz, stsz, stbl, ISOM_BOX_TYPE_STSZ, LSMASH_BOX_PRECEDENCE_ISOM_STSZ )  /* We don't create a list here. */
-DEFINE_SIMPLE_LIST_BOX_ADDER( isom_add_stz2, stz2, stbl, ISOM_BOX_TYPE_STZ2, LSMASH_BOX_PRECEDENCE_ISOM_STZ2 )
+DEFINE_SIMPLE_BOX_ADDER     ( isom_add_stsc, stsc, stbl, ISOM_BOX_TYPE_STSC, LSMASH_BOX_PRECEDENCE_ISOM_STSC )
+DEFINE_SIMPLE_BOX_ADDER     ( isom_add_stsz, stsz, stbl, ISOM_BOX_TYPE_STSZ, LSMASH_BOX_PRECEDENCE_ISOM_STSZ )  /* We don't create a table here. */
+DEFINE_SIMPLE_BOX_ADDER     ( isom_add_stz2, stz2, stbl, ISOM_BOX_TYPE_STZ2, LSMASH_BOX_PRECEDENCE_ISOM_STZ2 )
 DEFINE_SIMPLE_LIST_BOX_ADDER( isom_add_stss, stss, stbl, ISOM_BOX_TYPE_STSS, LSMASH_BOX_PRECEDENCE_ISOM_STSS )
 DEFINE_SIMPLE_LIST_BOX_ADDER( isom_add_stps, stps, stbl,   QT_BOX_TYPE_STPS, LSMASH_BOX_PRECEDENCE_QTFF_STPS )
 
 isom_stco_t *isom_add_stco( isom_stbl_t *stbl )
 {
-    ADD_LIST_BOX( stco, stbl, ISOM_BOX_TYPE_STCO, LSMASH_BOX_PRECEDENCE_ISOM_STCO );
+    ADD_BOX( stco, stbl, ISOM_BOX_TYPE_STCO, LSMASH_BOX_PRECEDENCE_ISOM_STCO );
     stco->large_presentation = 0;
     return stco;
 }
 
 isom_stco_t *isom_add_co64( isom_stbl_t *stbl )
 {
-    ADD_LIST_BOX( stco, stbl, ISOM_BOX_TYPE_CO64, LSMASH_BOX_PRECEDENCE_ISOM_CO64 );
+    ADD_BOX( stco, stbl, ISOM_BOX_TYPE_CO64, LSMASH_BOX_PRECEDENCE_ISOM_CO64 );
     stco->large_presentation = 1;
     return stco;
 }
@@ -1747,11 +1786,19 @@ lsmash_root_t *lsmash_create_root( void )
     if( LSMASH_IS_NON_EXISTING_BOX( root ) )
         return NULL;
     root->root = root;
+    root->sample_arena = isom_create_sample_arena();
+    if( !root->sample_arena )
+    {
+        isom_remove_box_by_itself( root );
+        return NULL;
+    }
     return root;
 }
 
 void lsmash_destroy_root( lsmash_root_t *root )
 {
+    if( LSMASH_IS_EXISTING_BOX( root ) )
+        isom_orphan_sample_arena( root->sample_arena );
     isom_remove_box_by_itself( root );
 }
 
@@ -1944,6 +1991,8 @@ int lsmash_add_box_ex
     bs->read   = fake_file_read;
     bs->write  = NULL;
     bs->seek   = fake_file_seek;
+    bs->writev = NULL;
+    bs->shift  = NULL;
     file->bs             = bs;
     file->fake_file_mode = 1;
     /* Make the byte string representing the given box. */
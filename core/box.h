@@ -42,6 +42,8 @@ typedef struct isom_unknown_box_tag isom_unknown_box_t;
 typedef struct isom_mdhd_tag isom_mdhd_t;
 typedef struct isom_stbl_tag isom_stbl_t;
 
+typedef struct isom_sample_arena_tag isom_sample_arena_t;
+
 typedef void (*isom_extension_destructor_t)( void *extension_data );
 typedef int (*isom_extension_writer_t)( lsmash_bs_t *bs, isom_box_t *box );
 
@@ -90,6 +92,7 @@ typedef int (*isom_bitrate_updater_t)( isom_stbl_t *stbl, isom_mdhd_t *mdhd, uin
 #define LSMASH_NON_EXISTING_BOX  0x800  /* This flag indicates a read only non-existing box constant.
                                          * Don't use for wild boxes other than non-existing box constants
                                          * because this flags prevents attempting to freeing its box. */
+#define LSMASH_UNPARSED_BOX      0x1000 /* The children of this box are not read yet. */
 
 /* Use these macros for checking existences of boxes.
  * If the result of LSMASH_IS_EXISTING_BOX is 0, the evaluated box is read only.
@@ -972,7 +975,9 @@ typedef struct
 typedef struct
 {
     ISOM_FULLBOX_COMMON;
-    lsmash_entry_list_t *list;
+    uint32_t           entry_count;
+    uint32_t           alloc_count;     /* the number of allocated entries */
+    isom_stts_entry_t *entries;
 } isom_stts_t;
 
 /* Composition Time to Sample Box
@@ -991,7 +996,9 @@ typedef struct
 typedef struct
 {
     ISOM_FULLBOX_COMMON;
-    lsmash_entry_list_t *list;
+    uint32_t           entry_count;
+    uint32_t           alloc_count;     /* the number of allocated entries */
+    isom_ctts_entry_t *entries;
 } isom_ctts_t;
 
 /* Composition to Decode Box (Composition Shift Least Greatest Box)
@@ -1027,7 +1034,10 @@ typedef struct
     uint32_t sample_size;           /* the default sample size
                                      * If this field is set to 0, then the samples have different sizes. */
     uint32_t sample_count;          /* the number of samples in the media within the initial movie */
-    lsmash_entry_list_t *list;      /* available if sample_size == 0 */
+    uint32_t entry_count;           /* the number of entries actually stored in the table
+                                     * This is less than sample_count only if the table read from a file is truncated. */
+    uint32_t alloc_count;           /* the number of allocated entries */
+    isom_stsz_entry_t *entries;     /* available if sample_size == 0 */
 } isom_stsz_t;
 
 typedef struct
@@ -1039,7 +1049,9 @@ typedef struct
                                      * entry[i]<<4 + entry[i+1]; if the sizes do not fill an integral number of bytes, the last byte is
                                      * padded with zero. */
     uint32_t     sample_count;      /* the number of entries in the following table */
-    lsmash_entry_list_t *list;      /* L-SMASH uses isom_stsz_entry_t for its internal processes. */
+    uint32_t     entry_count;       /* the number of entries actually stored in the table */
+    uint32_t     alloc_count;       /* the number of allocated entries */
+    isom_stsz_entry_t *entries;     /* L-SMASH uses isom_stsz_entry_t for its internal processes. */
 } isom_stz2_t;
 
 /* Sync Sample Box
@@ -1105,7 +1117,9 @@ typedef struct
 typedef struct
 {
     ISOM_FULLBOX_COMMON;
-    lsmash_entry_list_t *list;
+    uint32_t           entry_count;
+    uint32_t           alloc_count;     /* the number of allocated entries */
+    isom_stsc_entry_t *entries;
 } isom_stsc_t;
 
 /* Chunk Offset Box
@@ -1125,7 +1139,13 @@ typedef struct
 typedef struct
 {
     ISOM_FULLBOX_COMMON;        /* type = 'stco': 32-bit chunk offsets / type = 'co64': 64-bit chunk offsets */
-    lsmash_entry_list_t *list;
+    uint32_t entry_count;
+    uint32_t alloc_count;       /* the number of allocated entries */
+    union
+    {
+        isom_stco_entry_t *stco;    /* available if large_presentation == 0 */
+        isom_co64_entry_t *co64;    /* available if large_presentation == 1 */
+    } entries;
 
         uint8_t large_presentation;     /* Set 1 to this if 64-bit chunk-offset are needed. */
 } isom_stco_t;      /* share with co64 box */
@@ -1496,12 +1516,27 @@ typedef struct
 /** Caches for handling tracks **/
 typedef struct
 {
-    uint64_t alloc;             /* total buffer size for the pool */
-    uint64_t size;              /* total size of samples in the pool */
-    uint32_t sample_count;      /* number of samples in the pool */
-    uint8_t *data;              /* actual data of samples in the pool */
+    uint64_t          size;         /* total size of samples in the pool */
+    uint32_t          sample_count; /* number of samples in the pool */
+    uint32_t          entry_count;  /* number of pooled sample objects
+                                     * This differs from sample_count if a sample object contains multiple samples. */
+    uint32_t          alloc_count;  /* number of allocated entries */
+    lsmash_sample_t **samples;      /* pooled samples
+                                     * The data of samples are kept as they are until written, and never copied. */
 } isom_sample_pool_t;
 
+typedef struct
+{
+    volatile uint32_t    refcount;  /* number of references to this buffer from samples and a timeline
+                                     * Samples may be released on a thread other than the one reading the data. */
+    uint64_t             pos;       /* absolute file offset of the data */
+    uint64_t             size;      /* size of the data */
+    lsmash_file_t       *file;      /* file the data is read from */
+    uint8_t             *data;      /* data shared by samples */
+    isom_sample_arena_t *arena;     /* arena the buffer is returned to when released
+                                     * If NULL, the buffer is deallocated instead. */
+} isom_sample_buffer_t;
+
 typedef struct
 {
     uint32_t chunk_number;                  /* chunk number */
@@ -1555,6 +1590,8 @@ typedef struct
     uint64_t largest_cts;          /* the largest CTS of a subsegment of the reference stream */
     uint64_t smallest_cts;         /* the smallest CTS of a subsegment of the reference stream */
     uint64_t first_sample_cts;     /* the CTS of the first sample of a subsegment of the reference stream  */
+    uint32_t sample_count;         /* the number of samples of a subsegment of the reference stream */
+    uint32_t output_sample_count;  /* the number of output samples of a subsegment of the reference stream */
     /* SAP related info within the active subsegment of the reference stream */
     uint64_t                  first_ed_cts;     /* the earliest CTS of decodable samples after the first recovery point */
     uint64_t                  first_rp_cts;     /* the CTS of the first recovery point */
@@ -1573,20 +1610,44 @@ typedef struct
     uint32_t          traf_number;
     uint32_t          last_duration;        /* the last sample duration in this track fragment */
     uint64_t          largest_cts;          /* the largest CTS in this track fragment */
+    uint64_t          first_dts;            /* the DTS of the first sample in this track fragment */
     uint32_t          sample_count;         /* the number of samples in this track fragment */
     uint32_t          output_sample_count;  /* the number of output samples in this track fragment */
     isom_subsegment_t subsegment;
 } isom_fragment_t;
 
+/* statistics for the bitrate description of a sample description
+ * Samples associated with the sample description are placed on a timeline consisting only of them,
+ * and the timeline is divided into windows each of which lasts at least one second. */
+typedef struct
+{
+    uint64_t total_size;        /* the total size of samples */
+    uint64_t dts;               /* the DTS of the next sample on the timeline */
+    uint64_t time_wnd;          /* the DTS of the start of the current window */
+    uint32_t rate;              /* the total size of samples in the current window */
+    uint32_t max_rate;          /* the largest total size of samples in a window */
+    uint32_t max_sample_size;   /* the largest size of a sample */
+} isom_bitrate_t;
+
+typedef struct
+{
+    uint32_t        sample_count;   /* the number of samples in the sample table which the statistics cover */
+    uint32_t        last_index;     /* the sample description index of the last sample */
+    uint64_t        last_dts;       /* the DTS of the last sample */
+    uint32_t        entry_count;
+    isom_bitrate_t *entries;        /* the statistics of each sample description */
+} isom_bitrate_cache_t;
+
 typedef struct
 {
-    uint8_t           all_sync;     /* if all samples are sync sample */
-    uint8_t           is_audio;
-    isom_chunk_t      chunk;
-    isom_timestamp_t  timestamp;    /* Each field stores the last valid value. */
-    isom_grouping_t   roll;
-    isom_rap_group_t *rap;
-    isom_fragment_t  *fragment;
+    uint8_t              all_sync;  /* if all samples are sync sample */
+    uint8_t              is_audio;
+    isom_chunk_t         chunk;
+    isom_timestamp_t     timestamp; /* Each field stores the last valid value. */
+    isom_grouping_t      roll;
+    isom_rap_group_t    *rap;
+    isom_fragment_t     *fragment;
+    isom_bitrate_cache_t bitrate;   /* accumulated while appending samples into the sample table */
 } isom_cache_t;
 
 /** Movie Fragments Boxes **/
@@ -1843,6 +1904,7 @@ typedef struct
 #define FIRST_MOOF_POS_UNDETERMINED UINT64_MAX
     isom_moof_t         *movie;             /* the address corresponding to the current Movie Fragment Box */
     uint64_t             first_moof_pos;
+    uint64_t             subsegment_pos;    /* the position of the first Movie Fragment Box of the current subsegment */
     uint64_t             pool_size;         /* the total sample size in the current movie fragment */
     uint64_t             sample_count;      /* the number of samples within the current movie fragment */
     lsmash_entry_list_t *pool;              /* samples pooled to interleave for the current movie fragment */
@@ -2024,6 +2086,11 @@ struct lsmash_file_tag
         double    max_chunk_duration;       /* max duration per chunk in seconds */
         double    max_async_tolerance;      /* max tolerance, in seconds, for amount of interleaving asynchronization between tracks */
         uint64_t  max_chunk_size;           /* max size per chunk in bytes. */
+        uint32_t  max_fragment_chunk_samples;   /* max number of samples per chunk of a movie fragment */
+        double    max_fragment_chunk_duration;  /* max duration per chunk of a movie fragment in seconds */
+        uint64_t  max_segment_buffer_size;      /* max size of a media segment held on memory for unseekable output */
+        uint64_t  reserved_movie_size;      /* the reserved size for the Movie Box and the Meta Box at the front of the file */
+        uint64_t  reserved_movie_pos;       /* the position of the reserved region */
         uint32_t  brand_count;
         uint32_t *compatible_brands;        /* the backup of the compatible brands in the File Type Box or the valid Segment Type Box */
         uint8_t   fake_file_mode;           /* If set to 1, the bytestream manager handles fake-file stream. */
@@ -2057,6 +2124,8 @@ struct lsmash_root_tag
 {
     ISOM_FULLBOX_COMMON;                    /* The 'file' field contains the address of the current active file. */
     lsmash_entry_list_t file_abstract_list; /* the list of all files the ROOT contains */
+    isom_sample_arena_t *sample_arena;      /* recycler of samples created by lsmash_create_pooled_sample()
+                                             * This is made together with the ROOT since samples may be created on several threads. */
 };
 
 /** **/
@@ -2430,7 +2499,34 @@ uint32_t isom_get_sample_count
 
 isom_sample_pool_t *isom_create_sample_pool
 (
-    uint64_t size
+    uint32_t alloc_count
+);
+
+isom_sample_buffer_t *isom_create_sample_buffer
+(
+    lsmash_file_t *file,
+    uint64_t       pos,
+    uint8_t       *data,
+    uint64_t       size
+);
+
+void isom_release_sample_buffer
+(
+    isom_sample_buffer_t *buffer
+);
+
+lsmash_sample_t *isom_create_sample_view
+(
+    isom_sample_buffer_t *buffer,
+    uint64_t              pos,
+    uint32_t              length
+);
+
+isom_sample_arena_t *isom_create_sample_arena( void );
+
+void isom_orphan_sample_arena
+(
+    isom_sample_arena_t *arena
 );
 
 int isom_update_sample_tables
@@ -2448,6 +2544,17 @@ int isom_pool_sample
     uint32_t            samples_per_packet
 );
 
+int isom_write_sample_pool
+(
+    lsmash_bs_t        *bs,
+    isom_sample_pool_t *pool
+);
+
+void isom_empty_sample_pool
+(
+    isom_sample_pool_t *pool
+);
+
 int isom_append_sample_by_type
 (
     void                *track,
@@ -2665,5 +2772,15 @@ void isom_remove_all_extension_boxes( lsmash_entry_list_t *extensions );
 isom_box_t *isom_get_extension_box( lsmash_entry_list_t *extensions, lsmash_box_type_t box_type );
 void *isom_get_extension_box_format( lsmash_entry_list_t *extensions, lsmash_box_type_t box_type );
 void isom_remove_box_by_itself( void *opaque_box );
+void isom_reorder_tail_box( isom_box_t *parent );
+
+void *isom_reserve_table_entries
+(
+    void     *entries,
+    uint32_t *alloc_count,
+    uint32_t  entry_count,
+    uint32_t  additional_count,
+    size_t    entry_size
+);
 
 #endif
@@ -29,6 +29,15 @@
 
 #include <string.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <errno.h>
+
+/* for writev() */
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 #include "box.h"
 #include "read.h"
@@ -237,9 +246,9 @@ int isom_check_mandatory_boxes
             return LSMASH_ERR_INVALID_DATA;
         if( !file->fragment
          && (!stbl->stsd->list.head
-          || !stbl->stts->list || !stbl->stts->list->head
-          || !stbl->stsc->list || !stbl->stsc->list->head
-          || !stbl->stco->list || !stbl->stco->list->head) )
+          || stbl->stts->entry_count == 0
+          || stbl->stsc->entry_count == 0
+          || stbl->stco->entry_count == 0) )
             return LSMASH_ERR_INVALID_DATA;
     }
     if( !file->fragment )
@@ -265,11 +274,21 @@ int isom_rearrange_data
 )
 {
     assert( remux );
-    /* Copy-pastan */
-    int buf_switch = 1;
     lsmash_bs_t *bs = file->bs;
     int     ret;
     int64_t ret64;
+    if( !buf[0] )
+    {
+        /* The data was already moved by lsmash_bs_shift_data(). */
+        ret64 = lsmash_bs_write_seek( bs, 0, SEEK_END );
+        if( ret64 < 0 )
+            return ret64;
+        if( remux->func )
+            remux->func( remux->param, file_size, file_size );
+        return 0;
+    }
+    /* Copy-pastan */
+    int buf_switch = 1;
     while( read_num == size )
     {
         ret64 = lsmash_bs_write_seek( bs, read_pos, SEEK_SET );
@@ -410,6 +429,8 @@ typedef struct
     int   is_standard_stream;   /* If set to 1, 'file_ptr' points to standard stream (i.e. stdin, stdout or stderr).
                                  * This flag prevents from accidentally closing standard streams. */
     lsmash_file_mode file_mode;
+    uint8_t *map;               /* the address of the whole file mapped into memory for reading */
+    uint64_t map_size;
 } default_io_stream_t;
 
 static default_io_stream_t *default_io_stream_open( const char *filename, int open_mode )
@@ -436,10 +457,22 @@ static default_io_stream_t *default_io_stream_open( const char *filename, int op
         memcpy( mode, "rb", 3 );
         stream->file_mode = LSMASH_FILE_MODE_READ;
     }
+    else if( open_mode == 2 )
+    {
+        /* The file is read as an input and its movie can be rewritten in place. */
+        memcpy( mode, "r+b", 4 );
+        stream->file_mode = LSMASH_FILE_MODE_READ;
+    }
     else
         assert( 0 );
     if( !strcmp( filename, "-" ) )
     {
+        if( open_mode == 2 )
+        {
+            /* Standard streams cannot be rewritten. */
+            lsmash_free( stream );
+            return NULL;
+        }
         if( stream->file_mode & LSMASH_FILE_MODE_READ )
         {
             stream->file_ptr           = stdin;
@@ -453,7 +486,12 @@ static default_io_stream_t *default_io_stream_open( const char *filename, int op
         }
     }
     else
+    {
         stream->file_ptr = lsmash_fopen( filename, mode );
+        /* Map a regular file for reading if possible. If not, it is read through stdio. */
+        if( stream->file_ptr && (stream->file_mode & LSMASH_FILE_MODE_READ) )
+            stream->map = lsmash_map_file( stream->file_ptr, &stream->map_size );
+    }
     if( stream->file_ptr == NULL )
         lsmash_freep( &stream );
     return stream;
@@ -463,6 +501,8 @@ static int default_io_stream_close( default_io_stream_t *stream )
 {
     if( !stream )
         return 0;
+    if( stream->map )
+        lsmash_unmap_file( stream->map, stream->map_size );
     int ret = stream->is_standard_stream ? 0 : fclose( stream->file_ptr );
     lsmash_free( stream );
     return ret;
@@ -486,6 +526,90 @@ static int64_t default_io_stream_seek( void *opaque, int64_t offset, int whence
     return lsmash_ftell( ((default_io_stream_t *)opaque)->file_ptr );
 }
 
+#ifndef _WIN32
+#ifdef IOV_MAX
+#define DEFAULT_IO_MAX_VECTORS LSMASH_MIN( IOV_MAX, 64 )
+#else
+#define DEFAULT_IO_MAX_VECTORS 16
+#endif
+#define DEFAULT_IO_MAX_WRITE_SIZE (1 << 30)
+
+static int64_t default_io_stream_writev( void *opaque, const lsmash_io_vector_t *vec, int count )
+{
+    /* Write through the file descriptor directly after writing out the data buffered by stdio. */
+    FILE *fp = ((default_io_stream_t *)opaque)->file_ptr;
+    if( fflush( fp ) != 0 )
+        return LSMASH_ERR_NAMELESS;
+    int fd = fileno( fp );
+    struct iovec iov[DEFAULT_IO_MAX_VECTORS];
+    int64_t  total = 0;
+    int      i     = 0;
+    uint64_t done  = 0;     /* the number of bytes written in vec[i] */
+    while( 1 )
+    {
+        while( i < count && done == vec[i].size )
+        {
+            ++i;
+            done = 0;
+        }
+        if( i == count )
+            break;
+        int    n    = 0;
+        size_t size = 0;
+        for( int j = i; j < count && n < DEFAULT_IO_MAX_VECTORS && size < DEFAULT_IO_MAX_WRITE_SIZE; j++ )
+        {
+            uint64_t offset = j == i ? done : 0;
+            iov[n].iov_base = vec[j].data + offset;
+            iov[n].iov_len  = LSMASH_MIN( vec[j].size - offset, DEFAULT_IO_MAX_WRITE_SIZE - size );
+            size += iov[n++].iov_len;
+        }
+        ssize_t ret = writev( fd, iov, n );
+        if( ret < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            return LSMASH_ERR_NAMELESS;
+        }
+        total += ret;
+        /* A partial write may end in the middle of any buffer. */
+        while( ret > 0 )
+        {
+            uint64_t remainder = vec[i].size - done;
+            if( (uint64_t)ret < remainder )
+            {
+                done += ret;
+                break;
+            }
+            ret -= remainder;
+            ++i;
+            done = 0;
+        }
+    }
+    /* Let stdio know the position of the file descriptor. Unseekable streams such as pipes have no position. */
+    off_t pos = lseek( fd, 0, SEEK_CUR );
+    if( pos >= 0 && lsmash_fseek( fp, pos, SEEK_SET ) != 0 )
+        return LSMASH_ERR_NAMELESS;
+    return total;
+}
+
+static int64_t default_io_stream_shift( void *opaque, uint64_t offset, uint64_t shift )
+{
+    /* Move the data inside the kernel after writing out the data buffered by stdio. */
+    FILE *fp = ((default_io_stream_t *)opaque)->file_ptr;
+    if( fflush( fp ) != 0 )
+        return LSMASH_ERR_NAMELESS;
+    return lsmash_shift_file_data( fp, offset, shift );
+}
+#endif
+
+int64_t isom_get_file_modification_time( lsmash_file_t *file )
+{
+    if( !file->bs || file->bs->read != default_io_stream_read )
+        return 0;
+    default_io_stream_t *stream = (default_io_stream_t *)file->bs->stream;
+    return stream->is_standard_stream ? 0 : lsmash_get_file_modification_time( stream->file_ptr );
+}
+
 /*******************************
     public interfaces
 *******************************/
@@ -508,7 +632,7 @@ int lsmash_open_file
     lsmash_file_parameters_t *param
 )
 {
-    if( !filename || !param || (open_mode != 0 && open_mode != 1) )
+    if( !filename || !param || open_mode < 0 || open_mode > 2 )
         return LSMASH_ERR_FUNCTION_PARAM;
     default_io_stream_t *stream = default_io_stream_open( filename, open_mode );
     if( !stream )
@@ -567,15 +691,28 @@ lsmash_file_t *lsmash_set_file
     file->max_chunk_duration  = param->max_chunk_duration;
     file->max_async_tolerance = LSMASH_MAX( param->max_async_tolerance, 2 * param->max_chunk_duration );
     file->max_chunk_size      = param->max_chunk_size;
+    file->max_segment_buffer_size = 64 * 1024 * 1024;
+    if( param->read == default_io_stream_read
+     && ((default_io_stream_t *)param->opaque)->map
+     && !(file->flags & LSMASH_FILE_MODE_WRITE) )
+    {
+        /* Read the file through the memory mapping instead of copying into the buffer. */
+        default_io_stream_t *stream = (default_io_stream_t *)param->opaque;
+        if( lsmash_bs_set_mapped_stream( bs, stream->map, stream->map_size ) < 0 )
+            goto fail;
+    }
+#ifndef _WIN32
+    if( param->read == default_io_stream_read
+     && (file->flags & LSMASH_FILE_MODE_WRITE) )
+    {
+        file->bs->writev = default_io_stream_writev;
+        if( !((default_io_stream_t *)param->opaque)->is_standard_stream )
+            file->bs->shift = default_io_stream_shift;
+    }
+#endif
     if( (file->flags & LSMASH_FILE_MODE_WRITE)
      && (file->flags & LSMASH_FILE_MODE_BOX) )
     {
-        /* Construction of Segment Index Box requires seekability at our current implementation.
-         * If segment is not so large, data rearrangement can be avoided by buffering i.e. the
-         * seekability is not essential, but at present we don't support buffering of all materials
-         * within segment. */
-        if( (file->flags & LSMASH_FILE_MODE_INDEX) && file->bs->unseekable )
-            goto fail;
         /* Establish the fragment handler if required. */
         if( file->flags & LSMASH_FILE_MODE_FRAGMENTED )
         {
@@ -583,6 +720,7 @@ lsmash_file_t *lsmash_set_file
             if( !file->fragment )
                 goto fail;
             file->fragment->first_moof_pos = FIRST_MOOF_POS_UNDETERMINED;
+            file->fragment->subsegment_pos = FIRST_MOOF_POS_UNDETERMINED;
             file->fragment->pool = lsmash_list_create( isom_remove_sample_pool );
             if( !file->fragment->pool )
                 goto fail;
@@ -607,6 +745,60 @@ fail:
     return NULL;
 }
 
+int lsmash_set_file_writev
+(
+    lsmash_file_t               *file,
+    lsmash_file_writev_callback  writev
+)
+{
+    if( LSMASH_IS_NON_EXISTING_BOX( file ) || !file->bs )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    file->bs->writev = writev;
+    return 0;
+}
+
+int lsmash_set_file_shift
+(
+    lsmash_file_t              *file,
+    lsmash_file_shift_callback  shift
+)
+{
+    if( LSMASH_IS_NON_EXISTING_BOX( file ) || !file->bs )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    file->bs->shift = shift;
+    return 0;
+}
+
+int lsmash_set_file_write_queue_length
+(
+    lsmash_file_t *file,
+    uint32_t       queue_length
+)
+{
+    if( LSMASH_IS_NON_EXISTING_BOX( file )
+     || !file->bs
+     || !(file->flags & LSMASH_FILE_MODE_WRITE)
+     || queue_length == 0 )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    if( file->size )
+        /* Something is already written. */
+        return LSMASH_ERR_NAMELESS;
+    return lsmash_bs_enable_async_write( file->bs, queue_length );
+}
+
+int lsmash_set_max_segment_buffer_size
+(
+    lsmash_file_t *file,
+    uint64_t       size
+)
+{
+    if( LSMASH_IS_NON_EXISTING_BOX( file )
+     || !(file->flags & LSMASH_FILE_MODE_WRITE) )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    file->max_segment_buffer_size = size;
+    return 0;
+}
+
 int64_t lsmash_read_file
 (
     lsmash_file_t            *file,
@@ -697,6 +889,9 @@ int lsmash_switch_media_segment
     int ret = isom_finish_final_fragment_movie( predecessor, remux );
     if( ret < 0 )
         return ret;
+    /* Nothing is written into the predecessor anymore. Make it closable right after switching. */
+    if( (ret = lsmash_bs_disable_async_write( predecessor->bs )) < 0 )
+        return ret;
     if( predecessor->flags & LSMASH_FILE_MODE_INITIALIZATION )
     {
         if( predecessor->initializer != predecessor )
@@ -41,3 +41,10 @@ int isom_rearrange_data
     uint64_t              write_pos,
     uint64_t              file_size
 );
+
+/* Get the last modification time of the file opened by lsmash_open_file().
+ * Return 0 if unavailable, e.g. the file is read through the I/O functions given by the user. */
+int64_t isom_get_file_modification_time
+(
+    lsmash_file_t *file
+);
@@ -44,20 +44,12 @@ static isom_sidx_t *isom_get_sidx( lsmash_file_t *file, uint32_t reference_ID )
     return isom_non_existing_sidx();
 }
 
-static int isom_finish_fragment_movie( lsmash_file_t *file );
+static int isom_finish_fragment_movie( lsmash_file_t *file, int chunk );
 
-/* A movie fragment cannot switch a sample description to another.
- * So you must call this function before switching sample descriptions. */
-int lsmash_create_fragment_movie( lsmash_root_t *root )
+static int isom_create_fragment_movie( lsmash_file_t *file, int chunk )
 {
-    if( isom_check_initializer_present( root ) < 0 )
-        return LSMASH_ERR_FUNCTION_PARAM;
-    lsmash_file_t *file = root->file;
-    if( !file->bs
-     || !file->fragment )
-        return LSMASH_ERR_NAMELESS;
-    /* Finish and write the current movie fragment before starting a new one. */
-    int ret = isom_finish_fragment_movie( file );
+    /* Finish and write the current movie fragment, or the current chunk of it, before starting a new one. */
+    int ret = isom_finish_fragment_movie( file, chunk );
     if( ret < 0 )
         return ret;
     /* Add a new movie fragment if the current one is not present or not written. */
@@ -82,6 +74,49 @@ int lsmash_create_fragment_movie( lsmash_root_t *root )
     return 0;
 }
 
+/* A movie fragment cannot switch a sample description to another.
+ * So you must call this function before switching sample descriptions. */
+int lsmash_create_fragment_movie( lsmash_root_t *root )
+{
+    if( isom_check_initializer_present( root ) < 0 )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    lsmash_file_t *file = root->file;
+    if( !file->bs
+     || !file->fragment )
+        return LSMASH_ERR_NAMELESS;
+    return isom_create_fragment_movie( file, 0 );
+}
+
+/* Each chunk is a movie fragment on its own from the point of view of the file format, so the next chunk gets a new
+ * Movie Fragment Box with the next sequence_number. Only the segment indexing treats chunks as parts of a movie fragment. */
+int lsmash_create_fragment_chunk( lsmash_root_t *root )
+{
+    if( isom_check_initializer_present( root ) < 0 )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    lsmash_file_t *file = root->file;
+    if( !file->bs
+     || !file->fragment
+     || LSMASH_IS_NON_EXISTING_BOX( file->fragment->movie ) )
+        return LSMASH_ERR_NAMELESS;
+    return isom_create_fragment_movie( file, 1 );
+}
+
+int lsmash_set_fragment_chunk_limits
+(
+    lsmash_file_t *file,
+    uint32_t       max_samples,
+    double         max_duration
+)
+{
+    if( LSMASH_IS_NON_EXISTING_BOX( file )
+     || !(file->flags & LSMASH_FILE_MODE_WRITE)
+     || !(max_duration >= 0) )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    file->max_fragment_chunk_samples  = max_samples;
+    file->max_fragment_chunk_duration = max_duration;
+    return 0;
+}
+
 static inline uint64_t isom_fragment_get_implicit_segment_duration
 (
     isom_cache_t *cache
@@ -243,6 +278,16 @@ static int isom_write_fragment_random_access_info( lsmash_file_t *file )
     return isom_write_box( file->bs, (isom_box_t *)file->mfra );
 }
 
+static inline int isom_requires_segment_indexes
+(
+    lsmash_file_t *file
+)
+{
+    return (file->flags & LSMASH_FILE_MODE_MEDIA)
+        && (file->flags & LSMASH_FILE_MODE_INDEX)
+        && (file->flags & LSMASH_FILE_MODE_SEGMENT);
+}
+
 static int isom_update_indexed_material_offset
 (
     lsmash_file_t *file,
@@ -293,27 +338,36 @@ static int isom_write_segment_indexes
             continue;
         total_sidx_size += sidx->size;
     }
-    /* The buffer size must be at least total_sidx_size * 2. */
-    size_t buffer_size = total_sidx_size * 2;
-    if( remux->buffer_size > buffer_size )
-        buffer_size = remux->buffer_size;
-    /* Split to 2 buffers. */
-    uint8_t *buf[2] = { NULL, NULL };
-    if( (buf[0] = (uint8_t *)lsmash_malloc( buffer_size )) == NULL )
-        return LSMASH_ERR_MEMORY_ALLOC;
-    size_t size = buffer_size / 2;
-    buf[1] = buf[0] + size;
-    /* Seek to the beginning of the first Movie Fragment Box i.e. the first subsegment within this media segment. */
-    lsmash_bs_t *bs = file->bs;
-    int64_t ret64;
-    if( (ret64 = lsmash_bs_write_seek( bs, file->fragment->first_moof_pos, SEEK_SET )) < 0 )
+    lsmash_bs_t *bs       = file->bs;
+    uint8_t     *buf[2]   = { NULL, NULL };
+    size_t       size     = 0;
+    size_t       read_num = 0;
+    uint64_t     read_pos = 0;
+    int64_t      ret64;
+    /* Try to move the subsequent data inside the stream first. If unsupported, move it through the buffers. */
+    if( (ret = lsmash_bs_shift_data( bs, file->fragment->first_moof_pos, total_sidx_size )) == LSMASH_ERR_PATCH_WELCOME )
     {
-        ret = ret64;
-        goto fail;
+        /* The buffer size must be at least total_sidx_size * 2. */
+        size_t buffer_size = total_sidx_size * 2;
+        if( remux->buffer_size > buffer_size )
+            buffer_size = remux->buffer_size;
+        /* Split to 2 buffers. */
+        if( (buf[0] = (uint8_t *)lsmash_malloc( buffer_size )) == NULL )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        size = buffer_size / 2;
+        buf[1] = buf[0] + size;
+        /* Seek to the beginning of the first Movie Fragment Box i.e. the first subsegment within this media segment. */
+        if( (ret64 = lsmash_bs_write_seek( bs, file->fragment->first_moof_pos, SEEK_SET )) < 0 )
+        {
+            ret = ret64;
+            goto fail;
+        }
+        read_num = size;
+        lsmash_bs_read_data( bs, buf[0], &read_num );
+        read_pos = bs->offset;
     }
-    size_t read_num = size;
-    lsmash_bs_read_data( bs, buf[0], &read_num );
-    uint64_t read_pos = bs->offset;
+    else if( ret < 0 )
+        return ret;
     /* Write the Segment Index Boxes actually here. */
     if( (ret64 = lsmash_bs_write_seek( bs, file->fragment->first_moof_pos, SEEK_SET )) < 0 )
     {
@@ -356,6 +410,41 @@ fail:
     return ret;
 }
 
+/* Write the Segment Index Boxes followed by the media segment held since the first Movie Fragment Box.
+ * Unlike isom_write_segment_indexes(), no data in the stream is moved, so this works for unseekable streams. */
+static int isom_write_held_segment_indexes
+(
+    lsmash_file_t *file
+)
+{
+    if( !isom_requires_segment_indexes( file )
+     || file->fragment->first_moof_pos == FIRST_MOOF_POS_UNDETERMINED )
+        return 0;
+    int ret;
+    lsmash_bs_t *bs = lsmash_bs_create();
+    if( !bs )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    if( file->sidx_list.tail
+     && (ret = isom_update_indexed_material_offset( file, (isom_sidx_t *)file->sidx_list.tail->data )) < 0 )
+        goto fail;
+    /* Without any stream, the boxes are just accumulated on the buffer. */
+    for( lsmash_entry_t *entry = file->sidx_list.head; entry; entry = entry->next )
+    {
+        isom_sidx_t *sidx = (isom_sidx_t *)entry->data;
+        if( LSMASH_IS_NON_EXISTING_BOX( sidx ) )
+            continue;
+        if( (ret = isom_write_box( bs, (isom_box_t *)sidx )) < 0 )
+            goto fail;
+    }
+    size_t total_sidx_size = lsmash_bs_get_valid_data_size( bs );
+    if( (ret = lsmash_bs_release_held_data( file->bs, lsmash_bs_get_buffer_data_start( bs ), total_sidx_size )) < 0 )
+        goto fail;
+    file->size += total_sidx_size;
+fail:
+    lsmash_bs_cleanup( bs );
+    return ret;
+}
+
 int isom_finish_final_fragment_movie
 (
     lsmash_file_t        *file,
@@ -364,19 +453,17 @@ int isom_finish_final_fragment_movie
 {
     /* Output the final movie fragment. */
     int ret;
-    if( (ret = isom_finish_fragment_movie( file )) < 0 )
+    if( (ret = isom_finish_fragment_movie( file, 0 )) < 0 )
         return ret;
     if( file->bs->unseekable )
-        return 0;
+        return isom_write_held_segment_indexes( file );
     /* Write Segment Index Boxes.
      * This occurs only when the initial movie has no samples.
      * We don't consider updating of chunk offsets within initial movie sample table here.
      * This is reasonable since DASH requires no samples in the initial movie.
      * This implementation is not suitable for live-streaming.
      + To support live-streaming, it is good to use daisy-chained index. */
-    if( (file->flags & LSMASH_FILE_MODE_MEDIA)
-     && (file->flags & LSMASH_FILE_MODE_INDEX)
-     && (file->flags & LSMASH_FILE_MODE_SEGMENT) )
+    if( isom_requires_segment_indexes( file ) )
     {
         if( !remux )
             return LSMASH_ERR_FUNCTION_PARAM;
@@ -416,11 +503,8 @@ static int isom_create_fragment_overall_default_settings( lsmash_file_t *file )
          || !trak->cache )
             return LSMASH_ERR_NAMELESS;
         isom_stbl_t *stbl = trak->mdia->minf->stbl;
-        if( !stbl->stts->list
-         || (stbl->stts->list->tail && !stbl->stts->list->tail->data)
-         || (LSMASH_IS_NON_EXISTING_BOX( stbl->stsz ) && LSMASH_IS_NON_EXISTING_BOX( stbl->stz2 ))
-         || (LSMASH_IS_EXISTING_BOX( stbl->stsz ) && stbl->stsz->list && stbl->stsz->list->head && !stbl->stsz->list->head->data)
-         || (LSMASH_IS_EXISTING_BOX( stbl->stz2 ) && stbl->stz2->list && stbl->stz2->list->head && !stbl->stz2->list->head->data))
+        if( LSMASH_IS_NON_EXISTING_BOX( stbl->stts )
+         || (LSMASH_IS_NON_EXISTING_BOX( stbl->stsz ) && LSMASH_IS_NON_EXISTING_BOX( stbl->stz2 )) )
             return LSMASH_ERR_NAMELESS;
         isom_trex_t *trex = isom_add_trex( file->moov->mvex );
         if( LSMASH_IS_NON_EXISTING_BOX( trex ) )
@@ -430,8 +514,8 @@ static int isom_create_fragment_overall_default_settings( lsmash_file_t *file )
         trex->default_sample_description_index = trak->cache->chunk.sample_description_index
                                                ? trak->cache->chunk.sample_description_index
                                                : 1;
-        trex->default_sample_duration          = stbl->stts->list->tail
-                                               ? ((isom_stts_entry_t *)stbl->stts->list->tail->data)->sample_delta
+        trex->default_sample_duration          = stbl->stts->entry_count
+                                               ? stbl->stts->entries[ stbl->stts->entry_count - 1 ].sample_delta
                                                : 1;
         trex->default_sample_size              = isom_get_first_sample_size( stbl );
         if( stbl->sdtp->list )
@@ -604,7 +688,11 @@ static int isom_finish_fragment_initial_movie( lsmash_file_t *file )
         isom_trak_t *trak = (isom_trak_t *)entry->data;
         assert( LSMASH_IS_EXISTING_BOX( trak ) );
         if( trak->cache->fragment )
+        {
             isom_fragment_reset_sample_counts( trak->cache );
+            trak->cache->fragment->subsegment.sample_count        = 0;
+            trak->cache->fragment->subsegment.output_sample_count = 0;
+        }
     }
     return 0;
 }
@@ -622,206 +710,253 @@ static int isom_compare_sample_flags( isom_sample_flags_t *a, isom_sample_flags_
         || (a->sample_degradation_priority != b->sample_degradation_priority);
 }
 
-static int isom_make_segment_index_entry
+static int isom_make_subsegment_index_entry
 (
     lsmash_file_t *file,
-    isom_moof_t   *moof
+    isom_trak_t   *trak,
+    uint64_t       reference_size
 )
 {
-    /* Make the index of this subsegment. */
-    for( lsmash_entry_t *entry = moof->traf_list.head; entry; entry = entry->next )
+    if( LSMASH_IS_NON_EXISTING_BOX( trak->mdia->mdhd )
+     || !trak->cache
+     || !trak->cache->fragment )
+        return LSMASH_ERR_NAMELESS;
+    uint32_t           track_ID       = trak->tkhd->track_ID;
+    isom_fragment_t   *track_fragment = trak->cache->fragment;
+    isom_subsegment_t *subsegment     = &track_fragment->subsegment;
+    isom_sidx_t       *sidx           = isom_get_sidx( file, track_ID );
+    if( LSMASH_IS_NON_EXISTING_BOX( sidx ) )
     {
-        isom_traf_t       *traf           = (isom_traf_t *)entry->data;
-        isom_tfhd_t       *tfhd           = traf->tfhd;
-        isom_fragment_t   *track_fragment = traf->cache->fragment;
-        isom_subsegment_t *subsegment     = &track_fragment->subsegment;
-        isom_sidx_t       *sidx           = isom_get_sidx( file,              tfhd->track_ID );
-        isom_trak_t       *trak           = isom_get_trak( file->initializer, tfhd->track_ID );
-        if( LSMASH_IS_NON_EXISTING_BOX( trak->mdia->mdhd ) )
-            return LSMASH_ERR_NAMELESS;
-        assert( LSMASH_IS_EXISTING_BOX( traf->tfdt ) );
+        sidx = isom_add_sidx( file );
         if( LSMASH_IS_NON_EXISTING_BOX( sidx ) )
-        {
-            sidx = isom_add_sidx( file );
-            if( LSMASH_IS_NON_EXISTING_BOX( sidx ) )
-                return LSMASH_ERR_NAMELESS;
-            sidx->reference_ID    = tfhd->track_ID;
-            sidx->timescale       = trak->mdia->mdhd->timescale;
-            sidx->reserved        = 0;
-            sidx->reference_count = 0;
-            int ret = isom_update_indexed_material_offset( file, sidx );
-            if( ret < 0 )
-                return ret;
-        }
-        /* One pair of a Movie Fragment Box with an associated Media Box per subsegment. */
-        isom_sidx_referenced_item_t *data = lsmash_malloc( sizeof(isom_sidx_referenced_item_t) );
-        if( !data )
             return LSMASH_ERR_NAMELESS;
-        if( lsmash_list_add_entry( sidx->list, data ) < 0 )
-        {
-            lsmash_free( data );
-            return LSMASH_ERR_MEMORY_ALLOC;
-        }
-        sidx->reference_count = sidx->list->entry_count;
-        data->reference_type = 0;  /* media */
-        data->reference_size = file->size - moof->pos;
-        /* presentation */
-        uint64_t TSAP;
-        uint64_t TDEC;
-        uint64_t TEPT;
-        uint64_t TPTF;
-        uint64_t composition_duration = subsegment->largest_cts - subsegment->smallest_cts;
-        if( subsegment->smallest_cts != LSMASH_TIMESTAMP_UNDEFINED
-         && subsegment->largest_cts  != LSMASH_TIMESTAMP_UNDEFINED )
-            composition_duration += track_fragment->last_duration;
-        if( trak->edts->elst->list )
+        sidx->reference_ID    = track_ID;
+        sidx->timescale       = trak->mdia->mdhd->timescale;
+        sidx->reserved        = 0;
+        sidx->reference_count = 0;
+        int ret = isom_update_indexed_material_offset( file, sidx );
+        if( ret < 0 )
+            return ret;
+    }
+    /* One movie fragment, i.e. one or more pairs of a Movie Fragment Box with an associated Media Box, per subsegment. */
+    isom_sidx_referenced_item_t *data = lsmash_malloc( sizeof(isom_sidx_referenced_item_t) );
+    if( !data )
+        return LSMASH_ERR_NAMELESS;
+    if( lsmash_list_add_entry( sidx->list, data ) < 0 )
+    {
+        lsmash_free( data );
+        return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    sidx->reference_count = sidx->list->entry_count;
+    data->reference_type = 0;  /* media */
+    data->reference_size = reference_size;
+    /* presentation */
+    uint64_t TSAP;
+    uint64_t TDEC;
+    uint64_t TEPT;
+    uint64_t TPTF;
+    uint64_t composition_duration = subsegment->largest_cts - subsegment->smallest_cts;
+    if( subsegment->smallest_cts != LSMASH_TIMESTAMP_UNDEFINED
+     && subsegment->largest_cts  != LSMASH_TIMESTAMP_UNDEFINED )
+        composition_duration += track_fragment->last_duration;
+    if( trak->edts->elst->list )
+    {
+        /**-- Explicit edits --**/
+        const isom_elst_t       *elst = trak->edts->elst;
+        const isom_elst_entry_t *edit = NULL;
+        uint32_t movie_timescale = file->initializer->moov->mvhd->timescale;
+        uint64_t pts             = subsegment->segment_duration;
+        int subsegment_in_presentation   = 0;   /* If set to 1, TEPT is available. */
+        int first_rp_in_presentation     = 0;   /* If set to 1, both TSAP and TDEC are available. */
+        int first_sample_in_presentation = 0;   /* If set to 1, TPTF is available. */
+        TSAP = LSMASH_TIMESTAMP_UNDEFINED;
+        TDEC = LSMASH_TIMESTAMP_UNDEFINED;
+        TEPT = LSMASH_TIMESTAMP_UNDEFINED;
+        TPTF = LSMASH_TIMESTAMP_UNDEFINED;
+        /* */
+        for( lsmash_entry_t *elst_entry = elst->list->head; elst_entry; elst_entry = elst_entry->next )
         {
-            /**-- Explicit edits --**/
-            const isom_elst_t       *elst = trak->edts->elst;
-            const isom_elst_entry_t *edit = NULL;
-            uint32_t movie_timescale = file->initializer->moov->mvhd->timescale;
-            uint64_t pts             = subsegment->segment_duration;
-            int subsegment_in_presentation   = 0;   /* If set to 1, TEPT is available. */
-            int first_rp_in_presentation     = 0;   /* If set to 1, both TSAP and TDEC are available. */
-            int first_sample_in_presentation = 0;   /* If set to 1, TPTF is available. */
-            TSAP = LSMASH_TIMESTAMP_UNDEFINED;
-            TDEC = LSMASH_TIMESTAMP_UNDEFINED;
-            TEPT = LSMASH_TIMESTAMP_UNDEFINED;
-            TPTF = LSMASH_TIMESTAMP_UNDEFINED;
-            /* */
-            for( lsmash_entry_t *elst_entry = elst->list->head; elst_entry; elst_entry = elst_entry->next )
+            edit = (isom_elst_entry_t *)elst_entry->data;
+            if( !edit )
+                continue;
+            uint64_t edit_end_pts;
+            uint64_t edit_end_cts;
+            if( edit->segment_duration == ISOM_EDIT_DURATION_IMPLICIT
+             || (elst->version == 0 && edit->segment_duration == ISOM_EDIT_DURATION_UNKNOWN32)
+             || (elst->version == 1 && edit->segment_duration == ISOM_EDIT_DURATION_UNKNOWN64) )
             {
-                edit = (isom_elst_entry_t *)elst_entry->data;
-                if( !edit )
-                    continue;
-                uint64_t edit_end_pts;
-                uint64_t edit_end_cts;
-                if( edit->segment_duration == ISOM_EDIT_DURATION_IMPLICIT
-                 || (elst->version == 0 && edit->segment_duration == ISOM_EDIT_DURATION_UNKNOWN32)
-                 || (elst->version == 1 && edit->segment_duration == ISOM_EDIT_DURATION_UNKNOWN64) )
-                {
-                    edit_end_cts = UINT64_MAX;
-                    edit_end_pts = UINT64_MAX;
-                }
-                else
+                edit_end_cts = UINT64_MAX;
+                edit_end_pts = UINT64_MAX;
+            }
+            else
+            {
+                double segment_duration = edit->segment_duration * ((double)sidx->timescale / movie_timescale);
+                edit_end_cts = edit->media_time + (uint64_t)(segment_duration * ((double)edit->media_rate / (1 << 16)));
+                edit_end_pts = pts + (uint64_t)segment_duration;
+            }
+            if( edit->media_time == ISOM_EDIT_MODE_EMPTY )
+            {
+                pts = edit_end_pts;
+                continue;
+            }
+            if( subsegment->smallest_cts != LSMASH_TIMESTAMP_UNDEFINED
+             && subsegment->largest_cts  != LSMASH_TIMESTAMP_UNDEFINED
+             && ((subsegment->smallest_cts >= edit->media_time && subsegment->smallest_cts < edit_end_cts)
+              || (subsegment->largest_cts  >= edit->media_time && subsegment->largest_cts  < edit_end_cts)) )
+            {
+                /* This subsegment is present in this edit. */
+                double rate = (double)edit->media_rate / (1 << 16);
+                uint64_t start_time = LSMASH_MAX( subsegment->smallest_cts, edit->media_time );
+                if( sidx->reference_count == 1 )
+                    sidx->earliest_presentation_time = pts;
+                if( subsegment_in_presentation == 0 )
                 {
-                    double segment_duration = edit->segment_duration * ((double)sidx->timescale / movie_timescale);
-                    edit_end_cts = edit->media_time + (uint64_t)(segment_duration * ((double)edit->media_rate / (1 << 16)));
-                    edit_end_pts = pts + (uint64_t)segment_duration;
+                    subsegment_in_presentation = 1;
+                    if( subsegment->smallest_cts >= edit->media_time )
+                        TEPT = pts + (uint64_t)((subsegment->smallest_cts - start_time) / rate);
+                    else
+                        TEPT = pts;
                 }
-                if( edit->media_time == ISOM_EDIT_MODE_EMPTY )
+                if( first_rp_in_presentation == 0
+                 && subsegment->first_ed_cts != LSMASH_TIMESTAMP_UNDEFINED
+                 && subsegment->first_rp_cts != LSMASH_TIMESTAMP_UNDEFINED
+                 && ((subsegment->first_ed_cts >= edit->media_time && subsegment->first_ed_cts < edit_end_cts)
+                  || (subsegment->first_rp_cts >= edit->media_time && subsegment->first_rp_cts < edit_end_cts)) )
                 {
-                    pts = edit_end_pts;
-                    continue;
+                    /* FIXME: to distinguish TSAP and TDEC, need something to indicate incorrectly decodable sample. */
+                    first_rp_in_presentation = 1;
+                    if( subsegment->first_ed_cts >= edit->media_time && subsegment->first_ed_cts < edit_end_cts )
+                        TSAP = pts + (uint64_t)((subsegment->first_ed_cts - start_time) / rate);
+                    else
+                        TSAP = pts;
+                    TDEC = TSAP;
                 }
-                if( subsegment->smallest_cts != LSMASH_TIMESTAMP_UNDEFINED
-                 && subsegment->largest_cts  != LSMASH_TIMESTAMP_UNDEFINED
-                 && ((subsegment->smallest_cts >= edit->media_time && subsegment->smallest_cts < edit_end_cts)
-                  || (subsegment->largest_cts  >= edit->media_time && subsegment->largest_cts  < edit_end_cts)) )
+                if( first_sample_in_presentation == 0
+                 && subsegment->first_sample_cts != LSMASH_TIMESTAMP_UNDEFINED
+                 && subsegment->first_sample_cts >= edit->media_time && subsegment->first_sample_cts < edit_end_cts )
                 {
-                    /* This subsegment is present in this edit. */
-                    double rate = (double)edit->media_rate / (1 << 16);
-                    uint64_t start_time = LSMASH_MAX( subsegment->smallest_cts, edit->media_time );
-                    if( sidx->reference_count == 1 )
-                        sidx->earliest_presentation_time = pts;
-                    if( subsegment_in_presentation == 0 )
-                    {
-                        subsegment_in_presentation = 1;
-                        if( subsegment->smallest_cts >= edit->media_time )
-                            TEPT = pts + (uint64_t)((subsegment->smallest_cts - start_time) / rate);
-                        else
-                            TEPT = pts;
-                    }
-                    if( first_rp_in_presentation == 0
-                     && subsegment->first_ed_cts != LSMASH_TIMESTAMP_UNDEFINED
-                     && subsegment->first_rp_cts != LSMASH_TIMESTAMP_UNDEFINED
-                     && ((subsegment->first_ed_cts >= edit->media_time && subsegment->first_ed_cts < edit_end_cts)
-                      || (subsegment->first_rp_cts >= edit->media_time && subsegment->first_rp_cts < edit_end_cts)) )
-                    {
-                        /* FIXME: to distinguish TSAP and TDEC, need something to indicate incorrectly decodable sample. */
-                        first_rp_in_presentation = 1;
-                        if( subsegment->first_ed_cts >= edit->media_time && subsegment->first_ed_cts < edit_end_cts )
-                            TSAP = pts + (uint64_t)((subsegment->first_ed_cts - start_time) / rate);
-                        else
-                            TSAP = pts;
-                        TDEC = TSAP;
-                    }
-                    if( first_sample_in_presentation == 0
-                     && subsegment->first_sample_cts != LSMASH_TIMESTAMP_UNDEFINED
-                     && subsegment->first_sample_cts >= edit->media_time && subsegment->first_sample_cts < edit_end_cts )
-                    {
-                        first_sample_in_presentation = 1;
-                        TPTF = pts + (uint64_t)((subsegment->first_sample_cts - start_time) / rate);
-                    }
-                    uint64_t subsegment_end_pts = pts + (uint64_t)(composition_duration / rate);
-                    pts = LSMASH_MIN( edit_end_pts, subsegment_end_pts );
-                    /* Update subsegment_duration. */
-                    data->subsegment_duration = pts - subsegment->segment_duration;
+                    first_sample_in_presentation = 1;
+                    TPTF = pts + (uint64_t)((subsegment->first_sample_cts - start_time) / rate);
                 }
-                else
-                    /* This subsegment is not present in this edit. */
-                    pts = edit_end_pts;
+                uint64_t subsegment_end_pts = pts + (uint64_t)(composition_duration / rate);
+                pts = LSMASH_MIN( edit_end_pts, subsegment_end_pts );
+                /* Update subsegment_duration. */
+                data->subsegment_duration = pts - subsegment->segment_duration;
             }
+            else
+                /* This subsegment is not present in this edit. */
+                pts = edit_end_pts;
         }
-        else
+    }
+    else
+    {
+        /**-- Implicit edit --**/
+        if( sidx->reference_count == 1 )
+            sidx->earliest_presentation_time = subsegment->smallest_cts;
+        data->subsegment_duration = composition_duration;
+        /* FIXME: to distinguish TSAP and TDEC, need something to indicate incorrectly decodable sample. */
+        TSAP = subsegment->first_rp_cts;
+        TDEC = subsegment->first_rp_cts;
+        TEPT = subsegment->smallest_cts;
+        TPTF = subsegment->first_sample_cts;
+    }
+    /* Decide SAP_type. */
+    data->starts_with_SAP = (subsegment->first_ra_number == 1);
+    data->SAP_type        = 0;
+    data->SAP_delta_time  = 0;
+    if( TSAP != LSMASH_TIMESTAMP_UNDEFINED
+     && TDEC != LSMASH_TIMESTAMP_UNDEFINED
+     && TEPT != LSMASH_TIMESTAMP_UNDEFINED )
+    {
+        if( TPTF != LSMASH_TIMESTAMP_UNDEFINED )
         {
-            /**-- Implicit edit --**/
-            if( sidx->reference_count == 1 )
-                sidx->earliest_presentation_time = subsegment->smallest_cts;
-            data->subsegment_duration = composition_duration;
-            /* FIXME: to distinguish TSAP and TDEC, need something to indicate incorrectly decodable sample. */
-            TSAP = subsegment->first_rp_cts;
-            TDEC = subsegment->first_rp_cts;
-            TEPT = subsegment->smallest_cts;
-            TPTF = subsegment->first_sample_cts;
+            if( TEPT == TDEC && TDEC == TSAP && TSAP == TPTF )
+                data->SAP_type = 1;
+            else if( TEPT == TDEC && TDEC == TSAP && TSAP < TPTF )
+                data->SAP_type = 2;
+            else if( TEPT < TDEC && TDEC == TSAP && TSAP <= TPTF )
+                data->SAP_type = 3;
+            else if( TEPT <= TPTF && TPTF < TDEC && TDEC == TSAP )
+                data->SAP_type = 4;
         }
-        /* Decide SAP_type. */
-        data->starts_with_SAP = (subsegment->first_ra_number == 1);
-        data->SAP_type        = 0;
-        data->SAP_delta_time  = 0;
-        if( TSAP != LSMASH_TIMESTAMP_UNDEFINED
-         && TDEC != LSMASH_TIMESTAMP_UNDEFINED
-         && TEPT != LSMASH_TIMESTAMP_UNDEFINED )
+        if( data->SAP_type == 0 )
         {
-            if( TPTF != LSMASH_TIMESTAMP_UNDEFINED )
-            {
-                if( TEPT == TDEC && TDEC == TSAP && TSAP == TPTF )
-                    data->SAP_type = 1;
-                else if( TEPT == TDEC && TDEC == TSAP && TSAP < TPTF )
-                    data->SAP_type = 2;
-                else if( TEPT < TDEC && TDEC == TSAP && TSAP <= TPTF )
-                    data->SAP_type = 3;
-                else if( TEPT <= TPTF && TPTF < TDEC && TDEC == TSAP )
-                    data->SAP_type = 4;
-            }
-            if( data->SAP_type == 0 )
-            {
-                if( TEPT == TDEC && TDEC < TSAP )
-                    data->SAP_type = 5;
-                else if( TEPT < TDEC && TDEC < TSAP )
-                    data->SAP_type = 6;
-            }
-            if( data->SAP_type != 0 )
-                data->SAP_delta_time = TSAP - TEPT;
+            if( TEPT == TDEC && TDEC < TSAP )
+                data->SAP_type = 5;
+            else if( TEPT < TDEC && TDEC < TSAP )
+                data->SAP_type = 6;
         }
-        /* Prepare for the next subsegment. */
-        subsegment->segment_duration += data->subsegment_duration;
-        subsegment->largest_cts       = LSMASH_TIMESTAMP_UNDEFINED;
-        subsegment->smallest_cts      = LSMASH_TIMESTAMP_UNDEFINED;
-        subsegment->first_sample_cts  = LSMASH_TIMESTAMP_UNDEFINED;
-        subsegment->first_ed_cts      = LSMASH_TIMESTAMP_UNDEFINED;
-        subsegment->first_rp_cts      = LSMASH_TIMESTAMP_UNDEFINED;
-        subsegment->first_rp_number   = 0;
-        subsegment->first_ra_number   = 0;
-        subsegment->first_ra_flags    = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE;
-        subsegment->decodable         = 0;
+        if( data->SAP_type != 0 )
+            data->SAP_delta_time = TSAP - TEPT;
     }
+    /* Prepare for the next subsegment. */
+    subsegment->segment_duration += data->subsegment_duration;
+    subsegment->largest_cts       = LSMASH_TIMESTAMP_UNDEFINED;
+    subsegment->smallest_cts      = LSMASH_TIMESTAMP_UNDEFINED;
+    subsegment->first_sample_cts  = LSMASH_TIMESTAMP_UNDEFINED;
+    subsegment->first_ed_cts      = LSMASH_TIMESTAMP_UNDEFINED;
+    subsegment->first_rp_cts      = LSMASH_TIMESTAMP_UNDEFINED;
+    subsegment->first_rp_number   = 0;
+    subsegment->first_ra_number   = 0;
+    subsegment->first_ra_flags    = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE;
+    subsegment->decodable         = 0;
+    subsegment->sample_count        = 0;
+    subsegment->output_sample_count = 0;
     return 0;
 }
 
+static int isom_make_segment_index_entry
+(
+    lsmash_file_t *file,
+    isom_moof_t   *moof
+)
+{
+    /* Make the index of this subsegment.
+     * The subsegment spans all the chunks of the movie fragment, from the first Movie Fragment Box to the end of
+     * the last Media Data Box. */
+    uint64_t reference_size = file->size - file->fragment->subsegment_pos;
+    int ret;
+    for( lsmash_entry_t *entry = moof->traf_list.head; entry; entry = entry->next )
+    {
+        isom_traf_t *traf = (isom_traf_t *)entry->data;
+        assert( LSMASH_IS_EXISTING_BOX( traf->tfdt ) );
+        if( (ret = isom_make_subsegment_index_entry( file, isom_get_trak( file->initializer, traf->tfhd->track_ID ), reference_size )) < 0 )
+            return ret;
+    }
+    /* Tracks absent in the last chunk may have samples in the preceding chunks. */
+    for( lsmash_entry_t *entry = file->initializer->moov->trak_list.head; entry; entry = entry->next )
+    {
+        isom_trak_t *trak = (isom_trak_t *)entry->data;
+        if( LSMASH_IS_EXISTING_BOX( trak )
+         && trak->cache
+         && trak->cache->fragment
+         && trak->cache->fragment->subsegment.sample_count
+         && (ret = isom_make_subsegment_index_entry( file, trak, reference_size )) < 0 )
+            return ret;
+    }
+    return 0;
+}
+
+/* Finish the subsegment which the current movie fragment ends. */
+static int isom_finish_subsegment
+(
+    lsmash_file_t *file,
+    isom_moof_t   *moof
+)
+{
+    int ret = 0;
+    if( (file->flags & LSMASH_FILE_MODE_INDEX)
+     && file->max_isom_version >= 6
+     && file->fragment->subsegment_pos != FIRST_MOOF_POS_UNDETERMINED )
+        ret = isom_make_segment_index_entry( file, moof );
+    file->fragment->subsegment_pos = FIRST_MOOF_POS_UNDETERMINED;
+    return ret;
+}
+
 static int isom_finish_fragment_movie
 (
-    lsmash_file_t *file
+    lsmash_file_t *file,
+    int            chunk    /* If set to 1, the current movie fragment continues with the next chunk. */
 )
 {
     if( !file->fragment
@@ -839,7 +974,7 @@ static int isom_finish_fragment_movie
      * This is a requirement of DASH Media Segment. */
     if( !moof->traf_list.head
      || !moof->traf_list.head->data )
-        return 0;
+        return chunk ? 0 : isom_finish_subsegment( file, moof );
     /* Calculate appropriate default_sample_flags of each Track Fragment Header Box.
      * And check whether that default_sample_flags is useful or not. */
     for( lsmash_entry_t *entry = moof->traf_list.head; entry; entry = entry->next )
@@ -1082,12 +1217,20 @@ static int isom_finish_fragment_movie
             traf->tfhd->base_data_offset = file->size + moof->size + ISOM_BASEBOX_COMMON_SIZE;
         }
     }
+    /* Hold the whole media segment on the unseekable output until its Segment Index Boxes are determined. */
+    if( isom_requires_segment_indexes( file )
+     && file->bs->unseekable
+     && file->fragment->first_moof_pos == FIRST_MOOF_POS_UNDETERMINED
+     && (ret = lsmash_bs_hold_data( file->bs, (size_t)LSMASH_MIN( file->max_segment_buffer_size, SIZE_MAX ) )) < 0 )
+        return ret;
     /* Write Movie Fragment Box and its children. */
     moof->pos = file->size;
     if( (ret = isom_write_box( file->bs, (isom_box_t *)moof )) < 0 )
         return ret;
     if( file->fragment->first_moof_pos == FIRST_MOOF_POS_UNDETERMINED )
         file->fragment->first_moof_pos = moof->pos;
+    if( file->fragment->subsegment_pos == FIRST_MOOF_POS_UNDETERMINED )
+        file->fragment->subsegment_pos = moof->pos;
     file->size += moof->size;
     /* Output samples. */
     if( (ret = isom_output_fragment_media_data( file )) < 0 )
@@ -1100,9 +1243,7 @@ static int isom_finish_fragment_movie
         if( traf->cache->fragment )
             isom_fragment_reset_sample_counts( traf->cache );
     }
-    if( !(file->flags & LSMASH_FILE_MODE_INDEX) || file->max_isom_version < 6 )
-        return 0;
-    return isom_make_segment_index_entry( file, moof );
+    return chunk ? 0 : isom_finish_subsegment( file, moof );
 }
 
 #undef GET_MOST_USED
@@ -1248,7 +1389,7 @@ int isom_append_fragment_track_run
         return LSMASH_ERR_MEMORY_ALLOC;
     frag_manager->sample_count += chunk->pool->sample_count;
     frag_manager->pool_size    += chunk->pool->size;
-    chunk->pool = isom_create_sample_pool( chunk->pool->size );
+    chunk->pool = isom_create_sample_pool( chunk->pool->entry_count );
     return chunk->pool ? 0 : LSMASH_ERR_MEMORY_ALLOC;
 }
 
@@ -1415,14 +1556,16 @@ static void isom_fragment_update_cache_for_sap
 {
     isom_subsegment_t *subsegment = &cache->fragment->subsegment;
     int non_output_sample = (sample->cts == LSMASH_TIMESTAMP_UNDEFINED);
+    subsegment->sample_count        += 1;
+    subsegment->output_sample_count += non_output_sample ? 0 : 1;
     if( !non_output_sample )
     {
-        if( cache->fragment->sample_count == 1 )
+        if( subsegment->sample_count == 1 )
         {
             assert( subsegment->first_sample_cts == LSMASH_TIMESTAMP_UNDEFINED );
             subsegment->first_sample_cts = sample->cts;
         }
-        if( cache->fragment->output_sample_count > 1 )
+        if( subsegment->output_sample_count > 1 )
         {
             assert( subsegment->largest_cts  != LSMASH_TIMESTAMP_UNDEFINED
                  && subsegment->smallest_cts != LSMASH_TIMESTAMP_UNDEFINED );
@@ -1433,7 +1576,7 @@ static void isom_fragment_update_cache_for_sap
         {
             assert( subsegment->largest_cts  == LSMASH_TIMESTAMP_UNDEFINED
                  && subsegment->smallest_cts == LSMASH_TIMESTAMP_UNDEFINED );
-            if( cache->fragment->output_sample_count == 1 )
+            if( subsegment->output_sample_count == 1 )
             {
 
                 subsegment->largest_cts  = sample->cts;
@@ -1446,7 +1589,7 @@ static void isom_fragment_update_cache_for_sap
     {
         assert( subsegment->first_ra_number == 0 );
         subsegment->first_ra_flags  = sample->prop.ra_flags;
-        subsegment->first_ra_number = cache->fragment->sample_count;
+        subsegment->first_ra_number = subsegment->sample_count;
         if( sample->prop.ra_flags & (ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC | ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP) )
             subsegment->is_first_recovery_point = 1;
     }
@@ -1603,6 +1746,7 @@ static int isom_fragment_update_sample_tables( isom_traf_t *traf, lsmash_sample_
             int err = isom_fragment_set_base_media_decode_time( file, traf, sample->dts );
             if( err < 0 )
                 return err;
+            cache->fragment->first_dts = sample->dts;
         }
         trun->first_sample_flags = sample_flags;
         current->first_dts = sample->dts;
@@ -1714,6 +1858,40 @@ static int isom_append_fragment_sample_internal
     return 0;
 }
 
+/* Return 1 if the current chunk of the movie fragment shall be flushed before appending the sample, otherwise return 0. */
+static int isom_fragment_chunk_delimited
+(
+    lsmash_file_t   *file,
+    isom_traf_t     *traf,
+    lsmash_sample_t *sample
+)
+{
+    if( (file->max_fragment_chunk_samples == 0 && file->max_fragment_chunk_duration <= 0)
+     || LSMASH_IS_NON_EXISTING_BOX( traf )
+     || file->fragment->movie->traf_list.entry_count != 1
+     || !traf->cache
+     || !traf->cache->fragment
+     ||  traf->cache->fragment->sample_count == 0 )
+        return 0;
+    /* Leave invalid timestamps to the usual error handling. */
+    isom_fragment_t *track_fragment = traf->cache->fragment;
+    uint64_t         prev_dts       = traf->cache->timestamp.dts;
+    if( sample->dts <= prev_dts
+     || sample->dts >  prev_dts + UINT32_MAX )
+        return 0;
+    if( file->max_fragment_chunk_samples
+     && track_fragment->sample_count >= file->max_fragment_chunk_samples )
+        return 1;
+    if( file->max_fragment_chunk_duration > 0 )
+    {
+        uint32_t media_timescale = lsmash_get_media_timescale( file->root, traf->tfhd->track_ID );
+        if( media_timescale
+         && file->max_fragment_chunk_duration <= (double)(sample->dts - track_fragment->first_dts) / media_timescale )
+            return 1;
+    }
+    return 0;
+}
+
 int isom_append_fragment_sample
 (
     lsmash_file_t       *file,
@@ -1758,6 +1936,15 @@ int isom_append_fragment_sample
         if( sample->cts == LSMASH_TIMESTAMP_UNDEFINED )
             return LSMASH_ERR_INVALID_DATA;
         isom_traf_t *traf = isom_get_traf( fragment->movie, trak->tkhd->track_ID );
+        if( isom_fragment_chunk_delimited( file, traf, sample ) )
+        {
+            /* Flush the current chunk. The duration of its last sample is known from this sample. */
+            int ret;
+            if( (ret = isom_flush_fragment_pooled_samples( file, trak->tkhd->track_ID, sample->dts - traf->cache->timestamp.dts )) < 0
+             || (ret = isom_create_fragment_movie( file, 1 )) < 0 )
+                return ret;
+            traf = isom_non_existing_traf();
+        }
         if( LSMASH_IS_NON_EXISTING_BOX( traf ) )
         {
             traf = isom_add_traf( fragment->movie );
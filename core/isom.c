@@ -165,55 +165,46 @@ int lsmash_add_sample_entry( lsmash_root_t *root, uint32_t track_ID, void *summa
 static int isom_add_stts_entry( isom_stbl_t *stbl, uint32_t sample_delta )
 {
     assert( LSMASH_IS_EXISTING_BOX( stbl->stts ) );
-    if( !stbl->stts->list )
-        return LSMASH_ERR_NAMELESS;
-    isom_stts_entry_t *data = lsmash_malloc( sizeof(isom_stts_entry_t) );
-    if( !data )
+    isom_stts_t       *stts    = stbl->stts;
+    isom_stts_entry_t *entries = isom_reserve_table_entries( stts->entries, &stts->alloc_count,
+                                                             stts->entry_count, 1, sizeof(isom_stts_entry_t) );
+    if( !entries )
         return LSMASH_ERR_MEMORY_ALLOC;
+    stts->entries = entries;
+    isom_stts_entry_t *data = &entries[ stts->entry_count ++ ];
     data->sample_count = 1;
     data->sample_delta = sample_delta;
-    if( lsmash_list_add_entry( stbl->stts->list, data ) < 0 )
-    {
-        lsmash_free( data );
-        return LSMASH_ERR_MEMORY_ALLOC;
-    }
     return 0;
 }
 
 static int isom_add_ctts_entry( isom_stbl_t *stbl, uint32_t sample_count, uint32_t sample_offset )
 {
     assert( LSMASH_IS_EXISTING_BOX( stbl->ctts ) );
-    if( !stbl->ctts->list )
-        return LSMASH_ERR_NAMELESS;
-    isom_ctts_entry_t *data = lsmash_malloc( sizeof(isom_ctts_entry_t) );
-    if( !data )
+    isom_ctts_t       *ctts    = stbl->ctts;
+    isom_ctts_entry_t *entries = isom_reserve_table_entries( ctts->entries, &ctts->alloc_count,
+                                                             ctts->entry_count, 1, sizeof(isom_ctts_entry_t) );
+    if( !entries )
         return LSMASH_ERR_MEMORY_ALLOC;
+    ctts->entries = entries;
+    isom_ctts_entry_t *data = &entries[ ctts->entry_count ++ ];
     data->sample_count  = sample_count;
     data->sample_offset = sample_offset;
-    if( lsmash_list_add_entry( stbl->ctts->list, data ) < 0 )
-    {
-        lsmash_free( data );
-        return LSMASH_ERR_MEMORY_ALLOC;
-    }
     return 0;
 }
 
 static int isom_add_stsc_entry( isom_stbl_t *stbl, uint32_t first_chunk, uint32_t samples_per_chunk, uint32_t sample_description_index )
 {
     assert( LSMASH_IS_EXISTING_BOX( stbl->stsc ) );
-    if( !stbl->stsc->list )
-        return LSMASH_ERR_NAMELESS;
-    isom_stsc_entry_t *data = lsmash_malloc( sizeof(isom_stsc_entry_t) );
-    if( !data )
+    isom_stsc_t       *stsc    = stbl->stsc;
+    isom_stsc_entry_t *entries = isom_reserve_table_entries( stsc->entries, &stsc->alloc_count,
+                                                             stsc->entry_count, 1, sizeof(isom_stsc_entry_t) );
+    if( !entries )
         return LSMASH_ERR_MEMORY_ALLOC;
+    stsc->entries = entries;
+    isom_stsc_entry_t *data = &entries[ stsc->entry_count ++ ];
     data->first_chunk              = first_chunk;
     data->samples_per_chunk        = samples_per_chunk;
     data->sample_description_index = sample_description_index;
-    if( lsmash_list_add_entry( stbl->stsc->list, data ) < 0 )
-    {
-        lsmash_free( data );
-        return LSMASH_ERR_MEMORY_ALLOC;
-    }
     return 0;
 }
 
@@ -227,41 +218,25 @@ static int isom_add_stsz_entry( isom_stbl_t *stbl, uint32_t entry_size )
     if( stsz->sample_count == 0 )
         stsz->sample_size = entry_size;
     /* if it seems constant sample size at present, update sample_count only */
-    if( !stsz->list && stsz->sample_size == entry_size )
+    if( !stsz->entries && stsz->sample_size == entry_size )
     {
         ++ stsz->sample_count;
         return 0;
     }
-    /* found sample_size varies, create sample_size list */
-    if( !stsz->list )
+    isom_stsz_entry_t *entries = isom_reserve_table_entries( stsz->entries, &stsz->alloc_count,
+                                                             stsz->sample_count, 1, sizeof(isom_stsz_entry_t) );
+    if( !entries )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    /* found sample_size varies, fill the sample_size table with the constant sample size so far */
+    if( !stsz->entries )
     {
-        stsz->list = lsmash_list_create_simple();
-        if( !stsz->list )
-            return LSMASH_ERR_MEMORY_ALLOC;
         for( uint32_t i = 0; i < stsz->sample_count; i++ )
-        {
-            isom_stsz_entry_t *data = lsmash_malloc( sizeof(isom_stsz_entry_t) );
-            if( !data )
-                return LSMASH_ERR_MEMORY_ALLOC;
-            data->entry_size = stsz->sample_size;
-            if( lsmash_list_add_entry( stsz->list, data ) < 0 )
-            {
-                lsmash_free( data );
-                return LSMASH_ERR_MEMORY_ALLOC;
-            }
-        }
+            entries[i].entry_size = stsz->sample_size;
         stsz->sample_size = 0;
     }
-    isom_stsz_entry_t *data = lsmash_malloc( sizeof(isom_stsz_entry_t) );
-    if( !data )
-        return LSMASH_ERR_MEMORY_ALLOC;
-    data->entry_size = entry_size;
-    if( lsmash_list_add_entry( stsz->list, data ) < 0 )
-    {
-        lsmash_free( data );
-        return LSMASH_ERR_MEMORY_ALLOC;
-    }
-    ++ stsz->sample_count;
+    stsz->entries = entries;
+    entries[ stsz->sample_count ++ ].entry_size = entry_size;
+    stsz->entry_count = stsz->sample_count;
     return 0;
 }
 
@@ -346,17 +321,13 @@ static int isom_add_sdtp_entry( isom_box_t *parent, lsmash_sample_property_t *pr
 static int isom_add_co64_entry( isom_stbl_t *stbl, uint64_t chunk_offset )
 {
     assert( LSMASH_IS_EXISTING_BOX( stbl->stco ) );
-    if( !stbl->stco->list )
-        return LSMASH_ERR_NAMELESS;
-    isom_co64_entry_t *data = lsmash_malloc( sizeof(isom_co64_entry_t) );
-    if( !data )
-        return LSMASH_ERR_MEMORY_ALLOC;
-    data->chunk_offset = chunk_offset;
-    if( lsmash_list_add_entry( stbl->stco->list, data ) < 0 )
-    {
-        lsmash_free( data );
+    isom_stco_t       *co64    = stbl->stco;
+    isom_co64_entry_t *entries = isom_reserve_table_entries( co64->entries.co64, &co64->alloc_count,
+                                                             co64->entry_count, 1, sizeof(isom_co64_entry_t) );
+    if( !entries )
         return LSMASH_ERR_MEMORY_ALLOC;
-    }
+    co64->entries.co64 = entries;
+    entries[ co64->entry_count ++ ].chunk_offset = chunk_offset;
     return 0;
 }
 
@@ -373,12 +344,17 @@ static int isom_convert_stco_to_co64( isom_stbl_t *stbl )
         goto fail;
     }
     /* move chunk_offset to co64 from stco */
-    for( lsmash_entry_t *entry = stco->list->head; entry; entry = entry->next )
+    isom_stco_t *co64 = stbl->stco;
+    co64->entries.co64 = isom_reserve_table_entries( NULL, &co64->alloc_count,
+                                                     stco->entry_count, 1, sizeof(isom_co64_entry_t) );
+    if( !co64->entries.co64 )
     {
-        isom_stco_entry_t *data = (isom_stco_entry_t*)entry->data;
-        if( (err = isom_add_co64_entry( stbl, data->chunk_offset )) < 0 )
-            goto fail;
+        err = LSMASH_ERR_MEMORY_ALLOC;
+        goto fail;
     }
+    for( uint32_t i = 0; i < stco->entry_count; i++ )
+        co64->entries.co64[i].chunk_offset = stco->entries.stco[i].chunk_offset;
+    co64->entry_count = stco->entry_count;
 fail:
     isom_remove_box_by_itself( stco );
     return err;
@@ -386,8 +362,6 @@ fail:
 
 static int isom_add_stco_entry( isom_stbl_t *stbl, uint64_t chunk_offset )
 {
-    if( !stbl->stco->list )
-        return LSMASH_ERR_NAMELESS;
     if( stbl->stco->large_presentation )
         return isom_add_co64_entry( stbl, chunk_offset );
     if( chunk_offset > UINT32_MAX )
@@ -397,15 +371,13 @@ static int isom_add_stco_entry( isom_stbl_t *stbl, uint64_t chunk_offset )
             return err;
         return isom_add_co64_entry( stbl, chunk_offset );
     }
-    isom_stco_entry_t *data = lsmash_malloc( sizeof(isom_stco_entry_t) );
-    if( !data )
-        return LSMASH_ERR_MEMORY_ALLOC;
-    data->chunk_offset = (uint32_t)chunk_offset;
-    if( lsmash_list_add_entry( stbl->stco->list, data ) < 0 )
-    {
-        lsmash_free( data );
+    isom_stco_t       *stco    = stbl->stco;
+    isom_stco_entry_t *entries = isom_reserve_table_entries( stco->entries.stco, &stco->alloc_count,
+                                                             stco->entry_count, 1, sizeof(isom_stco_entry_t) );
+    if( !entries )
         return LSMASH_ERR_MEMORY_ALLOC;
-    }
+    stco->entries.stco = entries;
+    entries[ stco->entry_count ++ ].chunk_offset = (uint32_t)chunk_offset;
     return 0;
 }
 
@@ -544,23 +516,19 @@ uint32_t isom_get_sample_count( isom_trak_t *trak )
 
 static uint64_t isom_get_dts( isom_stts_t *stts, uint32_t sample_number )
 {
-    if( !stts->list )
-        return 0;
     uint64_t dts = 0;
     uint32_t i   = 1;
-    lsmash_entry_t    *entry;
+    uint32_t entry_index;
     isom_stts_entry_t *data = NULL;
-    for( entry = stts->list->head; entry; entry = entry->next )
+    for( entry_index = 0; entry_index < stts->entry_count; entry_index++ )
     {
-        data = (isom_stts_entry_t *)entry->data;
-        if( !data )
-            return 0;
+        data = &stts->entries[entry_index];
         if( i + data->sample_count > sample_number )
             break;
         dts += (uint64_t)data->sample_delta * data->sample_count;
         i   += data->sample_count;
     }
-    if( !entry )
+    if( entry_index == stts->entry_count )
         return 0;
     dts += (uint64_t)data->sample_delta * (sample_number - i);
     return dts;
@@ -569,25 +537,21 @@ static uint64_t isom_get_dts( isom_stts_t *stts, uint32_t sample_number )
 #if 0
 static uint64_t isom_get_cts( isom_stts_t *stts, isom_ctts_t *ctts, uint32_t sample_number )
 {
-    if( !stts->list )
-        return 0;
     if( LSMASH_IS_NON_EXISTING_BOX( ctts ) )
         return isom_get_dts( stts, sample_number );
     uint32_t i = 1;     /* This can be 0 (and then condition below shall be changed) but I dare use same algorithm with isom_get_dts. */
-    lsmash_entry_t    *entry;
+    uint32_t entry_index;
     isom_ctts_entry_t *data = NULL;
     if( sample_number == 0 )
         return 0;
-    for( entry = ctts->list->head; entry; entry = entry->next )
+    for( entry_index = 0; entry_index < ctts->entry_count; entry_index++ )
     {
-        data = (isom_ctts_entry_t *)entry->data;
-        if( !data )
-            return 0;
+        data = &ctts->entries[entry_index];
         if( i + data->sample_count > sample_number )
             break;
         i += data->sample_count;
     }
-    if( !entry )
+    if( entry_index == ctts->entry_count )
         return 0;
     return isom_get_dts( stts, sample_number ) + data->sample_offset;
 }
@@ -596,11 +560,9 @@ static uint64_t isom_get_cts( isom_stts_t *stts, isom_ctts_t *ctts, uint32_t sam
 static int isom_replace_last_sample_delta( isom_stbl_t *stbl, uint32_t sample_delta )
 {
     assert( LSMASH_IS_EXISTING_BOX( stbl->stts ) );
-    if( !stbl->stts->list
-     || !stbl->stts->list->tail
-     || !stbl->stts->list->tail->data )
+    if( stbl->stts->entry_count == 0 )
         return LSMASH_ERR_NAMELESS;
-    isom_stts_entry_t *last_stts_data = (isom_stts_entry_t *)stbl->stts->list->tail->data;
+    isom_stts_entry_t *last_stts_data = &stbl->stts->entries[ stbl->stts->entry_count - 1 ];
     if( sample_delta != last_stts_data->sample_delta )
     {
         if( last_stts_data->sample_count > 1 )
@@ -622,7 +584,7 @@ static int isom_update_mdhd_duration( isom_trak_t *trak, uint32_t last_sample_de
     if( LSMASH_IS_NON_EXISTING_BOX( trak->file )
      || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->mdhd )
      || !trak->cache
-     || !trak->mdia->minf->stbl->stts->list )
+     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stts ) )
         return LSMASH_ERR_INVALID_DATA;
     lsmash_file_t *file = trak->file;
     isom_mdhd_t *mdhd = trak->mdia->mdhd;
@@ -635,13 +597,14 @@ static int isom_update_mdhd_duration( isom_trak_t *trak, uint32_t last_sample_de
     if( sample_count == 0 )
     {
         /* Return error if non-fragmented movie has no samples. */
-        if( !file->fragment && !stts->list->entry_count )
+        if( !file->fragment && !stts->entry_count )
             return LSMASH_ERR_INVALID_DATA;
         return 0;
     }
     /* Now we have at least 1 sample, so do stts_entry. */
-    lsmash_entry_t    *last_stts      = stts->list->tail;
-    isom_stts_entry_t *last_stts_data = (isom_stts_entry_t *)last_stts->data;
+    if( stts->entry_count == 0 )
+        return LSMASH_ERR_INVALID_DATA;
+    isom_stts_entry_t *last_stts_data = &stts->entries[ stts->entry_count - 1 ];
     if( sample_count == 1 )
         mdhd->duration = last_stts_data->sample_delta;
     /* Now we have at least 2 samples,
@@ -662,17 +625,18 @@ static int isom_update_mdhd_duration( isom_trak_t *trak, uint32_t last_sample_de
         else
         {
             /* Remove the last entry. */
-            if( (err = lsmash_list_remove_entry_tail( stts->list )) < 0 )
-                return err;
+            if( stts->entry_count < 2 )
+                return LSMASH_ERR_INVALID_DATA;
+            -- stts->entry_count;
+            last_stts_data = &stts->entries[ stts->entry_count - 1 ];
             /* copy the previous sample_delta. */
-            ++ ((isom_stts_entry_t *)stts->list->tail->data)->sample_count;
-            mdhd->duration += ((isom_stts_entry_t *)stts->list->tail->data)->sample_delta;
+            ++ last_stts_data->sample_count;
+            mdhd->duration += last_stts_data->sample_delta;
         }
     }
     else
     {
-        if( !ctts->list
-         ||  ctts->list->entry_count == 0 )
+        if( ctts->entry_count == 0 )
             return LSMASH_ERR_INVALID_DATA;
         uint64_t dts        = 0;
         uint64_t max_cts    = 0;
@@ -683,16 +647,14 @@ static int isom_update_mdhd_duration( isom_trak_t *trak, uint32_t last_sample_de
         int32_t  ctd_shift  = trak->cache->timestamp.ctd_shift;
         uint32_t j = 0;
         uint32_t k = 0;
-        lsmash_entry_t *stts_entry = stts->list->head;
-        lsmash_entry_t *ctts_entry = ctts->list->head;
+        uint32_t stts_index = 0;
+        uint32_t ctts_index = 0;
         for( uint32_t i = 0; i < sample_count; i++ )
         {
-            if( !ctts_entry || !stts_entry )
-                return LSMASH_ERR_INVALID_DATA;
-            isom_stts_entry_t *stts_data = (isom_stts_entry_t *)stts_entry->data;
-            isom_ctts_entry_t *ctts_data = (isom_ctts_entry_t *)ctts_entry->data;
-            if( !stts_data || !ctts_data )
+            if( ctts_index >= ctts->entry_count || stts_index >= stts->entry_count )
                 return LSMASH_ERR_INVALID_DATA;
+            isom_stts_entry_t *stts_data = &stts->entries[stts_index];
+            isom_ctts_entry_t *ctts_data = &ctts->entries[ctts_index];
             if( ctts_data->sample_offset != ISOM_NON_OUTPUT_SAMPLE_OFFSET )
             {
                 uint64_t cts;
@@ -723,12 +685,12 @@ static int isom_update_mdhd_duration( isom_trak_t *trak, uint32_t last_sample_de
             /* If finished sample_count of current entry, move to next. */
             if( ++j == ctts_data->sample_count )
             {
-                ctts_entry = ctts_entry->next;
+                ++ctts_index;
                 j = 0;
             }
             if( ++k == stts_data->sample_count )
             {
-                stts_entry = stts_entry->next;
+                ++stts_index;
                 k = 0;
             }
         }
@@ -779,6 +741,9 @@ static int isom_update_mdhd_duration( isom_trak_t *trak, uint32_t last_sample_de
                 {
                     if( LSMASH_IS_BOX_ADDITION_FAILURE( isom_add_cslg( trak->mdia->minf->stbl ) ) )
                         return LSMASH_ERR_NAMELESS;
+                    /* A box added into a file opened for reading is left at the tail, so place it by precedence here. */
+                    if( file->flags & LSMASH_FILE_MODE_READ )
+                        isom_reorder_tail_box( (isom_box_t *)stbl );
                     cslg = stbl->cslg;
                 }
                 cslg->compositionToDTSShift        = ctd_shift;
@@ -882,83 +847,77 @@ int lsmash_update_track_duration( lsmash_root_t *root, uint32_t track_ID, uint32
     return err;
 }
 
-static inline int isom_increment_sample_number_in_entry
+static inline void isom_increment_sample_number_in_entry
 (
-    uint32_t        *sample_number_in_entry,
-    uint32_t         sample_count_in_entry,
-    lsmash_entry_t **entry
+    uint32_t *sample_number_in_entry,
+    uint32_t  sample_count_in_entry,
+    uint32_t *entry_index
 )
 {
     if( *sample_number_in_entry != sample_count_in_entry )
     {
         *sample_number_in_entry += 1;
-        return 0;
+        return;
     }
     /* Precede the next entry. */
     *sample_number_in_entry = 1;
-    if( *entry )
+    ++(*entry_index);
+}
+
+/* Count a sample placed at bitrate->dts into the bitrate statistics. */
+static void isom_count_bitrate_sample( isom_bitrate_t *bitrate, uint32_t size, uint32_t timescale )
+{
+    if( bitrate->max_sample_size < size )
+        bitrate->max_sample_size = size;
+    bitrate->total_size += size;
+    bitrate->rate       += size;
+    if( bitrate->dts > bitrate->time_wnd + timescale )
     {
-        *entry = (*entry)->next;
-        if( *entry && !(*entry)->data )
-            return LSMASH_ERR_INVALID_DATA;
+        if( bitrate->rate > bitrate->max_rate )
+            bitrate->max_rate = bitrate->rate;
+        bitrate->time_wnd = bitrate->dts;
+        bitrate->rate     = 0;
     }
-    return 0;
 }
 
-int isom_calculate_bitrate_description
+/* Walk the sample table to get the bitrate statistics of a given sample description. */
+static void isom_scan_bitrate_description
 (
-    isom_stbl_t *stbl,
-    isom_mdhd_t *mdhd,
-    uint32_t    *bufferSizeDB,
-    uint32_t    *maxBitrate,
-    uint32_t    *avgBitrate,
-    uint32_t     sample_description_index
+    isom_stbl_t    *stbl,
+    uint32_t        timescale,
+    isom_bitrate_t *bitrate,
+    uint32_t        sample_description_index
 )
 {
     isom_stsz_t *stsz = stbl->stsz;
-    lsmash_entry_list_t *stsz_list  = LSMASH_IS_EXISTING_BOX( stsz ) ? stsz->list : stbl->stz2->list;
-    lsmash_entry_t *stsz_entry      = stsz_list ? stsz_list->head : NULL;
-    lsmash_entry_t *stts_entry      = stbl->stts->list->head;
-    lsmash_entry_t *stsc_entry      = NULL;
-    lsmash_entry_t *next_stsc_entry = stbl->stsc->list->head;
+    isom_stts_t *stts = stbl->stts;
+    isom_stsc_t *stsc = stbl->stsc;
+    isom_stsz_entry_t *stsz_entries = LSMASH_IS_EXISTING_BOX( stsz ) ? stsz->entries : stbl->stz2->entries;
+    uint32_t stsz_entry_count       = LSMASH_IS_EXISTING_BOX( stsz ) ? stsz->entry_count : stbl->stz2->entry_count;
+    uint32_t stsz_index             = 0;
+    uint32_t stts_index             = 0;
+    uint32_t next_stsc_index        = 0;
     isom_stts_entry_t *stts_data    = NULL;
     isom_stsc_entry_t *stsc_data    = NULL;
-    if( next_stsc_entry && !next_stsc_entry->data )
-        return LSMASH_ERR_INVALID_DATA;
-    uint32_t rate                   = 0;
-    uint64_t dts                    = 0;
-    uint32_t time_wnd               = 0;
     uint32_t chunk_number           = 0;
     uint32_t sample_number_in_stts  = 1;
     uint32_t sample_number_in_chunk = 1;
     uint32_t constant_sample_size   = LSMASH_IS_EXISTING_BOX( stsz ) ? stsz->sample_size : 0;
-    *bufferSizeDB = 0;
-    *maxBitrate   = 0;
-    *avgBitrate   = 0;
-    while( stts_entry )
+    while( stts_index < stts->entry_count )
     {
-        int err;
         if( !stsc_data || sample_number_in_chunk == stsc_data->samples_per_chunk )
         {
             /* Move the next chunk. */
             sample_number_in_chunk = 1;
             ++chunk_number;
             /* Check if the next entry is broken. */
-            while( next_stsc_entry && ((isom_stsc_entry_t *)next_stsc_entry->data)->first_chunk < chunk_number )
-            {
+            while( next_stsc_index < stsc->entry_count && stsc->entries[next_stsc_index].first_chunk < chunk_number )
                 /* Just skip broken next entry. */
-                next_stsc_entry = next_stsc_entry->next;
-                if( next_stsc_entry && !next_stsc_entry->data )
-                    return LSMASH_ERR_INVALID_DATA;
-            }
+                ++next_stsc_index;
             /* Check if the next chunk belongs to the next sequence of chunks. */
-            if( next_stsc_entry && ((isom_stsc_entry_t *)next_stsc_entry->data)->first_chunk == chunk_number )
+            if( next_stsc_index < stsc->entry_count && stsc->entries[next_stsc_index].first_chunk == chunk_number )
             {
-                stsc_entry = next_stsc_entry;
-                next_stsc_entry = next_stsc_entry->next;
-                if( next_stsc_entry && !next_stsc_entry->data )
-                    return LSMASH_ERR_INVALID_DATA;
-                stsc_data = (isom_stsc_entry_t *)stsc_entry->data;
+                stsc_data = &stsc->entries[ next_stsc_index ++ ];
                 /* Check if the next contiguous chunks belong to given sample description. */
                 if( stsc_data->sample_description_index != sample_description_index )
                 {
@@ -966,43 +925,40 @@ int isom_calculate_bitrate_description
                     uint32_t number_of_skips   = 0;
                     uint32_t first_chunk       = stsc_data->first_chunk;
                     uint32_t samples_per_chunk = stsc_data->samples_per_chunk;
-                    while( next_stsc_entry )
+                    while( next_stsc_index < stsc->entry_count )
                     {
-                        if( ((isom_stsc_entry_t *)next_stsc_entry->data)->sample_description_index != sample_description_index )
+                        if( stsc->entries[next_stsc_index].sample_description_index != sample_description_index )
                         {
-                            stsc_data = (isom_stsc_entry_t *)next_stsc_entry->data;
+                            stsc_data = &stsc->entries[next_stsc_index];
                             number_of_skips  += (stsc_data->first_chunk - first_chunk) * samples_per_chunk;
                             first_chunk       = stsc_data->first_chunk;
                             samples_per_chunk = stsc_data->samples_per_chunk;
                         }
-                        else if( ((isom_stsc_entry_t *)next_stsc_entry->data)->first_chunk <= first_chunk )
+                        else if( stsc->entries[next_stsc_index].first_chunk <= first_chunk )
                             ;   /* broken entry */
                         else
                             break;
                         /* Just skip the next entry. */
-                        next_stsc_entry = next_stsc_entry->next;
-                        if( next_stsc_entry && !next_stsc_entry->data )
-                            return LSMASH_ERR_INVALID_DATA;
+                        ++next_stsc_index;
                     }
-                    if( !next_stsc_entry )
+                    if( next_stsc_index == stsc->entry_count )
                         break;      /* There is no more chunks which don't belong to given sample description. */
-                    number_of_skips += (((isom_stsc_entry_t *)next_stsc_entry->data)->first_chunk - first_chunk) * samples_per_chunk;
+                    number_of_skips += (stsc->entries[next_stsc_index].first_chunk - first_chunk) * samples_per_chunk;
                     for( uint32_t i = 0; i < number_of_skips; i++ )
                     {
-                        if( stsz_list )
+                        if( stsz_entries )
                         {
-                            if( !stsz_entry )
+                            if( stsz_index == stsz_entry_count )
                                 break;
-                            stsz_entry = stsz_entry->next;
+                            ++stsz_index;
                         }
-                        if( !stts_entry )
+                        if( stts_index == stts->entry_count )
                             break;
-                        if( (err = isom_increment_sample_number_in_entry( &sample_number_in_stts,
-                                                                          ((isom_stts_entry_t *)stts_entry->data)->sample_count,
-                                                                          &stts_entry )) < 0 )
-                            return err;
+                        isom_increment_sample_number_in_entry( &sample_number_in_stts,
+                                                               stts->entries[stts_index].sample_count,
+                                                               &stts_index );
                     }
-                    if( (stsz_list && !stsz_entry) || !stts_entry )
+                    if( (stsz_entries && stsz_index == stsz_entry_count) || stts_index == stts->entry_count )
                         break;
                     chunk_number = stsc_data->first_chunk;
                 }
@@ -1012,43 +968,48 @@ int isom_calculate_bitrate_description
             ++sample_number_in_chunk;
         /* Get current sample's size. */
         uint32_t size;
-        if( stsz_list )
+        if( stsz_entries )
         {
-            if( !stsz_entry )
+            if( stsz_index == stsz_entry_count )
                 break;
-            isom_stsz_entry_t *stsz_data = (isom_stsz_entry_t *)stsz_entry->data;
-            if( !stsz_data )
-                return LSMASH_ERR_INVALID_DATA;
-            size = stsz_data->entry_size;
-            stsz_entry = stsz_entry->next;
+            size = stsz_entries[ stsz_index ++ ].entry_size;
         }
         else
             size = constant_sample_size;
         /* Get current sample's DTS. */
         if( stts_data )
-            dts += stts_data->sample_delta;
-        stts_data = (isom_stts_entry_t *)stts_entry->data;
-        if( !stts_data )
-            return LSMASH_ERR_INVALID_DATA;
-        if( (err = isom_increment_sample_number_in_entry( &sample_number_in_stts, stts_data->sample_count, &stts_entry )) < 0 )
-            return err;
-        /* Calculate bitrate description. */
-        if( *bufferSizeDB < size )
-            *bufferSizeDB = size;
-        *avgBitrate += size;
-        rate += size;
-        if( dts > time_wnd + mdhd->timescale )
-        {
-            if( rate > *maxBitrate )
-                *maxBitrate = rate;
-            time_wnd = dts;
-            rate = 0;
-        }
+            bitrate->dts += stts_data->sample_delta;
+        stts_data = &stts->entries[stts_index];
+        isom_increment_sample_number_in_entry( &sample_number_in_stts, stts_data->sample_count, &stts_index );
+        isom_count_bitrate_sample( bitrate, size, timescale );
     }
+}
+
+int isom_calculate_bitrate_description
+(
+    isom_stbl_t *stbl,
+    isom_mdhd_t *mdhd,
+    uint32_t    *bufferSizeDB,
+    uint32_t    *maxBitrate,
+    uint32_t    *avgBitrate,
+    uint32_t     sample_description_index
+)
+{
+    isom_bitrate_t bitrate = { 0 };
+    isom_trak_t   *trak    = (isom_trak_t *)mdhd->parent->parent;
+    isom_cache_t  *cache   = trak->cache;
+    if( cache && cache->bitrate.sample_count == isom_get_sample_count_from_sample_table( stbl ) )
+    {
+        /* All samples in the sample table were counted into the statistics while being appended. */
+        if( sample_description_index <= cache->bitrate.entry_count )
+            bitrate = cache->bitrate.entries[ sample_description_index - 1 ];
+    }
+    else
+        isom_scan_bitrate_description( stbl, mdhd->timescale, &bitrate, sample_description_index );
     double duration = (double)mdhd->duration / mdhd->timescale;
-    *avgBitrate = (uint32_t)(*avgBitrate / duration);
-    if( *maxBitrate == 0 )
-        *maxBitrate = *avgBitrate;
+    *bufferSizeDB = bitrate.max_sample_size;
+    *avgBitrate   = (uint32_t)(bitrate.total_size / duration);
+    *maxBitrate   = bitrate.max_rate ? bitrate.max_rate : *avgBitrate;
     /* Convert to bits per second. */
     *maxBitrate *= 8;
     *avgBitrate *= 8;
@@ -1071,16 +1032,16 @@ uint32_t isom_get_first_sample_size( isom_stbl_t *stbl )
         /* 'stsz' */
         if( stbl->stsz->sample_size )
             return stbl->stsz->sample_size;
-        else if( stbl->stsz->list && stbl->stsz->list->head && stbl->stsz->list->head->data )
-            return ((isom_stsz_entry_t *)stbl->stsz->list->head->data)->entry_size;
+        else if( stbl->stsz->entry_count )
+            return stbl->stsz->entries[0].entry_size;
         else
             return 0;
     }
     else if( LSMASH_IS_EXISTING_BOX( stbl->stz2 ) )
     {
         /* stz2 */
-        if( stbl->stz2->list && stbl->stz2->list->head && stbl->stz2->list->head->data )
-            return ((isom_stsz_entry_t *)stbl->stz2->list->head->data)->entry_size;
+        if( stbl->stz2->entry_count )
+            return stbl->stz2->entries[0].entry_size;
         else
             return 0;
     }
@@ -1095,8 +1056,8 @@ int isom_update_bitrate_description( isom_mdia_t *mdia )
     isom_stbl_t *stbl = mdia->minf->stbl;
     if( LSMASH_IS_NON_EXISTING_BOX( stbl->stsd )
      || (LSMASH_IS_NON_EXISTING_BOX( stbl->stsz ) && LSMASH_IS_NON_EXISTING_BOX( stbl->stz2 ))
-     || !stbl->stsc->list
-     || !stbl->stts->list )
+     || LSMASH_IS_NON_EXISTING_BOX( stbl->stsc )
+     || LSMASH_IS_NON_EXISTING_BOX( stbl->stts ) )
         return LSMASH_ERR_INVALID_DATA;
     uint32_t sample_description_index = 0;
     for( lsmash_entry_t *entry = stbl->stsd->list.head; entry; entry = entry->next )
@@ -1732,11 +1693,10 @@ uint32_t lsmash_get_last_sample_delta( lsmash_root_t *root, uint32_t track_ID )
     if( isom_check_initializer_present( root ) < 0 )
         return 0;
     isom_trak_t *trak = isom_get_trak( root->file, track_ID );
-    if( !trak->mdia->minf->stbl->stts->list
-     || !trak->mdia->minf->stbl->stts->list->tail
-     || !trak->mdia->minf->stbl->stts->list->tail->data )
+    isom_stts_t *stts = trak->mdia->minf->stbl->stts;
+    if( stts->entry_count == 0 )
         return 0;
-    return ((isom_stts_entry_t *)trak->mdia->minf->stbl->stts->list->tail->data)->sample_delta;
+    return stts->entries[ stts->entry_count - 1 ].sample_delta;
 }
 
 uint32_t lsmash_get_start_time_offset( lsmash_root_t *root, uint32_t track_ID )
@@ -1744,11 +1704,10 @@ uint32_t lsmash_get_start_time_offset( lsmash_root_t *root, uint32_t track_ID )
     if( isom_check_initializer_present( root ) < 0 )
         return 0;
     isom_trak_t *trak = isom_get_trak( root->file, track_ID );
-    if( !trak->mdia->minf->stbl->ctts->list
-     || !trak->mdia->minf->stbl->ctts->list->head
-     || !trak->mdia->minf->stbl->ctts->list->head->data )
+    isom_ctts_t *ctts = trak->mdia->minf->stbl->ctts;
+    if( ctts->entry_count == 0 )
         return 0;
-    return ((isom_ctts_entry_t *)trak->mdia->minf->stbl->ctts->list->head->data)->sample_offset;
+    return ctts->entries[0].sample_offset;
 }
 
 uint32_t lsmash_get_composition_to_decode_shift( lsmash_root_t *root, uint32_t track_ID )
@@ -1761,26 +1720,26 @@ uint32_t lsmash_get_composition_to_decode_shift( lsmash_root_t *root, uint32_t t
     if( sample_count == 0 )
         return 0;
     isom_stbl_t *stbl = trak->mdia->minf->stbl;
-    if( !stbl->stts->list
-     || !stbl->ctts->list )
+    isom_stts_t *stts = stbl->stts;
+    isom_ctts_t *ctts = stbl->ctts;
+    if( LSMASH_IS_NON_EXISTING_BOX( stts )
+     || LSMASH_IS_NON_EXISTING_BOX( ctts ) )
         return 0;
-    if( !(file->max_isom_version >= 4 && stbl->ctts->version == 1) && !file->qt_compatible )
+    if( !(file->max_isom_version >= 4 && ctts->version == 1) && !file->qt_compatible )
         return 0;   /* This movie shall not have composition to decode timeline shift. */
-    lsmash_entry_t *stts_entry = stbl->stts->list->head;
-    lsmash_entry_t *ctts_entry = stbl->ctts->list->head;
-    if( !stts_entry || !ctts_entry )
+    if( stts->entry_count == 0 || ctts->entry_count == 0 )
         return 0;
-    uint64_t dts       = 0;
-    uint64_t cts       = 0;
-    uint32_t ctd_shift = 0;
-    uint32_t i         = 0;
-    uint32_t j         = 0;
+    uint64_t dts        = 0;
+    uint64_t cts        = 0;
+    uint32_t ctd_shift  = 0;
+    uint32_t i          = 0;
+    uint32_t j          = 0;
+    uint32_t stts_index = 0;
+    uint32_t ctts_index = 0;
     for( uint32_t k = 0; k < sample_count; k++ )
     {
-        isom_stts_entry_t *stts_data = (isom_stts_entry_t *)stts_entry->data;
-        isom_ctts_entry_t *ctts_data = (isom_ctts_entry_t *)ctts_entry->data;
-        if( !stts_data || !ctts_data )
-            return 0;
+        isom_stts_entry_t *stts_data = &stts->entries[stts_index];
+        isom_ctts_entry_t *ctts_data = &ctts->entries[ctts_index];
         if( ctts_data->sample_offset != ISOM_NON_OUTPUT_SAMPLE_OFFSET )
         {
             cts = dts + (int32_t)ctts_data->sample_offset;
@@ -1790,15 +1749,13 @@ uint32_t lsmash_get_composition_to_decode_shift( lsmash_root_t *root, uint32_t t
         dts += stts_data->sample_delta;
         if( ++i == stts_data->sample_count )
         {
-            stts_entry = stts_entry->next;
-            if( !stts_entry )
+            if( ++stts_index == stts->entry_count )
                 return 0;
             i = 0;
         }
         if( ++j == ctts_data->sample_count )
         {
-            ctts_entry = ctts_entry->next;
-            if( !ctts_entry )
+            if( ++ctts_index == ctts->entry_count )
                 return 0;
             j = 0;
         }
@@ -1959,11 +1916,9 @@ static int isom_compress_sample_size_table( isom_stbl_t *stbl )
     if( LSMASH_IS_EXISTING_BOX( stbl->stsz ) && isom_is_variable_size( stbl ) )
     {
         int max_num_bits = 0;
-        for( lsmash_entry_t *entry = stbl->stsz->list->head; entry; entry = entry->next )
+        for( uint32_t i = 0; i < stbl->stsz->entry_count; i++ )
         {
-            isom_stsz_entry_t *data = (isom_stsz_entry_t *)entry->data;
-            if( !data )
-                return LSMASH_ERR_INVALID_DATA;
+            isom_stsz_entry_t *data = &stbl->stsz->entries[i];
             int num_bits;
             for( num_bits = 1; data->entry_size >> num_bits; num_bits++ );
             if( max_num_bits < num_bits )
@@ -1985,7 +1940,12 @@ static int isom_compress_sample_size_table( isom_stbl_t *stbl )
                 stz2->field_size = 8;
             else
                 stz2->field_size = 16;
-            lsmash_list_move_entries( stz2->list, stsz->list );
+            stz2->entry_count  = stsz->entry_count;
+            stz2->alloc_count  = stsz->alloc_count;
+            stz2->entries      = stsz->entries;
+            stsz->entry_count  = 0;
+            stsz->alloc_count  = 0;
+            stsz->entries      = NULL;
             isom_remove_box_by_itself( stsz );
         }
     }
@@ -2248,6 +2208,25 @@ int lsmash_reserve_media_data_size
     return 0;
 }
 
+int lsmash_reserve_movie_size
+(
+    lsmash_root_t *root,
+    uint64_t       movie_size
+)
+{
+    if( isom_check_initializer_present( root ) < 0
+     || (movie_size && (movie_size < ISOM_BASEBOX_COMMON_SIZE || movie_size > UINT32_MAX)) )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    lsmash_file_t *file = root->file->initializer;
+    if( !file->bs
+     || file->bs->unseekable                            /* The reserved region is overwritten when finishing. */
+     || file->fragment                                  /* For fragmented movies, this function makes no sense. */
+     || (file->mdat->manager & (LSMASH_INCOMPLETE_BOX | LSMASH_WRITTEN_BOX)) )  /* whether any sample is already written or not */
+        return LSMASH_ERR_NAMELESS;
+    file->reserved_movie_size = movie_size;
+    return 0;
+}
+
 static int isom_scan_trak_profileLevelIndication
 (
     isom_trak_t                         *trak,
@@ -2398,9 +2377,9 @@ int isom_check_large_offset_requirement
     {
         isom_trak_t *trak = (isom_trak_t *)entry->data;
         isom_stco_t *stco = trak->mdia->minf->stbl->stco;
-        if( !stco->list->tail   /* no samples */
+        if( stco->entry_count == 0  /* no samples */
          || stco->large_presentation
-         || (((isom_stco_entry_t *)stco->list->tail->data)->chunk_offset + moov->size + meta_size) <= UINT32_MAX )
+         || (stco->entries.stco[ stco->entry_count - 1 ].chunk_offset + moov->size + meta_size) <= UINT32_MAX )
         {
             entry = entry->next;
             continue;   /* no need to convert stco into co64 */
@@ -2428,36 +2407,31 @@ void isom_add_preceding_box_size
         isom_trak_t *trak = (isom_trak_t *)entry->data;
         isom_stsc_t *stsc = trak->mdia->minf->stbl->stsc;
         isom_stco_t *stco = trak->mdia->minf->stbl->stco;
-        lsmash_entry_t    *stsc_entry = stsc->list->head;
-        isom_stsc_entry_t *stsc_data  = stsc_entry ? (isom_stsc_entry_t *)stsc_entry->data : NULL;
-        uint32_t chunk_number = 1;
-        for( lsmash_entry_t *stco_entry = stco->list->head; stco_entry; )
+        uint32_t           stsc_index = 0;
+        isom_stsc_entry_t *stsc_data  = stsc->entry_count ? &stsc->entries[0] : NULL;
+        /* chunk_number is equal to the index of the current chunk offset plus 1. */
+        for( uint32_t chunk_number = 1; chunk_number <= stco->entry_count; )
         {
             if( stsc_data
              && stsc_data->first_chunk == chunk_number )
             {
                 lsmash_file_t *ref_file = isom_get_written_media_file( trak, stsc_data->sample_description_index );
-                stsc_entry = stsc_entry->next;
-                stsc_data  = stsc_entry ? (isom_stsc_entry_t *)stsc_entry->data : NULL;
+                stsc_data = ++stsc_index < stsc->entry_count ? &stsc->entries[stsc_index] : NULL;
                 if( ref_file != trak->file )
                 {
                     /* The chunks are not contained in the same file. Skip applying the offset.
                      * If no more stsc entries, the rest of the chunks is not contained in the same file. */
-                    if( !stsc_entry || !stsc_data )
+                    if( !stsc_data )
                         break;
-                    while( stco_entry && chunk_number < stsc_data->first_chunk )
-                    {
-                        stco_entry = stco_entry->next;
+                    while( chunk_number <= stco->entry_count && chunk_number < stsc_data->first_chunk )
                         ++chunk_number;
-                    }
                     continue;
                 }
             }
             if( stco->large_presentation )
-                ((isom_co64_entry_t *)stco_entry->data)->chunk_offset += preceding_size;
+                stco->entries.co64[ chunk_number - 1 ].chunk_offset += preceding_size;
             else
-                ((isom_stco_entry_t *)stco_entry->data)->chunk_offset += preceding_size;
-            stco_entry = stco_entry->next;
+                stco->entries.stco[ chunk_number - 1 ].chunk_offset += preceding_size;
             ++chunk_number;
         }
     }
@@ -2475,14 +2449,37 @@ int isom_establish_movie( lsmash_file_t *file )
     return 0;
 }
 
-int lsmash_finish_movie
+/* This function is for non-fragmented movie. */
+static int isom_write_movie_into_reserved_space
+(
+    lsmash_file_t *file,
+    uint64_t       free_size
+)
+{
+    lsmash_bs_t *bs = file->bs;
+    uint64_t current_pos = bs->offset;
+    int err;
+    if( (err = lsmash_bs_write_seek( bs, file->reserved_movie_pos, SEEK_SET )) < 0
+     || (err = isom_write_box( bs, (isom_box_t *)file->moov ))                < 0
+     || (err = isom_write_box( bs, (isom_box_t *)file->meta ))                < 0 )
+        return err;
+    if( free_size )
+    {
+        /* The contents of the remainder are zero bytes written when reserving the region. */
+        lsmash_bs_put_be32( bs, free_size );
+        lsmash_bs_put_be32( bs, ISOM_BOX_TYPE_FREE.fourcc );
+        if( (err = lsmash_bs_flush_buffer( bs )) < 0 )
+            return err;
+    }
+    return lsmash_bs_write_seek( bs, current_pos, SEEK_SET ) < 0 ? LSMASH_ERR_NAMELESS : 0;
+}
+
+static int isom_finish_movie
 (
     lsmash_root_t        *root,
     lsmash_adhoc_remux_t *remux
 )
 {
-    if( isom_check_initializer_present( root ) < 0 )
-        return LSMASH_ERR_FUNCTION_PARAM;
     lsmash_file_t *file = root->file;
     if( !file->bs
      || LSMASH_IS_NON_EXISTING_BOX( file->initializer->moov ) )
@@ -2501,8 +2498,7 @@ int lsmash_finish_movie
          || !trak->cache
          || !trak->mdia->minf->stbl->stsd->list.head
          || !trak->mdia->minf->stbl->stsd->list.head->data
-         || !trak->mdia->minf->stbl->stco->list
-         || !trak->mdia->minf->stbl->stco->list->tail )
+         || trak->mdia->minf->stbl->stco->entry_count == 0 )
             return LSMASH_ERR_INVALID_DATA;
         if( (err = isom_complement_data_reference( trak->mdia->minf )) < 0 )
             return err;
@@ -2542,8 +2538,18 @@ int lsmash_finish_movie
     file->mdat->manager &= ~LSMASH_INCOMPLETE_BOX;
     if( (err = isom_write_box( bs, (isom_box_t *)file->mdat )) < 0 )
         return err;
+    uint64_t meta_size     = LSMASH_IS_EXISTING_BOX( file->meta ) ? file->meta->size : 0;
+    uint64_t reserved_size = file->reserved_movie_size;
+    if( reserved_size )
+    {
+        /* Write the Movie Box and a Meta Box into the reserved region if they fit in it.
+         * Any remainder is covered by a Free Space Box, so it must be large enough to hold a box header. */
+        uint64_t mtf_size = moov->size + meta_size;
+        if( mtf_size == reserved_size
+         || mtf_size + ISOM_BASEBOX_COMMON_SIZE <= reserved_size )
+            return isom_write_movie_into_reserved_space( file, reserved_size - mtf_size );
+    }
     /* Write the Movie Box and a Meta Box if no optimization for progressive download. */
-    uint64_t meta_size = LSMASH_IS_EXISTING_BOX( file->meta ) ? file->meta->size : 0;
     if( !remux )
     {
         if( (err = isom_write_box( bs, (isom_box_t *)file->moov )) < 0
@@ -2557,37 +2563,63 @@ int lsmash_finish_movie
         return err;
     /* now the amount of offset is fixed. */
     uint64_t mtf_size = moov->size + meta_size;     /* sum of size of boxes moved to front */
-    /* buffer size must be at least mtf_size * 2 */
-    remux->buffer_size = LSMASH_MAX( remux->buffer_size, mtf_size * 2 );
-    /* Split to 2 buffers. */
-    uint8_t *buf[2] = { NULL, NULL };
-    if( (buf[0] = (uint8_t*)lsmash_malloc( remux->buffer_size )) == NULL )
-        return LSMASH_ERR_MEMORY_ALLOC; /* NOTE: I think we still can fallback to "return isom_write_moov();" here. */
-    size_t size = remux->buffer_size / 2;
-    buf[1] = buf[0] + size;
+    /* The reserved region is occupied by the boxes moved to front, so the media data is moved only by the shortage.
+     * If the reserved region is a bit larger than them, move the media data so that the remainder fits a Free Space Box. */
+    uint64_t free_size  = 0;
+    uint64_t shift_size = mtf_size;
+    if( reserved_size )
+    {
+        if( mtf_size < reserved_size )
+            free_size = ISOM_BASEBOX_COMMON_SIZE;
+        shift_size = mtf_size + free_size - reserved_size;
+    }
     /* Now, the amount of the offset is fixed. apply it to stco/co64 */
-    isom_add_preceding_box_size( moov, mtf_size );
-    /* Backup starting area of mdat and write moov + meta there instead. */
+    isom_add_preceding_box_size( moov, shift_size );
     isom_mdat_t *mdat            = file->mdat;
-    uint64_t     total           = file->size + mtf_size;
-    uint64_t     placeholder_pos = mdat->pos;
-    if( (err = lsmash_bs_write_seek( bs, placeholder_pos, SEEK_SET )) < 0 )
-        goto fail;
-    size_t read_num = size;
-    lsmash_bs_read_data( bs, buf[0], &read_num );
-    uint64_t read_pos = bs->offset;
+    uint64_t     total           = file->size + shift_size;
+    uint64_t     placeholder_pos = reserved_size ? file->reserved_movie_pos : mdat->pos;
+    uint8_t     *buf[2]          = { NULL, NULL };
+    size_t       size            = 0;
+    size_t       read_num        = 0;
+    uint64_t     read_pos        = 0;
+    /* Try to move Media Data Box inside the stream first. If unsupported, move it through the buffers. */
+    if( (err = lsmash_bs_shift_data( bs, mdat->pos, shift_size )) == LSMASH_ERR_PATCH_WELCOME )
+    {
+        /* buffer size must be at least mtf_size * 2 */
+        remux->buffer_size = LSMASH_MAX( remux->buffer_size, mtf_size * 2 );
+        /* Split to 2 buffers. */
+        if( (buf[0] = (uint8_t*)lsmash_malloc( remux->buffer_size )) == NULL )
+            return LSMASH_ERR_MEMORY_ALLOC; /* NOTE: I think we still can fallback to "return isom_write_moov();" here. */
+        size = remux->buffer_size / 2;
+        buf[1] = buf[0] + size;
+        /* Backup starting area of mdat and write moov + meta there instead. */
+        if( (err = lsmash_bs_write_seek( bs, mdat->pos, SEEK_SET )) < 0 )
+            goto fail;
+        read_num = size;
+        lsmash_bs_read_data( bs, buf[0], &read_num );
+        read_pos = bs->offset;
+    }
+    else if( err < 0 )
+        return err;
     /* Write moov + meta there instead. */
     if( (err = lsmash_bs_write_seek( bs, placeholder_pos, SEEK_SET )) < 0
      || (err = isom_write_box( bs, (isom_box_t *)file->moov ))        < 0
      || (err = isom_write_box( bs, (isom_box_t *)file->meta ))        < 0 )
         goto fail;
+    if( free_size )
+    {
+        lsmash_bs_put_be32( bs, free_size );
+        lsmash_bs_put_be32( bs, ISOM_BOX_TYPE_FREE.fourcc );
+        if( (err = lsmash_bs_flush_buffer( bs )) < 0 )
+            goto fail;
+    }
     uint64_t write_pos = bs->offset;
     /* Update the positions */
-    mdat->pos += mtf_size;
+    mdat->pos += shift_size;
     /* Move Media Data Box. */
     if( (err = isom_rearrange_data( file, remux, buf, read_num, size, read_pos, write_pos, total )) < 0 )
         goto fail;
-    file->size += mtf_size;
+    file->size += shift_size;
     lsmash_free( buf[0] );
     return 0;
 fail:
@@ -2595,6 +2627,20 @@ fail:
     return err;
 }
 
+int lsmash_finish_movie
+(
+    lsmash_root_t        *root,
+    lsmash_adhoc_remux_t *remux
+)
+{
+    if( isom_check_initializer_present( root ) < 0 )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    int err = isom_finish_movie( root, remux );
+    /* Wait for the background writer so that any failure of writing is reported here. */
+    int write_err = lsmash_bs_disable_async_write( root->file->bs );
+    return err < 0 ? err : write_err;
+}
+
 int lsmash_set_last_sample_delta( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_delta )
 {
     if( isom_check_initializer_present( root ) < 0 || track_ID == 0 )
@@ -2618,13 +2664,13 @@ int lsmash_set_last_sample_delta( lsmash_root_t *root, uint32_t track_ID, uint32
      || (LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stsz )
       && LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stz2 ))
      || !trak->cache
-     || !trak->mdia->minf->stbl->stts->list )
+     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stts ) )
         return LSMASH_ERR_NAMELESS;
     isom_stbl_t *stbl = trak->mdia->minf->stbl;
     isom_stts_t *stts = stbl->stts;
     uint32_t sample_count = isom_get_sample_count( trak );
     int err;
-    if( !stts->list->tail )
+    if( stts->entry_count == 0 )
     {
         if( sample_count == 0 )
             return 0;       /* no samples */
@@ -2637,14 +2683,12 @@ int lsmash_set_last_sample_delta( lsmash_root_t *root, uint32_t track_ID, uint32
         return lsmash_update_track_duration( root, track_ID, 0 );
     }
     uint32_t i = 0;
-    for( lsmash_entry_t *entry = stts->list->head; entry; entry = entry->next )
-        i += ((isom_stts_entry_t *)entry->data)->sample_count;
+    for( uint32_t entry_index = 0; entry_index < stts->entry_count; entry_index++ )
+        i += stts->entries[entry_index].sample_count;
     if( sample_count < i )
         return LSMASH_ERR_INVALID_DATA;
     int no_last = (sample_count > i);
-    isom_stts_entry_t *last_stts_data = (isom_stts_entry_t *)stts->list->tail->data;
-    if( !last_stts_data )
-        return LSMASH_ERR_INVALID_DATA;
+    isom_stts_entry_t *last_stts_data = &stts->entries[ stts->entry_count - 1 ];
     /* Consider QuikcTime fixed compression audio. */
     isom_audio_entry_t *audio = (isom_audio_entry_t *)lsmash_list_get_entry_data( &trak->mdia->minf->stbl->stsd->list,
                                                                                   trak->cache->chunk.sample_description_index );
@@ -2659,11 +2703,9 @@ int lsmash_set_last_sample_delta( lsmash_root_t *root, uint32_t track_ID, uint32
             return LSMASH_ERR_INVALID_DATA;
         int exclude_last_sample = no_last ? 0 : 1;
         uint32_t j = audio->samplesPerPacket;
-        for( lsmash_entry_t *entry = stts->list->tail; entry && j > 1; entry = entry->prev )
+        for( uint32_t entry_index = stts->entry_count; entry_index && j > 1; entry_index-- )
         {
-            isom_stts_entry_t *stts_data = (isom_stts_entry_t *)entry->data;
-            if( !stts_data )
-                return LSMASH_ERR_INVALID_DATA;
+            isom_stts_entry_t *stts_data = &stts->entries[ entry_index - 1 ];
             for( uint32_t k = exclude_last_sample; k < stts_data->sample_count && j > 1; k++ )
             {
                 sample_delta -= stts_data->sample_delta;
@@ -2743,8 +2785,15 @@ int lsmash_create_explicit_timeline_map( lsmash_root_t *root, uint32_t track_ID,
                   : trak->tkhd->duration ? trak->tkhd->duration
                   : isom_update_tkhd_duration( trak ) < 0 ? 0
                   : trak->tkhd->duration;
-    if( (LSMASH_IS_NON_EXISTING_BOX( trak->edts )       && LSMASH_IS_BOX_ADDITION_FAILURE( isom_add_edts( trak ) ))
-     || (LSMASH_IS_NON_EXISTING_BOX( trak->edts->elst ) && LSMASH_IS_BOX_ADDITION_FAILURE( isom_add_elst( trak->edts ) )) )
+    if( LSMASH_IS_NON_EXISTING_BOX( trak->edts ) )
+    {
+        if( LSMASH_IS_BOX_ADDITION_FAILURE( isom_add_edts( trak ) ) )
+            return LSMASH_ERR_NAMELESS;
+        /* A box added into a file opened for reading is left at the tail, so place it before the Media Box here. */
+        if( trak->file->flags & LSMASH_FILE_MODE_READ )
+            isom_reorder_tail_box( (isom_box_t *)trak );
+    }
+    if( LSMASH_IS_NON_EXISTING_BOX( trak->edts->elst ) && LSMASH_IS_BOX_ADDITION_FAILURE( isom_add_elst( trak->edts ) ) )
         return LSMASH_ERR_NAMELESS;
     int err = isom_add_elst_entry( trak->edts->elst, edit.duration, edit.start_time, edit.rate );
     if( err < 0 )
@@ -2839,6 +2888,114 @@ int lsmash_update_movie_modification_time( lsmash_root_t *root )
 }
 
 /*---- sample manipulators ----*/
+/* A pooled sample is a single block holding the buffer header, the sample itself and its data.
+ * The block is returned to the arena of the ROOT when the sample is deleted, and is reused for later samples
+ * in the same size class. This saves allocations of both the sample and its data for each access unit. */
+#define ISOM_SAMPLE_ARENA_MIN_BLOCK_SIZE  64
+#define ISOM_SAMPLE_ARENA_CLASS_COUNT     19                  /* up to 16 MiB */
+#define ISOM_SAMPLE_ARENA_MAX_CACHED_SIZE (32 * 1024 * 1024)  /* maximum total size of blocks kept for reuse */
+
+typedef struct isom_pooled_sample_tag isom_pooled_sample_t;
+
+struct isom_pooled_sample_tag
+{
+    isom_sample_buffer_t  buffer;   /* 'data' points to the data following this struct. */
+    lsmash_sample_t       sample;
+    isom_pooled_sample_t *next;     /* next free block in the same size class */
+};
+
+struct isom_sample_arena_tag
+{
+    lsmash_mutex_t       *mutex;    /* Samples may be deleted on a thread other than the one creating them. */
+    isom_pooled_sample_t *free_list[ISOM_SAMPLE_ARENA_CLASS_COUNT];
+    uint64_t              cached_size;      /* total size of blocks in the free lists */
+    uint64_t              outstanding;      /* number of blocks in use */
+    int                   orphaned;         /* The ROOT was destroyed and the arena waits for the blocks in use. */
+};
+
+static int isom_get_sample_arena_class( uint32_t size )
+{
+    for( int i = 0; i < ISOM_SAMPLE_ARENA_CLASS_COUNT; i++ )
+        if( size <= ((uint32_t)ISOM_SAMPLE_ARENA_MIN_BLOCK_SIZE << i) )
+            return i;
+    return -1;
+}
+
+isom_sample_arena_t *isom_create_sample_arena( void )
+{
+    isom_sample_arena_t *arena = lsmash_malloc_zero( sizeof(isom_sample_arena_t) );
+    if( !arena )
+        return NULL;
+    arena->mutex = lsmash_mutex_create();
+    if( !arena->mutex )
+    {
+        lsmash_free( arena );
+        return NULL;
+    }
+    return arena;
+}
+
+static void isom_empty_sample_arena( isom_sample_arena_t *arena )
+{
+    for( int i = 0; i < ISOM_SAMPLE_ARENA_CLASS_COUNT; i++ )
+        while( arena->free_list[i] )
+        {
+            isom_pooled_sample_t *pooled = arena->free_list[i];
+            arena->free_list[i] = pooled->next;
+            lsmash_free( pooled );
+        }
+    arena->cached_size = 0;
+}
+
+static void isom_destroy_sample_arena( isom_sample_arena_t *arena )
+{
+    isom_empty_sample_arena( arena );
+    lsmash_mutex_destroy( arena->mutex );
+    lsmash_free( arena );
+}
+
+void isom_orphan_sample_arena( isom_sample_arena_t *arena )
+{
+    if( !arena )
+        return;
+    /* Samples created from the arena may outlive the ROOT.
+     * If so, the last one of them destroys the arena. */
+    lsmash_mutex_lock( arena->mutex );
+    isom_empty_sample_arena( arena );
+    arena->orphaned = 1;
+    int destroy = (arena->outstanding == 0);
+    lsmash_mutex_unlock( arena->mutex );
+    if( destroy )
+        isom_destroy_sample_arena( arena );
+}
+
+static void isom_recycle_pooled_sample( isom_pooled_sample_t *pooled )
+{
+    isom_sample_arena_t *arena = pooled->buffer.arena;
+    int index = isom_get_sample_arena_class( pooled->buffer.size );
+    lsmash_mutex_lock( arena->mutex );
+    --arena->outstanding;
+    if( !arena->orphaned && index >= 0
+     && arena->cached_size + pooled->buffer.size <= ISOM_SAMPLE_ARENA_MAX_CACHED_SIZE )
+    {
+        pooled->next = arena->free_list[index];
+        arena->free_list[index] = pooled;
+        arena->cached_size += pooled->buffer.size;
+        pooled = NULL;
+    }
+    int destroy = (arena->orphaned && arena->outstanding == 0);
+    lsmash_mutex_unlock( arena->mutex );
+    lsmash_free( pooled );
+    if( destroy )
+        isom_destroy_sample_arena( arena );
+}
+
+static inline isom_pooled_sample_t *isom_get_pooled_sample( lsmash_sample_t *sample )
+{
+    isom_sample_buffer_t *buffer = (isom_sample_buffer_t *)sample->buffer;
+    return buffer && buffer->arena ? (isom_pooled_sample_t *)buffer : NULL;
+}
+
 lsmash_sample_t *lsmash_create_sample( uint32_t size )
 {
     lsmash_sample_t *sample = lsmash_malloc_zero( sizeof(lsmash_sample_t) );
@@ -2856,17 +3013,121 @@ lsmash_sample_t *lsmash_create_sample( uint32_t size )
     return sample;
 }
 
+lsmash_sample_t *lsmash_create_pooled_sample( lsmash_root_t *root, uint32_t size )
+{
+    if( LSMASH_IS_NON_EXISTING_BOX( root ) )
+        return NULL;
+    isom_sample_arena_t *arena = root->sample_arena;
+    if( !arena )
+        return NULL;
+    /* Blocks larger than the largest size class are allocated by the exact size and never kept for reuse. */
+    int      index    = isom_get_sample_arena_class( size );
+    uint32_t capacity = index >= 0 ? (uint32_t)ISOM_SAMPLE_ARENA_MIN_BLOCK_SIZE << index : size;
+    isom_pooled_sample_t *pooled = NULL;
+    lsmash_mutex_lock( arena->mutex );
+    if( index >= 0 && arena->free_list[index] )
+    {
+        pooled = arena->free_list[index];
+        arena->free_list[index] = pooled->next;
+        arena->cached_size -= capacity;
+    }
+    ++arena->outstanding;
+    lsmash_mutex_unlock( arena->mutex );
+    if( !pooled )
+    {
+        pooled = lsmash_malloc( sizeof(isom_pooled_sample_t) + capacity );
+        if( !pooled )
+        {
+            lsmash_mutex_lock( arena->mutex );
+            --arena->outstanding;
+            lsmash_mutex_unlock( arena->mutex );
+            return NULL;
+        }
+    }
+    pooled->buffer.refcount = 1;
+    pooled->buffer.pos      = 0;
+    pooled->buffer.size     = capacity;
+    pooled->buffer.file     = NULL;
+    pooled->buffer.data     = (uint8_t *)(pooled + 1);
+    pooled->buffer.arena    = arena;
+    pooled->sample          = (lsmash_sample_t){ 0 };
+    pooled->sample.data     = size ? pooled->buffer.data : NULL;
+    pooled->sample.length   = size;
+    pooled->sample.buffer   = &pooled->buffer;
+    pooled->next            = NULL;
+    return &pooled->sample;
+}
+
+/* The sample lives in its block, so the block is kept whatever size is requested.
+ * Data beyond the capacity of the block is allocated separately. */
+static int isom_pooled_sample_alloc( isom_pooled_sample_t *pooled, uint32_t size )
+{
+    lsmash_sample_t *sample = &pooled->sample;
+    if( sample->data && sample->data != pooled->buffer.data )
+    {
+        /* The data has already outgrown the block. */
+        if( size == 0 )
+        {
+            lsmash_freep( &sample->data );
+            sample->length = 0;
+            return 0;
+        }
+        uint8_t *data = lsmash_realloc( sample->data, size );
+        if( !data )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        sample->data   = data;
+        sample->length = size;
+        return 0;
+    }
+    if( size <= pooled->buffer.size )
+    {
+        sample->data   = size ? pooled->buffer.data : NULL;
+        sample->length = size;
+        return 0;
+    }
+    uint8_t *data = lsmash_malloc( size );
+    if( !data )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    if( sample->data )
+        memcpy( data, sample->data, LSMASH_MIN( sample->length, pooled->buffer.size ) );
+    sample->data   = data;
+    sample->length = size;
+    return 0;
+}
+
 int lsmash_sample_alloc( lsmash_sample_t *sample, uint32_t size )
 {
     if( !sample )
         return LSMASH_ERR_FUNCTION_PARAM;
+    isom_pooled_sample_t *pooled = isom_get_pooled_sample( sample );
+    if( pooled )
+        return isom_pooled_sample_alloc( pooled, size );
     if( size == 0 )
     {
-        lsmash_free( sample->data );
+        if( sample->buffer )
+        {
+            isom_release_sample_buffer( (isom_sample_buffer_t *)sample->buffer );
+            sample->buffer = NULL;
+        }
+        else
+            lsmash_free( sample->data );
         sample->data   = NULL;
         sample->length = 0;
         return 0;
     }
+    if( sample->buffer )
+    {
+        /* Make a copy of the data since the buffer is shared with other samples. */
+        uint8_t *data = lsmash_malloc( size );
+        if( !data )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        memcpy( data, sample->data, LSMASH_MIN( size, sample->length ) );
+        isom_release_sample_buffer( (isom_sample_buffer_t *)sample->buffer );
+        sample->buffer = NULL;
+        sample->data   = data;
+        sample->length = size;
+        return 0;
+    }
     if( size == sample->length )
         return 0;
     uint8_t *data;
@@ -2885,35 +3146,154 @@ void lsmash_delete_sample( lsmash_sample_t *sample )
 {
     if( !sample )
         return;
-    lsmash_free( sample->data );
+    isom_pooled_sample_t *pooled = isom_get_pooled_sample( sample );
+    if( pooled )
+    {
+        if( sample->data != pooled->buffer.data )
+            lsmash_free( sample->data );
+        /* The sample itself goes back to the arena together with its block. */
+        isom_release_sample_buffer( &pooled->buffer );
+        return;
+    }
+    if( sample->buffer )
+        isom_release_sample_buffer( (isom_sample_buffer_t *)sample->buffer );
+    else
+        lsmash_free( sample->data );
     lsmash_free( sample );
 }
 
-isom_sample_pool_t *isom_create_sample_pool( uint64_t size )
+isom_sample_buffer_t *isom_create_sample_buffer( lsmash_file_t *file, uint64_t pos, uint8_t *data, uint64_t size )
+{
+    isom_sample_buffer_t *buffer = lsmash_malloc( sizeof(isom_sample_buffer_t) );
+    if( !buffer )
+        return NULL;
+    buffer->refcount = 1;
+    buffer->pos      = pos;
+    buffer->size     = size;
+    buffer->file     = file;
+    buffer->data     = data;
+    buffer->arena    = NULL;
+    return buffer;
+}
+
+void isom_release_sample_buffer( isom_sample_buffer_t *buffer )
+{
+    if( !buffer || lsmash_atomic_decrement( &buffer->refcount ) )
+        return;
+    if( buffer->arena )
+    {
+        isom_recycle_pooled_sample( (isom_pooled_sample_t *)buffer );
+        return;
+    }
+    lsmash_free( buffer->data );
+    lsmash_free( buffer );
+}
+
+lsmash_sample_t *isom_create_sample_view( isom_sample_buffer_t *buffer, uint64_t pos, uint32_t length )
+{
+    if( pos < buffer->pos || pos + length > buffer->pos + buffer->size )
+        return NULL;
+    lsmash_sample_t *sample = lsmash_create_sample( 0 );
+    if( !sample )
+        return NULL;
+    sample->data   = buffer->data + (pos - buffer->pos);
+    sample->length = length;
+    sample->buffer = buffer;
+    lsmash_atomic_increment( &buffer->refcount );
+    return sample;
+}
+
+isom_sample_pool_t *isom_create_sample_pool( uint32_t alloc_count )
 {
     isom_sample_pool_t *pool = lsmash_malloc_zero( sizeof(isom_sample_pool_t) );
     if( !pool )
         return NULL;
-    if( size == 0 )
+    if( alloc_count == 0 )
         return pool;
-    pool->data = lsmash_malloc( size );
-    if( !pool->data )
+    pool->samples = lsmash_malloc( alloc_count * sizeof(lsmash_sample_t *) );
+    if( !pool->samples )
     {
         lsmash_free( pool );
         return NULL;
     }
-    pool->alloc = size;
+    pool->alloc_count = alloc_count;
     return pool;
 }
 
+void isom_empty_sample_pool( isom_sample_pool_t *pool )
+{
+    for( uint32_t i = 0; i < pool->entry_count; i++ )
+        lsmash_delete_sample( pool->samples[i] );
+    pool->size         = 0;
+    pool->sample_count = 0;
+    pool->entry_count  = 0;
+}
+
 void isom_remove_sample_pool( isom_sample_pool_t *pool )
 {
     if( !pool )
         return;
-    lsmash_free( pool->data );
+    isom_empty_sample_pool( pool );
+    lsmash_free( pool->samples );
     lsmash_free( pool );
 }
 
+/* Samples smaller than this are gathered into one buffer by copying so as not to write lots of tiny pieces. */
+#define ISOM_MIN_UNCOPIED_SAMPLE_SIZE 4096
+
+int isom_write_sample_pool( lsmash_bs_t *bs, isom_sample_pool_t *pool )
+{
+    if( !bs->stream )
+    {
+        /* No stream to write the data into directly. Put the data onto the buffer. */
+        for( uint32_t i = 0; i < pool->entry_count; i++ )
+            lsmash_bs_put_bytes( bs, pool->samples[i]->length, pool->samples[i]->data );
+        return 0;
+    }
+    uint64_t gathered_size = 0;
+    for( uint32_t i = 0; i < pool->entry_count; i++ )
+        if( pool->samples[i]->length < ISOM_MIN_UNCOPIED_SAMPLE_SIZE )
+            gathered_size += pool->samples[i]->length;
+    uint8_t            *gathered = gathered_size ? lsmash_malloc( gathered_size ) : NULL;
+    lsmash_io_vector_t *vec      = lsmash_malloc( LSMASH_MAX( pool->entry_count, 1 ) * sizeof(lsmash_io_vector_t) );
+    if( !vec || (gathered_size && !gathered) )
+    {
+        lsmash_free( gathered );
+        lsmash_free( vec );
+        return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    int      count     = 0;
+    int      gathering = 0;     /* whether the last vector points to the gathered data */
+    uint8_t *p         = gathered;
+    for( uint32_t i = 0; i < pool->entry_count; i++ )
+    {
+        lsmash_sample_t *sample = pool->samples[i];
+        if( sample->length >= ISOM_MIN_UNCOPIED_SAMPLE_SIZE )
+        {
+            vec[count  ].data = sample->data;
+            vec[count++].size = sample->length;
+            gathering = 0;
+            continue;
+        }
+        if( sample->length == 0 )
+            continue;
+        memcpy( p, sample->data, sample->length );
+        if( gathering )
+            vec[count - 1].size += sample->length;
+        else
+        {
+            vec[count  ].data = p;
+            vec[count++].size = sample->length;
+            gathering = 1;
+        }
+        p += sample->length;
+    }
+    int err = lsmash_bs_write_vector( bs, vec, count );
+    lsmash_free( gathered );
+    lsmash_free( vec );
+    return err;
+}
+
 static uint32_t isom_add_size( isom_stbl_t *stbl, uint32_t sample_size )
 {
     if( isom_add_stsz_entry( stbl, sample_size ) < 0 )
@@ -2924,12 +3304,12 @@ static uint32_t isom_add_size( isom_stbl_t *stbl, uint32_t sample_size )
 static uint32_t isom_add_dts( isom_stbl_t *stbl, uint64_t dts, uint64_t prev_dts )
 {
     isom_stts_t *stts = stbl->stts;
-    if( stts->list->entry_count == 0 )
+    if( stts->entry_count == 0 )
         return isom_add_stts_entry( stbl, dts ) < 0 ? 0 : dts;
     if( dts <= prev_dts )
         return 0;
     uint32_t sample_delta = dts - prev_dts;
-    isom_stts_entry_t *data = (isom_stts_entry_t *)stts->list->tail->data;
+    isom_stts_entry_t *data = &stts->entries[ stts->entry_count - 1 ];
     if( data->sample_delta == sample_delta )
         ++ data->sample_count;
     else if( isom_add_stts_entry( stbl, sample_delta ) < 0 )
@@ -2957,9 +3337,10 @@ static int isom_add_initial_sample_offset( isom_stbl_t *stbl, uint32_t sample_of
 
 static int isom_add_sample_offset( isom_stbl_t *stbl, uint32_t sample_offset )
 {
-    if( !stbl->ctts->list )
+    isom_ctts_t *ctts = stbl->ctts;
+    if( ctts->entry_count == 0 )
         return LSMASH_ERR_INVALID_DATA;
-    isom_ctts_entry_t *data = (isom_ctts_entry_t *)stbl->ctts->list->tail->data;
+    isom_ctts_entry_t *data = &ctts->entries[ ctts->entry_count - 1 ];
     if( data->sample_offset == sample_offset )
         ++ data->sample_count;
     else
@@ -3028,7 +3409,7 @@ void isom_update_cache_timestamp
 
 static int isom_add_timestamp( isom_stbl_t *stbl, isom_cache_t *cache, lsmash_file_t *file, uint64_t dts, uint64_t cts )
 {
-    if( !cache || !stbl->stts->list )
+    if( !cache || LSMASH_IS_NON_EXISTING_BOX( stbl->stts ) )
         return LSMASH_ERR_INVALID_DATA;
     int non_output_sample = (cts == LSMASH_TIMESTAMP_UNDEFINED);
     int err = isom_check_sample_offset_compatibility( file, dts, cts, non_output_sample );
@@ -3617,7 +3998,7 @@ static int isom_update_chunk_tables
     isom_chunk_t  *current
 )
 {
-    isom_stsc_entry_t *last_stsc_data = stbl->stsc->list->tail ? (isom_stsc_entry_t *)stbl->stsc->list->tail->data : NULL;
+    isom_stsc_entry_t *last_stsc_data = stbl->stsc->entry_count ? &stbl->stsc->entries[ stbl->stsc->entry_count - 1 ] : NULL;
     /* Create a new chunk sequence in this track if needed. */
     int err;
     if( (!last_stsc_data
@@ -3650,7 +4031,7 @@ static int isom_add_sample_to_chunk
      || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stsd )
      || !trak->cache
      ||  trak->mdia->mdhd->timescale == 0
-     || !trak->mdia->minf->stbl->stsc->list )
+     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stsc ) )
         return LSMASH_ERR_INVALID_DATA;
     isom_chunk_t *current = &trak->cache->chunk;
     if( !current->pool )
@@ -3697,15 +4078,38 @@ static int isom_write_pooled_samples( lsmash_file_t *file, isom_sample_pool_t *p
      || !(file->flags & LSMASH_FILE_MODE_MEDIA)
      || ((file->flags & LSMASH_FILE_MODE_BOX) && LSMASH_IS_NON_EXISTING_BOX( file->mdat )) )
         return LSMASH_ERR_INVALID_DATA;
-    lsmash_bs_put_bytes( file->bs, pool->size, pool->data );
-    int err = lsmash_bs_flush_buffer( file->bs );
+    int err = isom_write_sample_pool( file->bs, pool );
     if( err < 0 )
         return err;
     if( LSMASH_IS_EXISTING_BOX( file->mdat ) )
         file->mdat->media_size += pool->size;
     file->size += pool->size;
-    pool->sample_count = 0;
-    pool->size         = 0;
+    isom_empty_sample_pool( pool );
+    return 0;
+}
+
+/* Count a sample appended into the sample table into the bitrate statistics in the cache. */
+static int isom_update_bitrate_cache( isom_trak_t *trak, uint32_t sample_description_index, uint64_t dts, uint32_t size )
+{
+    isom_bitrate_cache_t *cache = &trak->cache->bitrate;
+    if( sample_description_index == 0 )
+        return LSMASH_ERR_INVALID_DATA;
+    if( sample_description_index > cache->entry_count )
+    {
+        isom_bitrate_t *entries = lsmash_realloc( cache->entries, sample_description_index * sizeof(isom_bitrate_t) );
+        if( !entries )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        memset( &entries[ cache->entry_count ], 0, (sample_description_index - cache->entry_count) * sizeof(isom_bitrate_t) );
+        cache->entries     = entries;
+        cache->entry_count = sample_description_index;
+    }
+    /* The duration of the last sample is determined by this sample. */
+    if( cache->sample_count )
+        cache->entries[ cache->last_index - 1 ].dts += dts - cache->last_dts;
+    isom_count_bitrate_sample( &cache->entries[ sample_description_index - 1 ], size, trak->mdia->mdhd->timescale );
+    cache->last_index = sample_description_index;
+    cache->last_dts   = dts;
+    ++ cache->sample_count;
     return 0;
 }
 
@@ -3741,6 +4145,8 @@ int isom_update_sample_tables
             /* Add a decoding timestamp and a composition timestamp. */
             if( (err = isom_add_timestamp( stbl, trak->cache, trak->file, sample_dts, sample_cts )) < 0 )
                 return err;
+            if( (err = isom_update_bitrate_cache( trak, sample->index, sample_dts, 1 )) < 0 )
+                return err;
             sample_dts += sample_duration;
             sample_cts += sample_duration;
         }
@@ -3756,6 +4162,8 @@ int isom_update_sample_tables
         /* Add a decoding timestamp and a composition timestamp. */
         if( (err = isom_add_timestamp( stbl, trak->cache, trak->file, sample->dts, sample->cts )) < 0 )
             return err;
+        if( (err = isom_update_bitrate_cache( trak, sample->index, sample->dts, sample->length )) < 0 )
+            return err;
         /* Add a sync point if needed. */
         if( (err = isom_add_sync_point( stbl, trak->cache, sample_count, &sample->prop )) < 0 )
             return err;
@@ -3782,7 +4190,7 @@ static int isom_output_cached_chunk( isom_trak_t *trak )
 {
     isom_chunk_t      *chunk          = &trak->cache->chunk;
     isom_stbl_t       *stbl           = trak->mdia->minf->stbl;
-    isom_stsc_entry_t *last_stsc_data = stbl->stsc->list->tail ? (isom_stsc_entry_t *)stbl->stsc->list->tail->data : NULL;
+    isom_stsc_entry_t *last_stsc_data = stbl->stsc->entry_count ? &stbl->stsc->entries[ stbl->stsc->entry_count - 1 ] : NULL;
     /* Create a new chunk sequence in this track if needed. */
     int err;
     if( (!last_stsc_data
@@ -3809,24 +4217,14 @@ static int isom_output_cached_chunk( isom_trak_t *trak )
 
 int isom_pool_sample( isom_sample_pool_t *pool, lsmash_sample_t *sample, uint32_t samples_per_packet )
 {
-    uint64_t pool_size = pool->size + sample->length;
-    if( pool->alloc < pool_size )
-    {
-        uint8_t *data;
-        uint64_t alloc = pool_size + (1<<16);
-        if( !pool->data )
-            data = lsmash_malloc( alloc );
-        else
-            data = lsmash_realloc( pool->data, alloc );
-        if( !data )
-            return LSMASH_ERR_MEMORY_ALLOC;
-        pool->data  = data;
-        pool->alloc = alloc;
-    }
-    memcpy( pool->data + pool->size, sample->data, sample->length );
-    pool->size          = pool_size;
+    /* Keep the sample itself until it is written instead of copying its data. */
+    lsmash_sample_t **samples = isom_reserve_table_entries( pool->samples, &pool->alloc_count, pool->entry_count, 1, sizeof(lsmash_sample_t *) );
+    if( !samples )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    pool->samples = samples;
+    pool->samples[ pool->entry_count++ ] = sample;
+    pool->size         += sample->length;
     pool->sample_count += samples_per_packet;
-    lsmash_delete_sample( sample );
     return 0;
 }
 
@@ -3847,9 +4245,9 @@ static int isom_append_sample_internal
     {
         /* The sample_description_index in the cache is one of the next written chunk.
          * Therefore, it cannot be referenced here. */
-        lsmash_entry_list_t *stsc_list      = trak->mdia->minf->stbl->stsc->list;
-        isom_stsc_entry_t   *last_stsc_data = (isom_stsc_entry_t *)stsc_list->tail->data;
-        lsmash_file_t       *file           = isom_get_written_media_file( trak, last_stsc_data->sample_description_index );
+        isom_stsc_t       *stsc           = trak->mdia->minf->stbl->stsc;
+        isom_stsc_entry_t *last_stsc_data = &stsc->entries[ stsc->entry_count - 1 ];
+        lsmash_file_t     *file           = isom_get_written_media_file( trak, last_stsc_data->sample_description_index );
         if( (ret = isom_write_pooled_samples( file, current_pool )) < 0 )
             return ret;
     }
@@ -3869,7 +4267,7 @@ static int isom_append_sample_internal
          || LSMASH_IS_NON_EXISTING_BOX( other->mdia->mdhd )
          || !other->cache
          ||  other->mdia->mdhd->timescale == 0
-         || !other->mdia->minf->stbl->stsc->list )
+         || LSMASH_IS_NON_EXISTING_BOX( other->mdia->minf->stbl->stsc ) )
             return LSMASH_ERR_INVALID_DATA;
         isom_chunk_t *chunk = &other->cache->chunk;
         if( !chunk->pool || chunk->pool->sample_count == 0 )
@@ -3911,7 +4309,7 @@ int isom_append_sample_by_type
         uint64_t cts = sample->cts;
         for( uint32_t offset = 0; offset < sample->length; offset += frame_size )
         {
-            lsmash_sample_t *lpcm_sample = lsmash_create_sample( frame_size );
+            lsmash_sample_t *lpcm_sample = lsmash_create_pooled_sample( sample_entry->root, frame_size );
             if( !lpcm_sample )
                 return LSMASH_ERR_MEMORY_ALLOC;
             memcpy( lpcm_sample->data, sample->data + offset, frame_size );
@@ -3973,6 +4371,14 @@ static int isom_append_sample
     {
         if( mdat_absent && LSMASH_IS_BOX_ADDITION_FAILURE( isom_add_mdat( file ) ) )
             return LSMASH_ERR_NAMELESS;
+        if( file->reserved_movie_size )
+        {
+            /* Write the region reserved for the Movie Box as a Free Space Box before the Media Data Box. */
+            file->reserved_movie_pos = file->bs->offset;
+            if( (err = isom_write_free_space( file->bs, file->reserved_movie_size )) < 0 )
+                return err;
+            file->size += file->reserved_movie_size;
+        }
         file->mdat->manager |= LSMASH_PLACEHOLDER;
         if( (err = isom_write_box( file->bs, (isom_box_t *)file->mdat )) < 0 )
             return err;
@@ -4047,7 +4453,7 @@ int lsmash_flush_pooled_samples( lsmash_root_t *root, uint32_t track_ID, uint32_
     isom_trak_t *trak = isom_get_trak( file, track_ID );
     if( LSMASH_IS_NON_EXISTING_BOX( trak )
      || !trak->cache
-     || !trak->mdia->minf->stbl->stsc->list )
+     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stsc ) )
         return LSMASH_ERR_NAMELESS;
     int err = isom_output_cache( trak );
     if( err < 0 )
@@ -4088,7 +4494,7 @@ int lsmash_append_sample( lsmash_root_t *root, uint32_t track_ID, lsmash_sample_
      || LSMASH_IS_NON_EXISTING_BOX( trak->tkhd )
      ||  trak->mdia->mdhd->timescale == 0
      || !trak->cache
-     || !trak->mdia->minf->stbl->stsc->list )
+     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stsc ) )
         return LSMASH_ERR_NAMELESS;
     isom_sample_entry_t *sample_entry = (isom_sample_entry_t *)lsmash_list_get_entry_data( &trak->mdia->minf->stbl->stsd->list, sample->index );
     if( LSMASH_IS_NON_EXISTING_BOX( sample_entry ) )
@@ -4218,3 +4624,265 @@ int lsmash_set_copyright( lsmash_root_t *root, uint32_t track_ID, uint16_t ISO_l
     cprt->notice        = lsmash_memdup( notice, cprt->notice_length );
     return 0;
 }
+
+/*---- in-place rewriting ----*/
+
+/* Rebuild the tables of timestamps of a track from its media timeline. */
+static int isom_rebuild_timestamp_tables( lsmash_root_t *root, isom_trak_t *trak )
+{
+    lsmash_file_t *file     = trak->file;
+    isom_stbl_t   *stbl     = trak->mdia->minf->stbl;
+    uint32_t       track_ID = trak->tkhd->track_ID;
+    if( LSMASH_IS_NON_EXISTING_BOX( trak->mdia->mdhd )
+     || LSMASH_IS_NON_EXISTING_BOX( stbl->stts )
+     || !trak->cache )
+        return LSMASH_ERR_INVALID_DATA;
+    uint32_t last_sample_delta;
+    uint32_t ctd_shift;
+    int err;
+    if( (err = lsmash_get_last_sample_delta_from_media_timeline( root, track_ID, &last_sample_delta )) < 0
+     || (err = lsmash_get_composition_to_decode_shift_from_media_timeline( root, track_ID, &ctd_shift )) < 0 )
+        return err;
+    lsmash_media_ts_list_t ts_list;
+    if( (err = lsmash_get_media_timestamps( root, track_ID, &ts_list )) < 0 )
+        return err;
+    lsmash_media_ts_t *ts           = ts_list.timestamp;
+    uint32_t           sample_count = ts_list.sample_count;
+    if( sample_count == 0 || sample_count != isom_get_sample_count( trak ) )
+    {
+        err = LSMASH_ERR_INVALID_DATA;
+        goto fail;
+    }
+    /* Timestamps got from the media timeline include the composition to decode timeline shift. */
+    int need_ctts = 0;
+    int negative  = 0;
+    for( uint32_t i = 0; i < sample_count; i++ )
+    {
+        int non_output_sample = (ts[i].cts == LSMASH_TIMESTAMP_UNDEFINED);
+        if( !non_output_sample )
+            ts[i].cts -= ctd_shift;
+        if( (err = isom_check_sample_offset_compatibility( file, ts[i].dts, ts[i].cts, non_output_sample )) < 0 )
+            goto fail;
+        if( i + 1 < sample_count && ts[i + 1].dts - ts[i].dts > UINT32_MAX )
+        {
+            err = LSMASH_ERR_INVALID_DATA;
+            goto fail;
+        }
+        need_ctts |= (ts[i].cts != ts[i].dts);
+        negative  |= (non_output_sample || ts[i].cts < ts[i].dts);
+    }
+    /* Replace the tables. */
+    isom_stts_t *stts = stbl->stts;
+    stts->entry_count = 0;
+    isom_remove_box_by_itself( stbl->ctts );
+    if( need_ctts )
+    {
+        if( LSMASH_IS_BOX_ADDITION_FAILURE( isom_add_ctts( stbl ) ) )
+        {
+            err = LSMASH_ERR_NAMELESS;
+            goto fail;
+        }
+        /* Place the new box right after the Decoding Time to Sample Box as written by the muxer. */
+        if( file->flags & LSMASH_FILE_MODE_READ )
+            isom_reorder_tail_box( (isom_box_t *)stbl );
+        if( negative && !file->qt_compatible )
+            stbl->ctts->version = 1;
+    }
+    else
+        isom_remove_box_by_itself( stbl->cslg );
+    isom_ctts_t *ctts = stbl->ctts;
+    for( uint32_t i = 0; i < sample_count; i++ )
+    {
+        uint32_t sample_delta = i + 1 < sample_count ? ts[i + 1].dts - ts[i].dts : last_sample_delta;
+        if( stts->entry_count && stts->entries[ stts->entry_count - 1 ].sample_delta == sample_delta )
+            ++ stts->entries[ stts->entry_count - 1 ].sample_count;
+        else if( (err = isom_add_stts_entry( stbl, sample_delta )) < 0 )
+            goto fail;
+        if( !need_ctts )
+            continue;
+        uint32_t sample_offset = ts[i].cts != LSMASH_TIMESTAMP_UNDEFINED ? ts[i].cts - ts[i].dts : ISOM_NON_OUTPUT_SAMPLE_OFFSET;
+        if( ctts->entry_count && ctts->entries[ ctts->entry_count - 1 ].sample_offset == sample_offset )
+            ++ ctts->entries[ ctts->entry_count - 1 ].sample_count;
+        else if( (err = isom_add_ctts_entry( stbl, 1, sample_offset )) < 0 )
+            goto fail;
+    }
+    lsmash_delete_media_timestamps( &ts_list );
+    trak->cache->timestamp.ctd_shift = ctd_shift;
+    if( (err = isom_update_mdhd_duration( trak, last_sample_delta )) < 0
+     || (err = isom_update_tkhd_duration( trak )) < 0 )
+        return err;
+    /* The peak bitrates depend on the timestamps. */
+    return isom_update_bitrate_description( trak->mdia );
+fail:
+    lsmash_delete_media_timestamps( &ts_list );
+    return err;
+}
+
+/* Get the space which the Movie Box can occupy without moving any other box, that is, the Movie Box itself and
+ * the Free Space Boxes following it, by scanning the top level boxes.
+ * If the space lasts up to the end of the file, it is unlimited and 'space' is set to UINT64_MAX. */
+static int isom_get_movie_space( lsmash_bs_t *bs, uint64_t moov_pos, uint64_t *space, uint64_t *file_size, int *appendable )
+{
+    int64_t end = bs->seek( bs->stream, 0, SEEK_END );
+    if( end < 0 )
+        return (int)end;
+    *space      = 0;
+    *file_size  = end;
+    *appendable = 1;
+    int      in_space = 0;
+    uint64_t pos      = 0;
+    while( pos < *file_size )
+    {
+        uint8_t header[ISOM_BASEBOX_COMMON_SIZE + 8];
+        if( bs->seek( bs->stream, pos, SEEK_SET ) != (int64_t)pos )
+            return LSMASH_ERR_NAMELESS;
+        int read_size = bs->read( bs->stream, header, LSMASH_MIN( sizeof(header), *file_size - pos ) );
+        if( read_size < ISOM_BASEBOX_COMMON_SIZE )
+            return read_size < 0 ? read_size : LSMASH_ERR_INVALID_DATA;
+        uint64_t size   = LSMASH_GET_BE32( &header[0] );
+        uint32_t fourcc = LSMASH_GET_BE32( &header[4] );
+        if( size == 1 )
+        {
+            if( read_size < ISOM_BASEBOX_COMMON_SIZE + 8 )
+                return LSMASH_ERR_INVALID_DATA;
+            size = LSMASH_GET_BE64( &header[8] );
+        }
+        else if( size == 0 )
+        {
+            /* This box extends to the end of the file, so nothing can be appended after it. */
+            size = *file_size - pos;
+            if( pos != moov_pos
+             && fourcc != ISOM_BOX_TYPE_FREE.fourcc
+             && fourcc != ISOM_BOX_TYPE_SKIP.fourcc )
+                *appendable = 0;
+        }
+        if( size < ISOM_BASEBOX_COMMON_SIZE || size > *file_size - pos )
+            return LSMASH_ERR_INVALID_DATA;
+        if( pos == moov_pos )
+        {
+            if( fourcc != ISOM_BOX_TYPE_MOOV.fourcc )
+                return LSMASH_ERR_INVALID_DATA;
+            in_space = 1;
+        }
+        else if( in_space
+              && fourcc != ISOM_BOX_TYPE_FREE.fourcc
+              && fourcc != ISOM_BOX_TYPE_SKIP.fourcc )
+            in_space = 0;
+        if( in_space )
+            *space += size;
+        pos += size;
+    }
+    if( *space == 0 )
+        return LSMASH_ERR_INVALID_DATA; /* The Movie Box is not found at the position. */
+    if( in_space )
+        *space = UINT64_MAX;
+    return 0;
+}
+
+int lsmash_rewrite_movie( lsmash_root_t *root )
+{
+    if( isom_check_initializer_present( root ) < 0 )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    lsmash_file_t *file    = root->file;
+    isom_moov_t   *moov    = file->moov;
+    lsmash_bs_t   *file_bs = file->bs;
+    if( !(file->flags & LSMASH_FILE_MODE_READ)
+     || LSMASH_IS_NON_EXISTING_BOX( moov )
+     || !file_bs
+     || file_bs->unseekable
+     || !file_bs->read
+     || !file_bs->write )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    if( LSMASH_IS_EXISTING_BOX( moov->mvex ) )
+        return LSMASH_ERR_PATCH_WELCOME;    /* Rewriting movie fragments is not supported. */
+    /* Rebuild the sample tables of the retimed tracks. */
+    int err;
+    for( lsmash_entry_t *entry = moov->trak_list.head; entry; entry = entry->next )
+    {
+        isom_trak_t *trak = (isom_trak_t *)entry->data;
+        if( LSMASH_IS_NON_EXISTING_BOX( trak )
+         || LSMASH_IS_NON_EXISTING_BOX( trak->tkhd ) )
+            return LSMASH_ERR_INVALID_DATA;
+        if( isom_timeline_check_retimed( isom_get_timeline( root, trak->tkhd->track_ID ) )
+         && (err = isom_rebuild_timestamp_tables( root, trak )) < 0 )
+            return err;
+    }
+    /* Make the new Movie Box on the memory before touching the file. */
+    if( isom_update_box_size( moov ) == 0 )
+        return LSMASH_ERR_INVALID_DATA;
+    lsmash_bs_t *bs = lsmash_bs_create();
+    if( !bs )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    if( (err = isom_write_box( bs, (isom_box_t *)moov )) < 0 )
+        goto fail;
+    uint64_t moov_size = lsmash_bs_get_valid_data_size( bs );
+    /* Decide where the new Movie Box is placed.
+     * A Free Space Box fills the rest of the space if the new Movie Box fits in the space of the old one.
+     * The header of the Free Space Box is enough since its payload is ignored by any reader. */
+    uint64_t space      = 0;
+    uint64_t file_size  = 0;
+    int      appendable = 0;
+    if( (err = isom_get_movie_space( file_bs, moov->pos, &space, &file_size, &appendable )) < 0 )
+        goto fail;
+    uint64_t free_size = 0;
+    if( space == UINT64_MAX )
+        free_size = moov->pos + moov_size < file_size ? file_size - (moov->pos + moov_size) : 0;
+    else if( moov_size <= space )
+        free_size = space - moov_size;
+    int in_place = (space == UINT64_MAX || moov_size <= space)
+                && (free_size == 0
+                 || (free_size >= ISOM_BASEBOX_COMMON_SIZE && free_size <= UINT32_MAX)
+                 || free_size >= ISOM_BASEBOX_COMMON_SIZE + 8);
+    uint64_t free_padding = 0;
+    if( space == UINT64_MAX && !in_place )
+    {
+        /* The space lasts up to the end of the file, so extend the Free Space Box beyond there.
+         * Its payload is written as zeros so that the box does not claim any byte past the end of the file. */
+        free_padding = free_size;
+        free_size   += ISOM_BASEBOX_COMMON_SIZE;
+        in_place     = 1;
+    }
+    if( !in_place && !appendable )
+    {
+        err = LSMASH_ERR_PATCH_WELCOME;
+        goto fail;
+    }
+    if( in_place && free_size )
+    {
+        if( free_size <= UINT32_MAX )
+            lsmash_bs_put_be32( bs, free_size );
+        else
+            lsmash_bs_put_be32( bs, 1 );
+        lsmash_bs_put_be32( bs, ISOM_BOX_TYPE_FREE.fourcc );
+        if( free_size > UINT32_MAX )
+            lsmash_bs_put_be64( bs, free_size );
+        for( uint64_t i = 0; i < free_padding; i++ )
+            lsmash_bs_put_byte( bs, 0 );
+    }
+    /* Write the new Movie Box through the stream of the file. */
+    uint64_t old_moov_pos = moov->pos;
+    uint64_t new_moov_pos = in_place ? old_moov_pos : file_size;
+    bs->stream     = file_bs->stream;
+    bs->write      = file_bs->write;
+    bs->seek       = file_bs->seek;
+    bs->unseekable = 0;
+    if( (err = lsmash_bs_write_seek( bs, new_moov_pos, SEEK_SET )) < 0
+     || (err = lsmash_bs_flush_buffer( bs )) < 0 )
+        goto fail;
+    if( !in_place )
+    {
+        /* Turn the old Movie Box into a Free Space Box after writing the new one. */
+        lsmash_bs_put_be32( bs, ISOM_BOX_TYPE_FREE.fourcc );
+        if( (err = lsmash_bs_write_seek( bs, old_moov_pos + 4, SEEK_SET )) < 0
+         || (err = lsmash_bs_flush_buffer( bs )) < 0 )
+            goto fail;
+    }
+    moov->pos = new_moov_pos;
+    err = 0;
+fail:
+    /* Restore the position of the stream for reading. */
+    if( !file_bs->mapped && file_bs->seek( file_bs->stream, file_bs->offset, SEEK_SET ) < 0 && err == 0 )
+        err = LSMASH_ERR_NAMELESS;
+    lsmash_bs_cleanup( bs );
+    return err;
+}
@@ -0,0 +1,261 @@
+/*****************************************************************************
+ * prefetch.c
+ *****************************************************************************
+ * Copyright (C) 2017 L-SMASH project
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include "common/internal.h" /* must be placed first */
+
+#include "box.h"
+#include "timeline.h"
+
+typedef struct
+{
+    uint32_t          track_ID;
+    uint32_t          timescale;
+    uint32_t          next_sample_number;   /* sample number of the next sample to be fetched */
+    double            next_dts;             /* DTS of the next sample to be fetched in seconds */
+    int               status;               /* 0: fetching, 1: reached the end of the media timeline, negative: error */
+    uint32_t          head;                 /* index of the oldest sample in the queue */
+    uint32_t          count;                /* number of queued samples */
+    lsmash_sample_t **queue;                /* ring buffer of fetched samples */
+} isom_prefetch_track_t;
+
+static const lsmash_class_t lsmash_prefetcher_class =
+{
+    "prefetcher"
+};
+
+struct lsmash_prefetcher_tag
+{
+    const lsmash_class_t  *class;
+    lsmash_root_t         *root;
+    uint32_t               queue_length;    /* maximum number of queued samples per track */
+    uint32_t               track_count;
+    isom_prefetch_track_t *track;
+    lsmash_thread_t       *thread;
+    lsmash_mutex_t        *mutex;
+    lsmash_cond_t         *fetched;         /* signaled when a sample is queued or a track stops being fetched */
+    lsmash_cond_t         *consumed;        /* signaled when a sample is dequeued or the worker is requested to stop */
+    int                    stop;
+};
+
+static isom_prefetch_track_t *isom_get_prefetch_track( lsmash_prefetcher_t *prefetcher, uint32_t track_ID )
+{
+    for( uint32_t i = 0; i < prefetcher->track_count; i++ )
+        if( prefetcher->track[i].track_ID == track_ID )
+            return &prefetcher->track[i];
+    return NULL;
+}
+
+/* Pick the track whose next sample is the earliest in decoding order among tracks with room in their queues.
+ * Fetching in DTS order across tracks keeps every queue fed whatever order the consumer takes samples in. */
+static isom_prefetch_track_t *isom_select_prefetch_track( lsmash_prefetcher_t *prefetcher, int *finished )
+{
+    isom_prefetch_track_t *target = NULL;
+    *finished = 1;
+    for( uint32_t i = 0; i < prefetcher->track_count; i++ )
+    {
+        isom_prefetch_track_t *track = &prefetcher->track[i];
+        if( track->status )
+            continue;
+        *finished = 0;
+        if( track->count < prefetcher->queue_length
+         && (!target || track->next_dts < target->next_dts) )
+            target = track;
+    }
+    return target;
+}
+
+static void *isom_prefetcher_main( void *arg )
+{
+    lsmash_prefetcher_t *prefetcher = (lsmash_prefetcher_t *)arg;
+    lsmash_root_t       *root       = prefetcher->root;
+    lsmash_mutex_lock( prefetcher->mutex );
+    while( !prefetcher->stop )
+    {
+        int finished;
+        isom_prefetch_track_t *track = isom_select_prefetch_track( prefetcher, &finished );
+        if( finished )
+            break;
+        if( !track )
+        {
+            lsmash_cond_wait( prefetcher->consumed, prefetcher->mutex );
+            continue;
+        }
+        /* Only this thread updates the fetching state of tracks, so it can be read without the lock. */
+        uint32_t track_ID      = track->track_ID;
+        uint32_t sample_number = track->next_sample_number;
+        lsmash_mutex_unlock( prefetcher->mutex );
+        int status = 0;
+        lsmash_sample_t *sample = lsmash_get_sample_from_media_timeline( root, track_ID, sample_number );
+        if( !sample )
+        {
+            /* Distinguish the end of the media timeline from failures in the same way as the remuxer. */
+            lsmash_sample_t info;
+            int ret = lsmash_get_sample_info_from_media_timeline( root, track_ID, sample_number, &info );
+            if( ret == 0 || lsmash_check_sample_existence_in_media_timeline( root, track_ID, sample_number ) )
+                status = LSMASH_ERR_NAMELESS;
+            else if( ret != LSMASH_ERR_NAMELESS )
+                status = ret;   /* failed to walk the movie fragments */
+            else
+                status = 1;
+        }
+        uint64_t next_dts;
+        int got_next_dts = sample && lsmash_get_dts_from_media_timeline( root, track_ID, sample_number + 1, &next_dts ) == 0;
+        lsmash_mutex_lock( prefetcher->mutex );
+        if( sample )
+        {
+            track->queue[ (track->head + track->count) % prefetcher->queue_length ] = sample;
+            ++ track->count;
+            ++ track->next_sample_number;
+            if( got_next_dts )
+                track->next_dts = (double)next_dts / track->timescale;
+        }
+        else
+            track->status = status;
+        lsmash_cond_broadcast( prefetcher->fetched );
+    }
+    /* Tracks still being fetched are never fed anymore. */
+    for( uint32_t i = 0; i < prefetcher->track_count; i++ )
+        if( prefetcher->track[i].status == 0 )
+            prefetcher->track[i].status = LSMASH_ERR_NAMELESS;
+    lsmash_cond_broadcast( prefetcher->fetched );
+    lsmash_mutex_unlock( prefetcher->mutex );
+    return NULL;
+}
+
+lsmash_prefetcher_t *lsmash_create_prefetcher( lsmash_root_t *root, uint32_t queue_length )
+{
+    if( isom_check_initializer_present( root ) < 0 || queue_length == 0 )
+        return NULL;
+    lsmash_prefetcher_t *prefetcher = lsmash_malloc_zero( sizeof(lsmash_prefetcher_t) );
+    if( !prefetcher )
+        return NULL;
+    prefetcher->class        = &lsmash_prefetcher_class;
+    prefetcher->root         = root;
+    prefetcher->queue_length = queue_length;
+    prefetcher->mutex        = lsmash_mutex_create();
+    prefetcher->fetched      = lsmash_cond_create();
+    prefetcher->consumed     = lsmash_cond_create();
+    if( !prefetcher->mutex || !prefetcher->fetched || !prefetcher->consumed )
+    {
+        lsmash_destroy_prefetcher( prefetcher );
+        return NULL;
+    }
+    return prefetcher;
+}
+
+int lsmash_add_prefetch_track( lsmash_prefetcher_t *prefetcher, uint32_t track_ID, uint32_t start_sample_number )
+{
+    if( !prefetcher || prefetcher->thread || start_sample_number == 0 )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    if( isom_get_prefetch_track( prefetcher, track_ID ) )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    isom_timeline_t *timeline  = isom_get_timeline( prefetcher->root, track_ID );
+    uint32_t         timescale = isom_timeline_get_media_timescale( timeline );
+    if( timescale == 0 )
+        return LSMASH_ERR_NAMELESS;
+    /* The timeline of a file read lazily is completed here since it is never extended while the worker runs. */
+    int err = isom_timeline_complete( timeline );
+    if( err < 0 )
+        return err;
+    lsmash_sample_t **queue = lsmash_malloc( prefetcher->queue_length * sizeof(lsmash_sample_t *) );
+    if( !queue )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    isom_prefetch_track_t *track = lsmash_realloc( prefetcher->track, (prefetcher->track_count + 1) * sizeof(isom_prefetch_track_t) );
+    if( !track )
+    {
+        lsmash_free( queue );
+        return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    prefetcher->track = track;
+    track = &prefetcher->track[ prefetcher->track_count++ ];
+    uint64_t dts;
+    if( lsmash_get_dts_from_media_timeline( prefetcher->root, track_ID, start_sample_number, &dts ) < 0 )
+        dts = 0;    /* The worker finds out that there is no sample to fetch. */
+    track->track_ID           = track_ID;
+    track->timescale          = timescale;
+    track->next_sample_number = start_sample_number;
+    track->next_dts           = (double)dts / timescale;
+    track->status             = 0;
+    track->head               = 0;
+    track->count              = 0;
+    track->queue              = queue;
+    return 0;
+}
+
+int lsmash_start_prefetcher( lsmash_prefetcher_t *prefetcher )
+{
+    if( !prefetcher || prefetcher->thread )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    prefetcher->thread = lsmash_thread_create( isom_prefetcher_main, prefetcher );
+    return prefetcher->thread ? 0 : LSMASH_ERR_NAMELESS;
+}
+
+int lsmash_get_prefetched_sample( lsmash_prefetcher_t *prefetcher, uint32_t track_ID, lsmash_sample_t **sample )
+{
+    if( !prefetcher || !prefetcher->thread || !sample )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    isom_prefetch_track_t *track = isom_get_prefetch_track( prefetcher, track_ID );
+    if( !track )
+        return LSMASH_ERR_NAMELESS;
+    int ret = 0;
+    lsmash_mutex_lock( prefetcher->mutex );
+    while( track->count == 0 && track->status == 0 )
+        lsmash_cond_wait( prefetcher->fetched, prefetcher->mutex );
+    if( track->count )
+    {
+        *sample = track->queue[ track->head ];
+        track->head = (track->head + 1) % prefetcher->queue_length;
+        --track->count;
+        lsmash_cond_signal( prefetcher->consumed );
+    }
+    else
+    {
+        *sample = NULL;
+        ret = track->status < 0 ? track->status : 0;
+    }
+    lsmash_mutex_unlock( prefetcher->mutex );
+    return ret;
+}
+
+void lsmash_destroy_prefetcher( lsmash_prefetcher_t *prefetcher )
+{
+    if( !prefetcher )
+        return;
+    if( prefetcher->thread )
+    {
+        lsmash_mutex_lock( prefetcher->mutex );
+        prefetcher->stop = 1;
+        lsmash_cond_signal( prefetcher->consumed );
+        lsmash_mutex_unlock( prefetcher->mutex );
+        lsmash_thread_join( prefetcher->thread );
+    }
+    for( uint32_t i = 0; i < prefetcher->track_count; i++ )
+    {
+        isom_prefetch_track_t *track = &prefetcher->track[i];
+        for( uint32_t j = 0; j < track->count; j++ )
+            lsmash_delete_sample( track->queue[ (track->head + j) % prefetcher->queue_length ] );
+        lsmash_free( track->queue );
+    }
+    lsmash_free( prefetcher->track );
+    lsmash_cond_destroy( prefetcher->consumed );
+    lsmash_cond_destroy( prefetcher->fetched );
+    lsmash_mutex_destroy( prefetcher->mutex );
+    lsmash_free( prefetcher );
+}
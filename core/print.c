@@ -1376,17 +1376,14 @@ static int isom_print_sample_description_extesion( FILE *fp, lsmash_file_t *file
 
 static int isom_print_stts( FILE *fp, lsmash_file_t *file, isom_box_t *box, int level )
 {
-    if( !((isom_stts_t *)box)->list )
-        return LSMASH_ERR_INVALID_DATA;
     isom_stts_t *stts = (isom_stts_t *)box;
     int indent = level;
-    uint32_t i = 0;
     isom_print_box_common( fp, indent++, box, "Decoding Time to Sample Box" );
-    lsmash_ifprintf( fp, indent, "entry_count = %"PRIu32"\n", stts->list->entry_count );
-    for( lsmash_entry_t *entry = stts->list->head; entry; entry = entry->next )
+    lsmash_ifprintf( fp, indent, "entry_count = %"PRIu32"\n", stts->entry_count );
+    for( uint32_t i = 0; i < stts->entry_count; i++ )
     {
-        isom_stts_entry_t *data = (isom_stts_entry_t *)entry->data;
-        lsmash_ifprintf( fp, indent++, "entry[%"PRIu32"]\n", i++ );
+        isom_stts_entry_t *data = &stts->entries[i];
+        lsmash_ifprintf( fp, indent++, "entry[%"PRIu32"]\n", i );
         lsmash_ifprintf( fp, indent, "sample_count = %"PRIu32"\n", data->sample_count );
         lsmash_ifprintf( fp, indent--, "sample_delta = %"PRIu32"\n", data->sample_delta );
     }
@@ -1395,18 +1392,15 @@ static int isom_print_stts( FILE *fp, lsmash_file_t *file, isom_box_t *box, int
 
 static int isom_print_ctts( FILE *fp, lsmash_file_t *file, isom_box_t *box, int level )
 {
-    if( !((isom_ctts_t *)box)->list )
-        return LSMASH_ERR_INVALID_DATA;
     isom_ctts_t *ctts = (isom_ctts_t *)box;
     int indent = level;
-    uint32_t i = 0;
     isom_print_box_common( fp, indent++, box, "Composition Time to Sample Box" );
-    lsmash_ifprintf( fp, indent, "entry_count = %"PRIu32"\n", ctts->list->entry_count );
+    lsmash_ifprintf( fp, indent, "entry_count = %"PRIu32"\n", ctts->entry_count );
     if( file->qt_compatible || ctts->version == 1 )
-        for( lsmash_entry_t *entry = ctts->list->head; entry; entry = entry->next )
+        for( uint32_t i = 0; i < ctts->entry_count; i++ )
         {
-            isom_ctts_entry_t *data = (isom_ctts_entry_t *)entry->data;
-            lsmash_ifprintf( fp, indent++, "entry[%"PRIu32"]\n", i++ );
+            isom_ctts_entry_t *data = &ctts->entries[i];
+            lsmash_ifprintf( fp, indent++, "entry[%"PRIu32"]\n", i );
             lsmash_ifprintf( fp, indent, "sample_count = %"PRIu32"\n", data->sample_count );
             if( data->sample_offset != ISOM_NON_OUTPUT_SAMPLE_OFFSET )
                 lsmash_ifprintf( fp, indent--, "sample_offset = %"PRId32"\n", (union {uint32_t ui; int32_t si;}){ data->sample_offset }.si );
@@ -1414,10 +1408,10 @@ static int isom_print_ctts( FILE *fp, lsmash_file_t *file, isom_box_t *box, int
                 lsmash_ifprintf( fp, indent--, "sample_offset = -2^31 (non-output sample)\n" );
         }
     else
-        for( lsmash_entry_t *entry = ctts->list->head; entry; entry = entry->next )
+        for( uint32_t i = 0; i < ctts->entry_count; i++ )
         {
-            isom_ctts_entry_t *data = (isom_ctts_entry_t *)entry->data;
-            lsmash_ifprintf( fp, indent++, "entry[%"PRIu32"]\n", i++ );
+            isom_ctts_entry_t *data = &ctts->entries[i];
+            lsmash_ifprintf( fp, indent++, "entry[%"PRIu32"]\n", i );
             lsmash_ifprintf( fp, indent, "sample_count = %"PRIu32"\n", data->sample_count );
             lsmash_ifprintf( fp, indent--, "sample_offset = %"PRIu32"\n", data->sample_offset );
         }
@@ -1524,17 +1518,14 @@ static int isom_print_sdtp( FILE *fp, lsmash_file_t *file, isom_box_t *box, int
 
 static int isom_print_stsc( FILE *fp, lsmash_file_t *file, isom_box_t *box, int level )
 {
-    if( !((isom_stsc_t *)box)->list )
-        return LSMASH_ERR_INVALID_DATA;
     isom_stsc_t *stsc = (isom_stsc_t *)box;
     int indent = level;
-    uint32_t i = 0;
     isom_print_box_common( fp, indent++, box, "Sample To Chunk Box" );
-    lsmash_ifprintf( fp, indent, "entry_count = %"PRIu32"\n", stsc->list->entry_count );
-    for( lsmash_entry_t *entry = stsc->list->head; entry; entry = entry->next )
+    lsmash_ifprintf( fp, indent, "entry_count = %"PRIu32"\n", stsc->entry_count );
+    for( uint32_t i = 0; i < stsc->entry_count; i++ )
     {
-        isom_stsc_entry_t *data = (isom_stsc_entry_t *)entry->data;
-        lsmash_ifprintf( fp, indent++, "entry[%"PRIu32"]\n", i++ );
+        isom_stsc_entry_t *data = &stsc->entries[i];
+        lsmash_ifprintf( fp, indent++, "entry[%"PRIu32"]\n", i );
         lsmash_ifprintf( fp, indent, "first_chunk = %"PRIu32"\n", data->first_chunk );
         lsmash_ifprintf( fp, indent, "samples_per_chunk = %"PRIu32"\n", data->samples_per_chunk );
         lsmash_ifprintf( fp, indent--, "sample_description_index = %"PRIu32"\n", data->sample_description_index );
@@ -1546,19 +1537,15 @@ static int isom_print_stsz( FILE *fp, lsmash_file_t *file, isom_box_t *box, int
 {
     isom_stsz_t *stsz = (isom_stsz_t *)box;
     int indent = level;
-    uint32_t i = 0;
     isom_print_box_common( fp, indent++, box, "Sample Size Box" );
     if( !stsz->sample_size )
         lsmash_ifprintf( fp, indent, "sample_size = 0 (variable)\n" );
     else
         lsmash_ifprintf( fp, indent, "sample_size = %"PRIu32" (constant)\n", stsz->sample_size );
     lsmash_ifprintf( fp, indent, "sample_count = %"PRIu32"\n", stsz->sample_count );
-    if( !stsz->sample_size && stsz->list )
-        for( lsmash_entry_t *entry = stsz->list->head; entry; entry = entry->next )
-        {
-            isom_stsz_entry_t *data = (isom_stsz_entry_t *)entry->data;
-            lsmash_ifprintf( fp, indent, "entry_size[%"PRIu32"] = %"PRIu32"\n", i++, data->entry_size );
-        }
+    if( !stsz->sample_size )
+        for( uint32_t i = 0; i < stsz->entry_count; i++ )
+            lsmash_ifprintf( fp, indent, "entry_size[%"PRIu32"] = %"PRIu32"\n", i, stsz->entries[i].entry_size );
     return 0;
 }
 
@@ -1566,37 +1553,30 @@ static int isom_print_stz2( FILE *fp, lsmash_file_t *file, isom_box_t *box, int
 {
     isom_stz2_t *stz2 = (isom_stz2_t *)box;
     int indent = level;
-    uint32_t i = 0;
     isom_print_box_common( fp, indent++, box, "Compact Sample Size Box" );
     lsmash_ifprintf( fp, indent, "reserved = 0x%06"PRIx32"\n", stz2->reserved );
     lsmash_ifprintf( fp, indent, "field_size = %"PRIu8"\n", stz2->field_size );
     lsmash_ifprintf( fp, indent, "sample_count = %"PRIu32"\n", stz2->sample_count );
-    for( lsmash_entry_t *entry = stz2->list->head; entry; entry = entry->next )
-    {
-        isom_stsz_entry_t *data = (isom_stsz_entry_t *)entry->data;
-        lsmash_ifprintf( fp, indent, "entry_size[%"PRIu32"] = %"PRIu32"\n", i++, data->entry_size );
-    }
+    for( uint32_t i = 0; i < stz2->entry_count; i++ )
+        lsmash_ifprintf( fp, indent, "entry_size[%"PRIu32"] = %"PRIu32"\n", i, stz2->entries[i].entry_size );
     return 0;
 }
 
 static int isom_print_stco( FILE *fp, lsmash_file_t *file, isom_box_t *box, int level )
 {
-    if( !((isom_stco_t *)box)->list )
-        return LSMASH_ERR_INVALID_DATA;
     isom_stco_t *stco = (isom_stco_t *)box;
     int indent = level;
-    uint32_t i = 0;
     isom_print_box_common( fp, indent++, box, "Chunk Offset Box" );
-    lsmash_ifprintf( fp, indent, "entry_count = %"PRIu32"\n", stco->list->entry_count );
-    if( lsmash_check_box_type_identical( stco->type, ISOM_BOX_TYPE_STCO ) )
+    lsmash_ifprintf( fp, indent, "entry_count = %"PRIu32"\n", stco->entry_count );
+    if( !stco->large_presentation )
     {
-        for( lsmash_entry_t *entry = stco->list->head; entry; entry = entry->next )
-            lsmash_ifprintf( fp, indent, "chunk_offset[%"PRIu32"] = %"PRIu32"\n", i++, ((isom_stco_entry_t *)entry->data)->chunk_offset );
+        for( uint32_t i = 0; i < stco->entry_count; i++ )
+            lsmash_ifprintf( fp, indent, "chunk_offset[%"PRIu32"] = %"PRIu32"\n", i, stco->entries.stco[i].chunk_offset );
     }
     else
     {
-        for( lsmash_entry_t *entry = stco->list->head; entry; entry = entry->next )
-            lsmash_ifprintf( fp, indent, "chunk_offset[%"PRIu32"] = %"PRIu64"\n", i++, ((isom_co64_entry_t *)entry->data)->chunk_offset );
+        for( uint32_t i = 0; i < stco->entry_count; i++ )
+            lsmash_ifprintf( fp, indent, "chunk_offset[%"PRIu32"] = %"PRIu64"\n", i, stco->entries.co64[i].chunk_offset );
     }
     return 0;
 }
@@ -2575,8 +2555,9 @@ static isom_print_box_t isom_select_print_func( isom_box_t *box )
 static inline void isom_print_remove_plastic_box( isom_box_t *box )
 {
     if( box->manager & LSMASH_ABSENT_IN_FILE )
-        /* free flagged box */
-        isom_remove_box_by_itself( box );
+        /* free flagged box
+         * Such a box is never listed in its parent, so don't search the parent, which may have numerous children. */
+        isom_remove_extension_box( box );
 }
 
 int isom_add_print_func( lsmash_file_t *file, void *box, int level )
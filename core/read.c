@@ -1046,6 +1046,7 @@ static int isom_read_visual_description( lsmash_file_t *file, isom_box_t *box, i
     box->parent   = parent;
     box->manager |= LSMASH_VIDEO_DESCRIPTION;
     isom_box_common_copy( visual, box );
+    isom_set_box_writer( (isom_box_t *)visual );
     if( (ret = isom_add_print_func( file, visual, level )) < 0 )
         return ret;
     return isom_read_children( file, box, visual, level );
@@ -1293,6 +1294,7 @@ static int isom_read_audio_description( lsmash_file_t *file, isom_box_t *box, is
     box->parent   = parent;
     box->manager |= LSMASH_AUDIO_DESCRIPTION;
     isom_box_common_copy( audio, box );
+    isom_set_box_writer( (isom_box_t *)audio );
     int ret = isom_add_print_func( file, audio, level );
     if( ret < 0 )
         return ret;
@@ -1411,6 +1413,7 @@ static int isom_read_qt_text_description( lsmash_file_t *file, isom_box_t *box,
     }
     box->parent = parent;
     isom_box_common_copy( text, box );
+    isom_set_box_writer( (isom_box_t *)text );
     int ret = isom_add_print_func( file, text, level );
     if( ret < 0 )
         return ret;
@@ -1446,6 +1449,7 @@ static int isom_read_tx3g_description( lsmash_file_t *file, isom_box_t *box, iso
         tx3g->text_color_rgba[i]       = lsmash_bs_get_byte( bs );
     box->parent = parent;
     isom_box_common_copy( tx3g, box );
+    isom_set_box_writer( (isom_box_t *)tx3g );
     int ret = isom_add_print_func( file, tx3g, level );
     if( ret < 0 )
         return ret;
@@ -1508,6 +1512,7 @@ static int isom_read_mp4s_description( lsmash_file_t *file, isom_box_t *box, iso
     mp4s->data_reference_index = lsmash_bs_get_be16( bs );
     box->parent = parent;
     isom_box_common_copy( mp4s, box );
+    isom_set_box_writer( (isom_box_t *)mp4s );
     int ret = isom_add_print_func( file, mp4s, level );
     if( ret < 0 )
         return ret;
@@ -1521,6 +1526,19 @@ static int isom_read_other_description( lsmash_file_t *file, isom_box_t *box, is
     return isom_read_unknown_box( file, box, parent, level );
 }
 
+/* Limit the number of entries of a sample table to what the rest of the box can contain
+ * so that a broken entry count never makes us allocate a huge table at once. */
+static uint32_t isom_limit_table_entry_count( lsmash_bs_t *bs, isom_box_t *box, uint32_t entry_count, uint32_t entry_bits )
+{
+    uint64_t pos = lsmash_bs_count( bs );
+    if( pos >= box->size )
+        return 0;
+    uint64_t remaining = box->size - pos;
+    uint64_t max_count = entry_bits >= 8 ? (remaining + entry_bits / 8 - 1) / (entry_bits / 8)
+                                         :  remaining * (8 / entry_bits);
+    return LSMASH_MIN( max_count, entry_count );
+}
+
 static int isom_read_stts( lsmash_file_t *file, isom_box_t *box, isom_box_t *parent, int level )
 {
     if( !lsmash_check_box_type_identical( parent->type, ISOM_BOX_TYPE_STBL )
@@ -1528,17 +1546,13 @@ static int isom_read_stts( lsmash_file_t *file, isom_box_t *box, isom_box_t *par
         return isom_read_unknown_box( file, box, parent, level );
     ADD_BOX( stts, isom_stbl_t );
     lsmash_bs_t *bs = file->bs;
-    uint32_t entry_count = lsmash_bs_get_be32( bs );
-    for( uint64_t pos = lsmash_bs_count( bs ); pos < box->size && stts->list->entry_count < entry_count; pos = lsmash_bs_count( bs ) )
+    uint32_t entry_count = isom_limit_table_entry_count( bs, box, lsmash_bs_get_be32( bs ), 64 );
+    if( entry_count
+     && !(stts->entries = isom_reserve_table_entries( NULL, &stts->alloc_count, 0, entry_count, sizeof(isom_stts_entry_t) )) )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    for( ; stts->entry_count < entry_count; stts->entry_count++ )
     {
-        isom_stts_entry_t *data = lsmash_malloc( sizeof(isom_stts_entry_t) );
-        if( !data )
-            return LSMASH_ERR_MEMORY_ALLOC;
-        if( lsmash_list_add_entry( stts->list, data ) < 0 )
-        {
-            lsmash_free( data );
-            return LSMASH_ERR_MEMORY_ALLOC;
-        }
+        isom_stts_entry_t *data = &stts->entries[ stts->entry_count ];
         data->sample_count = lsmash_bs_get_be32( bs );
         data->sample_delta = lsmash_bs_get_be32( bs );
     }
@@ -1552,17 +1566,13 @@ static int isom_read_ctts( lsmash_file_t *file, isom_box_t *box, isom_box_t *par
         return isom_read_unknown_box( file, box, parent, level );
     ADD_BOX( ctts, isom_stbl_t );
     lsmash_bs_t *bs = file->bs;
-    uint32_t entry_count = lsmash_bs_get_be32( bs );
-    for( uint64_t pos = lsmash_bs_count( bs ); pos < box->size && ctts->list->entry_count < entry_count; pos = lsmash_bs_count( bs ) )
+    uint32_t entry_count = isom_limit_table_entry_count( bs, box, lsmash_bs_get_be32( bs ), 64 );
+    if( entry_count
+     && !(ctts->entries = isom_reserve_table_entries( NULL, &ctts->alloc_count, 0, entry_count, sizeof(isom_ctts_entry_t) )) )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    for( ; ctts->entry_count < entry_count; ctts->entry_count++ )
     {
-        isom_ctts_entry_t *data = lsmash_malloc( sizeof(isom_ctts_entry_t) );
-        if( !data )
-            return LSMASH_ERR_MEMORY_ALLOC;
-        if( lsmash_list_add_entry( ctts->list, data ) < 0 )
-        {
-            lsmash_free( data );
-            return LSMASH_ERR_MEMORY_ALLOC;
-        }
+        isom_ctts_entry_t *data = &ctts->entries[ ctts->entry_count ];
         data->sample_count  = lsmash_bs_get_be32( bs );
         data->sample_offset = lsmash_bs_get_be32( bs );
     }
@@ -1665,17 +1675,13 @@ static int isom_read_stsc( lsmash_file_t *file, isom_box_t *box, isom_box_t *par
         return isom_read_unknown_box( file, box, parent, level );
     ADD_BOX( stsc, isom_stbl_t );
     lsmash_bs_t *bs = file->bs;
-    uint32_t entry_count = lsmash_bs_get_be32( bs );
-    for( uint64_t pos = lsmash_bs_count( bs ); pos < box->size && stsc->list->entry_count < entry_count; pos = lsmash_bs_count( bs ) )
+    uint32_t entry_count = isom_limit_table_entry_count( bs, box, lsmash_bs_get_be32( bs ), 96 );
+    if( entry_count
+     && !(stsc->entries = isom_reserve_table_entries( NULL, &stsc->alloc_count, 0, entry_count, sizeof(isom_stsc_entry_t) )) )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    for( ; stsc->entry_count < entry_count; stsc->entry_count++ )
     {
-        isom_stsc_entry_t *data = lsmash_malloc( sizeof(isom_stsc_entry_t) );
-        if( !data )
-            return LSMASH_ERR_MEMORY_ALLOC;
-        if( lsmash_list_add_entry( stsc->list, data ) < 0 )
-        {
-            lsmash_free( data );
-            return LSMASH_ERR_MEMORY_ALLOC;
-        }
+        isom_stsc_entry_t *data = &stsc->entries[ stsc->entry_count ];
         data->first_chunk              = lsmash_bs_get_be32( bs );
         data->samples_per_chunk        = lsmash_bs_get_be32( bs );
         data->sample_description_index = lsmash_bs_get_be32( bs );
@@ -1692,25 +1698,12 @@ static int isom_read_stsz( lsmash_file_t *file, isom_box_t *box, isom_box_t *par
     lsmash_bs_t *bs = file->bs;
     stsz->sample_size  = lsmash_bs_get_be32( bs );
     stsz->sample_count = lsmash_bs_get_be32( bs );
-    uint64_t pos = lsmash_bs_count( bs );
-    if( pos < box->size )
-    {
-        stsz->list = lsmash_list_create_simple();
-        if( !stsz->list )
-            return LSMASH_ERR_MEMORY_ALLOC;
-        for( ; pos < box->size && stsz->list->entry_count < stsz->sample_count; pos = lsmash_bs_count( bs ) )
-        {
-            isom_stsz_entry_t *data = lsmash_malloc( sizeof(isom_stsz_entry_t) );
-            if( !data )
-                return LSMASH_ERR_MEMORY_ALLOC;
-            if( lsmash_list_add_entry( stsz->list, data ) < 0 )
-            {
-                lsmash_free( data );
-                return LSMASH_ERR_MEMORY_ALLOC;
-            }
-            data->entry_size = lsmash_bs_get_be32( bs );
-        }
-    }
+    uint32_t entry_count = isom_limit_table_entry_count( bs, box, stsz->sample_count, 32 );
+    if( entry_count
+     && !(stsz->entries = isom_reserve_table_entries( NULL, &stsz->alloc_count, 0, entry_count, sizeof(isom_stsz_entry_t) )) )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    for( ; stsz->entry_count < entry_count; stsz->entry_count++ )
+        stsz->entries[ stsz->entry_count ].entry_size = lsmash_bs_get_be32( bs );
     return isom_read_leaf_box_common_last_process( file, box, level, stsz );
 }
 
@@ -1725,60 +1718,36 @@ static int isom_read_stz2( lsmash_file_t *file, isom_box_t *box, isom_box_t *par
     stz2->reserved     = temp32 >> 24;
     stz2->field_size   = temp32 & 0xff;
     stz2->sample_count = lsmash_bs_get_be32( bs );
-    uint64_t pos = lsmash_bs_count( bs );
-    if( pos < box->size )
+    if( lsmash_bs_count( bs ) < box->size )
     {
-        if( stz2->field_size == 16 || stz2->field_size == 8 )
-        {
-            uint64_t (*bs_get_funcs[2])( lsmash_bs_t * ) =
-                {
-                  lsmash_bs_get_byte_to_64,
-                  lsmash_bs_get_be16_to_64
-                };
-            uint64_t (*bs_get_entry_size)( lsmash_bs_t * ) = bs_get_funcs[ stz2->field_size == 16 ? 1 : 0 ];
-            for( ; pos < box->size && stz2->list->entry_count < stz2->sample_count; pos = lsmash_bs_count( bs ) )
-            {
-                isom_stsz_entry_t *data = lsmash_malloc( sizeof(isom_stsz_entry_t) );
-                if( !data )
-                    return LSMASH_ERR_MEMORY_ALLOC;
-                if( lsmash_list_add_entry( stz2->list, data ) < 0 )
-                {
-                    lsmash_free( data );
-                    return LSMASH_ERR_MEMORY_ALLOC;
-                }
-                data->entry_size = bs_get_entry_size( bs );
-            }
-        }
-        else if( stz2->field_size == 4 )
+        if( stz2->field_size != 16 && stz2->field_size != 8 && stz2->field_size != 4 )
+            return LSMASH_ERR_INVALID_DATA;
+        uint32_t entry_count = isom_limit_table_entry_count( bs, box, stz2->sample_count, stz2->field_size );
+        if( entry_count
+         && !(stz2->entries = isom_reserve_table_entries( NULL, &stz2->alloc_count, 0, entry_count, sizeof(isom_stsz_entry_t) )) )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        if( stz2->field_size == 16 )
+            for( uint32_t i = 0; i < entry_count; i++ )
+                stz2->entries[i].entry_size = lsmash_bs_get_be16( bs );
+        else if( stz2->field_size == 8 )
+            for( uint32_t i = 0; i < entry_count; i++ )
+                stz2->entries[i].entry_size = lsmash_bs_get_byte( bs );
+        else
         {
-            int parity = 1;
-            uint8_t temp8;
-            while( pos < box->size && stz2->list->entry_count < stz2->sample_count )
+            /* Read a byte by two entries. */
+            uint8_t temp8 = 0;
+            for( uint32_t i = 0; i < entry_count; i++ )
             {
-                isom_stsz_entry_t *data = lsmash_malloc( sizeof(isom_stsz_entry_t) );
-                if( !data )
-                    return LSMASH_ERR_MEMORY_ALLOC;
-                if( lsmash_list_add_entry( stz2->list, data ) < 0 )
-                {
-                    lsmash_free( data );
-                    return LSMASH_ERR_MEMORY_ALLOC;
-                }
-                /* Read a byte by two entries. */
-                if( parity )
+                if( (i & 1) == 0 )
                 {
                     temp8 = lsmash_bs_get_byte( bs );
-                    data->entry_size = (temp8 >> 4) & 0xf;
+                    stz2->entries[i].entry_size = (temp8 >> 4) & 0xf;
                 }
                 else
-                {
-                    pos = lsmash_bs_count( bs );
-                    data->entry_size =  temp8       & 0xf;
-                }
-                parity ^= 1;
+                    stz2->entries[i].entry_size =  temp8       & 0xf;
             }
         }
-        else
-            return LSMASH_ERR_INVALID_DATA;
+        stz2->entry_count = entry_count;
     }
     return isom_read_leaf_box_common_last_process( file, box, level, stz2 );
 }
@@ -1796,34 +1765,22 @@ static int isom_read_stco( lsmash_file_t *file, isom_box_t *box, isom_box_t *par
     if( !stco )
         return LSMASH_ERR_NAMELESS;
     lsmash_bs_t *bs = file->bs;
-    uint32_t entry_count = lsmash_bs_get_be32( bs );
+    uint32_t entry_count = isom_limit_table_entry_count( bs, box, lsmash_bs_get_be32( bs ), is_stco ? 32 : 64 );
     if( is_stco )
-        for( uint64_t pos = lsmash_bs_count( bs ); pos < box->size && stco->list->entry_count < entry_count; pos = lsmash_bs_count( bs ) )
-        {
-            isom_stco_entry_t *data = lsmash_malloc( sizeof(isom_stco_entry_t) );
-            if( !data )
-                return LSMASH_ERR_MEMORY_ALLOC;
-            if( lsmash_list_add_entry( stco->list, data ) < 0 )
-            {
-                lsmash_free( data );
-                return LSMASH_ERR_MEMORY_ALLOC;
-            }
-            data->chunk_offset = lsmash_bs_get_be32( bs );
-        }
+    {
+        if( entry_count
+         && !(stco->entries.stco = isom_reserve_table_entries( NULL, &stco->alloc_count, 0, entry_count, sizeof(isom_stco_entry_t) )) )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        for( ; stco->entry_count < entry_count; stco->entry_count++ )
+            stco->entries.stco[ stco->entry_count ].chunk_offset = lsmash_bs_get_be32( bs );
+    }
     else
     {
-        for( uint64_t pos = lsmash_bs_count( bs ); pos < box->size && stco->list->entry_count < entry_count; pos = lsmash_bs_count( bs ) )
-        {
-            isom_co64_entry_t *data = lsmash_malloc( sizeof(isom_co64_entry_t) );
-            if( !data )
-                return LSMASH_ERR_MEMORY_ALLOC;
-            if( lsmash_list_add_entry( stco->list, data ) < 0 )
-            {
-                lsmash_free( data );
-                return LSMASH_ERR_MEMORY_ALLOC;
-            }
-            data->chunk_offset = lsmash_bs_get_be64( bs );
-        }
+        if( entry_count
+         && !(stco->entries.co64 = isom_reserve_table_entries( NULL, &stco->alloc_count, 0, entry_count, sizeof(isom_co64_entry_t) )) )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        for( ; stco->entry_count < entry_count; stco->entry_count++ )
+            stco->entries.co64[ stco->entry_count ].chunk_offset = lsmash_bs_get_be64( bs );
     }
     return isom_read_leaf_box_common_last_process( file, box, level, stco );
 }
@@ -2040,6 +1997,17 @@ static int isom_read_moof( lsmash_file_t *file, isom_box_t *box, isom_box_t *par
         return isom_read_unknown_box( file, box, parent, level );
     ADD_BOX( moof, lsmash_file_t );
     box->parent = parent;
+    if( (file->flags & LSMASH_FILE_MODE_LAZY)
+     && !(file->flags & LSMASH_FILE_MODE_DUMP)
+     && !file->bs->unseekable )
+    {
+        /* Just record the location of this movie fragment.
+         * Its children are read by isom_read_fragment() when the timeline reaches it. */
+        isom_skip_box_rest( file->bs, box );
+        isom_box_common_copy( moof, box );
+        moof->manager |= LSMASH_UNPARSED_BOX;
+        return 0;
+    }
     isom_box_common_copy( moof, box );
     int ret = isom_add_print_func( file, moof, level );
     if( ret < 0 )
@@ -2047,6 +2015,485 @@ static int isom_read_moof( lsmash_file_t *file, isom_box_t *box, isom_box_t *par
     return isom_read_children( file, box, moof, level );
 }
 
+int isom_read_fragment( lsmash_file_t *file, isom_moof_t *moof )
+{
+    if( !(moof->manager & LSMASH_UNPARSED_BOX) )
+        return 0;
+    lsmash_bs_t *bs = file->bs;
+    if( lsmash_bs_read_seek( bs, moof->pos, SEEK_SET ) != (int64_t)moof->pos )
+        return LSMASH_ERR_NAMELESS;
+    isom_box_t box = { 0 };
+    box.root = moof->root;
+    box.file = moof->file;
+    int ret = isom_bs_read_box_common( bs, &box );
+    if( ret != 0 )
+        return ret < 0 ? ret : LSMASH_ERR_INVALID_DATA;
+    if( box.type.fourcc != ISOM_BOX_TYPE_MOOF.fourcc || box.size != moof->size )
+        return LSMASH_ERR_INVALID_DATA;
+    moof->manager &= ~LSMASH_UNPARSED_BOX;
+    ret = isom_read_children( file, &box, moof, 1 );
+    lsmash_bs_empty( bs );
+    bs->error = 0;
+    return ret;
+}
+
+/* Read the header of the box at a given position. The box shall end by 'end'. */
+static int isom_skim_box_header
+(
+    lsmash_bs_t *bs,
+    uint64_t     pos,
+    uint64_t     end,
+    uint32_t    *fourcc,
+    uint64_t    *size,
+    uint64_t    *header_size
+)
+{
+    if( pos > end || end - pos < ISOM_BASEBOX_COMMON_SIZE
+     || lsmash_bs_read_seek( bs, pos, SEEK_SET ) != (int64_t)pos )
+        return LSMASH_ERR_INVALID_DATA;
+    *size        = lsmash_bs_get_be32( bs );
+    *fourcc      = lsmash_bs_get_be32( bs );
+    *header_size = ISOM_BASEBOX_COMMON_SIZE;
+    if( *size == 1 )
+    {
+        *size         = lsmash_bs_get_be64( bs );
+        *header_size += 8;
+    }
+    else if( *size == 0 )
+        *size = end - pos;
+    if( bs->error || *size < *header_size || *size > end - pos )
+        return LSMASH_ERR_INVALID_DATA;
+    return 0;
+}
+
+/* Get the size of the optional fields preceding the sample rows in a track run. */
+static inline uint32_t isom_get_trun_fields_size( uint32_t tr_flags )
+{
+    return 4 * (!!(tr_flags & ISOM_TR_FLAGS_DATA_OFFSET_PRESENT)
+              + !!(tr_flags & ISOM_TR_FLAGS_FIRST_SAMPLE_FLAGS_PRESENT));
+}
+
+/* Get the size of each sample row in a track run. */
+static inline uint32_t isom_get_trun_row_size( uint32_t tr_flags )
+{
+    return 4 * (!!(tr_flags & ISOM_TR_FLAGS_SAMPLE_DURATION_PRESENT)
+              + !!(tr_flags & ISOM_TR_FLAGS_SAMPLE_SIZE_PRESENT)
+              + !!(tr_flags & ISOM_TR_FLAGS_SAMPLE_FLAGS_PRESENT)
+              + !!(tr_flags & ISOM_TR_FLAGS_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT));
+}
+
+/* Check if the sample rows of a track run fit in the box of a given size whose body begins with the sample count. */
+static inline int isom_check_trun_rows( uint32_t tr_flags, uint32_t sample_count, uint64_t size, uint64_t header_size )
+{
+    uint32_t fields_size = isom_get_trun_fields_size( tr_flags );
+    uint32_t row_size    = isom_get_trun_row_size( tr_flags );
+    return size - header_size - 8 >= fields_size
+        && (row_size == 0 || (size - header_size - 8 - fields_size) / row_size >= sample_count);
+}
+
+/* Update the minimum of the negative composition time offsets by a signed offset in a track run of version 1.
+ * Such offsets grow the composition to decode timeline shift only in ISO Base Media version 6 or later. */
+static inline void isom_update_min_composition_offset( int32_t *min_offset, uint32_t offset )
+{
+    if( offset != ISOM_NON_OUTPUT_SAMPLE_OFFSET && (int32_t)offset < *min_offset )
+        *min_offset = (int32_t)offset;
+}
+
+/* Get the summary of the samples of a track in a movie fragment.
+ * Unlike isom_read_fragment(), only the headers of the track fragments and the track runs are read and no box is
+ * allocated, so that movie fragments not needed yet can be skipped cheaply. Only the composition time offsets are read
+ * from the sample rows, and only in the track runs which may have negative ones. */
+int isom_skim_fragment
+(
+    lsmash_file_t           *file,
+    isom_moof_t             *moof,
+    uint32_t                 track_ID,
+    isom_fragment_summary_t *summary
+)
+{
+    memset( summary, 0, sizeof(isom_fragment_summary_t) );
+    int traf_count = 0;
+    if( !(moof->manager & LSMASH_UNPARSED_BOX) )
+    {
+        for( lsmash_entry_t *traf_entry = moof->traf_list.head; traf_entry; traf_entry = traf_entry->next )
+        {
+            isom_traf_t *traf = (isom_traf_t *)traf_entry->data;
+            if( LSMASH_IS_NON_EXISTING_BOX( traf ) || traf->tfhd->track_ID != track_ID )
+                continue;
+            if( traf_count++ == 0 && LSMASH_IS_EXISTING_BOX( traf->tfdt ) )
+            {
+                summary->base_media_decode_time         = traf->tfdt->baseMediaDecodeTime;
+                summary->base_media_decode_time_present = 1;
+            }
+            for( lsmash_entry_t *trun_entry = traf->trun_list.head; trun_entry; trun_entry = trun_entry->next )
+            {
+                isom_trun_t *trun = (isom_trun_t *)trun_entry->data;
+                if( LSMASH_IS_NON_EXISTING_BOX( trun ) )
+                    return LSMASH_ERR_INVALID_DATA;
+                if( trun->sample_count > UINT32_MAX - summary->sample_count )
+                    return LSMASH_ERR_INVALID_DATA;
+                summary->sample_count += trun->sample_count;
+                if( file->max_isom_version >= 6 && trun->version != 0 && trun->optional
+                 && (trun->flags & ISOM_TR_FLAGS_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) )
+                    for( lsmash_entry_t *row_entry = trun->optional->head; row_entry; row_entry = row_entry->next )
+                    {
+                        isom_trun_optional_row_t *row = (isom_trun_optional_row_t *)row_entry->data;
+                        if( !row )
+                            return LSMASH_ERR_INVALID_DATA;
+                        isom_update_min_composition_offset( &summary->min_composition_offset, row->sample_composition_time_offset );
+                    }
+            }
+        }
+        return 0;
+    }
+    lsmash_bs_t *bs       = file->bs;
+    uint64_t     moof_end = moof->pos + moof->size;
+    uint32_t     fourcc;
+    uint64_t     size        = 0;
+    uint64_t     header_size = 0;
+    int err = isom_skim_box_header( bs, moof->pos, moof_end, &fourcc, &size, &header_size );
+    if( err == 0 && (fourcc != ISOM_BOX_TYPE_MOOF.fourcc || size != moof->size) )
+        err = LSMASH_ERR_INVALID_DATA;
+    for( uint64_t pos = moof->pos + header_size; err == 0 && moof_end - pos >= ISOM_BASEBOX_COMMON_SIZE; pos += size )
+    {
+        uint64_t traf_header_size;
+        if( (err = isom_skim_box_header( bs, pos, moof_end, &fourcc, &size, &traf_header_size )) < 0 )
+            break;
+        if( fourcc != ISOM_BOX_TYPE_TRAF.fourcc )
+            continue;
+        /* Track fragment */
+        uint64_t traf_end       = pos + size;
+        uint32_t traf_track_ID  = 0;
+        int      tfhd_present   = 0;
+        uint64_t base           = 0;
+        int      base_present   = 0;
+        uint32_t sample_count   = 0;
+        int32_t  min_offset     = 0;
+        uint64_t child_size     = 0;
+        for( uint64_t child_pos = pos + traf_header_size; traf_end - child_pos >= ISOM_BASEBOX_COMMON_SIZE; child_pos += child_size )
+        {
+            uint64_t child_header_size;
+            if( (err = isom_skim_box_header( bs, child_pos, traf_end, &fourcc, &child_size, &child_header_size )) < 0 )
+                break;
+            if( fourcc != ISOM_BOX_TYPE_TFHD.fourcc
+             && fourcc != ISOM_BOX_TYPE_TFDT.fourcc
+             && fourcc != ISOM_BOX_TYPE_TRUN.fourcc )
+                continue;
+            /* All of them are full boxes beginning with a 32-bit field. */
+            if( child_size < child_header_size + 8 )
+            {
+                err = LSMASH_ERR_INVALID_DATA;
+                break;
+            }
+            uint32_t temp    = lsmash_bs_get_be32( bs );
+            uint8_t  version = (temp >> 24) & 0xff;
+            uint32_t flags   =  temp        & 0xffffff;
+            if( fourcc == ISOM_BOX_TYPE_TFHD.fourcc )
+            {
+                if( !tfhd_present )
+                    traf_track_ID = lsmash_bs_get_be32( bs );
+                tfhd_present = 1;
+            }
+            else if( fourcc == ISOM_BOX_TYPE_TFDT.fourcc )
+            {
+                if( version == 1 )
+                {
+                    if( child_size < child_header_size + 12 )
+                    {
+                        err = LSMASH_ERR_INVALID_DATA;
+                        break;
+                    }
+                    base = lsmash_bs_get_be64( bs );
+                }
+                else
+                    base = lsmash_bs_get_be32( bs );
+                base_present = 1;
+            }
+            else
+            {
+                uint32_t trun_sample_count = lsmash_bs_get_be32( bs );
+                if( trun_sample_count > UINT32_MAX - sample_count )
+                {
+                    err = LSMASH_ERR_INVALID_DATA;
+                    break;
+                }
+                sample_count += trun_sample_count;
+                if( file->max_isom_version >= 6 && version != 0 && (flags & ISOM_TR_FLAGS_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) )
+                {
+                    /* Read only the composition time offset placed last in each sample row. */
+                    uint32_t row_size = isom_get_trun_row_size( flags );
+                    if( !isom_check_trun_rows( flags, trun_sample_count, child_size, child_header_size ) )
+                    {
+                        err = LSMASH_ERR_INVALID_DATA;
+                        break;
+                    }
+                    lsmash_bs_skip_bytes( bs, isom_get_trun_fields_size( flags ) );
+                    for( uint32_t i = 0; i < trun_sample_count && !bs->error; i++ )
+                    {
+                        lsmash_bs_skip_bytes( bs, row_size - 4 );
+                        isom_update_min_composition_offset( &min_offset, lsmash_bs_get_be32( bs ) );
+                    }
+                }
+            }
+            if( bs->error )
+            {
+                err = LSMASH_ERR_INVALID_DATA;
+                break;
+            }
+        }
+        if( err < 0 || !tfhd_present || traf_track_ID != track_ID )
+            continue;
+        if( traf_count++ == 0 )
+        {
+            summary->base_media_decode_time         = base;
+            summary->base_media_decode_time_present = base_present;
+        }
+        if( sample_count > UINT32_MAX - summary->sample_count )
+            err = LSMASH_ERR_INVALID_DATA;
+        else
+            summary->sample_count += sample_count;
+        summary->min_composition_offset = LSMASH_MIN( summary->min_composition_offset, min_offset );
+    }
+    lsmash_bs_empty( bs );
+    bs->error = 0;
+    return err;
+}
+
+void isom_init_fragment_cursor( lsmash_file_t *file, isom_fragment_cursor_t *cursor )
+{
+    memset( cursor, 0, sizeof(isom_fragment_cursor_t) );
+    cursor->moof_entry = file->moof_list.head;
+}
+
+static int isom_set_fragment_cursor_defaults
+(
+    lsmash_file_t          *file,
+    uint32_t                track_ID,
+    isom_fragment_cursor_t *cursor,
+    uint32_t                tf_flags,
+    uint32_t                default_sample_duration,
+    uint32_t                sample_description_index
+)
+{
+    isom_trex_t *trex = isom_get_trex( file->moov->mvex, track_ID );
+    if( LSMASH_IS_NON_EXISTING_BOX( trex ) )
+        return LSMASH_ERR_INVALID_DATA;
+    cursor->default_sample_duration  = (tf_flags & ISOM_TF_FLAGS_DEFAULT_SAMPLE_DURATION_PRESENT)
+                                     ? default_sample_duration
+                                     : trex->default_sample_duration;
+    cursor->sample_description_index = (tf_flags & ISOM_TF_FLAGS_SAMPLE_DESCRIPTION_INDEX_PRESENT)
+                                     ? sample_description_index
+                                     : trex->default_sample_description_index;
+    return 0;
+}
+
+/* Move the cursor to the next track run having samples of the track in the movie fragment parsed.
+ * Return 1 if found, 0 if no more track run in the movie fragment, or a negative value if any error. */
+static int isom_move_to_next_parsed_trun( lsmash_file_t *file, uint32_t track_ID, isom_fragment_cursor_t *cursor )
+{
+    while( 1 )
+    {
+        while( cursor->trun_entry )
+        {
+            isom_trun_t *trun = (isom_trun_t *)cursor->trun_entry->data;
+            cursor->trun_entry = cursor->trun_entry->next;
+            if( LSMASH_IS_NON_EXISTING_BOX( trun ) )
+                return LSMASH_ERR_INVALID_DATA;
+            if( trun->sample_count == 0 )
+                continue;
+            cursor->sample_count = trun->sample_count;
+            cursor->flags        = trun->flags;
+            cursor->version      = trun->version;
+            cursor->row_entry    = trun->optional ? trun->optional->head : NULL;
+            return 1;
+        }
+        if( !cursor->traf_entry )
+            return 0;
+        isom_traf_t *traf = (isom_traf_t *)cursor->traf_entry->data;
+        cursor->traf_entry = cursor->traf_entry->next;
+        if( LSMASH_IS_NON_EXISTING_BOX( traf ) )
+            return LSMASH_ERR_INVALID_DATA;
+        isom_tfhd_t *tfhd = traf->tfhd;
+        if( tfhd->track_ID != track_ID )
+            continue;
+        int err = isom_set_fragment_cursor_defaults( file, track_ID, cursor, tfhd->flags,
+                                                     tfhd->default_sample_duration, tfhd->sample_description_index );
+        if( err < 0 )
+            return err;
+        cursor->trun_entry = traf->trun_list.head;
+    }
+}
+
+/* Same as above, but the movie fragment is read from the stream. */
+static int isom_move_to_next_skimmed_trun( lsmash_file_t *file, uint32_t track_ID, isom_fragment_cursor_t *cursor )
+{
+    lsmash_bs_t *bs       = file->bs;
+    uint64_t     moof_end = cursor->moof->pos + cursor->moof->size;
+    uint32_t     fourcc;
+    uint64_t     size;
+    uint64_t     header_size;
+    int          err;
+    while( 1 )
+    {
+        /* Track runs */
+        while( cursor->traf_end - cursor->child_pos >= ISOM_BASEBOX_COMMON_SIZE )
+        {
+            uint64_t pos = cursor->child_pos;
+            if( (err = isom_skim_box_header( bs, pos, cursor->traf_end, &fourcc, &size, &header_size )) < 0 )
+                return err;
+            cursor->child_pos += size;
+            if( fourcc != ISOM_BOX_TYPE_TRUN.fourcc )
+                continue;
+            if( size < header_size + 8 )
+                return LSMASH_ERR_INVALID_DATA;
+            uint32_t temp         = lsmash_bs_get_be32( bs );
+            uint32_t sample_count = lsmash_bs_get_be32( bs );
+            uint32_t flags        = temp & 0xffffff;
+            if( bs->error || !isom_check_trun_rows( flags, sample_count, size, header_size ) )
+                return LSMASH_ERR_INVALID_DATA;
+            if( sample_count == 0 )
+                continue;
+            cursor->sample_count = sample_count;
+            cursor->flags        = flags;
+            cursor->version      = (temp >> 24) & 0xff;
+            cursor->row_pos      = pos + header_size + 8 + isom_get_trun_fields_size( flags );
+            return 1;
+        }
+        /* Track fragments */
+        if( moof_end - cursor->traf_pos < ISOM_BASEBOX_COMMON_SIZE )
+            return 0;
+        uint64_t pos = cursor->traf_pos;
+        if( (err = isom_skim_box_header( bs, pos, moof_end, &fourcc, &size, &header_size )) < 0 )
+            return err;
+        cursor->traf_pos += size;
+        cursor->child_pos = 0;
+        cursor->traf_end  = 0;
+        if( fourcc != ISOM_BOX_TYPE_TRAF.fourcc )
+            continue;
+        /* Find the track fragment header. */
+        uint64_t traf_end   = pos + size;
+        uint64_t child_size = 0;
+        for( uint64_t child_pos = pos + header_size; traf_end - child_pos >= ISOM_BASEBOX_COMMON_SIZE; child_pos += child_size )
+        {
+            uint64_t child_header_size;
+            if( (err = isom_skim_box_header( bs, child_pos, traf_end, &fourcc, &child_size, &child_header_size )) < 0 )
+                return err;
+            if( fourcc != ISOM_BOX_TYPE_TFHD.fourcc )
+                continue;
+            uint32_t flags = lsmash_bs_get_be32( bs ) & 0xffffff;
+            uint64_t tfhd_size = child_header_size + 8
+                               + 8 * !!(flags & ISOM_TF_FLAGS_BASE_DATA_OFFSET_PRESENT)
+                               + 4 * !!(flags & ISOM_TF_FLAGS_SAMPLE_DESCRIPTION_INDEX_PRESENT)
+                               + 4 * !!(flags & ISOM_TF_FLAGS_DEFAULT_SAMPLE_DURATION_PRESENT);
+            if( child_size < tfhd_size )
+                return LSMASH_ERR_INVALID_DATA;
+            uint32_t tfhd_track_ID = lsmash_bs_get_be32( bs );
+            if( flags & ISOM_TF_FLAGS_BASE_DATA_OFFSET_PRESENT )
+                lsmash_bs_skip_bytes( bs, 8 );
+            uint32_t sample_description_index = (flags & ISOM_TF_FLAGS_SAMPLE_DESCRIPTION_INDEX_PRESENT) ? lsmash_bs_get_be32( bs ) : 0;
+            uint32_t default_sample_duration  = (flags & ISOM_TF_FLAGS_DEFAULT_SAMPLE_DURATION_PRESENT)  ? lsmash_bs_get_be32( bs ) : 0;
+            if( bs->error )
+                return LSMASH_ERR_INVALID_DATA;
+            if( tfhd_track_ID == track_ID )
+            {
+                if( (err = isom_set_fragment_cursor_defaults( file, track_ID, cursor, flags,
+                                                              default_sample_duration, sample_description_index )) < 0 )
+                    return err;
+                cursor->child_pos = pos + header_size;
+                cursor->traf_end  = traf_end;
+            }
+            break;
+        }
+    }
+}
+
+/* Get the duration and the composition time offset of the next sample of a track in the movie fragments. */
+int isom_get_next_fragment_sample
+(
+    lsmash_file_t          *file,
+    uint32_t                track_ID,
+    isom_fragment_cursor_t *cursor,
+    uint32_t               *duration,
+    uint32_t               *offset
+)
+{
+    lsmash_bs_t *bs = file->bs;
+    int err = 0;
+    while( cursor->sample_count == 0 )
+    {
+        if( cursor->moof )
+        {
+            int ret = cursor->parsed
+                    ? isom_move_to_next_parsed_trun ( file, track_ID, cursor )
+                    : isom_move_to_next_skimmed_trun( file, track_ID, cursor );
+            if( ret > 0 )
+                break;
+            if( (err = ret) < 0 )
+                goto fail;
+        }
+        /* Move to the next movie fragment. */
+        if( !cursor->moof_entry )
+            return 0;
+        isom_moof_t *moof = (isom_moof_t *)cursor->moof_entry->data;
+        cursor->moof_entry = cursor->moof_entry->next;
+        if( LSMASH_IS_NON_EXISTING_BOX( moof ) )
+            return LSMASH_ERR_INVALID_DATA;
+        cursor->moof       = moof;
+        cursor->parsed     = !(moof->manager & LSMASH_UNPARSED_BOX);
+        cursor->traf_entry = moof->traf_list.head;
+        cursor->trun_entry = NULL;
+        cursor->child_pos  = 0;
+        cursor->traf_end   = 0;
+        if( !cursor->parsed )
+        {
+            uint32_t fourcc;
+            uint64_t size;
+            uint64_t header_size;
+            if( (err = isom_skim_box_header( bs, moof->pos, moof->pos + moof->size, &fourcc, &size, &header_size )) < 0 )
+                goto fail;
+            if( fourcc != ISOM_BOX_TYPE_MOOF.fourcc || size != moof->size )
+                return LSMASH_ERR_INVALID_DATA;
+            cursor->traf_pos = moof->pos + header_size;
+        }
+    }
+    uint32_t flags = cursor->flags;
+    if( cursor->parsed )
+    {
+        isom_trun_optional_row_t *row = cursor->row_entry ? (isom_trun_optional_row_t *)cursor->row_entry->data : NULL;
+        if( cursor->row_entry )
+            cursor->row_entry = cursor->row_entry->next;
+        *duration = row && (flags & ISOM_TR_FLAGS_SAMPLE_DURATION_PRESENT)                ? row->sample_duration                : cursor->default_sample_duration;
+        *offset   = row && (flags & ISOM_TR_FLAGS_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) ? row->sample_composition_time_offset : 0;
+    }
+    else
+    {
+        uint32_t row_size = isom_get_trun_row_size( flags );
+        if( row_size && lsmash_bs_read_seek( bs, cursor->row_pos, SEEK_SET ) != (int64_t)cursor->row_pos )
+        {
+            err = LSMASH_ERR_INVALID_DATA;
+            goto fail;
+        }
+        *duration = (flags & ISOM_TR_FLAGS_SAMPLE_DURATION_PRESENT) ? lsmash_bs_get_be32( bs ) : cursor->default_sample_duration;
+        if( flags & ISOM_TR_FLAGS_SAMPLE_SIZE_PRESENT )
+            lsmash_bs_skip_bytes( bs, 4 );
+        if( flags & ISOM_TR_FLAGS_SAMPLE_FLAGS_PRESENT )
+            lsmash_bs_skip_bytes( bs, 4 );
+        *offset = (flags & ISOM_TR_FLAGS_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) ? lsmash_bs_get_be32( bs ) : 0;
+        if( bs->error )
+        {
+            err = LSMASH_ERR_INVALID_DATA;
+            goto fail;
+        }
+        cursor->row_pos += row_size;
+    }
+    -- cursor->sample_count;
+    return 1;
+fail:
+    lsmash_bs_empty( bs );
+    bs->error = 0;
+    return err;
+}
+
 static int isom_read_mfhd( lsmash_file_t *file, isom_box_t *box, isom_box_t *parent, int level )
 {
     if( !lsmash_check_box_type_identical( parent->type, ISOM_BOX_TYPE_MOOF )
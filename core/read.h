@@ -25,5 +25,60 @@
 
 int isom_read_file( lsmash_file_t *file );
 int isom_read_box( lsmash_file_t *file, isom_box_t *box, isom_box_t *parent, uint64_t parent_pos, int level );
+int isom_read_fragment( lsmash_file_t *file, isom_moof_t *moof );
+
+typedef struct
+{
+    uint32_t sample_count;              /* number of samples of the track in the movie fragment */
+    uint64_t base_media_decode_time;    /* decoding time of the first sample of the track */
+    int      base_media_decode_time_present;
+    int32_t  min_composition_offset;    /* minimum of the negative composition time offsets, or 0 if none
+                                         * Only the track runs of version 1 in ISO Base Media version 6 or later count. */
+} isom_fragment_summary_t;
+
+int isom_skim_fragment
+(
+    lsmash_file_t           *file,
+    isom_moof_t             *moof,
+    uint32_t                 track_ID,
+    isom_fragment_summary_t *summary
+);
+
+/* Cursor over the samples of a track in the movie fragments
+ * Only the durations and the composition time offsets of the samples are read. The movie fragments not parsed yet
+ * are read directly from the stream and are left unparsed, so no box is allocated. */
+typedef struct
+{
+    lsmash_entry_t *moof_entry;         /* movie fragment to be read next */
+    isom_moof_t    *moof;               /* movie fragment being read */
+    int             parsed;             /* If set to 1, the movie fragment being read has been parsed. */
+    /* for the movie fragment parsed */
+    lsmash_entry_t *traf_entry;         /* track fragment to be read next */
+    lsmash_entry_t *trun_entry;         /* track run to be read next */
+    lsmash_entry_t *row_entry;          /* sample row to be read next */
+    /* for the movie fragment not parsed */
+    uint64_t        traf_pos;           /* position of the box to be read next in the movie fragment */
+    uint64_t        child_pos;          /* position of the box to be read next in the track fragment */
+    uint64_t        traf_end;
+    uint64_t        row_pos;            /* position of the sample row to be read next */
+    /* track run being read */
+    uint32_t        sample_count;       /* number of the samples left */
+    uint32_t        flags;
+    uint8_t         version;
+    uint32_t        default_sample_duration;
+    uint32_t        sample_description_index;
+} isom_fragment_cursor_t;
+
+void isom_init_fragment_cursor( lsmash_file_t *file, isom_fragment_cursor_t *cursor );
+
+/* Return 1 if the next sample is got, 0 if no more sample, or a negative value if any error. */
+int isom_get_next_fragment_sample
+(
+    lsmash_file_t          *file,
+    uint32_t                track_ID,
+    isom_fragment_cursor_t *cursor,
+    uint32_t               *duration,
+    uint32_t               *offset
+);
 
 #endif /* LSMASH_READ_H */
@@ -27,6 +27,8 @@
 #include <inttypes.h>
 
 #include "box.h"
+#include "file.h"
+#include "read.h"
 #include "timeline.h"
 
 #include "codecs/mp4a.h"
@@ -36,6 +38,10 @@
 #include "importer/importer.h"
 
 #define NO_RANDOM_ACCESS_POINT 0xffffffff
+#define CHUNK_BLOCK_SIZE       1024         /* number of chunks in each block of chunks */
+#define READ_AHEAD_MAX_SIZE    (1 << 26)    /* maximum size of data read at a time by read-ahead */
+#define MAX_AVERAGE_TS_MOVES   16           /* average number of moves per timestamp allowed in insertion sort */
+#define MAX_REORDER_WINDOW     1024         /* maximum number of CTSs kept to get the maximum sample delay */
 
 typedef struct
 {
@@ -48,6 +54,61 @@ typedef struct
     lsmash_sample_property_t prop;
 } isom_sample_info_t;
 
+typedef struct
+{
+    isom_lpcm_bunch_t bunch;
+    uint32_t          first_sample_number;  /* sample number of the first sample in this bunch */
+    uint64_t          dts;                  /* decoding timestamp of the first sample in this bunch */
+} isom_lpcm_bunch_entry_t;
+
+typedef struct
+{
+    uint64_t cts;               /* composition timestamp added the composition to decode timeline shift */
+    uint32_t sample_number;
+} isom_cts_index_entry_t;
+
+/* Movie fragment skipped by the walk
+ * The samples in it have no sample info until it is walked, so it is held only as a range of sample numbers, which
+ * has the duration of the whole movie fragment derived from the decoding times of the track fragments. */
+typedef struct
+{
+    isom_moof_t *moof;
+    uint32_t     first_sample_number;   /* sample number of the first sample in this movie fragment */
+    uint32_t     sample_count;
+    uint32_t     info_index;            /* index of the sample info the first sample would have in the array
+                                         * This is the number of the samples walked before this movie fragment. */
+    uint32_t     duration;
+    uint64_t     dts;                   /* decoding timestamp of the first sample in this movie fragment */
+} isom_skipped_fragment_t;
+
+/* State of the walk through movie fragments, which is carried over from a fragment to the next. */
+typedef struct
+{
+    lsmash_file_t                   *file;
+    lsmash_entry_t                  *moof_entry;    /* movie fragment to be walked next */
+    isom_stsd_t                     *stsd;
+    lsmash_entry_list_t             *dref_list;
+    isom_sgpd_t                     *sgpd_rap;
+    isom_sgpd_t                     *sgpd_roll;
+    isom_tfra_t                     *tfra;
+    lsmash_entry_t                  *tfra_entry;
+    isom_tfra_location_time_entry_t *rap;           /* next random access point listed in 'tfra' */
+    isom_portable_chunk_t            chunk;         /* last chunk */
+    uint32_t                         chunk_number;
+    uint32_t                         distance;      /* distance from the previous random access point */
+    uint32_t                         sample_number_in_sbgp_roll_entry;
+    uint32_t                         sample_number_in_sbgp_rap_entry;
+    uint64_t                         dts;
+    isom_lpcm_bunch_t                bunch;         /* LPCM bunch not added to the timeline yet */
+    isom_skipped_fragment_t         *skipped;       /* array of movie fragments skipped and not walked yet */
+    uint32_t                         skipped_count;
+    uint32_t                         skipped_alloc;
+    isom_moof_t                     *skimmed_moof;  /* movie fragment skimmed last */
+    isom_fragment_summary_t          skimmed;
+    int                              no_skip;       /* If set to 1, no movie fragment is skipped. */
+    int                              ctd_shift_fixed;   /* If set to 1, the composition to decode timeline shift never grows. */
+} isom_fragment_walker_t;
+
 static const lsmash_class_t lsmash_timeline_class =
 {
     "timeline"
@@ -62,19 +123,33 @@ struct isom_timeline_tag
     uint32_t sample_count;
     uint32_t max_sample_size;
     uint32_t ctd_shift;     /* shift from composition to decode timeline */
+    int      retimed;       /* If set to 1, the timestamps have been changed by lsmash_set_media_timestamps(). */
     uint64_t media_duration;
     uint64_t track_duration;
-    uint32_t last_accessed_sample_number;
-    uint64_t last_accessed_sample_dts;
-    uint32_t last_accessed_lpcm_bunch_number;
-    uint32_t last_accessed_lpcm_bunch_duration;
-    uint32_t last_accessed_lpcm_bunch_sample_count;
-    uint32_t last_accessed_lpcm_bunch_first_sample_number;
-    uint64_t last_accessed_lpcm_bunch_dts;
-    lsmash_entry_list_t edit_list [1];  /* list of edits */
-    lsmash_entry_list_t chunk_list[1];  /* list of chunks */
-    lsmash_entry_list_t info_list [1];  /* list of sample info */
-    lsmash_entry_list_t bunch_list[1];  /* list of LPCM bunch */
+    uint32_t last_accessed_lpcm_bunch_index;
+    lsmash_entry_list_t      edit_list[1];  /* list of edits */
+    isom_portable_chunk_t  **chunk_block;   /* blocks of chunks
+                                             * Any chunk is never moved once added since samples refer to it by its address. */
+    uint32_t                 chunk_block_count;
+    uint32_t                 chunk_count;
+    isom_sample_info_t      *info_array;    /* array of sample info */
+    uint64_t                *dts_array;     /* array of decoding timestamps of sample info */
+    uint32_t                 dts_count;     /* number of decoding timestamps made in the array */
+    uint32_t                 info_count;
+    uint32_t                 info_alloc;
+    isom_lpcm_bunch_entry_t *bunch_array;   /* array of LPCM bunches */
+    uint32_t                 bunch_count;
+    uint32_t                 bunch_alloc;
+    isom_cts_index_entry_t  *cts_index;     /* array of output samples sorted in composition order
+                                             * This array is made on demand. */
+    uint32_t                 cts_index_count;
+    uint32_t                 read_ahead_chunk_count;    /* number of chunks read at a time
+                                                         * If set to 0, read-ahead is disabled. */
+    isom_sample_buffer_t    *read_buffer;               /* buffer read ahead */
+    isom_fragment_walker_t  *walker;                    /* walker through movie fragments not walked yet
+                                                         * If NULL, the timeline is complete. */
+    int                      walk_error;                /* error in walking a movie fragment
+                                                         * If set, the timeline is never extended any more. */
     int (*get_dts)( isom_timeline_t *timeline, uint32_t sample_number, uint64_t *dts );
     int (*get_cts)( isom_timeline_t *timeline, uint32_t sample_number, uint64_t *cts );
     int (*get_sample_duration)( isom_timeline_t *timeline, uint32_t sample_number, uint32_t *sample_duration );
@@ -101,6 +176,14 @@ isom_timeline_t *isom_get_timeline( lsmash_root_t *root, uint32_t track_ID )
     return NULL;
 }
 
+static void isom_destroy_fragment_walker( isom_fragment_walker_t *walker )
+{
+    if( !walker )
+        return;
+    lsmash_free( walker->skipped );
+    lsmash_free( walker );
+}
+
 isom_timeline_t *isom_timeline_create( void )
 {
     isom_timeline_t *timeline = lsmash_malloc_zero( sizeof(isom_timeline_t) );
@@ -108,9 +191,6 @@ isom_timeline_t *isom_timeline_create( void )
         return NULL;
     timeline->class = &lsmash_timeline_class;
     lsmash_list_init_simple( timeline->edit_list );
-    lsmash_list_init_simple( timeline->chunk_list );
-    lsmash_list_init_simple( timeline->info_list );
-    lsmash_list_init_simple( timeline->bunch_list );
     return timeline;
 }
 
@@ -119,9 +199,15 @@ void isom_timeline_destroy( isom_timeline_t *timeline )
     if( !timeline )
         return;
     lsmash_list_remove_entries( timeline->edit_list );
-    lsmash_list_remove_entries( timeline->chunk_list ); /* chunk data must be already freed. */
-    lsmash_list_remove_entries( timeline->info_list );
-    lsmash_list_remove_entries( timeline->bunch_list );
+    for( uint32_t i = 0; i < timeline->chunk_block_count; i++ )
+        lsmash_free( timeline->chunk_block[i] );   /* chunk data must be already freed. */
+    lsmash_free( timeline->chunk_block );
+    lsmash_free( timeline->info_array );
+    lsmash_free( timeline->dts_array );
+    lsmash_free( timeline->bunch_array );
+    lsmash_free( timeline->cts_index );
+    isom_destroy_fragment_walker( timeline->walker );
+    isom_release_sample_buffer( timeline->read_buffer );
     lsmash_free( timeline );
 }
 
@@ -187,6 +273,22 @@ int isom_timeline_set_media_timescale
     return 0;
 }
 
+uint32_t isom_timeline_get_media_timescale
+(
+    isom_timeline_t *timeline
+)
+{
+    return timeline ? timeline->media_timescale : 0;
+}
+
+int isom_timeline_check_retimed
+(
+    isom_timeline_t *timeline
+)
+{
+    return timeline ? timeline->retimed : 0;
+}
+
 int isom_timeline_set_sample_count
 (
     isom_timeline_t *timeline,
@@ -279,48 +381,253 @@ static int isom_is_qt_fixed_compressed_audio
     return (((isom_audio_entry_t *)description)->compression_ID != QT_AUDIO_COMPRESSION_ID_VARIABLE_COMPRESSION);
 }
 
+static void *isom_expand_timeline_array
+(
+    void     *array,
+    uint32_t *alloc,
+    uint32_t  count,
+    size_t    element_size
+)
+{
+    if( count < *alloc )
+        return array;
+    if( count == UINT32_MAX )
+        return NULL;
+    uint64_t new_alloc = LSMASH_MAX( 2 * (uint64_t)*alloc, 16 );
+    new_alloc = LSMASH_MIN( new_alloc, UINT32_MAX );
+    if( new_alloc > SIZE_MAX / element_size )
+        return NULL;
+    void *temp = lsmash_realloc( array, new_alloc * element_size );
+    if( !temp )
+        return NULL;
+    *alloc = new_alloc;
+    return temp;
+}
+
+static int isom_reserve_sample_info_entries( isom_timeline_t *timeline, uint32_t entry_count )
+{
+    if( entry_count <= timeline->info_alloc || entry_count > SIZE_MAX / sizeof(isom_sample_info_t) )
+        return 0;
+    isom_sample_info_t *info_array = lsmash_realloc( timeline->info_array, entry_count * sizeof(isom_sample_info_t) );
+    if( !info_array )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    timeline->info_array = info_array;
+    timeline->info_alloc = entry_count;
+    return 0;
+}
+
 static int isom_add_sample_info_entry( isom_timeline_t *timeline, isom_sample_info_t *src_info )
 {
-    isom_sample_info_t *dst_info = lsmash_malloc( sizeof(isom_sample_info_t) );
-    if( !dst_info )
+    isom_sample_info_t *info_array = isom_expand_timeline_array( timeline->info_array, &timeline->info_alloc,
+                                                                 timeline->info_count, sizeof(isom_sample_info_t) );
+    if( !info_array )
         return LSMASH_ERR_MEMORY_ALLOC;
-    if( lsmash_list_add_entry( timeline->info_list, dst_info ) < 0 )
+    timeline->info_array = info_array;
+    timeline->info_array[ timeline->info_count ++ ] = *src_info;
+    return 0;
+}
+
+/* Find the skipped movie fragment containing the sample of a given number by binary search.
+ * If not found, the index of the first one after the sample is got. */
+static int isom_find_skipped_fragment( isom_fragment_walker_t *walker, uint32_t sample_number, uint32_t *index )
+{
+    uint32_t lo = 0;
+    uint32_t hi = walker->skipped_count;
+    while( lo < hi )
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        isom_skipped_fragment_t *skipped = &walker->skipped[mid];
+        if( skipped->first_sample_number - 1 + skipped->sample_count < sample_number )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *index = lo;
+    return lo < walker->skipped_count && walker->skipped[lo].first_sample_number <= sample_number;
+}
+
+/* Get the number of the samples in the skipped movie fragments until a given one. */
+static inline uint32_t isom_get_skipped_sample_count_until( isom_skipped_fragment_t *skipped )
+{
+    return skipped->first_sample_number - 1 - skipped->info_index + skipped->sample_count;
+}
+
+/* Get the index in the array of sample info of the sample of a given number.
+ * The samples in the skipped movie fragments have no sample info, so the index got for such a sample is the one which
+ * the first sample in its movie fragment would have. The number of the skipped movie fragments before the sample is
+ * also got if requested. Return 1 if the sample has its sample info, or 0 otherwise. */
+static int isom_get_sample_info_index( isom_timeline_t *timeline, uint32_t sample_number, uint32_t *index, uint32_t *skipped_index )
+{
+    isom_fragment_walker_t *walker = timeline->walker;
+    uint32_t skipped_sample_count = 0;
+    uint32_t k = 0;
+    if( walker && walker->skipped_count && sample_number )
+    {
+        int skipped = isom_find_skipped_fragment( walker, sample_number, &k );
+        if( skipped_index )
+            *skipped_index = k;
+        if( skipped )
+        {
+            *index = walker->skipped[k].info_index;
+            return 0;
+        }
+        if( k )
+            skipped_sample_count = isom_get_skipped_sample_count_until( &walker->skipped[k - 1] );
+    }
+    else if( skipped_index )
+        *skipped_index = 0;
+    if( sample_number == 0 )
+    {
+        *index = 0;
+        return 0;
+    }
+    *index = sample_number - 1 - skipped_sample_count;
+    return *index < timeline->info_count;
+}
+
+/* Get the sample number of the sample having the sample info of a given index. */
+static uint32_t isom_get_sample_number_of_info( isom_timeline_t *timeline, uint32_t index )
+{
+    isom_fragment_walker_t *walker = timeline->walker;
+    if( !walker || walker->skipped_count == 0 )
+        return index + 1;
+    /* Find the first skipped movie fragment after the sample by binary search. */
+    uint32_t lo = 0;
+    uint32_t hi = walker->skipped_count;
+    while( lo < hi )
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if( walker->skipped[mid].info_index <= index )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return index + 1 + (lo ? isom_get_skipped_sample_count_until( &walker->skipped[lo - 1] ) : 0);
+}
+
+static inline isom_sample_info_t *isom_get_sample_info( isom_timeline_t *timeline, uint32_t sample_number )
+{
+    uint32_t index;
+    if( !isom_get_sample_info_index( timeline, sample_number, &index, NULL ) )
+        return NULL;
+    return &timeline->info_array[index];
+}
+
+/* Make the decoding timestamps of samples from their durations.
+ * Random access to the timestamps of any sample is done in constant time through this array.
+ * Only the timestamps of samples added after the last update are made, so reset 'dts_count' to remake all.
+ * The decoding timestamps of the skipped movie fragments are also made in passing. */
+static int isom_update_dts_array( isom_timeline_t *timeline )
+{
+    if( timeline->info_count == 0 )
     {
-        lsmash_free( dst_info );
+        lsmash_freep( &timeline->dts_array );
+        timeline->dts_count = 0;
+        return 0;
+    }
+    isom_fragment_walker_t *walker = timeline->walker;
+    uint32_t skipped_count = walker ? walker->skipped_count : 0;
+    if( timeline->dts_count == timeline->info_count && timeline->dts_array
+     && (skipped_count == 0 || walker->skipped[skipped_count - 1].info_index < timeline->info_count) )
+        return 0;
+    if( timeline->info_count > SIZE_MAX / sizeof(uint64_t) )
         return LSMASH_ERR_MEMORY_ALLOC;
+    uint64_t *dts_array = timeline->dts_array;
+    if( timeline->dts_count != timeline->info_count || !dts_array )
+    {
+        dts_array = lsmash_realloc( timeline->dts_array, timeline->info_count * sizeof(uint64_t) );
+        if( !dts_array )
+            return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    uint32_t i   = LSMASH_MIN( timeline->dts_count, timeline->info_count );
+    uint64_t dts = i ? dts_array[i - 1] + timeline->info_array[i - 1].duration : 0;
+    /* Find the first skipped movie fragment not before the first sample to be made by binary search. */
+    uint32_t lo = 0;
+    uint32_t hi = skipped_count;
+    while( lo < hi )
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if( walker->skipped[mid].info_index < i )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for( ; ; i++ )
+    {
+        for( ; lo < skipped_count && walker->skipped[lo].info_index == i; lo++ )
+        {
+            walker->skipped[lo].dts = dts;
+            dts += walker->skipped[lo].duration;
+        }
+        if( i == timeline->info_count )
+            break;
+        dts_array[i] = dts;
+        dts += timeline->info_array[i].duration;
     }
-    *dst_info = *src_info;
+    timeline->dts_array = dts_array;
+    timeline->dts_count = timeline->info_count;
     return 0;
 }
 
 int isom_add_lpcm_bunch_entry( isom_timeline_t *timeline, isom_lpcm_bunch_t *src_bunch )
 {
-    isom_lpcm_bunch_t *dst_bunch = lsmash_malloc( sizeof(isom_lpcm_bunch_t) );
-    if( !dst_bunch )
+    isom_lpcm_bunch_entry_t *bunch_array = isom_expand_timeline_array( timeline->bunch_array, &timeline->bunch_alloc,
+                                                                       timeline->bunch_count, sizeof(isom_lpcm_bunch_entry_t) );
+    if( !bunch_array )
         return LSMASH_ERR_MEMORY_ALLOC;
-    if( lsmash_list_add_entry( timeline->bunch_list, dst_bunch ) < 0 )
+    timeline->bunch_array = bunch_array;
+    isom_lpcm_bunch_entry_t *dst = &bunch_array[ timeline->bunch_count ];
+    if( timeline->bunch_count )
     {
-        lsmash_free( dst_bunch );
-        return LSMASH_ERR_MEMORY_ALLOC;
+        isom_lpcm_bunch_entry_t *prev = dst - 1;
+        dst->first_sample_number = prev->first_sample_number + prev->bunch.sample_count;
+        dst->dts                 = prev->dts + (uint64_t)prev->bunch.duration * prev->bunch.sample_count;
     }
-    *dst_bunch = *src_bunch;
+    else
+    {
+        dst->first_sample_number = 1;
+        dst->dts                 = 0;
+    }
+    dst->bunch = *src_bunch;
+    ++ timeline->bunch_count;
     return 0;
 }
 
 static int isom_add_portable_chunk_entry( isom_timeline_t *timeline, isom_portable_chunk_t *src_chunk )
 {
-    isom_portable_chunk_t *dst_chunk = lsmash_malloc( sizeof(isom_portable_chunk_t) );
-    if( !dst_chunk )
-        return LSMASH_ERR_MEMORY_ALLOC;
-    if( lsmash_list_add_entry( timeline->chunk_list, dst_chunk ) < 0 )
+    uint32_t block_index = timeline->chunk_count / CHUNK_BLOCK_SIZE;
+    if( block_index >= timeline->chunk_block_count )
     {
-        lsmash_free( dst_chunk );
-        return LSMASH_ERR_MEMORY_ALLOC;
+        isom_portable_chunk_t **chunk_block = lsmash_realloc( timeline->chunk_block, (block_index + 1) * sizeof(isom_portable_chunk_t *) );
+        if( !chunk_block )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        timeline->chunk_block = chunk_block;
+        chunk_block[block_index] = lsmash_malloc( CHUNK_BLOCK_SIZE * sizeof(isom_portable_chunk_t) );
+        if( !chunk_block[block_index] )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        timeline->chunk_block_count = block_index + 1;
     }
-    *dst_chunk = *src_chunk;
+    timeline->chunk_block[block_index][ timeline->chunk_count % CHUNK_BLOCK_SIZE ] = *src_chunk;
+    ++ timeline->chunk_count;
     return 0;
 }
 
+static inline isom_portable_chunk_t *isom_get_portable_chunk( isom_timeline_t *timeline, uint32_t chunk_number )
+{
+    if( chunk_number == 0 || chunk_number > timeline->chunk_count )
+        return NULL;
+    uint32_t index = chunk_number - 1;
+    return &timeline->chunk_block[index / CHUNK_BLOCK_SIZE][index % CHUNK_BLOCK_SIZE];
+}
+
+static inline isom_portable_chunk_t *isom_get_last_portable_chunk( isom_timeline_t *timeline )
+{
+    if( timeline->chunk_count == 0 )
+        return NULL;
+    uint32_t index = timeline->chunk_count - 1;
+    return &timeline->chunk_block[index / CHUNK_BLOCK_SIZE][index % CHUNK_BLOCK_SIZE];
+}
+
 static int isom_compare_lpcm_sample_info( isom_lpcm_bunch_t *bunch, isom_sample_info_t *info )
 {
     return info->duration != bunch->duration
@@ -342,125 +649,91 @@ static void isom_update_bunch( isom_lpcm_bunch_t *bunch, isom_sample_info_t *inf
     bunch->sample_count = 1;
 }
 
-static isom_lpcm_bunch_t *isom_get_bunch( isom_timeline_t *timeline, uint32_t sample_number )
+static inline int isom_check_sample_in_bunch( isom_lpcm_bunch_entry_t *entry, uint32_t sample_number )
+{
+    return sample_number >= entry->first_sample_number
+        && sample_number - entry->first_sample_number < entry->bunch.sample_count;
+}
+
+static isom_lpcm_bunch_entry_t *isom_get_bunch( isom_timeline_t *timeline, uint32_t sample_number )
 {
-    if( sample_number >= timeline->last_accessed_lpcm_bunch_first_sample_number
-     && sample_number <  timeline->last_accessed_lpcm_bunch_first_sample_number + timeline->last_accessed_lpcm_bunch_sample_count )
-        /* Get from the last accessed LPCM bunch. */
-        return (isom_lpcm_bunch_t *)lsmash_list_get_entry_data( timeline->bunch_list, timeline->last_accessed_lpcm_bunch_number );
-    uint32_t first_sample_number_in_next_bunch;
-    uint32_t bunch_number = 1;
-    uint64_t bunch_dts;
-    if( timeline->last_accessed_lpcm_bunch_first_sample_number
-     && timeline->last_accessed_lpcm_bunch_first_sample_number <= sample_number )
+    if( timeline->bunch_count == 0 )
+        return NULL;
+    /* The last accessed index is only a hint, so a stale value written by another thread is harmless. */
+    uint32_t index = timeline->last_accessed_lpcm_bunch_index;
+    if( index < timeline->bunch_count )
     {
-        first_sample_number_in_next_bunch = timeline->last_accessed_lpcm_bunch_first_sample_number + timeline->last_accessed_lpcm_bunch_sample_count;
-        bunch_number                     += timeline->last_accessed_lpcm_bunch_number;
-        bunch_dts                         = timeline->last_accessed_lpcm_bunch_dts
-                                          + timeline->last_accessed_lpcm_bunch_duration * timeline->last_accessed_lpcm_bunch_sample_count;
+        /* Get from the last accessed LPCM bunch or the next one. */
+        if( isom_check_sample_in_bunch( &timeline->bunch_array[index], sample_number ) )
+            return &timeline->bunch_array[index];
+        if( index + 1 < timeline->bunch_count
+         && isom_check_sample_in_bunch( &timeline->bunch_array[index + 1], sample_number ) )
+        {
+            timeline->last_accessed_lpcm_bunch_index = index + 1;
+            return &timeline->bunch_array[index + 1];
+        }
     }
-    else
+    /* Find the LPCM bunch by binary search. */
+    uint32_t lo = 0;
+    uint32_t hi = timeline->bunch_count;
+    while( hi - lo > 1 )
     {
-        /* Seek from the first LPCM bunch. */
-        first_sample_number_in_next_bunch = 1;
-        bunch_dts = 0;
+        uint32_t mid = lo + (hi - lo) / 2;
+        if( timeline->bunch_array[mid].first_sample_number <= sample_number )
+            lo = mid;
+        else
+            hi = mid;
     }
-    isom_lpcm_bunch_t *bunch = (isom_lpcm_bunch_t *)lsmash_list_get_entry_data( timeline->bunch_list, bunch_number++ );
-    if( !bunch )
+    if( !isom_check_sample_in_bunch( &timeline->bunch_array[lo], sample_number ) )
         return NULL;
-    first_sample_number_in_next_bunch += bunch->sample_count;
-    while( sample_number >= first_sample_number_in_next_bunch )
-    {
-        bunch_dts += bunch->duration * bunch->sample_count;
-        bunch = (isom_lpcm_bunch_t *)lsmash_list_get_entry_data( timeline->bunch_list, bunch_number++ );
-        if( !bunch )
-            return NULL;
-        first_sample_number_in_next_bunch += bunch->sample_count;
-    }
-    timeline->last_accessed_lpcm_bunch_dts                 = bunch_dts;
-    timeline->last_accessed_lpcm_bunch_number              = bunch_number - 1;
-    timeline->last_accessed_lpcm_bunch_duration            = bunch->duration;
-    timeline->last_accessed_lpcm_bunch_sample_count        = bunch->sample_count;
-    timeline->last_accessed_lpcm_bunch_first_sample_number = first_sample_number_in_next_bunch - bunch->sample_count;
-    return bunch;
+    timeline->last_accessed_lpcm_bunch_index = lo;
+    return &timeline->bunch_array[lo];
 }
 
 static int isom_get_dts_from_info_list( isom_timeline_t *timeline, uint32_t sample_number, uint64_t *dts )
 {
-    if( sample_number == timeline->last_accessed_sample_number )
-        *dts = timeline->last_accessed_sample_dts;
-    else if( sample_number == 1 )
-        *dts = 0;
-    else if( sample_number == timeline->last_accessed_sample_number + 1 )
-    {
-        isom_sample_info_t *info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, timeline->last_accessed_sample_number );
-        if( !info )
-            return LSMASH_ERR_NAMELESS;
-        *dts = timeline->last_accessed_sample_dts + info->duration;
-    }
-    else if( sample_number == timeline->last_accessed_sample_number - 1 )
-    {
-        isom_sample_info_t *info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, timeline->last_accessed_sample_number - 1 );
-        if( !info )
-            return LSMASH_ERR_NAMELESS;
-        *dts = timeline->last_accessed_sample_dts - info->duration;
-    }
-    else
-    {
-        *dts = 0;
-        uint32_t distance = sample_number - 1;
-        lsmash_entry_t *entry;
-        for( entry = timeline->info_list->head; entry; entry = entry->next )
-        {
-            isom_sample_info_t *info = (isom_sample_info_t *)entry->data;
-            if( !info )
-                return LSMASH_ERR_NAMELESS;
-            if( distance-- == 0 )
-                break;
-            *dts += info->duration;
-        }
-        if( !entry )
-            return LSMASH_ERR_NAMELESS;
-    }
-    /* Note: last_accessed_sample_number is always updated together with last_accessed_sample_dts, and vice versa. */
-    timeline->last_accessed_sample_dts    = *dts;
-    timeline->last_accessed_sample_number = sample_number;
+    uint32_t index;
+    if( !isom_get_sample_info_index( timeline, sample_number, &index, NULL ) || !timeline->dts_array )
+        return LSMASH_ERR_NAMELESS;
+    *dts = timeline->dts_array[index];
     return 0;
 }
 
 static int isom_get_cts_from_info_list( isom_timeline_t *timeline, uint32_t sample_number, uint64_t *cts )
 {
-    int ret = isom_get_dts_from_info_list( timeline, sample_number, cts );
-    if( ret < 0 )
-        return ret;
-    isom_sample_info_t *info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, sample_number );
-    if( !info )
+    uint32_t index;
+    if( !isom_get_sample_info_index( timeline, sample_number, &index, NULL ) || !timeline->dts_array )
         return LSMASH_ERR_NAMELESS;
-    *cts = isom_make_cts( *cts, info->offset, timeline->ctd_shift );
+    *cts = isom_make_cts( timeline->dts_array[index], timeline->info_array[index].offset, timeline->ctd_shift );
     return 0;
 }
 
+static inline uint64_t isom_get_dts_in_bunch( isom_lpcm_bunch_entry_t *entry, uint32_t sample_number )
+{
+    return entry->dts + (uint64_t)(sample_number - entry->first_sample_number) * entry->bunch.duration;
+}
+
 static int isom_get_dts_from_bunch_list( isom_timeline_t *timeline, uint32_t sample_number, uint64_t *dts )
 {
-    isom_lpcm_bunch_t *bunch = isom_get_bunch( timeline, sample_number );
-    if( !bunch )
+    isom_lpcm_bunch_entry_t *entry = isom_get_bunch( timeline, sample_number );
+    if( !entry )
         return LSMASH_ERR_NAMELESS;
-    *dts = timeline->last_accessed_lpcm_bunch_dts + (sample_number - timeline->last_accessed_lpcm_bunch_first_sample_number) * bunch->duration;
+    *dts = isom_get_dts_in_bunch( entry, sample_number );
     return 0;
 }
 
 static int isom_get_cts_from_bunch_list( isom_timeline_t *timeline, uint32_t sample_number, uint64_t *cts )
 {
-    isom_lpcm_bunch_t *bunch = isom_get_bunch( timeline, sample_number );
-    if( !bunch )
+    isom_lpcm_bunch_entry_t *entry = isom_get_bunch( timeline, sample_number );
+    if( !entry )
         return LSMASH_ERR_NAMELESS;
-    *cts = timeline->last_accessed_lpcm_bunch_dts + (sample_number - timeline->last_accessed_lpcm_bunch_first_sample_number) * bunch->duration + bunch->offset;
+    *cts = isom_get_dts_in_bunch( entry, sample_number ) + entry->bunch.offset;
     return 0;
 }
 
 static int isom_get_sample_duration_from_info_list( isom_timeline_t *timeline, uint32_t sample_number, uint32_t *sample_duration )
 {
-    isom_sample_info_t *info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, sample_number );
+    isom_sample_info_t *info = isom_get_sample_info( timeline, sample_number );
     if( !info )
         return LSMASH_ERR_NAMELESS;
     *sample_duration = info->duration;
@@ -469,16 +742,16 @@ static int isom_get_sample_duration_from_info_list( isom_timeline_t *timeline, u
 
 static int isom_get_sample_duration_from_bunch_list( isom_timeline_t *timeline, uint32_t sample_number, uint32_t *sample_duration )
 {
-    isom_lpcm_bunch_t *bunch = isom_get_bunch( timeline, sample_number );
-    if( !bunch )
+    isom_lpcm_bunch_entry_t *entry = isom_get_bunch( timeline, sample_number );
+    if( !entry )
         return LSMASH_ERR_NAMELESS;
-    *sample_duration = bunch->duration;
+    *sample_duration = entry->bunch.duration;
     return 0;
 }
 
 static int isom_check_sample_existence_in_info_list( isom_timeline_t *timeline, uint32_t sample_number )
 {
-    isom_sample_info_t *info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, sample_number );
+    isom_sample_info_t *info = isom_get_sample_info( timeline, sample_number );
     if( !info || !info->chunk )
         return 0;
     return !!info->chunk->file;
@@ -486,10 +759,10 @@ static int isom_check_sample_existence_in_info_list( isom_timeline_t *timeline,
 
 static int isom_check_sample_existence_in_bunch_list( isom_timeline_t *timeline, uint32_t sample_number )
 {
-    isom_lpcm_bunch_t *bunch = isom_get_bunch( timeline, sample_number );
-    if( !bunch || !bunch->chunk )
+    isom_lpcm_bunch_entry_t *entry = isom_get_bunch( timeline, sample_number );
+    if( !entry || !entry->bunch.chunk )
         return 0;
-    return !!bunch->chunk->file;
+    return !!entry->bunch.chunk->file;
 }
 
 static lsmash_sample_t *isom_read_sample_data_from_stream
@@ -500,15 +773,14 @@ static lsmash_sample_t *isom_read_sample_data_from_stream
     uint64_t         sample_pos
 )
 {
-    if( !file )
+    if( !file || sample_length == 0 )
         return NULL;
-    lsmash_sample_t *sample = lsmash_create_sample( 0 );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( file->root, sample_length );
     if( !sample )
         return NULL;
     lsmash_bs_t *bs = file->bs;
     lsmash_bs_read_seek( bs, sample_pos, SEEK_SET );
-    sample->data = lsmash_bs_get_bytes( bs, sample_length );
-    if( !sample->data )
+    if( lsmash_bs_get_bytes_ex( bs, sample_length, sample->data ) != sample_length )
     {
         lsmash_delete_sample( sample );
         return NULL;
@@ -516,20 +788,85 @@ static lsmash_sample_t *isom_read_sample_data_from_stream
     return sample;
 }
 
+/* Read the data from the sample to the end of its chunk and subsequent chunks at a time into a buffer shared by samples. */
+static isom_sample_buffer_t *isom_read_ahead_chunks
+(
+    isom_timeline_t       *timeline,
+    isom_portable_chunk_t *chunk,
+    uint32_t               sample_length,
+    uint64_t               sample_pos
+)
+{
+    uint64_t end = LSMASH_MAX( chunk->data_offset + chunk->length, sample_pos + sample_length );
+    if( end - sample_pos > READ_AHEAD_MAX_SIZE )
+        return NULL;
+    /* Chunks not in this timeline such as the one made by an importer are read by themselves. */
+    if( isom_get_portable_chunk( timeline, chunk->number ) == chunk )
+        for( uint32_t i = 1; i < timeline->read_ahead_chunk_count; i++ )
+        {
+            isom_portable_chunk_t *next = isom_get_portable_chunk( timeline, chunk->number + i );
+            if( !next
+             || next->file != chunk->file
+             || next->data_offset < end
+             || next->data_offset + next->length - sample_pos > READ_AHEAD_MAX_SIZE )
+                break;
+            end = next->data_offset + next->length;
+        }
+    lsmash_bs_t *bs = chunk->file->bs;
+    if( lsmash_bs_read_seek( bs, sample_pos, SEEK_SET ) < 0 )
+        return NULL;
+    uint8_t *data = lsmash_bs_get_bytes( bs, end - sample_pos );
+    if( !data )
+        return NULL;
+    isom_sample_buffer_t *buffer = isom_create_sample_buffer( chunk->file, sample_pos, data, end - sample_pos );
+    if( !buffer )
+    {
+        lsmash_free( data );
+        return NULL;
+    }
+    return buffer;
+}
+
+static lsmash_sample_t *isom_read_sample_data
+(
+    isom_timeline_t       *timeline,
+    isom_portable_chunk_t *chunk,
+    uint32_t               sample_length,
+    uint64_t               sample_pos
+)
+{
+    if( timeline->read_ahead_chunk_count == 0 || !chunk->file )
+        return isom_read_sample_data_from_stream( chunk->file, timeline, sample_length, sample_pos );
+    isom_sample_buffer_t *buffer = timeline->read_buffer;
+    if( !buffer
+     || buffer->file != chunk->file
+     || sample_pos < buffer->pos
+     || sample_pos + sample_length > buffer->pos + buffer->size )
+    {
+        buffer = isom_read_ahead_chunks( timeline, chunk, sample_length, sample_pos );
+        if( !buffer )
+            return isom_read_sample_data_from_stream( chunk->file, timeline, sample_length, sample_pos );
+        isom_release_sample_buffer( timeline->read_buffer );
+        timeline->read_buffer = buffer;
+    }
+    return isom_create_sample_view( buffer, sample_pos, sample_length );
+}
+
 static lsmash_sample_t *isom_get_lpcm_sample_from_media_timeline( isom_timeline_t *timeline, uint32_t sample_number )
 {
-    isom_lpcm_bunch_t *bunch = isom_get_bunch( timeline, sample_number );
-    if( !bunch
-     || !bunch->chunk )
+    isom_lpcm_bunch_entry_t *entry = isom_get_bunch( timeline, sample_number );
+    if( !entry
+     || !entry->bunch.chunk )
         return NULL;
+    isom_lpcm_bunch_t *bunch = &entry->bunch;
     /* Get data of a sample from the stream. */
-    uint64_t sample_number_offset = sample_number - timeline->last_accessed_lpcm_bunch_first_sample_number;
+    uint64_t sample_number_offset = sample_number - entry->first_sample_number;
     uint64_t sample_pos           = bunch->pos + sample_number_offset * bunch->length;
-    lsmash_sample_t *sample = isom_read_sample_data_from_stream( bunch->chunk->file, timeline, bunch->length, sample_pos );
+    lsmash_sample_t *sample = isom_read_sample_data( timeline, bunch->chunk, bunch->length, sample_pos );
     if( !sample )
         return NULL;
     /* Get sample info. */
-    sample->dts    = timeline->last_accessed_lpcm_bunch_dts + sample_number_offset * bunch->duration;
+    sample->dts    = entry->dts + sample_number_offset * bunch->duration;
     sample->cts    = isom_make_cts( sample->dts, bunch->offset, timeline->ctd_shift );
     sample->pos    = sample_pos;
     sample->length = bunch->length;
@@ -543,12 +880,11 @@ static lsmash_sample_t *isom_get_sample_from_media_timeline( isom_timeline_t *ti
     uint64_t dts;
     if( isom_get_dts_from_info_list( timeline, sample_number, &dts ) < 0 )
         return NULL;
-    isom_sample_info_t *info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, sample_number );
-    if( !info
-     || !info->chunk )
+    isom_sample_info_t *info = isom_get_sample_info( timeline, sample_number );
+    if( !info->chunk )
         return NULL;
     /* Get data of a sample from the stream. */
-    lsmash_sample_t *sample = isom_read_sample_data_from_stream( info->chunk->file, timeline, info->length, info->pos );
+    lsmash_sample_t *sample = isom_read_sample_data( timeline, info->chunk, info->length, info->pos );
     if( !sample )
         return NULL;
     /* Get sample info. */
@@ -563,11 +899,12 @@ static lsmash_sample_t *isom_get_sample_from_media_timeline( isom_timeline_t *ti
 
 static int isom_get_lpcm_sample_info_from_media_timeline( isom_timeline_t *timeline, uint32_t sample_number, lsmash_sample_t *sample )
 {
-    isom_lpcm_bunch_t *bunch = isom_get_bunch( timeline, sample_number );
-    if( !bunch )
+    isom_lpcm_bunch_entry_t *entry = isom_get_bunch( timeline, sample_number );
+    if( !entry )
         return LSMASH_ERR_NAMELESS;
-    uint64_t sample_number_offset = sample_number - timeline->last_accessed_lpcm_bunch_first_sample_number;
-    sample->dts    = timeline->last_accessed_lpcm_bunch_dts + sample_number_offset * bunch->duration;
+    isom_lpcm_bunch_t *bunch = &entry->bunch;
+    uint64_t sample_number_offset = sample_number - entry->first_sample_number;
+    sample->dts    = entry->dts + sample_number_offset * bunch->duration;
     sample->cts    = isom_make_cts( sample->dts, bunch->offset, timeline->ctd_shift );
     sample->pos    = bunch->pos + sample_number_offset * bunch->length;
     sample->length = bunch->length;
@@ -582,9 +919,7 @@ static int isom_get_sample_info_from_media_timeline( isom_timeline_t *timeline,
     int ret = isom_get_dts_from_info_list( timeline, sample_number, &dts );
     if( ret < 0 )
         return ret;
-    isom_sample_info_t *info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, sample_number );
-    if( !info )
-        return LSMASH_ERR_NAMELESS;
+    isom_sample_info_t *info = isom_get_sample_info( timeline, sample_number );
     sample->dts    = dts;
     sample->cts    = isom_make_cts( dts, info->offset, timeline->ctd_shift );
     sample->pos    = info->pos;
@@ -603,7 +938,7 @@ static int isom_get_lpcm_sample_property_from_media_timeline( isom_timeline_t *t
 
 static int isom_get_sample_property_from_media_timeline( isom_timeline_t *timeline, uint32_t sample_number, lsmash_sample_property_t *prop )
 {
-    isom_sample_info_t *info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, sample_number );
+    isom_sample_info_t *info = isom_get_sample_info( timeline, sample_number );
     if( !info )
         return LSMASH_ERR_NAMELESS;
     *prop = info->prop;
@@ -654,6 +989,22 @@ static inline void isom_increment_sample_number_in_entry
         *sample_number_in_entry += 1;
 }
 
+static inline void isom_increment_sample_number_in_table
+(
+    uint32_t *sample_number_in_entry,
+    uint32_t *entry_index,
+    uint32_t  sample_count
+)
+{
+    if( *sample_number_in_entry == sample_count )
+    {
+        *sample_number_in_entry = 1;
+        ++(*entry_index);
+    }
+    else
+        *sample_number_in_entry += 1;
+}
+
 static inline isom_sgpd_t *isom_select_appropriate_sgpd
 (
     isom_sgpd_t *sgpd,
@@ -750,98 +1101,773 @@ static int isom_get_random_access_point_grouping_info
     return 0;
 }
 
-int isom_timeline_construct( lsmash_root_t *root, uint32_t track_ID )
+/* Walk a movie fragment and add the samples of the track in it to the timeline. */
+static int isom_timeline_walk_fragment( isom_timeline_t *timeline, isom_fragment_walker_t *walker, isom_moof_t *moof )
 {
-    if( isom_check_initializer_present( root ) < 0 )
-        return LSMASH_ERR_FUNCTION_PARAM;
-    lsmash_file_t *file = root->file;
-    if( LSMASH_IS_NON_EXISTING_BOX( file->moov->mvhd )
-     ||  file->moov->mvhd->timescale == 0 )
-        return LSMASH_ERR_INVALID_DATA;
-    /* Get track by track_ID. */
-    isom_trak_t *trak = isom_get_trak( file, track_ID );
-    if( LSMASH_IS_NON_EXISTING_BOX( trak->tkhd )
-     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->mdhd )
-     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stco )
-     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stsd )
-     || (LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stsz ) && LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stz2 ))
-     ||  trak->mdia->mdhd->timescale == 0 )
+    if( LSMASH_IS_NON_EXISTING_BOX( moof ) )
         return LSMASH_ERR_INVALID_DATA;
-    /* Create a timeline list if it doesn't exist. */
-    if( !file->timeline )
+    lsmash_file_t *file = walker->file;
+    int err = isom_read_fragment( file, moof );
+    if( err < 0 )
+        return err;
+    uint64_t last_sample_end_pos = 0;
+    /* Track fragments */
+    uint32_t traf_number = 1;
+    for( lsmash_entry_t *traf_entry = moof->traf_list.head; traf_entry; traf_entry = traf_entry->next )
     {
-        file->timeline = lsmash_list_create( isom_timeline_destroy );
-        if( !file->timeline )
-            return LSMASH_ERR_MEMORY_ALLOC;
-    }
-    /* Create a timeline. */
-    isom_timeline_t *timeline = isom_timeline_create();
-    if( !timeline )
-        return LSMASH_ERR_MEMORY_ALLOC;
-    timeline->track_ID        = track_ID;
-    timeline->movie_timescale = file->moov->mvhd->timescale;
-    timeline->media_timescale = trak->mdia->mdhd->timescale;
-    timeline->track_duration  = trak->tkhd->duration;
-    /* Preparation for construction. */
-    isom_elst_t *elst = trak->edts->elst;
-    isom_minf_t *minf = trak->mdia->minf;
-    isom_dref_t *dref = minf->dinf->dref;
-    isom_stbl_t *stbl = minf->stbl;
-    isom_stsd_t *stsd = stbl->stsd;
-    isom_stts_t *stts = stbl->stts;
-    isom_ctts_t *ctts = stbl->ctts;
-    isom_stss_t *stss = stbl->stss;
-    isom_stps_t *stps = stbl->stps;
-    isom_sdtp_t *sdtp = stbl->sdtp;
-    isom_stsc_t *stsc = stbl->stsc;
-    isom_stsz_t *stsz = stbl->stsz;
-    isom_stz2_t *stz2 = stbl->stz2;
-    isom_stco_t *stco = stbl->stco;
-    isom_sgpd_t *sgpd_rap  = isom_get_sample_group_description( stbl, ISOM_GROUP_TYPE_RAP );
-    isom_sbgp_t *sbgp_rap  = isom_get_sample_to_group         ( stbl, ISOM_GROUP_TYPE_RAP );
-    isom_sgpd_t *sgpd_roll = isom_get_roll_recovery_sample_group_description( &stbl->sgpd_list );
-    isom_sbgp_t *sbgp_roll = isom_get_roll_recovery_sample_to_group         ( &stbl->sbgp_list );
-    lsmash_entry_t *elst_entry = elst->list ? elst->list->head : NULL;
-    lsmash_entry_t *stts_entry = stts->list ? stts->list->head : NULL;
-    lsmash_entry_t *ctts_entry = ctts->list ? ctts->list->head : NULL;
-    lsmash_entry_t *stss_entry = stss->list ? stss->list->head : NULL;
-    lsmash_entry_t *stps_entry = stps->list ? stps->list->head : NULL;
-    lsmash_entry_t *sdtp_entry = sdtp->list ? sdtp->list->head : NULL;
-    lsmash_entry_t *stsz_entry = LSMASH_IS_EXISTING_BOX( stsz ) ? (stsz->list ? stsz->list->head : NULL)
-                                                                : (stz2->list ? stz2->list->head : NULL);
-    lsmash_entry_t *stsc_entry = stsc->list ? stsc->list->head : NULL;
-    lsmash_entry_t *stco_entry = stco->list ? stco->list->head : NULL;
-    lsmash_entry_t *sbgp_roll_entry = sbgp_roll->list ? sbgp_roll->list->head : NULL;
-    lsmash_entry_t *sbgp_rap_entry  = sbgp_rap->list  ? sbgp_rap->list->head  : NULL;
-    lsmash_entry_t *next_stsc_entry = stsc_entry ? stsc_entry->next : NULL;
-    isom_stsc_entry_t *stsc_data = stsc_entry ? (isom_stsc_entry_t *)stsc_entry->data : NULL;
-    int err = LSMASH_ERR_INVALID_DATA;
-    int movie_fragments_present = (LSMASH_IS_EXISTING_BOX( file->moov->mvex ) && file->moof_list.head);
-    if( !movie_fragments_present && (!stts_entry || !stsc_entry || !stco_entry || !stco_entry->data || (next_stsc_entry && !next_stsc_entry->data)) )
-        goto fail;
-    isom_sample_entry_t *description = (isom_sample_entry_t *)lsmash_list_get_entry_data( &stsd->list, stsc_data ? stsc_data->sample_description_index : 1 );
-    if( LSMASH_IS_NON_EXISTING_BOX( description ) )
-        goto fail;
-    lsmash_entry_list_t *dref_list = LSMASH_IS_EXISTING_BOX( dref ) ? &dref->list : NULL;
-    isom_dref_entry_t *dref_entry = (isom_dref_entry_t *)lsmash_list_get_entry_data( dref_list, description->data_reference_index );
-    int all_sync = LSMASH_IS_NON_EXISTING_BOX( stss );
-    int large_presentation = stco->large_presentation || lsmash_check_box_type_identical( stco->type, ISOM_BOX_TYPE_CO64 );
-    int is_lpcm_audio          = isom_is_lpcm_audio( description );
-    int is_qt_fixed_comp_audio = isom_is_qt_fixed_compressed_audio( description );
-    int iso_sdtp = file->max_isom_version >= 2 || file->avc_extensions;
-    int allow_negative_sample_offset = ctts && ((file->max_isom_version >= 4 && ctts->version == 1) || file->qt_compatible);
-    uint32_t sample_number_in_stts_entry      = 1;
-    uint32_t sample_number_in_ctts_entry      = 1;
-    uint32_t sample_number_in_sbgp_roll_entry = 1;
-    uint32_t sample_number_in_sbgp_rap_entry  = 1;
-    uint64_t dts               = 0;
-    uint32_t chunk_number      = 1;
-    uint64_t offset_from_chunk = 0;
-    uint64_t data_offset = stco_entry && stco_entry->data
-                         ? large_presentation
-                             ? ((isom_co64_entry_t *)stco_entry->data)->chunk_offset
-                             : ((isom_stco_entry_t *)stco_entry->data)->chunk_offset
-                         : 0;
+        isom_traf_t *traf = (isom_traf_t *)traf_entry->data;
+        isom_tfhd_t *tfhd = traf->tfhd;
+        isom_trex_t *trex = isom_get_trex( file->moov->mvex, tfhd->track_ID );
+        if( LSMASH_IS_NON_EXISTING_BOX( trex ) )
+            return LSMASH_ERR_INVALID_DATA;
+        /* Ignore ISOM_TF_FLAGS_DURATION_IS_EMPTY flag even if set. */
+        if( !traf->trun_list.head )
+        {
+            ++traf_number;
+            continue;
+        }
+        /* Get base_data_offset. */
+        uint64_t base_data_offset;
+        if( tfhd->flags & ISOM_TF_FLAGS_BASE_DATA_OFFSET_PRESENT )
+            base_data_offset = tfhd->base_data_offset;
+        else if( (tfhd->flags & ISOM_TF_FLAGS_DEFAULT_BASE_IS_MOOF) || traf_entry == moof->traf_list.head )
+            base_data_offset = moof->pos;
+        else
+            base_data_offset = last_sample_end_pos;
+        /* sample grouping */
+        isom_sgpd_t *sgpd_frag_rap   = isom_get_fragment_sample_group_description( traf, ISOM_GROUP_TYPE_RAP );
+        isom_sbgp_t *sbgp_rap        = isom_get_fragment_sample_to_group         ( traf, ISOM_GROUP_TYPE_RAP );
+        lsmash_entry_t *sbgp_rap_entry  = sbgp_rap->list ? sbgp_rap->list->head : NULL;
+        isom_sgpd_t *sgpd_frag_roll  = isom_get_roll_recovery_sample_group_description( &traf->sgpd_list );
+        isom_sbgp_t *sbgp_roll       = isom_get_roll_recovery_sample_to_group         ( &traf->sbgp_list );
+        lsmash_entry_t *sbgp_roll_entry = sbgp_roll->list ? sbgp_roll->list->head : NULL;
+        int need_data_offset_only = (tfhd->track_ID != timeline->track_ID);
+        /* Track runs */
+        uint32_t trun_number = 1;
+        for( lsmash_entry_t *trun_entry = traf->trun_list.head; trun_entry; trun_entry = trun_entry->next )
+        {
+            isom_trun_t *trun = (isom_trun_t *)trun_entry->data;
+            if( LSMASH_IS_NON_EXISTING_BOX( trun ) )
+                return LSMASH_ERR_INVALID_DATA;
+            if( trun->sample_count == 0 )
+            {
+                ++trun_number;
+                continue;
+            }
+            /* Get data_offset. */
+            uint64_t data_offset;
+            if( trun->flags & ISOM_TR_FLAGS_DATA_OFFSET_PRESENT )
+                data_offset = trun->data_offset + base_data_offset;
+            else if( trun_entry == traf->trun_list.head )
+                data_offset = base_data_offset;
+            else
+                data_offset = last_sample_end_pos;
+            /* */
+            uint32_t sample_description_index = 0;
+            int is_lpcm_audio = 0;
+            lsmash_entry_t    *sdtp_entry = NULL;
+            isom_sdtp_entry_t *sdtp_data  = NULL;
+            if( !need_data_offset_only )
+            {
+                /* Get sample_description_index of this track fragment. */
+                if( tfhd->flags & ISOM_TF_FLAGS_SAMPLE_DESCRIPTION_INDEX_PRESENT )
+                    sample_description_index = tfhd->sample_description_index;
+                else
+                    sample_description_index = trex->default_sample_description_index;
+                isom_sample_entry_t *description = (isom_sample_entry_t *)lsmash_list_get_entry_data( &walker->stsd->list, sample_description_index );
+                is_lpcm_audio = LSMASH_IS_EXISTING_BOX( description ) ? isom_is_lpcm_audio( description ) : 0;
+                /* Reference media data. */
+                isom_dref_entry_t *dref_entry = (isom_dref_entry_t *)lsmash_list_get_entry_data( walker->dref_list, LSMASH_IS_EXISTING_BOX( description ) ? description->data_reference_index : 0 );
+                lsmash_file_t *ref_file = (!dref_entry || LSMASH_IS_NON_EXISTING_BOX( dref_entry->ref_file )) ? NULL : dref_entry->ref_file;
+                /* Each track run can be considered as a chunk.
+                 * Here, we consider physically consecutive track runs as one chunk. */
+                isom_portable_chunk_t *chunk = &walker->chunk;
+                if( chunk->data_offset + chunk->length != data_offset || chunk->file != ref_file )
+                {
+                    chunk->data_offset = data_offset;
+                    chunk->length      = 0;
+                    chunk->number      = ++ walker->chunk_number;
+                    chunk->file        = ref_file;
+                    if( (err = isom_add_portable_chunk_entry( timeline, chunk )) < 0 )
+                        return err;
+                }
+                /* Get dependency info for this track fragment. */
+                sdtp_entry = traf->sdtp->list ? traf->sdtp->list->head : NULL;
+                sdtp_data  = sdtp_entry && sdtp_entry->data ? (isom_sdtp_entry_t *)sdtp_entry->data : NULL;
+            }
+            /* Get info of each sample. */
+            lsmash_entry_t *row_entry = trun->optional && trun->optional->head ? trun->optional->head : NULL;
+            uint32_t sample_number = 1;
+            while( sample_number <= trun->sample_count )
+            {
+                isom_sample_info_t info = { 0 };
+                isom_trun_optional_row_t *row = row_entry && row_entry->data ? (isom_trun_optional_row_t *)row_entry->data : NULL;
+                /* Get sample_size */
+                if( row && (trun->flags & ISOM_TR_FLAGS_SAMPLE_SIZE_PRESENT) )
+                    info.length = row->sample_size;
+                else if( tfhd->flags & ISOM_TF_FLAGS_DEFAULT_SAMPLE_SIZE_PRESENT )
+                    info.length = tfhd->default_sample_size;
+                else
+                    info.length = trex->default_sample_size;
+                if( !need_data_offset_only )
+                {
+                    info.pos   = data_offset;
+                    info.index = sample_description_index;
+                    info.chunk = isom_get_last_portable_chunk( timeline );
+                    info.chunk->length += info.length;
+                    /* Get sample_duration. */
+                    if( row && (trun->flags & ISOM_TR_FLAGS_SAMPLE_DURATION_PRESENT) )
+                        info.duration = row->sample_duration;
+                    else if( tfhd->flags & ISOM_TF_FLAGS_DEFAULT_SAMPLE_DURATION_PRESENT )
+                        info.duration = tfhd->default_sample_duration;
+                    else
+                        info.duration = trex->default_sample_duration;
+                    /* Get composition time offset. */
+                    if( row && (trun->flags & ISOM_TR_FLAGS_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) )
+                    {
+                        info.offset = row->sample_composition_time_offset;
+                        /* Check composition to decode timeline shift. */
+                        if( file->max_isom_version >= 6 && trun->version != 0 && info.offset != ISOM_NON_OUTPUT_SAMPLE_OFFSET )
+                        {
+                            uint64_t cts = walker->dts + (int32_t)info.offset;
+                            if( (cts + timeline->ctd_shift) < walker->dts )
+                                timeline->ctd_shift = walker->dts - cts;
+                        }
+                    }
+                    else
+                        info.offset = 0;
+                    walker->dts += info.duration;
+                    /* Update media duration and maximun sample size. */
+                    timeline->media_duration += info.duration;
+                    timeline->max_sample_size = LSMASH_MAX( timeline->max_sample_size, info.length );
+                    if( !is_lpcm_audio )
+                    {
+                        /* Get sample_flags. */
+                        isom_sample_flags_t sample_flags;
+                        if( sample_number == 1 && (trun->flags & ISOM_TR_FLAGS_FIRST_SAMPLE_FLAGS_PRESENT) )
+                            sample_flags = trun->first_sample_flags;
+                        else if( row && (trun->flags & ISOM_TR_FLAGS_SAMPLE_FLAGS_PRESENT) )
+                            sample_flags = row->sample_flags;
+                        else if( tfhd->flags & ISOM_TF_FLAGS_DEFAULT_SAMPLE_FLAGS_PRESENT )
+                            sample_flags = tfhd->default_sample_flags;
+                        else
+                            sample_flags = trex->default_sample_flags;
+                        if( sdtp_data )
+                        {
+                            /* Independent and Disposable Samples Box overrides the information from sample_flags.
+                             * There is no description in the specification about this, but the intention should be such a thing.
+                             * The ground is that sample_flags is placed in media layer
+                             * while Independent and Disposable Samples Box is placed in track or presentation layer. */
+                            info.prop.leading     = sdtp_data->is_leading;
+                            info.prop.independent = sdtp_data->sample_depends_on;
+                            info.prop.disposable  = sdtp_data->sample_is_depended_on;
+                            info.prop.redundant   = sdtp_data->sample_has_redundancy;
+                            if( sdtp_entry )
+                                sdtp_entry = sdtp_entry->next;
+                            sdtp_data = sdtp_entry ? (isom_sdtp_entry_t *)sdtp_entry->data : NULL;
+                        }
+                        else
+                        {
+                            info.prop.leading     = sample_flags.is_leading;
+                            info.prop.independent = sample_flags.sample_depends_on;
+                            info.prop.disposable  = sample_flags.sample_is_depended_on;
+                            info.prop.redundant   = sample_flags.sample_has_redundancy;
+                        }
+                        /* Check this sample is a sync sample or not.
+                         * Note: all sync sample shall be independent. */
+                        if( !sample_flags.sample_is_non_sync_sample
+                         && info.prop.independent != ISOM_SAMPLE_IS_NOT_INDEPENDENT )
+                        {
+                            info.prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
+                            walker->distance = 0;
+                        }
+                        /* Get roll recovery grouping info. */
+                        uint32_t roll_id = timeline->sample_count + sample_number;
+                        if( sbgp_roll_entry
+                         && (err = isom_get_roll_recovery_grouping_info( timeline,
+                                                                         &sbgp_roll_entry, walker->sgpd_roll, sgpd_frag_roll,
+                                                                         &walker->sample_number_in_sbgp_roll_entry,
+                                                                         &info, roll_id )) < 0 )
+                            return err;
+                        info.prop.post_roll.identifier = roll_id;
+                        /* Get random access point grouping info. */
+                        if( sbgp_rap_entry
+                         && (err = isom_get_random_access_point_grouping_info( timeline,
+                                                                               &sbgp_rap_entry, walker->sgpd_rap, sgpd_frag_rap,
+                                                                               &walker->sample_number_in_sbgp_rap_entry,
+                                                                               &info, &walker->distance )) < 0 )
+                            return err;
+                        /* Get the location of the sync sample from 'tfra' if it is not set up yet.
+                         * Note: there is no guarantee that its entries are placed in a specific order. */
+                        isom_tfra_t *tfra = walker->tfra;
+                        if( LSMASH_IS_EXISTING_BOX( tfra ) )
+                        {
+                            if( tfra->number_of_entry == 0
+                             && info.prop.ra_flags == ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
+                                info.prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
+                            isom_tfra_location_time_entry_t *rap = walker->rap;
+                            if( rap
+                             && rap->moof_offset   == moof->pos
+                             && rap->traf_number   == traf_number
+                             && rap->trun_number   == trun_number
+                             && rap->sample_number == sample_number )
+                            {
+                                if( info.prop.ra_flags == ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
+                                    info.prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
+                                if( walker->tfra_entry )
+                                    walker->tfra_entry = walker->tfra_entry->next;
+                                walker->rap = walker->tfra_entry ? (isom_tfra_location_time_entry_t *)walker->tfra_entry->data : NULL;
+                            }
+                        }
+                        /* Set up distance from the previous random access point. */
+                        if( walker->distance != NO_RANDOM_ACCESS_POINT )
+                        {
+                            if( info.prop.pre_roll.distance == 0 )
+                                info.prop.pre_roll.distance = walker->distance;
+                            ++ walker->distance;
+                        }
+                        /* OK. Let's add its info. */
+                        if( (err = isom_add_sample_info_entry( timeline, &info )) < 0 )
+                            return err;
+                    }
+                    else
+                    {
+                        /* All LPCMFrame is a sync sample. */
+                        info.prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
+                        /* OK. Let's add its info. */
+                        isom_lpcm_bunch_t *bunch = &walker->bunch;
+                        if( bunch->sample_count == 0 )
+                            isom_update_bunch( bunch, &info );
+                        else if( isom_compare_lpcm_sample_info( bunch, &info ) )
+                        {
+                            if( (err = isom_add_lpcm_bunch_entry( timeline, bunch )) < 0 )
+                                return err;
+                            isom_update_bunch( bunch, &info );
+                        }
+                        else
+                            ++ bunch->sample_count;
+                    }
+                    if( timeline->info_count
+                     && (timeline->bunch_count || walker->bunch.sample_count) )
+                    {
+                        lsmash_log( timeline, LSMASH_LOG_ERROR, "LPCM + non-LPCM track is not supported.\n" );
+                        return LSMASH_ERR_PATCH_WELCOME;
+                    }
+                }
+                data_offset += info.length;
+                last_sample_end_pos = data_offset;
+                if( row_entry )
+                    row_entry = row_entry->next;
+                ++sample_number;
+            }
+            if( !need_data_offset_only )
+                timeline->sample_count += sample_number - 1;
+            ++trun_number;
+        }   /* Track runs */
+        ++traf_number;
+    }   /* Track fragments */
+    return 0;
+}
+
+/* Get the summary of the samples of the track in a movie fragment.
+ * The summary got last is reused since the movie fragment following a skipped one is skimmed again when reached. */
+static int isom_timeline_skim_fragment( isom_timeline_t *timeline, isom_fragment_walker_t *walker, isom_moof_t *moof, isom_fragment_summary_t *summary )
+{
+    if( walker->skimmed_moof != moof )
+    {
+        walker->skimmed_moof = NULL;
+        int err = isom_skim_fragment( walker->file, moof, timeline->track_ID, &walker->skimmed );
+        if( err < 0 )
+            return err;
+        walker->skimmed_moof = moof;
+    }
+    *summary = walker->skimmed;
+    return 0;
+}
+
+/* Skip a movie fragment instead of walking it if neither the sample of a given number nor the sample at a given
+ * decoding time is in it. The samples in it are counted by skimming it, and its duration is derived from the decoding
+ * time of the next movie fragment having samples of the track, so the sample numbers and the decoding times of the
+ * samples after it are known without walking it.
+ * Return 1 if skipped, 0 if it has to be walked, or a negative value if any error. */
+static int isom_timeline_skip_fragment( isom_timeline_t *timeline, isom_fragment_walker_t *walker, isom_moof_t *moof,
+                                        uint32_t sample_number, uint64_t time )
+{
+    /* LPCM samples are bunched while walked, so they are never skipped. */
+    if( walker->no_skip || timeline->info_count == 0 || LSMASH_IS_NON_EXISTING_BOX( moof ) )
+        return 0;
+    isom_fragment_summary_t summary;
+    if( isom_timeline_skim_fragment( timeline, walker, moof, &summary ) < 0 )
+    {
+        /* Leave the error to the walk. */
+        walker->no_skip = 1;
+        return 0;
+    }
+    if( summary.sample_count == 0 )
+        return 1;   /* Nothing to be walked for the track. */
+    if( !summary.base_media_decode_time_present
+     || summary.sample_count > UINT32_MAX - timeline->sample_count )
+        return 0;
+    isom_fragment_summary_t next = { 0 };
+    lsmash_entry_t *entry;
+    for( entry = walker->moof_entry; entry; entry = entry->next )
+    {
+        isom_moof_t *next_moof = (isom_moof_t *)entry->data;
+        if( !next_moof || isom_timeline_skim_fragment( timeline, walker, next_moof, &next ) < 0 )
+            return 0;
+        if( next.sample_count )
+            break;
+    }
+    if( !entry
+     || !next.base_media_decode_time_present
+     ||  next.base_media_decode_time < summary.base_media_decode_time
+     ||  next.base_media_decode_time - summary.base_media_decode_time > UINT32_MAX )
+        return 0;
+    uint32_t duration = next.base_media_decode_time - summary.base_media_decode_time;
+    if( (timeline->sample_count < sample_number && timeline->sample_count + summary.sample_count >= sample_number)
+     || (time != UINT64_MAX && timeline->media_duration <= time && timeline->media_duration + duration > time) )
+        return 0;
+    isom_skipped_fragment_t *skipped = isom_expand_timeline_array( walker->skipped, &walker->skipped_alloc,
+                                                                   walker->skipped_count, sizeof(isom_skipped_fragment_t) );
+    if( !skipped )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    walker->skipped = skipped;
+    skipped = &walker->skipped[ walker->skipped_count ];
+    skipped->moof                = moof;
+    skipped->first_sample_number = timeline->sample_count + 1;
+    skipped->sample_count        = summary.sample_count;
+    skipped->info_index          = timeline->info_count;
+    skipped->duration            = duration;
+    skipped->dts                 = walker->dts;
+    ++ walker->skipped_count;
+    /* Negative composition time offsets grow the shift even if not walked. */
+    if( timeline->ctd_shift < -(int64_t)summary.min_composition_offset )
+        timeline->ctd_shift = -(int64_t)summary.min_composition_offset;
+    timeline->sample_count   += summary.sample_count;
+    timeline->media_duration += duration;
+    /* The state carried over from the skipped movie fragment is unknown until it is walked. */
+    walker->dts     += duration;
+    walker->distance = NO_RANDOM_ACCESS_POINT;
+    walker->sample_number_in_sbgp_roll_entry = 1;
+    walker->sample_number_in_sbgp_rap_entry  = 1;
+    walker->chunk.data_offset = 0;
+    walker->chunk.length      = 0;
+    while( walker->rap && walker->rap->moof_offset <= moof->pos )
+    {
+        walker->tfra_entry = walker->tfra_entry ? walker->tfra_entry->next : NULL;
+        walker->rap        = walker->tfra_entry ? (isom_tfra_location_time_entry_t *)walker->tfra_entry->data : NULL;
+    }
+    return 1;
+}
+
+static inline int isom_timeline_needs_extension( isom_timeline_t *timeline, uint32_t sample_number, uint64_t time )
+{
+    return timeline->walker
+        && (timeline->walker->moof_entry || timeline->walk_error)
+        && (timeline->sample_count < sample_number || (time != UINT64_MAX && timeline->media_duration <= time));
+}
+
+/* Release the walker if no movie fragment is left to be walked.
+ * The walker failed to walk is kept so that the timeline never looks complete. */
+static void isom_timeline_check_walk_end( isom_timeline_t *timeline )
+{
+    isom_fragment_walker_t *walker = timeline->walker;
+    if( walker && !walker->moof_entry && walker->skipped_count == 0 && !timeline->walk_error )
+    {
+        isom_destroy_fragment_walker( walker );
+        timeline->walker = NULL;
+    }
+}
+
+/* Get the distance of a sample from the previous random access point.
+ * If it is unknown because of a skipped movie fragment, the number of the last sample in it is also got. */
+static uint32_t isom_get_distance_from_previous_rap( isom_timeline_t *timeline, uint32_t sample_number, uint32_t *skipped_number )
+{
+    *skipped_number = 0;
+    uint32_t index;
+    uint32_t skipped_index;
+    isom_get_sample_info_index( timeline, sample_number, &index, &skipped_index );
+    /* the last skipped movie fragment before the sample */
+    isom_skipped_fragment_t *skipped = skipped_index ? &timeline->walker->skipped[skipped_index - 1] : NULL;
+    for( uint32_t i = index; i; i-- )
+    {
+        if( skipped && skipped->info_index == i )
+        {
+            *skipped_number = skipped->first_sample_number - 1 + skipped->sample_count;
+            break;
+        }
+        isom_sample_info_t *info = &timeline->info_array[i - 1];
+        if( info->prop.ra_flags & (ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC | ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP) )
+            return index - i + 1;
+    }
+    return NO_RANDOM_ACCESS_POINT;
+}
+
+/* Walk a skipped movie fragment and insert the sample info of its samples. */
+static int isom_timeline_fill_skipped_fragment( isom_timeline_t *timeline, uint32_t index )
+{
+    isom_fragment_walker_t *walker  = timeline->walker;
+    isom_skipped_fragment_t skipped = walker->skipped[index];
+    uint32_t first = skipped.first_sample_number;
+    int err = isom_update_dts_array( timeline );
+    if( err < 0 )
+        return err;
+    /* Walk it by a copy of the walker set up for the beginning of it. */
+    isom_fragment_walker_t local = *walker;
+    local.dts      = walker->skipped[index].dts;
+    uint32_t skipped_number;
+    local.distance = isom_get_distance_from_previous_rap( timeline, first, &skipped_number );
+    local.sample_number_in_sbgp_roll_entry = 1;
+    local.sample_number_in_sbgp_rap_entry  = 1;
+    local.chunk.data_offset = 0;
+    local.chunk.length      = 0;
+    local.tfra_entry = local.tfra->list ? local.tfra->list->head : NULL;
+    local.rap        = local.tfra_entry ? (isom_tfra_location_time_entry_t *)local.tfra_entry->data : NULL;
+    while( local.rap && local.rap->moof_offset < skipped.moof->pos )
+    {
+        local.tfra_entry = local.tfra_entry->next;
+        local.rap        = local.tfra_entry ? (isom_tfra_location_time_entry_t *)local.tfra_entry->data : NULL;
+    }
+    /* The samples are added to an array of their own so that the others are never broken by any inconsistency. */
+    isom_sample_info_t *info_array      = timeline->info_array;
+    uint32_t            info_count      = timeline->info_count;
+    uint32_t            info_alloc      = timeline->info_alloc;
+    uint32_t            sample_count    = timeline->sample_count;
+    uint64_t            media_duration  = timeline->media_duration;
+    timeline->info_array   = NULL;
+    timeline->info_count   = 0;
+    timeline->info_alloc   = 0;
+    timeline->sample_count = first - 1;
+    if( (err = isom_reserve_sample_info_entries( timeline, skipped.sample_count )) == 0
+     && (err = isom_timeline_walk_fragment( timeline, &local, skipped.moof )) == 0
+     && timeline->info_count != skipped.sample_count )
+        err = LSMASH_ERR_INVALID_DATA;
+    isom_sample_info_t *walked          = timeline->info_array;
+    uint64_t            walked_duration = timeline->media_duration - media_duration;
+    timeline->info_array     = info_array;
+    timeline->info_count     = info_count;
+    timeline->info_alloc     = info_alloc;
+    timeline->sample_count   = sample_count;
+    timeline->media_duration = media_duration;
+    /* Chunks may have been added even if failed. */
+    walker->chunk_number      = local.chunk_number;
+    walker->chunk.data_offset = 0;
+    walker->chunk.length      = 0;
+    if( err == 0 && info_count > UINT32_MAX - skipped.sample_count )
+        err = LSMASH_ERR_MEMORY_ALLOC;
+    if( err == 0 && (err = isom_reserve_sample_info_entries( timeline, info_count + skipped.sample_count )) == 0 )
+        info_array = timeline->info_array;
+    if( err < 0 )
+    {
+        lsmash_free( walked );
+        lsmash_log( timeline, LSMASH_LOG_ERROR, "failed to walk a skipped movie fragment.\n" );
+        return err;
+    }
+    /* Insert the sample info of the samples in place of the skipped movie fragment. */
+    uint32_t at = skipped.info_index;
+    memmove( &info_array[at + skipped.sample_count], &info_array[at], (info_count - at) * sizeof(isom_sample_info_t) );
+    memcpy( &info_array[at], walked, skipped.sample_count * sizeof(isom_sample_info_t) );
+    lsmash_free( walked );
+    timeline->info_count    += skipped.sample_count;
+    timeline->media_duration = media_duration - skipped.duration + walked_duration;
+    memmove( &walker->skipped[index], &walker->skipped[index + 1], (walker->skipped_count - index - 1) * sizeof(isom_skipped_fragment_t) );
+    -- walker->skipped_count;
+    for( uint32_t i = index; i < walker->skipped_count; i++ )
+        walker->skipped[i].info_index += skipped.sample_count;
+    /* Make the decoding timestamps of the samples and the following ones. */
+    walker->dts += walked_duration - skipped.duration;
+    timeline->dts_count = at;
+    if( (err = isom_update_dts_array( timeline )) < 0 )
+        return err;
+    lsmash_freep( &timeline->cts_index );
+    timeline->cts_index_count = 0;
+    /* Set up the distances of the following samples from the random access point in this movie fragment
+     * until the next skipped movie fragment. */
+    if( local.distance != NO_RANDOM_ACCESS_POINT )
+    {
+        uint32_t end = index < walker->skipped_count ? walker->skipped[index].info_index : timeline->info_count;
+        uint32_t distance = local.distance;
+        uint32_t i;
+        for( i = at + skipped.sample_count; i < end; i++ )
+        {
+            isom_sample_info_t *info = &info_array[i];
+            if( info->prop.ra_flags & (ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC | ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP) )
+                break;
+            if( info->prop.pre_roll.distance == 0 )
+                info->prop.pre_roll.distance = distance;
+            ++distance;
+        }
+        if( i == timeline->info_count && index == walker->skipped_count && walker->distance == NO_RANDOM_ACCESS_POINT )
+            walker->distance = distance;
+    }
+    isom_timeline_check_walk_end( timeline );
+    return 0;
+}
+
+/* Walk the skipped movie fragments back from the sample of a given number until the distances of the samples from
+ * the random access point are known. */
+static int isom_timeline_walk_back( isom_timeline_t *timeline, uint32_t sample_number )
+{
+    uint32_t skipped_number;
+    uint32_t index;
+    isom_sample_info_t *info;
+    while( timeline->walker
+        && (info = isom_get_sample_info( timeline, sample_number ))
+        && !(info->prop.ra_flags & (ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC | ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP))
+        && isom_get_distance_from_previous_rap( timeline, sample_number, &skipped_number ) == NO_RANDOM_ACCESS_POINT
+        && skipped_number
+        && isom_find_skipped_fragment( timeline->walker, skipped_number, &index ) )
+    {
+        sample_number = timeline->walker->skipped[index].first_sample_number;
+        int err = isom_timeline_fill_skipped_fragment( timeline, index );
+        if( err < 0 )
+            return err;
+    }
+    return 0;
+}
+
+/* Walk a skipped movie fragment.
+ * The distances from the random access point of the samples before the first random access point in it are carried
+ * over from the previous movie fragments, so the skipped ones are also walked back until the distances are known. */
+static int isom_timeline_walk_skipped_fragment( isom_timeline_t *timeline, uint32_t index )
+{
+    uint32_t first = timeline->walker->skipped[index].first_sample_number;
+    int err = isom_timeline_fill_skipped_fragment( timeline, index );
+    if( err < 0 )
+        return err;
+    return isom_timeline_walk_back( timeline, first );
+}
+
+/* Walk the skipped movie fragments containing any sample in a given range of sample numbers. */
+static int isom_timeline_walk_skipped_fragments( isom_timeline_t *timeline, uint32_t first_sample_number, uint32_t last_sample_number )
+{
+    uint32_t index;
+    while( timeline->walker
+        && (isom_find_skipped_fragment( timeline->walker, first_sample_number, &index ) || index < timeline->walker->skipped_count)
+        && timeline->walker->skipped[index].first_sample_number <= last_sample_number )
+    {
+        int err = isom_timeline_walk_skipped_fragment( timeline, index );
+        if( err < 0 )
+            return err;
+    }
+    return 0;
+}
+
+/* Extend the timeline by walking movie fragments until it contains both the sample of a given number and the sample
+ * at a given decoding time, or until all movie fragments are walked. UINT64_MAX as 'time' means no time is given.
+ * Movie fragments before the required sample are skipped unless skipping is disabled. */
+static int isom_timeline_extend( isom_timeline_t *timeline, uint32_t sample_number, uint64_t time )
+{
+    if( !isom_timeline_needs_extension( timeline, sample_number, time ) )
+        return 0;
+    if( timeline->walk_error )
+        return timeline->walk_error;    /* The samples beyond the movie fragment failed to be walked are unknown. */
+    isom_fragment_walker_t *walker = timeline->walker;
+    int err = 0;
+    uint32_t first_unknown = 0;     /* first sample walked without knowing its distance from the random access point */
+    while( isom_timeline_needs_extension( timeline, sample_number, time ) )
+    {
+        isom_moof_t *moof = (isom_moof_t *)walker->moof_entry->data;
+        walker->moof_entry = walker->moof_entry->next;
+        int skipped = isom_timeline_skip_fragment( timeline, walker, moof, sample_number, time );
+        if( skipped == 0 )
+        {
+            if( first_unknown == 0 && walker->distance == NO_RANDOM_ACCESS_POINT && walker->skipped_count )
+                first_unknown = timeline->sample_count + 1;
+            err = isom_timeline_walk_fragment( timeline, walker, moof );
+        }
+        else if( skipped < 0 )
+            err = skipped;
+        if( err < 0 )
+        {
+            lsmash_log( timeline, LSMASH_LOG_ERROR, "failed to walk a movie fragment.\n" );
+            break;
+        }
+    }
+    /* Make the samples walked so far accessible. */
+    if( walker->bunch.sample_count )
+    {
+        int ret = isom_add_lpcm_bunch_entry( timeline, &walker->bunch );
+        if( ret < 0 && err == 0 )
+            err = ret;
+        walker->bunch.sample_count = 0;
+    }
+    int ret = isom_update_dts_array( timeline );
+    if( ret < 0 && err == 0 )
+        err = ret;
+    lsmash_freep( &timeline->cts_index );
+    timeline->cts_index_count = 0;
+    if( err == 0 && first_unknown && first_unknown <= timeline->sample_count )
+        err = isom_timeline_walk_back( timeline, first_unknown );
+    if( err < 0 )
+        timeline->walk_error = err;
+    else
+        isom_timeline_check_walk_end( timeline );
+    return err;
+}
+
+/* Make the sample of a given number accessible if present.
+ * UINT32_MAX as 'sample_number' requires the complete timeline. */
+static int isom_timeline_prepare_sample( isom_timeline_t *timeline, uint32_t sample_number )
+{
+    if( sample_number == UINT32_MAX )
+        return isom_timeline_complete( timeline );
+    int err = isom_timeline_extend( timeline, sample_number, UINT64_MAX );
+    if( err < 0 )
+        return err;
+    return isom_timeline_walk_skipped_fragments( timeline, sample_number, sample_number );
+}
+
+int isom_timeline_complete( isom_timeline_t *timeline )
+{
+    if( !timeline || !timeline->walker )
+        return 0;
+    timeline->walker->no_skip = 1;
+    int err = isom_timeline_extend( timeline, UINT32_MAX, UINT64_MAX );
+    if( err < 0 )
+        return err;
+    return isom_timeline_walk_skipped_fragments( timeline, 1, UINT32_MAX );
+}
+
+/* Fix the composition to decode timeline shift, which grows as samples with negative composition time offsets are
+ * walked, before getting any composition timestamp. The rest of the movie fragments are skimmed, where the negative
+ * offsets in the skipped ones are also taken into the shift, so no movie fragment is walked just for the shift. */
+static int isom_timeline_fix_ctd_shift( isom_timeline_t *timeline )
+{
+    if( !timeline->walker || timeline->walker->ctd_shift_fixed )
+        return 0;
+    if( timeline->walker->file->max_isom_version >= 6 )
+    {
+        int err = isom_timeline_extend( timeline, UINT32_MAX, UINT64_MAX );
+        if( err < 0 )
+            return err;
+    }
+    if( timeline->walker )
+        timeline->walker->ctd_shift_fixed = 1;
+    return 0;
+}
+
+/* Get the timeline extended to contain the sample of a given number if present.
+ * UINT32_MAX as 'sample_number' requires the complete timeline.
+ * Return 0 if successful, or a negative value if the timeline is not found or any movie fragment failed to be walked. */
+static int isom_get_extended_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_number, isom_timeline_t **timeline_p )
+{
+    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
+    if( !timeline )
+        return LSMASH_ERR_NAMELESS;
+    int err = isom_timeline_prepare_sample( timeline, sample_number );
+    if( err < 0 )
+        return err;
+    *timeline_p = timeline;
+    return 0;
+}
+
+/* Same as above, but the composition to decode timeline shift is also fixed to get composition timestamps. */
+static int isom_get_extended_timeline_with_cts( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_number, isom_timeline_t **timeline_p )
+{
+    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
+    if( !timeline )
+        return LSMASH_ERR_NAMELESS;
+    int err;
+    if( (err = isom_timeline_fix_ctd_shift( timeline )) < 0
+     || (err = isom_timeline_prepare_sample( timeline, sample_number )) < 0 )
+        return err;
+    *timeline_p = timeline;
+    return 0;
+}
+
+int isom_timeline_construct( lsmash_root_t *root, uint32_t track_ID )
+{
+    if( isom_check_initializer_present( root ) < 0 )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    lsmash_file_t *file = root->file;
+    if( LSMASH_IS_NON_EXISTING_BOX( file->moov->mvhd )
+     ||  file->moov->mvhd->timescale == 0 )
+        return LSMASH_ERR_INVALID_DATA;
+    /* Get track by track_ID. */
+    isom_trak_t *trak = isom_get_trak( file, track_ID );
+    if( LSMASH_IS_NON_EXISTING_BOX( trak->tkhd )
+     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->mdhd )
+     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stco )
+     || LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stsd )
+     || (LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stsz ) && LSMASH_IS_NON_EXISTING_BOX( trak->mdia->minf->stbl->stz2 ))
+     ||  trak->mdia->mdhd->timescale == 0 )
+        return LSMASH_ERR_INVALID_DATA;
+    /* Create a timeline list if it doesn't exist. */
+    if( !file->timeline )
+    {
+        file->timeline = lsmash_list_create( isom_timeline_destroy );
+        if( !file->timeline )
+            return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    /* Create a timeline. */
+    isom_timeline_t *timeline = isom_timeline_create();
+    if( !timeline )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    timeline->track_ID        = track_ID;
+    timeline->movie_timescale = file->moov->mvhd->timescale;
+    timeline->media_timescale = trak->mdia->mdhd->timescale;
+    timeline->track_duration  = trak->tkhd->duration;
+    /* Preparation for construction. */
+    isom_elst_t *elst = trak->edts->elst;
+    isom_minf_t *minf = trak->mdia->minf;
+    isom_dref_t *dref = minf->dinf->dref;
+    isom_stbl_t *stbl = minf->stbl;
+    isom_stsd_t *stsd = stbl->stsd;
+    isom_stts_t *stts = stbl->stts;
+    isom_ctts_t *ctts = stbl->ctts;
+    isom_stss_t *stss = stbl->stss;
+    isom_stps_t *stps = stbl->stps;
+    isom_sdtp_t *sdtp = stbl->sdtp;
+    isom_stsc_t *stsc = stbl->stsc;
+    isom_stsz_t *stsz = stbl->stsz;
+    isom_stz2_t *stz2 = stbl->stz2;
+    isom_stco_t *stco = stbl->stco;
+    isom_sgpd_t *sgpd_rap  = isom_get_sample_group_description( stbl, ISOM_GROUP_TYPE_RAP );
+    isom_sbgp_t *sbgp_rap  = isom_get_sample_to_group         ( stbl, ISOM_GROUP_TYPE_RAP );
+    isom_sgpd_t *sgpd_roll = isom_get_roll_recovery_sample_group_description( &stbl->sgpd_list );
+    isom_sbgp_t *sbgp_roll = isom_get_roll_recovery_sample_to_group         ( &stbl->sbgp_list );
+    lsmash_entry_t *elst_entry = elst->list ? elst->list->head : NULL;
+    lsmash_entry_t *stss_entry = stss->list ? stss->list->head : NULL;
+    lsmash_entry_t *stps_entry = stps->list ? stps->list->head : NULL;
+    lsmash_entry_t *sdtp_entry = sdtp->list ? sdtp->list->head : NULL;
+    lsmash_entry_t *sbgp_roll_entry = sbgp_roll->list ? sbgp_roll->list->head : NULL;
+    lsmash_entry_t *sbgp_rap_entry  = sbgp_rap->list  ? sbgp_rap->list->head  : NULL;
+    isom_stsz_entry_t *stsz_entries     = LSMASH_IS_EXISTING_BOX( stsz ) ? stsz->entries     : stz2->entries;
+    uint32_t           stsz_entry_count = LSMASH_IS_EXISTING_BOX( stsz ) ? stsz->entry_count : stz2->entry_count;
+    uint32_t           stts_index       = 0;
+    uint32_t           ctts_index       = 0;
+    uint32_t           stsz_index       = 0;
+    uint32_t           stco_index       = 0;
+    uint32_t           next_stsc_index  = 1;
+    isom_stsc_entry_t *stsc_data = stsc->entry_count ? &stsc->entries[0] : NULL;
+    int err = LSMASH_ERR_INVALID_DATA;
+    int movie_fragments_present = (LSMASH_IS_EXISTING_BOX( file->moov->mvex ) && file->moof_list.head);
+    if( !movie_fragments_present && (stts->entry_count == 0 || stsc->entry_count == 0 || stco->entry_count == 0) )
+        goto fail;
+    isom_sample_entry_t *description = (isom_sample_entry_t *)lsmash_list_get_entry_data( &stsd->list, stsc_data ? stsc_data->sample_description_index : 1 );
+    if( LSMASH_IS_NON_EXISTING_BOX( description ) )
+        goto fail;
+    lsmash_entry_list_t *dref_list = LSMASH_IS_EXISTING_BOX( dref ) ? &dref->list : NULL;
+    isom_dref_entry_t *dref_entry = (isom_dref_entry_t *)lsmash_list_get_entry_data( dref_list, description->data_reference_index );
+    int all_sync = LSMASH_IS_NON_EXISTING_BOX( stss );
+    int large_presentation = stco->large_presentation || lsmash_check_box_type_identical( stco->type, ISOM_BOX_TYPE_CO64 );
+    int is_lpcm_audio          = isom_is_lpcm_audio( description );
+    int is_qt_fixed_comp_audio = isom_is_qt_fixed_compressed_audio( description );
+    int iso_sdtp = file->max_isom_version >= 2 || file->avc_extensions;
+    int allow_negative_sample_offset = ctts && ((file->max_isom_version >= 4 && ctts->version == 1) || file->qt_compatible);
+    uint32_t sample_number_in_stts_entry      = 1;
+    uint32_t sample_number_in_ctts_entry      = 1;
+    uint32_t sample_number_in_sbgp_roll_entry = 1;
+    uint32_t sample_number_in_sbgp_rap_entry  = 1;
+    uint64_t dts               = 0;
+    uint32_t chunk_number      = 1;
+    uint64_t offset_from_chunk = 0;
+    uint64_t data_offset = stco->entry_count
+                         ? large_presentation
+                             ? stco->entries.co64[0].chunk_offset
+                             : stco->entries.stco[0].chunk_offset
+                         : 0;
     uint32_t initial_movie_sample_count = LSMASH_IS_EXISTING_BOX( stsz ) ? stsz->sample_count : stz2->sample_count;
     uint32_t samples_per_packet;
     uint32_t constant_sample_size;
@@ -895,6 +1921,10 @@ int isom_timeline_construct( lsmash_root_t *root, uint32_t track_ID )
     chunk.file        = (!dref_entry || LSMASH_IS_NON_EXISTING_BOX( dref_entry->ref_file )) ? NULL : dref_entry->ref_file;
     if( (err = isom_add_portable_chunk_entry( timeline, &chunk )) < 0 )
         goto fail;
+    /* Allocate all sample entries at once for non-LPCM tracks since their number is known here. */
+    if( !is_lpcm_audio && !is_qt_fixed_comp_audio
+     && (err = isom_reserve_sample_info_entries( timeline, initial_movie_sample_count )) < 0 )
+        goto fail;
     uint32_t distance      = NO_RANDOM_ACCESS_POINT;
     uint32_t last_duration = UINT32_MAX;
     uint32_t packet_number = 1;
@@ -906,24 +1936,20 @@ int isom_timeline_construct( lsmash_root_t *root, uint32_t track_ID )
         for( uint32_t i = 0; i < samples_per_packet; i++ )
         {
             /* sample duration */
-            if( stts_entry )
+            if( stts_index < stts->entry_count )
             {
-                isom_stts_entry_t *stts_data = (isom_stts_entry_t *)stts_entry->data;
-                if( !stts_data )
-                    goto fail;
-                isom_increment_sample_number_in_entry( &sample_number_in_stts_entry, &stts_entry, stts_data->sample_count );
+                isom_stts_entry_t *stts_data = &stts->entries[stts_index];
+                isom_increment_sample_number_in_table( &sample_number_in_stts_entry, &stts_index, stts_data->sample_count );
                 last_duration = stts_data->sample_delta;
             }
             info.duration += last_duration;
             dts           += last_duration;
             /* sample offset */
             uint32_t sample_offset;
-            if( ctts_entry )
+            if( ctts_index < ctts->entry_count )
             {
-                isom_ctts_entry_t *ctts_data = (isom_ctts_entry_t *)ctts_entry->data;
-                if( !ctts_data )
-                    goto fail;
-                isom_increment_sample_number_in_entry( &sample_number_in_ctts_entry, &ctts_entry, ctts_data->sample_count );
+                isom_ctts_entry_t *ctts_data = &ctts->entries[ctts_index];
+                isom_increment_sample_number_in_table( &sample_number_in_ctts_entry, &ctts_index, ctts_data->sample_count );
                 sample_offset = ctts_data->sample_offset;
                 if( allow_negative_sample_offset && sample_offset != ISOM_NON_OUTPUT_SAMPLE_OFFSET )
                 {
@@ -1012,20 +2038,15 @@ int isom_timeline_construct( lsmash_root_t *root, uint32_t track_ID )
             /* All uncompressed and non-variable compressed audio frame is a sync sample. */
             info.prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
         /* Get size of sample in the stream. */
-        if( is_qt_fixed_comp_audio || !stsz_entry )
+        if( is_qt_fixed_comp_audio || stsz_index >= stsz_entry_count )
             info.length = constant_sample_size;
         else
-        {
-            if( !stsz_entry->data )
-                goto fail;
-            info.length = ((isom_stsz_entry_t *)stsz_entry->data)->entry_size;
-            stsz_entry = stsz_entry->next;
-        }
+            info.length = stsz_entries[ stsz_index ++ ].entry_size;
         timeline->max_sample_size = LSMASH_MAX( timeline->max_sample_size, info.length );
         /* Get chunk info. */
         info.pos   = data_offset;
         info.index = stsc_data->sample_description_index;
-        info.chunk = (isom_portable_chunk_t *)timeline->chunk_list->tail->data;
+        info.chunk = isom_get_last_portable_chunk( timeline );
         offset_from_chunk += info.length;
         if( sample_number_in_chunk == stsc_data->samples_per_chunk )
         {
@@ -1033,37 +2054,28 @@ int isom_timeline_construct( lsmash_root_t *root, uint32_t track_ID )
             if( info.chunk )
                 info.chunk->length = offset_from_chunk;
             /* Move the next chunk. */
-            if( stco_entry )
-                stco_entry = stco_entry->next;
-            if( stco_entry
-             && stco_entry->data )
+            if( stco_index < stco->entry_count )
+                ++stco_index;
+            if( stco_index < stco->entry_count )
                 data_offset = large_presentation
-                            ? ((isom_co64_entry_t *)stco_entry->data)->chunk_offset
-                            : ((isom_stco_entry_t *)stco_entry->data)->chunk_offset;
+                            ? stco->entries.co64[stco_index].chunk_offset
+                            : stco->entries.stco[stco_index].chunk_offset;
             chunk.data_offset = data_offset;
             chunk.length      = 0;
             chunk.number      = ++chunk_number;
             offset_from_chunk = 0;
             /* Check if the next entry is broken. */
-            while( next_stsc_entry && chunk_number > ((isom_stsc_entry_t *)next_stsc_entry->data)->first_chunk )
+            while( next_stsc_index < stsc->entry_count && chunk_number > stsc->entries[next_stsc_index].first_chunk )
             {
                 /* Just skip broken next entry. */
                 lsmash_log( timeline, LSMASH_LOG_WARNING, "ignore broken entry in Sample To Chunk Box.\n" );
                 lsmash_log( timeline, LSMASH_LOG_WARNING, "timeline might be corrupted.\n" );
-                next_stsc_entry = next_stsc_entry->next;
-                if(  next_stsc_entry
-                 && !next_stsc_entry->data )
-                    goto fail;
+                ++next_stsc_index;
             }
             /* Check if the next chunk belongs to the next sequence of chunks. */
-            if( next_stsc_entry && chunk_number == ((isom_stsc_entry_t *)next_stsc_entry->data)->first_chunk )
+            if( next_stsc_index < stsc->entry_count && chunk_number == stsc->entries[next_stsc_index].first_chunk )
             {
-                stsc_entry      = next_stsc_entry;
-                next_stsc_entry = next_stsc_entry->next;
-                if(  next_stsc_entry
-                 && !next_stsc_entry->data )
-                    goto fail;
-                stsc_data = (isom_stsc_entry_t *)stsc_entry->data;
+                stsc_data = &stsc->entries[ next_stsc_index ++ ];
                 /* Update sample description. */
                 description = (isom_sample_entry_t *)lsmash_list_get_entry_data( &stsd->list, stsc_data->sample_description_index );
                 is_lpcm_audio          = LSMASH_IS_EXISTING_BOX( description ) ? isom_is_lpcm_audio( description )                : 0;
@@ -1104,7 +2116,7 @@ int isom_timeline_construct( lsmash_root_t *root, uint32_t track_ID )
         }
         else if( (err = isom_add_sample_info_entry( timeline, &info )) < 0 )
             goto fail;
-        if( timeline->info_list->entry_count && timeline->bunch_list->entry_count )
+        if( timeline->info_count && timeline->bunch_count )
         {
             lsmash_log( timeline, LSMASH_LOG_ERROR, "LPCM + non-LPCM track is not supported.\n" );
             err = LSMASH_ERR_PATCH_WELCOME;
@@ -1113,7 +2125,7 @@ int isom_timeline_construct( lsmash_root_t *root, uint32_t track_ID )
         sample_number += samples_per_packet;
         packet_number += 1;
     }
-    isom_portable_chunk_t *last_chunk = lsmash_list_get_entry_data( timeline->chunk_list, timeline->chunk_list->entry_count );
+    isom_portable_chunk_t *last_chunk = isom_get_last_portable_chunk( timeline );
     if( last_chunk )
     {
         if( offset_from_chunk )
@@ -1121,287 +2133,58 @@ int isom_timeline_construct( lsmash_root_t *root, uint32_t track_ID )
         else
         {
             /* Remove the last invalid chunk. */
-            lsmash_list_remove_entry( timeline->chunk_list, timeline->chunk_list->entry_count );
+            -- timeline->chunk_count;
             --chunk_number;
         }
     }
-    uint32_t sample_count = packet_number - 1;
+    timeline->sample_count = packet_number - 1;
     if( movie_fragments_present )
     {
-        isom_tfra_t                     *tfra       = isom_get_tfra( file->mfra, track_ID );
-        lsmash_entry_t                  *tfra_entry = tfra->list ? tfra->list->head : NULL;
-        isom_tfra_location_time_entry_t *rap        = tfra_entry ? (isom_tfra_location_time_entry_t *)tfra_entry->data : NULL;
-        chunk.data_offset = 0;
-        chunk.length      = 0;
-        /* Movie fragments */
-        for( lsmash_entry_t *moof_entry = file->moof_list.head; moof_entry; moof_entry = moof_entry->next )
+        isom_fragment_walker_t *walker = lsmash_malloc_zero( sizeof(isom_fragment_walker_t) );
+        if( !walker )
         {
-            isom_moof_t *moof = (isom_moof_t *)moof_entry->data;
-            if( LSMASH_IS_NON_EXISTING_BOX( moof ) )
-                goto fail;
-            uint64_t last_sample_end_pos = 0;
-            /* Track fragments */
-            uint32_t traf_number = 1;
-            for( lsmash_entry_t *traf_entry = moof->traf_list.head; traf_entry; traf_entry = traf_entry->next )
-            {
-                isom_traf_t *traf = (isom_traf_t *)traf_entry->data;
-                isom_tfhd_t *tfhd = traf->tfhd;
-                isom_trex_t *trex = isom_get_trex( file->moov->mvex, tfhd->track_ID );
-                if( LSMASH_IS_NON_EXISTING_BOX( trex ) )
-                    goto fail;
-                /* Ignore ISOM_TF_FLAGS_DURATION_IS_EMPTY flag even if set. */
-                if( !traf->trun_list.head )
-                {
-                    ++traf_number;
-                    continue;
-                }
-                /* Get base_data_offset. */
-                uint64_t base_data_offset;
-                if( tfhd->flags & ISOM_TF_FLAGS_BASE_DATA_OFFSET_PRESENT )
-                    base_data_offset = tfhd->base_data_offset;
-                else if( (tfhd->flags & ISOM_TF_FLAGS_DEFAULT_BASE_IS_MOOF) || traf_entry == moof->traf_list.head )
-                    base_data_offset = moof->pos;
-                else
-                    base_data_offset = last_sample_end_pos;
-                /* sample grouping */
-                isom_sgpd_t *sgpd_frag_rap;
-                isom_sgpd_t *sgpd_frag_roll;
-                sgpd_frag_rap   = isom_get_fragment_sample_group_description( traf, ISOM_GROUP_TYPE_RAP );
-                sbgp_rap        = isom_get_fragment_sample_to_group         ( traf, ISOM_GROUP_TYPE_RAP );
-                sbgp_rap_entry  = sbgp_rap->list ? sbgp_rap->list->head : NULL;
-                sgpd_frag_roll  = isom_get_roll_recovery_sample_group_description( &traf->sgpd_list );
-                sbgp_roll       = isom_get_roll_recovery_sample_to_group         ( &traf->sbgp_list );
-                sbgp_roll_entry = sbgp_roll->list ? sbgp_roll->list->head : NULL;
-                int need_data_offset_only = (tfhd->track_ID != track_ID);
-                /* Track runs */
-                uint32_t trun_number = 1;
-                for( lsmash_entry_t *trun_entry = traf->trun_list.head; trun_entry; trun_entry = trun_entry->next )
-                {
-                    isom_trun_t *trun = (isom_trun_t *)trun_entry->data;
-                    if( LSMASH_IS_NON_EXISTING_BOX( trun ) )
-                        goto fail;
-                    if( trun->sample_count == 0 )
-                    {
-                        ++trun_number;
-                        continue;
-                    }
-                    /* Get data_offset. */
-                    if( trun->flags & ISOM_TR_FLAGS_DATA_OFFSET_PRESENT )
-                        data_offset = trun->data_offset + base_data_offset;
-                    else if( trun_entry == traf->trun_list.head )
-                        data_offset = base_data_offset;
-                    else
-                        data_offset = last_sample_end_pos;
-                    /* */
-                    uint32_t sample_description_index = 0;
-                    isom_sdtp_entry_t *sdtp_data = NULL;
-                    if( !need_data_offset_only )
-                    {
-                        /* Get sample_description_index of this track fragment. */
-                        if( tfhd->flags & ISOM_TF_FLAGS_SAMPLE_DESCRIPTION_INDEX_PRESENT )
-                            sample_description_index = tfhd->sample_description_index;
-                        else
-                            sample_description_index = trex->default_sample_description_index;
-                        description   = (isom_sample_entry_t *)lsmash_list_get_entry_data( &stsd->list, sample_description_index );
-                        is_lpcm_audio = LSMASH_IS_EXISTING_BOX( description ) ? isom_is_lpcm_audio( description ) : 0;
-                        /* Reference media data. */
-                        dref_entry = (isom_dref_entry_t *)lsmash_list_get_entry_data( dref_list, LSMASH_IS_EXISTING_BOX( description ) ? description->data_reference_index : 0 );
-                        lsmash_file_t *ref_file = (!dref_entry || LSMASH_IS_NON_EXISTING_BOX( dref_entry->ref_file )) ? NULL : dref_entry->ref_file;
-                        /* Each track run can be considered as a chunk.
-                         * Here, we consider physically consecutive track runs as one chunk. */
-                        if( chunk.data_offset + chunk.length != data_offset || chunk.file != ref_file )
-                        {
-                            chunk.data_offset = data_offset;
-                            chunk.length      = 0;
-                            chunk.number      = ++chunk_number;
-                            chunk.file        = ref_file;
-                            if( (err = isom_add_portable_chunk_entry( timeline, &chunk )) < 0 )
-                                goto fail;
-                        }
-                        /* Get dependency info for this track fragment. */
-                        sdtp_entry = traf->sdtp->list ? traf->sdtp->list->head : NULL;
-                        sdtp_data  = sdtp_entry && sdtp_entry->data ? (isom_sdtp_entry_t *)sdtp_entry->data : NULL;
-                    }
-                    /* Get info of each sample. */
-                    lsmash_entry_t *row_entry = trun->optional && trun->optional->head ? trun->optional->head : NULL;
-                    sample_number = 1;
-                    while( sample_number <= trun->sample_count )
-                    {
-                        isom_sample_info_t info = { 0 };
-                        isom_trun_optional_row_t *row = row_entry && row_entry->data ? (isom_trun_optional_row_t *)row_entry->data : NULL;
-                        /* Get sample_size */
-                        if( row && (trun->flags & ISOM_TR_FLAGS_SAMPLE_SIZE_PRESENT) )
-                            info.length = row->sample_size;
-                        else if( tfhd->flags & ISOM_TF_FLAGS_DEFAULT_SAMPLE_SIZE_PRESENT )
-                            info.length = tfhd->default_sample_size;
-                        else
-                            info.length = trex->default_sample_size;
-                        if( !need_data_offset_only )
-                        {
-                            info.pos   = data_offset;
-                            info.index = sample_description_index;
-                            info.chunk = (isom_portable_chunk_t *)timeline->chunk_list->tail->data;
-                            info.chunk->length += info.length;
-                            /* Get sample_duration. */
-                            if( row && (trun->flags & ISOM_TR_FLAGS_SAMPLE_DURATION_PRESENT) )
-                                info.duration = row->sample_duration;
-                            else if( tfhd->flags & ISOM_TF_FLAGS_DEFAULT_SAMPLE_DURATION_PRESENT )
-                                info.duration = tfhd->default_sample_duration;
-                            else
-                                info.duration = trex->default_sample_duration;
-                            /* Get composition time offset. */
-                            if( row && (trun->flags & ISOM_TR_FLAGS_SAMPLE_COMPOSITION_TIME_OFFSET_PRESENT) )
-                            {
-                                info.offset = row->sample_composition_time_offset;
-                                /* Check composition to decode timeline shift. */
-                                if( file->max_isom_version >= 6 && trun->version != 0 && info.offset != ISOM_NON_OUTPUT_SAMPLE_OFFSET )
-                                {
-                                    uint64_t cts = dts + (int32_t)info.offset;
-                                    if( (cts + timeline->ctd_shift) < dts )
-                                        timeline->ctd_shift = dts - cts;
-                                }
-                            }
-                            else
-                                info.offset = 0;
-                            dts += info.duration;
-                            /* Update media duration and maximun sample size. */
-                            timeline->media_duration += info.duration;
-                            timeline->max_sample_size = LSMASH_MAX( timeline->max_sample_size, info.length );
-                            if( !is_lpcm_audio )
-                            {
-                                /* Get sample_flags. */
-                                isom_sample_flags_t sample_flags;
-                                if( sample_number == 1 && (trun->flags & ISOM_TR_FLAGS_FIRST_SAMPLE_FLAGS_PRESENT) )
-                                    sample_flags = trun->first_sample_flags;
-                                else if( row && (trun->flags & ISOM_TR_FLAGS_SAMPLE_FLAGS_PRESENT) )
-                                    sample_flags = row->sample_flags;
-                                else if( tfhd->flags & ISOM_TF_FLAGS_DEFAULT_SAMPLE_FLAGS_PRESENT )
-                                    sample_flags = tfhd->default_sample_flags;
-                                else
-                                    sample_flags = trex->default_sample_flags;
-                                if( sdtp_data )
-                                {
-                                    /* Independent and Disposable Samples Box overrides the information from sample_flags.
-                                     * There is no description in the specification about this, but the intention should be such a thing.
-                                     * The ground is that sample_flags is placed in media layer
-                                     * while Independent and Disposable Samples Box is placed in track or presentation layer. */
-                                    info.prop.leading     = sdtp_data->is_leading;
-                                    info.prop.independent = sdtp_data->sample_depends_on;
-                                    info.prop.disposable  = sdtp_data->sample_is_depended_on;
-                                    info.prop.redundant   = sdtp_data->sample_has_redundancy;
-                                    if( sdtp_entry )
-                                        sdtp_entry = sdtp_entry->next;
-                                    sdtp_data = sdtp_entry ? (isom_sdtp_entry_t *)sdtp_entry->data : NULL;
-                                }
-                                else
-                                {
-                                    info.prop.leading     = sample_flags.is_leading;
-                                    info.prop.independent = sample_flags.sample_depends_on;
-                                    info.prop.disposable  = sample_flags.sample_is_depended_on;
-                                    info.prop.redundant   = sample_flags.sample_has_redundancy;
-                                }
-                                /* Check this sample is a sync sample or not.
-                                 * Note: all sync sample shall be independent. */
-                                if( !sample_flags.sample_is_non_sync_sample
-                                 && info.prop.independent != ISOM_SAMPLE_IS_NOT_INDEPENDENT )
-                                {
-                                    info.prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
-                                    distance = 0;
-                                }
-                                /* Get roll recovery grouping info. */
-                                uint32_t roll_id = sample_count + sample_number;
-                                if( sbgp_roll_entry
-                                 && isom_get_roll_recovery_grouping_info( timeline,
-                                                                          &sbgp_roll_entry, sgpd_roll, sgpd_frag_roll,
-                                                                          &sample_number_in_sbgp_roll_entry,
-                                                                          &info, roll_id ) < 0 )
-                                    goto fail;
-                                info.prop.post_roll.identifier = roll_id;
-                                /* Get random access point grouping info. */
-                                if( sbgp_rap_entry
-                                 && isom_get_random_access_point_grouping_info( timeline,
-                                                                                &sbgp_rap_entry, sgpd_rap, sgpd_frag_rap,
-                                                                                &sample_number_in_sbgp_rap_entry,
-                                                                                &info, &distance ) < 0 )
-                                    goto fail;
-                                /* Get the location of the sync sample from 'tfra' if it is not set up yet.
-                                 * Note: there is no guarantee that its entries are placed in a specific order. */
-                                if( LSMASH_IS_EXISTING_BOX( tfra ) )
-                                {
-                                    if( tfra->number_of_entry == 0
-                                     && info.prop.ra_flags == ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
-                                        info.prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
-                                    if( rap
-                                     && rap->moof_offset   == moof->pos
-                                     && rap->traf_number   == traf_number
-                                     && rap->trun_number   == trun_number
-                                     && rap->sample_number == sample_number )
-                                    {
-                                        if( info.prop.ra_flags == ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
-                                            info.prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
-                                        if( tfra_entry )
-                                            tfra_entry = tfra_entry->next;
-                                        rap = tfra_entry ? (isom_tfra_location_time_entry_t *)tfra_entry->data : NULL;
-                                    }
-                                }
-                                /* Set up distance from the previous random access point. */
-                                if( distance != NO_RANDOM_ACCESS_POINT )
-                                {
-                                    if( info.prop.pre_roll.distance == 0 )
-                                        info.prop.pre_roll.distance = distance;
-                                    ++distance;
-                                }
-                                /* OK. Let's add its info. */
-                                if( (err = isom_add_sample_info_entry( timeline, &info )) < 0 )
-                                    goto fail;
-                            }
-                            else
-                            {
-                                /* All LPCMFrame is a sync sample. */
-                                info.prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
-                                /* OK. Let's add its info. */
-                                if( sample_count == 0 && sample_number == 1 )
-                                    isom_update_bunch( &bunch, &info );
-                                else if( isom_compare_lpcm_sample_info( &bunch, &info ) )
-                                {
-                                    if( (err = isom_add_lpcm_bunch_entry( timeline, &bunch )) < 0 )
-                                        goto fail;
-                                    isom_update_bunch( &bunch, &info );
-                                }
-                                else
-                                    ++ bunch.sample_count;
-                            }
-                            if( timeline-> info_list->entry_count
-                             && timeline->bunch_list->entry_count )
-                            {
-                                lsmash_log( timeline, LSMASH_LOG_ERROR, "LPCM + non-LPCM track is not supported.\n" );
-                                err = LSMASH_ERR_PATCH_WELCOME;
-                                goto fail;
-                            }
-                        }
-                        data_offset += info.length;
-                        last_sample_end_pos = data_offset;
-                        if( row_entry )
-                            row_entry = row_entry->next;
-                        ++sample_number;
-                    }
-                    if( !need_data_offset_only )
-                        sample_count += sample_number - 1;
-                    ++trun_number;
-                }   /* Track runs */
-                ++traf_number;
-            }   /* Track fragments */
-        }   /* Movie fragments */
-    }
-    else if( timeline->chunk_list->entry_count == 0 )
+            err = LSMASH_ERR_MEMORY_ALLOC;
+            goto fail;
+        }
+        walker->file         = file;
+        walker->moof_entry   = file->moof_list.head;
+        walker->stsd         = stsd;
+        walker->dref_list    = dref_list;
+        walker->sgpd_rap     = sgpd_rap;
+        walker->sgpd_roll    = sgpd_roll;
+        walker->tfra         = isom_get_tfra( file->mfra, track_ID );
+        walker->tfra_entry   = walker->tfra->list ? walker->tfra->list->head : NULL;
+        walker->rap          = walker->tfra_entry ? (isom_tfra_location_time_entry_t *)walker->tfra_entry->data : NULL;
+        walker->chunk        = chunk;
+        walker->chunk_number = chunk_number;
+        walker->distance     = distance;
+        walker->dts          = dts;
+        walker->bunch        = bunch;
+        walker->chunk.data_offset = 0;
+        walker->chunk.length      = 0;
+        walker->sample_number_in_sbgp_roll_entry = sample_number_in_sbgp_roll_entry;
+        walker->sample_number_in_sbgp_rap_entry  = sample_number_in_sbgp_rap_entry;
+        bunch.sample_count = 0;
+        timeline->walker = walker;
+        /* Movie fragments */
+        if( file->flags & LSMASH_FILE_MODE_LAZY )
+            /* Walk only until the kind of samples is known. The rest is walked on demand. */
+            err = isom_timeline_extend( timeline, 1, UINT64_MAX );
+        else
+            err = isom_timeline_complete( timeline );
+        if( err < 0 )
+            goto fail;
+    }
+    else if( timeline->chunk_count == 0 )
         goto fail;  /* No samples in this track. */
     if( bunch.sample_count && (err = isom_add_lpcm_bunch_entry( timeline, &bunch )) < 0 )
         goto fail;
+    if( (err = isom_update_dts_array( timeline )) < 0 )
+        goto fail;
     if( (err = lsmash_list_add_entry( file->timeline, timeline )) < 0 )
         goto fail;
     /* Finish timeline construction. */
-    timeline->sample_count = sample_count;
-    if( timeline->info_list->entry_count )
+    if( timeline->info_count )
         isom_timeline_set_sample_getter_funcs( timeline );
     else
         isom_timeline_set_lpcm_sample_getter_funcs( timeline );
@@ -1449,8 +2232,11 @@ int lsmash_get_dts_from_media_timeline( lsmash_root_t *root, uint32_t track_ID,
 {
     if( !sample_number || !dts )
         return LSMASH_ERR_FUNCTION_PARAM;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    if( !timeline || sample_number > timeline->sample_count )
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline( root, track_ID, sample_number, &timeline );
+    if( err < 0 )
+        return err;
+    if( sample_number > timeline->sample_count )
         return LSMASH_ERR_NAMELESS;
      return timeline->get_dts( timeline, sample_number, dts );
 }
@@ -1459,32 +2245,284 @@ int lsmash_get_cts_from_media_timeline( lsmash_root_t *root, uint32_t track_ID,
 {
     if( !sample_number || !cts )
         return LSMASH_ERR_FUNCTION_PARAM;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    if( !timeline || sample_number > timeline->sample_count )
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline_with_cts( root, track_ID, sample_number, &timeline );
+    if( err < 0 )
+        return err;
+    if( sample_number > timeline->sample_count )
         return LSMASH_ERR_NAMELESS;
      return timeline->get_cts( timeline, sample_number, cts );
 }
 
-lsmash_sample_t *lsmash_get_sample_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_number )
+static int isom_get_sample_number_by_dts( isom_timeline_t *timeline, uint64_t dts, uint32_t *sample_number )
+{
+    if( timeline->info_count )
+    {
+        uint64_t *dts_array = timeline->dts_array;
+        if( !dts_array || dts < dts_array[0] )
+            return LSMASH_ERR_NAMELESS;
+        /* Find the last sample whose DTS is not greater than the given one. */
+        uint32_t lo = 0;
+        uint32_t hi = timeline->info_count;
+        while( hi - lo > 1 )
+        {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if( dts_array[mid] <= dts )
+                lo = mid;
+            else
+                hi = mid;
+        }
+        *sample_number = isom_get_sample_number_of_info( timeline, lo );
+        /* The sample may be in a skipped movie fragment after it, where the last sample is taken tentatively. */
+        isom_fragment_walker_t *walker = timeline->walker;
+        if( walker && walker->skipped_count )
+        {
+            lo = 0;
+            hi = walker->skipped_count;
+            while( lo < hi )
+            {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if( walker->skipped[mid].dts <= dts )
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            isom_skipped_fragment_t *skipped = lo ? &walker->skipped[lo - 1] : NULL;
+            if( skipped && skipped->first_sample_number > *sample_number )
+                *sample_number = skipped->first_sample_number - 1 + skipped->sample_count;
+        }
+        return 0;
+    }
+    if( timeline->bunch_count == 0 || dts < timeline->bunch_array[0].dts )
+        return LSMASH_ERR_NAMELESS;
+    isom_lpcm_bunch_entry_t *bunch_array = timeline->bunch_array;
+    uint32_t lo = 0;
+    uint32_t hi = timeline->bunch_count;
+    while( hi - lo > 1 )
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if( bunch_array[mid].dts <= dts )
+            lo = mid;
+        else
+            hi = mid;
+    }
+    isom_lpcm_bunch_entry_t *entry = &bunch_array[lo];
+    uint64_t sample_number_offset = entry->bunch.duration ? (dts - entry->dts) / entry->bunch.duration : 0;
+    sample_number_offset = LSMASH_MIN( sample_number_offset, entry->bunch.sample_count - 1 );
+    *sample_number = entry->first_sample_number + sample_number_offset;
+    return 0;
+}
+
+static int isom_compare_cts_index_entry( const isom_cts_index_entry_t *a, const isom_cts_index_entry_t *b )
+{
+    if( a->cts != b->cts )
+        return a->cts > b->cts ? 1 : -1;
+    return a->sample_number > b->sample_number ? 1 : (a->sample_number == b->sample_number ? 0 : -1);
+}
+
+static int isom_make_cts_index( isom_timeline_t *timeline )
+{
+    if( timeline->cts_index )
+        return 0;
+    if( timeline->info_count > SIZE_MAX / sizeof(isom_cts_index_entry_t) )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    isom_cts_index_entry_t *cts_index = lsmash_malloc( timeline->info_count * sizeof(isom_cts_index_entry_t) );
+    if( !cts_index )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    /* The samples in the skipped movie fragments are not indexed. */
+    isom_fragment_walker_t *walker = timeline->walker;
+    uint32_t skipped_count        = walker ? walker->skipped_count : 0;
+    uint32_t skipped_index        = 0;
+    uint32_t skipped_sample_count = 0;
+    uint32_t count = 0;
+    for( uint32_t i = 0; i < timeline->info_count; i++ )
+    {
+        for( ; skipped_index < skipped_count && walker->skipped[skipped_index].info_index <= i; skipped_index++ )
+            skipped_sample_count += walker->skipped[skipped_index].sample_count;
+        uint32_t offset = timeline->info_array[i].offset;
+        if( offset == ISOM_NON_OUTPUT_SAMPLE_OFFSET )
+            continue;   /* Any non-output sample is never presented. */
+        cts_index[count].cts           = isom_make_cts_adjust( timeline->dts_array[i], offset, timeline->ctd_shift );
+        cts_index[count].sample_number = i + 1 + skipped_sample_count;
+        ++count;
+    }
+    qsort( cts_index, count, sizeof(isom_cts_index_entry_t), (int(*)( const void *, const void * ))isom_compare_cts_index_entry );
+    timeline->cts_index       = cts_index;
+    timeline->cts_index_count = count;
+    return 0;
+}
+
+static int isom_get_sample_number_by_cts( isom_timeline_t *timeline, uint64_t cts, uint32_t *sample_number )
+{
+    if( timeline->info_count == 0 )
+    {
+        /* LPCM samples are presented in decoding order. */
+        if( timeline->bunch_count == 0 )
+            return LSMASH_ERR_NAMELESS;
+        uint64_t offset = timeline->bunch_array[0].bunch.offset;
+        if( cts < offset )
+            return LSMASH_ERR_NAMELESS;
+        return isom_get_sample_number_by_dts( timeline, cts - offset, sample_number );
+    }
+    if( !timeline->dts_array )
+        return LSMASH_ERR_NAMELESS;
+    int err = isom_make_cts_index( timeline );
+    if( err < 0 )
+        return err;
+    /* The index is sorted on the composition timeline added the shift so that no timestamp is negative. */
+    isom_cts_index_entry_t *cts_index = timeline->cts_index;
+    cts += timeline->ctd_shift;
+    if( timeline->cts_index_count == 0 || cts < cts_index[0].cts )
+        return LSMASH_ERR_NAMELESS;
+    /* Find the last sample in composition order whose CTS is not greater than the given one. */
+    uint32_t lo = 0;
+    uint32_t hi = timeline->cts_index_count;
+    while( hi - lo > 1 )
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if( cts_index[mid].cts <= cts )
+            lo = mid;
+        else
+            hi = mid;
+    }
+    *sample_number = cts_index[lo].sample_number;
+    return 0;
+}
+
+static int isom_get_media_time_from_movie_time( isom_timeline_t *timeline, uint64_t movie_time, uint64_t *media_time )
+{
+    if( timeline->movie_timescale == 0 || timeline->media_timescale == 0 )
+        return LSMASH_ERR_NAMELESS;
+    double timescale_ratio = (double)timeline->media_timescale / timeline->movie_timescale;
+    if( !timeline->edit_list->head )
+    {
+        /* No edits means the media is presented as it is from the beginning of the movie. */
+        *media_time = movie_time * timescale_ratio;
+        return 0;
+    }
+    uint64_t edit_start_time = 0;
+    for( lsmash_entry_t *entry = timeline->edit_list->head; entry; entry = entry->next )
+    {
+        isom_elst_entry_t *edit = (isom_elst_entry_t *)entry->data;
+        if( !edit )
+            return LSMASH_ERR_NAMELESS;
+        /* The implicit duration edit lasts until the end of the presentation. */
+        if( edit->segment_duration == 0 || movie_time < edit_start_time + edit->segment_duration )
+        {
+            if( edit->media_time == ISOM_EDIT_MODE_EMPTY )
+                return LSMASH_ERR_NAMELESS;     /* No sample is presented in an empty edit. */
+            uint64_t elapsed_time = movie_time - edit_start_time;
+            *media_time = edit->media_time;
+            if( edit->media_rate != ISOM_EDIT_MODE_DWELL )
+                *media_time += elapsed_time * timescale_ratio * (edit->media_rate / 65536.0);
+            return 0;
+        }
+        edit_start_time += edit->segment_duration;
+    }
+    return LSMASH_ERR_NAMELESS;     /* beyond the end of the presentation */
+}
+
+/* Make the timeline contain all samples decoded until a given time. */
+static int isom_timeline_prepare_until( isom_timeline_t *timeline, uint64_t time )
+{
+    while( 1 )
+    {
+        int err = isom_timeline_extend( timeline, 0, time );
+        if( err < 0 )
+            return err;
+        uint32_t sample_number;
+        if( !timeline->walker
+         ||  timeline->walker->skipped_count == 0
+         ||  isom_get_sample_number_by_dts( timeline, time, &sample_number ) < 0
+         ||  timeline->walker->skipped[0].first_sample_number > sample_number )
+            return 0;
+        if( (err = isom_timeline_walk_skipped_fragment( timeline, 0 )) < 0 )
+            return err;
+    }
+}
+
+int lsmash_get_sample_number_by_dts_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint64_t dts, uint32_t *sample_number )
+{
+    if( !sample_number )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
+    if( !timeline )
+        return LSMASH_ERR_NAMELESS;
+    while( 1 )
+    {
+        int err;
+        if( (err = isom_timeline_extend( timeline, 0, dts )) < 0
+         || (err = isom_get_sample_number_by_dts( timeline, dts, sample_number )) < 0 )
+            return err;
+        /* The sample found may be in a skipped movie fragment, whose decoding times are tentative. */
+        uint32_t skipped_count = timeline->walker ? timeline->walker->skipped_count : 0;
+        if( (err = isom_timeline_walk_skipped_fragments( timeline, *sample_number, *sample_number )) < 0 )
+            return err;
+        if( (timeline->walker ? timeline->walker->skipped_count : 0) == skipped_count )
+            return 0;
+    }
+}
+
+int lsmash_get_sample_number_by_cts_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint64_t cts, uint32_t *sample_number )
+{
+    if( !sample_number )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
+    if( !timeline )
+        return LSMASH_ERR_NAMELESS;
+    /* Any sample decoded after the given time added the shift is never presented until then. */
+    int err;
+    if( (err = isom_timeline_fix_ctd_shift( timeline )) < 0
+     || (err = isom_timeline_prepare_until( timeline, cts + timeline->ctd_shift )) < 0 )
+        return err;
+    return isom_get_sample_number_by_cts( timeline, cts, sample_number );
+}
+
+int lsmash_get_sample_number_by_movie_time_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint64_t movie_time, uint32_t *sample_number )
 {
+    if( !sample_number )
+        return LSMASH_ERR_FUNCTION_PARAM;
     isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    return timeline ? timeline->get_sample( timeline, sample_number ) : NULL;
+    if( !timeline )
+        return LSMASH_ERR_NAMELESS;
+    uint64_t media_time;
+    int err = isom_get_media_time_from_movie_time( timeline, movie_time, &media_time );
+    if( err < 0 )
+        return err;
+    if( (err = isom_timeline_fix_ctd_shift( timeline )) < 0
+     || (err = isom_timeline_prepare_until( timeline, media_time + timeline->ctd_shift )) < 0 )
+        return err;
+    return isom_get_sample_number_by_cts( timeline, media_time, sample_number );
+}
+
+lsmash_sample_t *lsmash_get_sample_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_number )
+{
+    isom_timeline_t *timeline;
+    if( isom_get_extended_timeline_with_cts( root, track_ID, sample_number, &timeline ) < 0 )
+        return NULL;
+    return timeline->get_sample( timeline, sample_number );
 }
 
 int lsmash_get_sample_info_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_number, lsmash_sample_t *sample )
 {
     if( !sample )
         return LSMASH_ERR_FUNCTION_PARAM;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    return timeline ? timeline->get_sample_info( timeline, sample_number, sample ) : -1;
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline_with_cts( root, track_ID, sample_number, &timeline );
+    if( err < 0 )
+        return err;
+    return timeline->get_sample_info( timeline, sample_number, sample );
 }
 
 int lsmash_get_sample_property_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_number, lsmash_sample_property_t *prop )
 {
     if( !prop )
         return LSMASH_ERR_FUNCTION_PARAM;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    return timeline ? timeline->get_sample_property( timeline, sample_number, prop ) : -1;
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline( root, track_ID, sample_number, &timeline );
+    if( err < 0 )
+        return err;
+    return timeline->get_sample_property( timeline, sample_number, prop );
 }
 
 int lsmash_get_composition_to_decode_shift_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t *ctd_shift )
@@ -1494,47 +2532,53 @@ int lsmash_get_composition_to_decode_shift_from_media_timeline( lsmash_root_t *r
     isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
     if( !timeline )
         return LSMASH_ERR_NAMELESS;
+    int err = isom_timeline_fix_ctd_shift( timeline );
+    if( err < 0 )
+        return err;
     *ctd_shift = timeline->ctd_shift;
     return 0;
 }
 
 static int isom_get_closest_past_random_accessible_point_from_media_timeline( isom_timeline_t *timeline, uint32_t sample_number, uint32_t *rap_number )
 {
-    lsmash_entry_t *entry = lsmash_list_get_entry( timeline->info_list, sample_number-- );
-    if( !entry
-     || !entry->data )
+    if( sample_number == 0 || sample_number > timeline->sample_count )
         return LSMASH_ERR_NAMELESS;
-    isom_sample_info_t *info = (isom_sample_info_t *)entry->data;
-    while( info->prop.ra_flags == ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
+    while( 1 )
     {
-        entry = entry->prev;
-        if( !entry
-         || !entry->data )
+        /* The sample may be in a skipped movie fragment. */
+        int err = isom_timeline_walk_skipped_fragments( timeline, sample_number, sample_number );
+        if( err < 0 )
+            return err;
+        isom_sample_info_t *info = isom_get_sample_info( timeline, sample_number );
+        if( !info )
+            return LSMASH_ERR_NAMELESS;
+        if( info->prop.ra_flags != ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
+            break;
+        if( --sample_number == 0 )
             return LSMASH_ERR_NAMELESS;
-        info = (isom_sample_info_t *)entry->data;
-        --sample_number;
     }
-    *rap_number = sample_number + 1;
+    *rap_number = sample_number;
     return 0;
 }
 
 static inline int isom_get_closest_future_random_accessible_point_from_media_timeline( isom_timeline_t *timeline, uint32_t sample_number, uint32_t *rap_number )
 {
-    lsmash_entry_t *entry = lsmash_list_get_entry( timeline->info_list, sample_number++ );
-    if( !entry
-     || !entry->data )
+    if( sample_number == 0 )
         return LSMASH_ERR_NAMELESS;
-    isom_sample_info_t *info = (isom_sample_info_t *)entry->data;
-    while( info->prop.ra_flags == ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
+    while( 1 )
     {
-        entry = entry->next;
-        if( !entry
-         || !entry->data )
+        /* The random accessible point may be in the movie fragments not walked yet. */
+        int err = isom_timeline_prepare_sample( timeline, sample_number );
+        if( err < 0 )
+            return err;
+        isom_sample_info_t *info = isom_get_sample_info( timeline, sample_number );
+        if( !info )
             return LSMASH_ERR_NAMELESS;
-        info = (isom_sample_info_t *)entry->data;
+        if( info->prop.ra_flags != ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
+            break;
         ++sample_number;
     }
-    *rap_number = sample_number - 1;
+    *rap_number = sample_number;
     return 0;
 }
 
@@ -1553,10 +2597,11 @@ int lsmash_get_closest_random_accessible_point_from_media_timeline( lsmash_root_
 {
     if( sample_number == 0 || !rap_number )
         return LSMASH_ERR_FUNCTION_PARAM;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    if( !timeline )
-        return LSMASH_ERR_NAMELESS;
-    if( timeline->info_list->entry_count == 0 )
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline( root, track_ID, sample_number, &timeline );
+    if( err < 0 )
+        return err;
+    if( timeline->info_count == 0 )
     {
         *rap_number = sample_number;    /* All LPCM is sync sample. */
         return 0;
@@ -1569,10 +2614,11 @@ int lsmash_get_closest_random_accessible_point_detail_from_media_timeline( lsmas
 {
     if( sample_number == 0 )
         return LSMASH_ERR_FUNCTION_PARAM;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    if( !timeline )
-        return LSMASH_ERR_NAMELESS;
-    if( timeline->info_list->entry_count == 0 )
+    isom_timeline_t *timeline;
+    int ret = isom_get_extended_timeline_with_cts( root, track_ID, sample_number, &timeline );
+    if( ret < 0 )
+        return ret;
+    if( timeline->info_count == 0 )
     {
         /* All LPCM is sync sample. */
         *rap_number = sample_number;
@@ -1584,10 +2630,9 @@ int lsmash_get_closest_random_accessible_point_detail_from_media_timeline( lsmas
             *distance = 0;
         return 0;
     }
-    int ret = isom_get_closest_random_accessible_point_from_media_timeline_internal( timeline, sample_number, rap_number );
-    if( ret < 0 )
+    if( (ret = isom_get_closest_random_accessible_point_from_media_timeline_internal( timeline, sample_number, rap_number )) < 0 )
         return ret;
-    isom_sample_info_t *info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, *rap_number );
+    isom_sample_info_t *info = isom_get_sample_info( timeline, *rap_number );
     if( !info )
         return LSMASH_ERR_NAMELESS;
     if( ra_flags )
@@ -1614,7 +2659,9 @@ int lsmash_get_closest_random_accessible_point_detail_from_media_timeline( lsmas
                 dts += info->duration;
                 if( rap_cts <= dts )
                     break;  /* leading samples of this random accessible point must not be present more. */
-                info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, current_sample_number++ );
+                if( (ret = isom_timeline_prepare_sample( timeline, current_sample_number )) < 0 )
+                    return ret;
+                info = isom_get_sample_info( timeline, current_sample_number++ );
                 if( !info )
                     break;
                 uint64_t cts = isom_make_cts_adjust( dts, info->offset, timeline->ctd_shift );
@@ -1631,7 +2678,7 @@ int lsmash_get_closest_random_accessible_point_detail_from_media_timeline( lsmas
             if( isom_get_closest_past_random_accessible_point_from_media_timeline( timeline, prev_rap_number - 1, &prev_rap_number ) < 0 )
                 /* The previous random accessible point is not present. */
                 return 0;
-            info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, prev_rap_number );
+            info = isom_get_sample_info( timeline, prev_rap_number );
             if( !info )
                 return LSMASH_ERR_NAMELESS;
             if( !(info->prop.ra_flags & ISOM_SAMPLE_RANDOM_ACCESS_FLAG_GDR) )
@@ -1704,7 +2751,7 @@ int lsmash_get_closest_random_accessible_point_detail_from_media_timeline( lsmas
         if( isom_get_closest_past_random_accessible_point_from_media_timeline( timeline, prev_rap_number - 1, &prev_rap_number ) < 0 )
             /* The previous random accessible point is not present. */
             return 0;
-        info = (isom_sample_info_t *)lsmash_list_get_entry_data( timeline->info_list, prev_rap_number );
+        info = isom_get_sample_info( timeline, prev_rap_number );
         if( !info )
             return LSMASH_ERR_NAMELESS;
         if( !(info->prop.ra_flags & ISOM_SAMPLE_RANDOM_ACCESS_FLAG_GDR) || sample_number >= info->prop.post_roll.complete )
@@ -1715,48 +2762,70 @@ int lsmash_get_closest_random_accessible_point_detail_from_media_timeline( lsmas
     } while( 1 );
 }
 
-int lsmash_check_sample_existence_in_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_number )
+int lsmash_set_read_ahead_chunk_count_in_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t chunk_count )
 {
     isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    return timeline ? timeline->check_sample_existence( timeline, sample_number ) : 0;
+    if( !timeline )
+        return LSMASH_ERR_NAMELESS;
+    timeline->read_ahead_chunk_count = chunk_count;
+    if( chunk_count == 0 )
+    {
+        isom_release_sample_buffer( timeline->read_buffer );
+        timeline->read_buffer = NULL;
+    }
+    return 0;
+}
+
+int lsmash_check_sample_existence_in_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_number )
+{
+    isom_timeline_t *timeline;
+    if( isom_get_extended_timeline( root, track_ID, sample_number, &timeline ) < 0 )
+        return 0;
+    return timeline->check_sample_existence( timeline, sample_number );
 }
 
 int lsmash_get_last_sample_delta_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t *last_sample_delta )
 {
     if( !last_sample_delta )
         return LSMASH_ERR_FUNCTION_PARAM;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    return timeline ? timeline->get_sample_duration( timeline, timeline->sample_count, last_sample_delta ) : -1;
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline( root, track_ID, UINT32_MAX, &timeline );
+    if( err < 0 )
+        return err;
+    return timeline->get_sample_duration( timeline, timeline->sample_count, last_sample_delta );
 }
 
 int lsmash_get_sample_delta_from_media_timeline( lsmash_root_t *root, uint32_t track_ID, uint32_t sample_number, uint32_t *sample_delta )
 {
     if( !sample_delta )
         return LSMASH_ERR_FUNCTION_PARAM;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    return timeline ? timeline->get_sample_duration( timeline, sample_number, sample_delta ) : -1;
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline( root, track_ID, sample_number, &timeline );
+    if( err < 0 )
+        return err;
+    return timeline->get_sample_duration( timeline, sample_number, sample_delta );
 }
 
 uint32_t lsmash_get_sample_count_in_media_timeline( lsmash_root_t *root, uint32_t track_ID )
 {
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    if( !timeline )
+    isom_timeline_t *timeline;
+    if( isom_get_extended_timeline( root, track_ID, UINT32_MAX, &timeline ) < 0 )
         return 0;
     return timeline->sample_count;
 }
 
 uint32_t lsmash_get_max_sample_size_in_media_timeline( lsmash_root_t *root, uint32_t track_ID )
 {
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    if( !timeline )
+    isom_timeline_t *timeline;
+    if( isom_get_extended_timeline( root, track_ID, UINT32_MAX, &timeline ) < 0 )
         return 0;
     return timeline->max_sample_size;
 }
 
 uint64_t lsmash_get_media_duration_from_media_timeline( lsmash_root_t *root, uint32_t track_ID )
 {
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    if( !timeline )
+    isom_timeline_t *timeline;
+    if( isom_get_extended_timeline( root, track_ID, UINT32_MAX, &timeline ) < 0 )
         return 0;
     return timeline->media_duration;
 }
@@ -1815,8 +2884,8 @@ int lsmash_copy_timeline_map( lsmash_root_t *dst, uint32_t dst_track_ID, lsmash_
      || src_fragmented )
     {
         /* Get from constructed timeline instead of boxes. */
-        isom_timeline_t *src_timeline = isom_get_timeline( src, src_track_ID );
-        if( src_timeline
+        isom_timeline_t *src_timeline;
+        if( isom_get_extended_timeline( src, src_track_ID, UINT32_MAX, &src_timeline ) == 0
          && src_timeline->movie_timescale
          && src_timeline->media_timescale )
         {
@@ -1893,74 +2962,584 @@ int lsmash_copy_timeline_map( lsmash_root_t *dst, uint32_t dst_track_ID, lsmash_
     return 0;
 }
 
+/*---- sidecar index of media timelines ----*/
+/* The index consists of a header followed by the timelines, each of which is followed by its edits, chunks and samples.
+ * The header ends with a hash of all the bytes following it to detect a corrupted index.
+ * All fields are stored in big-endian byte order. The sizes below are the number of bytes of each part. */
+#define TIMELINE_INDEX_MAGIC        LSMASH_4CC( 'L', 'S', 'T', 'I' )
+#define TIMELINE_INDEX_VERSION      2
+#define TIMELINE_INDEX_HEADER_SIZE  44
+#define TIMELINE_INDEX_HASH_OFFSET  32  /* the position of the hash of the bytes following the header */
+#define TIMELINE_INDEX_TRACK_SIZE   60
+#define TIMELINE_INDEX_EDIT_SIZE    20
+#define TIMELINE_INDEX_CHUNK_SIZE   24
+#define TIMELINE_INDEX_PROP_SIZE    21
+#define TIMELINE_INDEX_INFO_SIZE    (28 + TIMELINE_INDEX_PROP_SIZE)
+#define TIMELINE_INDEX_BUNCH_SIZE   (32 + TIMELINE_INDEX_PROP_SIZE)
+
+/* flags of a timeline in the index */
+#define TIMELINE_INDEX_FLAG_RETIMED 0x00000001
+
+#define FNV1A_64_OFFSET_BASIS UINT64_C(0xcbf29ce484222325)
+
+/* Update a 64-bit FNV-1a hash with the given bytes. */
+static uint64_t isom_update_fnv1a_hash( uint64_t h, const uint8_t *data, uint64_t size )
+{
+    for( uint64_t i = 0; i < size; i++ )
+    {
+        h ^= data[i];
+        h *= UINT64_C(0x100000001b3);
+    }
+    return h;
+}
+
+/* Hash the Movie Box as it is stored in the file by 64-bit FNV-1a. */
+static int isom_hash_movie_box( lsmash_file_t *file, uint64_t *hash )
+{
+    isom_moov_t *moov = file->moov;
+    lsmash_bs_t *bs   = file->bs;
+    if( LSMASH_IS_NON_EXISTING_BOX( moov ) || !bs || bs->unseekable )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    if( lsmash_bs_read_seek( bs, moov->pos, SEEK_SET ) < 0 )
+        return LSMASH_ERR_NAMELESS;
+    uint8_t  buf[4096];
+    uint64_t h         = FNV1A_64_OFFSET_BASIS;
+    uint64_t remainder = moov->size;
+    while( remainder )
+    {
+        uint32_t size = LSMASH_MIN( remainder, sizeof(buf) );
+        if( lsmash_bs_get_bytes_ex( bs, size, buf ) != size )
+            return LSMASH_ERR_NAMELESS;
+        h = isom_update_fnv1a_hash( h, buf, size );
+        remainder -= size;
+    }
+    *hash = h;
+    return 0;
+}
+
+static lsmash_entry_list_t *isom_get_dref_list( lsmash_file_t *file, uint32_t track_ID )
+{
+    isom_dref_t *dref = isom_get_trak( file, track_ID )->mdia->minf->dinf->dref;
+    return LSMASH_IS_EXISTING_BOX( dref ) ? &dref->list : NULL;
+}
+
+/* Return the data_reference_index of the data reference referring to a given file.
+ * Return 0 if the file is NULL or not referred to by any data reference. */
+static uint32_t isom_get_data_reference_index( lsmash_entry_list_t *dref_list, lsmash_file_t *file )
+{
+    if( !file || !dref_list )
+        return 0;
+    uint32_t data_reference_index = 1;
+    for( lsmash_entry_t *entry = dref_list->head; entry; entry = entry->next, data_reference_index++ )
+    {
+        isom_dref_entry_t *dref_entry = (isom_dref_entry_t *)entry->data;
+        if( dref_entry && dref_entry->ref_file == file )
+            return data_reference_index;
+    }
+    return 0;
+}
+
+static lsmash_file_t *isom_get_referred_file( lsmash_entry_list_t *dref_list, uint32_t data_reference_index )
+{
+    isom_dref_entry_t *dref_entry = (isom_dref_entry_t *)lsmash_list_get_entry_data( dref_list, data_reference_index );
+    return (!dref_entry || LSMASH_IS_NON_EXISTING_BOX( dref_entry->ref_file )) ? NULL : dref_entry->ref_file;
+}
+
+/* Return the number of a chunk in the timeline, or 0 if the chunk is not in the timeline. */
+static uint32_t isom_get_portable_chunk_number( isom_timeline_t *timeline, isom_portable_chunk_t *chunk )
+{
+    if( !chunk )
+        return 0;
+    if( isom_get_portable_chunk( timeline, chunk->number ) == chunk )
+        return chunk->number;
+    for( uint32_t i = 0; i < timeline->chunk_block_count; i++ )
+        if( chunk >= timeline->chunk_block[i] && chunk < timeline->chunk_block[i] + CHUNK_BLOCK_SIZE )
+            return i * CHUNK_BLOCK_SIZE + (uint32_t)(chunk - timeline->chunk_block[i]) + 1;
+    return 0;
+}
+
+static void isom_put_index_sample_property( lsmash_bs_t *bs, lsmash_sample_property_t *prop )
+{
+    lsmash_bs_put_be32( bs, prop->ra_flags );
+    lsmash_bs_put_be32( bs, prop->post_roll.identifier );
+    lsmash_bs_put_be32( bs, prop->post_roll.complete );
+    lsmash_bs_put_be32( bs, prop->pre_roll.distance );
+    lsmash_bs_put_byte( bs, prop->allow_earlier );
+    lsmash_bs_put_byte( bs, prop->leading );
+    lsmash_bs_put_byte( bs, prop->independent );
+    lsmash_bs_put_byte( bs, prop->disposable );
+    lsmash_bs_put_byte( bs, prop->redundant );
+}
+
+static int isom_put_timeline_index( lsmash_bs_t *bs, lsmash_file_t *file, isom_timeline_t *timeline )
+{
+    /* The index holds only complete timelines. */
+    int err;
+    if( (err = isom_timeline_complete( timeline )) < 0 )
+        return err;
+    lsmash_entry_list_t *dref_list = isom_get_dref_list( file, timeline->track_ID );
+    lsmash_bs_put_be32( bs, timeline->track_ID );
+    lsmash_bs_put_be32( bs, timeline->movie_timescale );
+    lsmash_bs_put_be32( bs, timeline->media_timescale );
+    lsmash_bs_put_be32( bs, timeline->sample_count );
+    lsmash_bs_put_be32( bs, timeline->max_sample_size );
+    lsmash_bs_put_be32( bs, timeline->ctd_shift );
+    lsmash_bs_put_be64( bs, timeline->media_duration );
+    lsmash_bs_put_be64( bs, timeline->track_duration );
+    lsmash_bs_put_be32( bs, timeline->edit_list->entry_count );
+    lsmash_bs_put_be32( bs, timeline->chunk_count );
+    lsmash_bs_put_be32( bs, timeline->info_count );
+    lsmash_bs_put_be32( bs, timeline->bunch_count );
+    lsmash_bs_put_be32( bs, timeline->retimed ? TIMELINE_INDEX_FLAG_RETIMED : 0 );
+    for( lsmash_entry_t *entry = timeline->edit_list->head; entry; entry = entry->next )
+    {
+        isom_elst_entry_t *edit = (isom_elst_entry_t *)entry->data;
+        if( !edit )
+            return LSMASH_ERR_NAMELESS;
+        lsmash_bs_put_be64( bs, edit->segment_duration );
+        lsmash_bs_put_be64( bs, edit->media_time );
+        lsmash_bs_put_be32( bs, edit->media_rate );
+    }
+    lsmash_file_t *last_file            = NULL;
+    uint32_t       data_reference_index = 0;
+    for( uint32_t i = 1; i <= timeline->chunk_count; i++ )
+    {
+        isom_portable_chunk_t *chunk = isom_get_portable_chunk( timeline, i );
+        if( chunk->file != last_file )
+        {
+            data_reference_index = isom_get_data_reference_index( dref_list, chunk->file );
+            if( data_reference_index == 0 && chunk->file )
+                return LSMASH_ERR_PATCH_WELCOME;
+            last_file = chunk->file;
+        }
+        lsmash_bs_put_be64( bs, chunk->data_offset );
+        lsmash_bs_put_be64( bs, chunk->length );
+        lsmash_bs_put_be32( bs, chunk->number );
+        lsmash_bs_put_be32( bs, data_reference_index );
+    }
+    for( uint32_t i = 0; i < timeline->info_count; i++ )
+    {
+        isom_sample_info_t *info = &timeline->info_array[i];
+        uint32_t chunk_number = isom_get_portable_chunk_number( timeline, info->chunk );
+        if( chunk_number == 0 && info->chunk )
+            return LSMASH_ERR_PATCH_WELCOME;
+        lsmash_bs_put_be64( bs, info->pos );
+        lsmash_bs_put_be32( bs, info->duration );
+        lsmash_bs_put_be32( bs, info->offset );
+        lsmash_bs_put_be32( bs, info->length );
+        lsmash_bs_put_be32( bs, info->index );
+        lsmash_bs_put_be32( bs, chunk_number );
+        isom_put_index_sample_property( bs, &info->prop );
+    }
+    for( uint32_t i = 0; i < timeline->bunch_count; i++ )
+    {
+        isom_lpcm_bunch_t *bunch = &timeline->bunch_array[i].bunch;
+        uint32_t chunk_number = isom_get_portable_chunk_number( timeline, bunch->chunk );
+        if( chunk_number == 0 && bunch->chunk )
+            return LSMASH_ERR_PATCH_WELCOME;
+        lsmash_bs_put_be64( bs, bunch->pos );
+        lsmash_bs_put_be32( bs, bunch->duration );
+        lsmash_bs_put_be32( bs, bunch->offset );
+        lsmash_bs_put_be32( bs, bunch->length );
+        lsmash_bs_put_be32( bs, bunch->index );
+        lsmash_bs_put_be32( bs, chunk_number );
+        isom_put_index_sample_property( bs, &bunch->prop );
+        lsmash_bs_put_be32( bs, bunch->sample_count );
+    }
+    return 0;
+}
+
+int lsmash_write_timeline_index( lsmash_root_t *root, const char *filename )
+{
+    if( isom_check_initializer_present( root ) < 0 || !filename )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    lsmash_file_t *file = root->file;
+    if( !file->timeline )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    uint64_t moov_hash;
+    int err = isom_hash_movie_box( file, &moov_hash );
+    if( err < 0 )
+        return err;
+    lsmash_bs_t *bs = lsmash_bs_create();
+    if( !bs )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    lsmash_bs_put_be32( bs, TIMELINE_INDEX_MAGIC );
+    lsmash_bs_put_be32( bs, TIMELINE_INDEX_VERSION );
+    lsmash_bs_put_be64( bs, file->size );
+    lsmash_bs_put_be64( bs, isom_get_file_modification_time( file ) );
+    lsmash_bs_put_be64( bs, moov_hash );
+    lsmash_bs_put_be64( bs, 0 );    /* placeholder for the hash of the rest */
+    lsmash_bs_put_be32( bs, file->timeline->entry_count );
+    for( lsmash_entry_t *entry = file->timeline->head; entry; entry = entry->next )
+    {
+        isom_timeline_t *timeline = (isom_timeline_t *)entry->data;
+        if( !timeline )
+        {
+            err = LSMASH_ERR_NAMELESS;
+            goto fail;
+        }
+        if( (err = isom_put_timeline_index( bs, file, timeline )) < 0 )
+            goto fail;
+    }
+    if( lsmash_bs_is_error( bs ) )
+    {
+        err = LSMASH_ERR_MEMORY_ALLOC;
+        goto fail;
+    }
+    uint8_t *data = lsmash_bs_get_buffer_data_start( bs );
+    size_t   size = lsmash_bs_get_valid_data_size( bs );
+    LSMASH_SET_BE64( &data[TIMELINE_INDEX_HASH_OFFSET],
+                     isom_update_fnv1a_hash( FNV1A_64_OFFSET_BASIS, data + TIMELINE_INDEX_HEADER_SIZE, size - TIMELINE_INDEX_HEADER_SIZE ) );
+    FILE *fp = lsmash_fopen( filename, "wb" );
+    if( !fp )
+    {
+        err = LSMASH_ERR_NAMELESS;
+        goto fail;
+    }
+    if( fwrite( data, 1, size, fp ) != size )
+        err = LSMASH_ERR_NAMELESS;
+    if( fclose( fp ) != 0 )
+        err = LSMASH_ERR_NAMELESS;
+fail:
+    lsmash_bs_cleanup( bs );
+    return err;
+}
+
+static inline uint8_t isom_get_index_byte( const uint8_t **p )
+{
+    return *(*p)++;
+}
+
+static inline uint32_t isom_get_index_be32( const uint8_t **p )
+{
+    const uint8_t *q = *p;
+    *p += 4;
+    return ((uint32_t)q[0] << 24) | ((uint32_t)q[1] << 16) | ((uint32_t)q[2] << 8) | q[3];
+}
+
+static inline uint64_t isom_get_index_be64( const uint8_t **p )
+{
+    uint64_t value = isom_get_index_be32( p );
+    return (value << 32) | isom_get_index_be32( p );
+}
+
+/* Check if 'count' entries of 'entry_size' bytes remain. */
+static inline int isom_check_index_remainder( const uint8_t *p, const uint8_t *end, uint32_t count, uint32_t entry_size )
+{
+    return (uint64_t)(end - p) / entry_size >= count;
+}
+
+/* Check if the data of 'length' bytes at 'pos' lies within the file which contains it.
+ * The size of a file referred to by a data reference is unknown until the file is opened. */
+static inline int isom_check_index_data_range( lsmash_file_t *file, isom_portable_chunk_t *chunk, uint64_t pos, uint64_t length )
+{
+    uint64_t file_size = !chunk       ? file->size
+                       : chunk->file  ? chunk->file->size
+                       :                INT64_MAX;
+    return pos <= INT64_MAX && pos <= file_size && length <= file_size - pos;
+}
+
+static void isom_get_index_sample_property( const uint8_t **p, lsmash_sample_property_t *prop )
+{
+    prop->ra_flags             = isom_get_index_be32( p );
+    prop->post_roll.identifier = isom_get_index_be32( p );
+    prop->post_roll.complete   = isom_get_index_be32( p );
+    prop->pre_roll.distance    = isom_get_index_be32( p );
+    prop->allow_earlier        = isom_get_index_byte( p );
+    prop->leading              = isom_get_index_byte( p );
+    prop->independent          = isom_get_index_byte( p );
+    prop->disposable           = isom_get_index_byte( p );
+    prop->redundant            = isom_get_index_byte( p );
+}
+
+static isom_timeline_t *isom_get_timeline_from_index( lsmash_file_t *file, const uint8_t **p, const uint8_t *end, int *err )
+{
+    *err = LSMASH_ERR_INVALID_DATA;
+    if( !isom_check_index_remainder( *p, end, 1, TIMELINE_INDEX_TRACK_SIZE ) )
+        return NULL;
+    isom_timeline_t *timeline = isom_timeline_create();
+    if( !timeline )
+    {
+        *err = LSMASH_ERR_MEMORY_ALLOC;
+        return NULL;
+    }
+    timeline->track_ID        = isom_get_index_be32( p );
+    timeline->movie_timescale = isom_get_index_be32( p );
+    timeline->media_timescale = isom_get_index_be32( p );
+    timeline->sample_count    = isom_get_index_be32( p );
+    timeline->max_sample_size = isom_get_index_be32( p );
+    timeline->ctd_shift       = isom_get_index_be32( p );
+    timeline->media_duration  = isom_get_index_be64( p );
+    timeline->track_duration  = isom_get_index_be64( p );
+    uint32_t edit_count  = isom_get_index_be32( p );
+    uint32_t chunk_count = isom_get_index_be32( p );
+    uint32_t info_count  = isom_get_index_be32( p );
+    uint32_t bunch_count = isom_get_index_be32( p );
+    uint32_t flags       = isom_get_index_be32( p );
+    timeline->retimed    = !!(flags & TIMELINE_INDEX_FLAG_RETIMED);
+    /* The track and its timescales must be the same as the ones in the file. */
+    isom_trak_t *trak = isom_get_trak( file, timeline->track_ID );
+    if( LSMASH_IS_NON_EXISTING_BOX( trak->mdia->mdhd )
+     || timeline->movie_timescale != file->moov->mvhd->timescale
+     || timeline->media_timescale != trak->mdia->mdhd->timescale
+     || (info_count && bunch_count)
+     || (info_count && info_count != timeline->sample_count) )
+        goto fail;
+    lsmash_entry_list_t *dref_list = isom_get_dref_list( file, timeline->track_ID );
+    if( !isom_check_index_remainder( *p, end, edit_count, TIMELINE_INDEX_EDIT_SIZE ) )
+        goto fail;
+    for( uint32_t i = 0; i < edit_count; i++ )
+    {
+        isom_elst_entry_t *edit = lsmash_malloc( sizeof(isom_elst_entry_t) );
+        if( !edit
+         || lsmash_list_add_entry( timeline->edit_list, edit ) < 0 )
+        {
+            lsmash_free( edit );
+            *err = LSMASH_ERR_MEMORY_ALLOC;
+            goto fail;
+        }
+        edit->segment_duration = isom_get_index_be64( p );
+        edit->media_time       = (int64_t)isom_get_index_be64( p );
+        edit->media_rate       = (int32_t)isom_get_index_be32( p );
+    }
+    if( !isom_check_index_remainder( *p, end, chunk_count, TIMELINE_INDEX_CHUNK_SIZE ) )
+        goto fail;
+    uint32_t       last_index = 0;
+    lsmash_file_t *last_file  = NULL;
+    for( uint32_t i = 0; i < chunk_count; i++ )
+    {
+        isom_portable_chunk_t chunk;
+        chunk.data_offset = isom_get_index_be64( p );
+        chunk.length      = isom_get_index_be64( p );
+        chunk.number      = isom_get_index_be32( p );
+        uint32_t data_reference_index = isom_get_index_be32( p );
+        if( data_reference_index != last_index )
+        {
+            last_file  = isom_get_referred_file( dref_list, data_reference_index );
+            last_index = data_reference_index;
+        }
+        chunk.file = last_file;
+        if( !isom_check_index_data_range( file, &chunk, chunk.data_offset, chunk.length ) )
+            goto fail;
+        if( (*err = isom_add_portable_chunk_entry( timeline, &chunk )) < 0 )
+            goto fail;
+    }
+    *err = LSMASH_ERR_INVALID_DATA;
+    if( !isom_check_index_remainder( *p, end, info_count, TIMELINE_INDEX_INFO_SIZE ) )
+        goto fail;
+    if( (*err = isom_reserve_sample_info_entries( timeline, info_count )) < 0 )
+        goto fail;
+    *err = LSMASH_ERR_INVALID_DATA;
+    for( uint32_t i = 0; i < info_count; i++ )
+    {
+        isom_sample_info_t *info = &timeline->info_array[i];
+        info->pos      = isom_get_index_be64( p );
+        info->duration = isom_get_index_be32( p );
+        info->offset   = isom_get_index_be32( p );
+        info->length   = isom_get_index_be32( p );
+        info->index    = isom_get_index_be32( p );
+        uint32_t chunk_number = isom_get_index_be32( p );
+        info->chunk    = isom_get_portable_chunk( timeline, chunk_number );
+        if( (!info->chunk && chunk_number)
+         || !isom_check_index_data_range( file, info->chunk, info->pos, info->length ) )
+            goto fail;
+        isom_get_index_sample_property( p, &info->prop );
+    }
+    timeline->info_count = info_count;
+    if( !isom_check_index_remainder( *p, end, bunch_count, TIMELINE_INDEX_BUNCH_SIZE ) )
+        goto fail;
+    uint64_t lpcm_sample_count = 0;
+    for( uint32_t i = 0; i < bunch_count; i++ )
+    {
+        isom_lpcm_bunch_t bunch;
+        bunch.pos      = isom_get_index_be64( p );
+        bunch.duration = isom_get_index_be32( p );
+        bunch.offset   = isom_get_index_be32( p );
+        bunch.length   = isom_get_index_be32( p );
+        bunch.index    = isom_get_index_be32( p );
+        uint32_t chunk_number = isom_get_index_be32( p );
+        bunch.chunk    = isom_get_portable_chunk( timeline, chunk_number );
+        isom_get_index_sample_property( p, &bunch.prop );
+        bunch.sample_count = isom_get_index_be32( p );
+        if( (!bunch.chunk && chunk_number)
+         || !isom_check_index_data_range( file, bunch.chunk, bunch.pos, (uint64_t)bunch.length * bunch.sample_count ) )
+            goto fail;
+        lpcm_sample_count += bunch.sample_count;
+        if( (*err = isom_add_lpcm_bunch_entry( timeline, &bunch )) < 0 )
+            goto fail;
+        *err = LSMASH_ERR_INVALID_DATA;
+    }
+    if( bunch_count && lpcm_sample_count != timeline->sample_count )
+        goto fail;
+    if( (*err = isom_update_dts_array( timeline )) < 0 )
+        goto fail;
+    if( timeline->info_count )
+        isom_timeline_set_sample_getter_funcs( timeline );
+    else
+        isom_timeline_set_lpcm_sample_getter_funcs( timeline );
+    *err = 0;
+    return timeline;
+fail:
+    isom_timeline_destroy( timeline );
+    return NULL;
+}
+
+static int isom_get_timelines_from_index( lsmash_file_t *file, const uint8_t *data, uint64_t size )
+{
+    const uint8_t *p   = data;
+    const uint8_t *end = data + size;
+    if( size < TIMELINE_INDEX_HEADER_SIZE
+     || isom_get_index_be32( &p ) != TIMELINE_INDEX_MAGIC
+     || isom_get_index_be32( &p ) != TIMELINE_INDEX_VERSION )
+        return LSMASH_ERR_INVALID_DATA;
+    /* Any change of the file makes the index stale. */
+    uint64_t file_size = isom_get_index_be64( &p );
+    int64_t  mtime     = (int64_t)isom_get_index_be64( &p );
+    uint64_t hash      = isom_get_index_be64( &p );
+    uint64_t checksum  = isom_get_index_be64( &p );
+    if( checksum != isom_update_fnv1a_hash( FNV1A_64_OFFSET_BASIS, data + TIMELINE_INDEX_HEADER_SIZE, size - TIMELINE_INDEX_HEADER_SIZE ) )
+        return LSMASH_ERR_INVALID_DATA;
+    uint64_t moov_hash;
+    int err = isom_hash_movie_box( file, &moov_hash );
+    if( err < 0 )
+        return err;
+    if( file_size != file->size
+     || mtime     != isom_get_file_modification_time( file )
+     || hash      != moov_hash )
+        return LSMASH_ERR_INVALID_DATA;
+    uint32_t timeline_count = isom_get_index_be32( &p );
+    lsmash_entry_list_t *timelines = lsmash_list_create( isom_timeline_destroy );
+    if( !timelines )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    for( uint32_t i = 0; i < timeline_count; i++ )
+    {
+        isom_timeline_t *timeline = isom_get_timeline_from_index( file, &p, end, &err );
+        if( !timeline )
+            goto fail;
+        if( (err = lsmash_list_add_entry( timelines, timeline )) < 0 )
+        {
+            isom_timeline_destroy( timeline );
+            goto fail;
+        }
+    }
+    if( p != end )
+    {
+        err = LSMASH_ERR_INVALID_DATA;
+        goto fail;
+    }
+    /* Replace the timelines constructed already with the ones from the index. */
+    if( !file->timeline )
+    {
+        file->timeline = timelines;
+        return 0;
+    }
+    for( lsmash_entry_t *entry = timelines->head; entry; entry = entry->next )
+    {
+        isom_timeline_t *timeline = (isom_timeline_t *)entry->data;
+        lsmash_destruct_timeline( file->root, timeline->track_ID );
+        if( (err = lsmash_list_add_entry( file->timeline, timeline )) < 0 )
+            goto fail;
+        entry->data = NULL;
+    }
+    err = 0;
+fail:
+    lsmash_list_destroy( timelines );
+    return err;
+}
+
+int lsmash_read_timeline_index( lsmash_root_t *root, const char *filename )
+{
+    if( isom_check_initializer_present( root ) < 0 || !filename )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    FILE *fp = lsmash_fopen( filename, "rb" );
+    if( !fp )
+        return LSMASH_ERR_NAMELESS;
+    uint64_t size;
+    uint8_t *data = lsmash_map_file( fp, &size );
+    uint8_t *copy = NULL;
+    if( !data )
+    {
+        /* Read the whole index if it cannot be mapped. */
+        int64_t end = lsmash_fseek( fp, 0, SEEK_END ) == 0 ? lsmash_ftell( fp ) : -1;
+        if( end > 0 && (uint64_t)end <= SIZE_MAX && lsmash_fseek( fp, 0, SEEK_SET ) == 0 )
+        {
+            size = end;
+            copy = lsmash_malloc( size );
+            if( copy && fread( copy, 1, size, fp ) != size )
+                lsmash_freep( &copy );
+        }
+        data = copy;
+    }
+    fclose( fp );
+    if( !data )
+        return LSMASH_ERR_NAMELESS;
+    int err = isom_get_timelines_from_index( root->file, data, size );
+    if( copy )
+        lsmash_free( copy );
+    else
+        lsmash_unmap_file( data, size );
+    return err;
+}
+
 int lsmash_set_media_timestamps( lsmash_root_t *root, uint32_t track_ID, lsmash_media_ts_list_t *ts_list )
 {
     if( LSMASH_IS_NON_EXISTING_BOX( root )
      || LSMASH_IS_NON_EXISTING_BOX( root->file )
      || !ts_list )
         return -1;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    if( !timeline )
-        return LSMASH_ERR_NAMELESS;
-    if( timeline->info_list->entry_count == 0 )
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline( root, track_ID, UINT32_MAX, &timeline );
+    if( err < 0 )
+        return err;
+    if( timeline->info_count == 0 )
     {
         lsmash_log( timeline, LSMASH_LOG_ERROR, "Changing timestamps of LPCM track is not supported.\n" );
         return LSMASH_ERR_PATCH_WELCOME;
     }
-    if( ts_list->sample_count != timeline->info_list->entry_count )
+    if( ts_list->sample_count != timeline->info_count )
         return LSMASH_ERR_INVALID_DATA; /* Number of samples must be same. */
     lsmash_media_ts_t *ts = ts_list->timestamp;
     if( ts[0].dts )
         return LSMASH_ERR_INVALID_DATA; /* DTS must start from value zero. */
     /* Update DTSs. */
-    uint32_t sample_count  = ts_list->sample_count;
-    uint32_t i;
-    if( timeline->info_list->entry_count > 1 )
-    {
-        i = 1;
-        lsmash_entry_t *entry = timeline->info_list->head;
-        isom_sample_info_t *info = NULL;
-        while( i < sample_count )
-        {
-            info = (isom_sample_info_t *)entry->data;
-            if( !info || (ts[i].dts < ts[i - 1].dts) )
-                return LSMASH_ERR_INVALID_DATA;
-            info->duration = ts[i].dts - ts[i - 1].dts;
-            entry = entry->next;
-            ++i;
-        }
-        if( i > 1 )
+    uint32_t sample_count = ts_list->sample_count;
+    isom_sample_info_t *info_array = timeline->info_array;
+    if( sample_count > 1 )
+    {
+        for( uint32_t i = 1; i < sample_count; i++ )
         {
-            if( !entry
-             || !entry->data )
+            if( ts[i].dts < ts[i - 1].dts )
                 return LSMASH_ERR_INVALID_DATA;
-            /* Copy the previous duration. */
-            ((isom_sample_info_t *)entry->data)->duration = info->duration;
+            info_array[i - 1].duration = ts[i].dts - ts[i - 1].dts;
         }
-        else
-            return LSMASH_ERR_INVALID_DATA; /* Irregular case: sample_count this timeline has is incorrect. */
+        /* Copy the previous duration. */
+        info_array[sample_count - 1].duration = info_array[sample_count - 2].duration;
     }
     else    /* still image */
-        ((isom_sample_info_t *)timeline->info_list->head->data)->duration = UINT32_MAX;
+        info_array[0].duration = UINT32_MAX;
+    timeline->dts_count = 0;
+    err = isom_update_dts_array( timeline );
+    if( err < 0 )
+        return err;
+    lsmash_freep( &timeline->cts_index );
+    timeline->cts_index_count = 0;
     /* Update CTSs.
      * ToDo: hint track must not have any sample_offset. */
-    i = 0;
     timeline->ctd_shift = 0;
-    for( lsmash_entry_t *entry = timeline->info_list->head; entry; entry = entry->next )
+    for( uint32_t i = 0; i < sample_count; i++ )
     {
-        isom_sample_info_t *info = (isom_sample_info_t *)entry->data;
         if( ts[i].cts != LSMASH_TIMESTAMP_UNDEFINED )
         {
             if( (ts[i].cts + timeline->ctd_shift) < ts[i].dts )
                 timeline->ctd_shift = ts[i].dts - ts[i].cts;
-            info->offset = ts[i].cts - ts[i].dts;
+            info_array[i].offset = ts[i].cts - ts[i].dts;
         }
         else
-            info->offset = ISOM_NON_OUTPUT_SAMPLE_OFFSET;
-        ++i;
+            info_array[i].offset = ISOM_NON_OUTPUT_SAMPLE_OFFSET;
     }
     if( timeline->ctd_shift && (!root->file->qt_compatible || root->file->max_isom_version < 4) )
         return LSMASH_ERR_INVALID_DATA; /* Don't allow composition to decode timeline shift. */
+    timeline->retimed = 1;
     return 0;
 }
 
@@ -1968,10 +3547,11 @@ int lsmash_get_media_timestamps( lsmash_root_t *root, uint32_t track_ID, lsmash_
 {
     if( !ts_list )
         return LSMASH_ERR_FUNCTION_PARAM;
-    isom_timeline_t *timeline = isom_get_timeline( root, track_ID );
-    if( !timeline )
-        return LSMASH_ERR_NAMELESS;
-    uint32_t sample_count = timeline->info_list->entry_count;
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline( root, track_ID, UINT32_MAX, &timeline );
+    if( err < 0 )
+        return err;
+    uint32_t sample_count = timeline->info_count;
     if( sample_count == 0 )
     {
         ts_list->sample_count = 0;
@@ -1981,63 +3561,290 @@ int lsmash_get_media_timestamps( lsmash_root_t *root, uint32_t track_ID, lsmash_
     lsmash_media_ts_t *ts = lsmash_malloc( sample_count * sizeof(lsmash_media_ts_t) );
     if( !ts )
         return LSMASH_ERR_MEMORY_ALLOC;
-    uint64_t dts = 0;
-    uint32_t i = 0;
-    if( timeline->info_list->entry_count )
-        for( lsmash_entry_t *entry = timeline->info_list->head; entry; entry = entry->next )
+    for( uint32_t i = 0; i < sample_count; i++ )
+    {
+        ts[i].dts = timeline->dts_array[i];
+        ts[i].cts = isom_make_cts( ts[i].dts, timeline->info_array[i].offset, timeline->ctd_shift );
+    }
+    ts_list->sample_count = sample_count;
+    ts_list->timestamp    = ts;
+    return 0;
+}
+
+void lsmash_delete_media_timestamps( lsmash_media_ts_list_t *ts_list )
+{
+    if( !ts_list )
+        return;
+    lsmash_freep( &ts_list->timestamp );
+    ts_list->sample_count = 0;
+}
+
+struct lsmash_media_ts_iterator_tag
+{
+    lsmash_root_t *root;
+    uint32_t       track_ID;
+    uint32_t       sample_number;       /* sample number of the next timestamps */
+    int            timeline_present;    /* If set to 1, the timestamps are got from the media timeline. */
+    /* The following are used to read the sample tables directly if the media timeline is not constructed. */
+    lsmash_file_t     *file;
+    isom_stbl_t       *stbl;
+    int                lpcm;            /* If set to 1, no timestamps are given like the media timeline of LPCM. */
+    uint32_t           ctd_shift;
+    uint64_t           dts;             /* decoding timestamp of the next sample */
+    uint32_t           movie_sample_count;      /* number of the samples in the sample tables */
+    uint32_t           movie_sample_number;     /* number of the last sample in the sample tables of the next packet */
+    uint32_t           samples_per_packet;
+    uint32_t           last_duration;
+    uint32_t           stts_index;
+    uint32_t           sample_number_in_stts_entry;
+    uint32_t           ctts_index;
+    uint32_t           sample_number_in_ctts_entry;
+    isom_stsc_entry_t *stsc_data;
+    uint32_t           next_stsc_index;
+    uint32_t           chunk_number;
+    uint32_t           sample_number_in_chunk;
+    isom_fragment_cursor_t fragment;    /* cursor over the samples in the movie fragments */
+};
+
+/* Get the number of the samples in the sample tables making a sample of the media timeline. */
+static uint32_t isom_get_samples_per_packet( isom_sample_entry_t *description )
+{
+    if( LSMASH_IS_NON_EXISTING_BOX( description ) || !isom_is_qt_fixed_compressed_audio( description ) )
+        return 1;
+    uint32_t samples_per_packet;
+    uint32_t constant_sample_size;
+    isom_get_qt_fixed_comp_audio_sample_quants( NULL, description, &samples_per_packet, &constant_sample_size );
+    return samples_per_packet;
+}
+
+/* Set up an iterator reading the sample tables and the movie fragments directly in the same way as the construction
+ * of the media timeline. Only the composition to decode timeline shift is got beforehand, from the composition time
+ * offsets in 'ctts' and the ones read by skimming the movie fragments. */
+static int isom_setup_media_ts_iterator( lsmash_media_ts_iterator_t *iterator )
+{
+    lsmash_file_t *file = iterator->root->file;
+    isom_trak_t   *trak = isom_get_trak( file, iterator->track_ID );
+    isom_stbl_t   *stbl = trak->mdia->minf->stbl;
+    if( LSMASH_IS_NON_EXISTING_BOX( stbl->stsd )
+     || (LSMASH_IS_NON_EXISTING_BOX( stbl->stsz ) && LSMASH_IS_NON_EXISTING_BOX( stbl->stz2 )) )
+        return LSMASH_ERR_INVALID_DATA;
+    iterator->file               = file;
+    iterator->stbl               = stbl;
+    iterator->movie_sample_count = LSMASH_IS_EXISTING_BOX( stbl->stsz ) ? stbl->stsz->sample_count : stbl->stz2->sample_count;
+    iterator->last_duration      = UINT32_MAX;
+    iterator->sample_number_in_stts_entry = 1;
+    iterator->sample_number_in_ctts_entry = 1;
+    iterator->stsc_data          = stbl->stsc->entry_count ? &stbl->stsc->entries[0] : NULL;
+    iterator->next_stsc_index    = 1;
+    iterator->chunk_number       = 1;
+    if( iterator->movie_sample_count && !iterator->stsc_data )
+        return LSMASH_ERR_INVALID_DATA;
+    isom_sample_entry_t *description = (isom_sample_entry_t *)lsmash_list_get_entry_data( &stbl->stsd->list,
+                                                                                          iterator->stsc_data ? iterator->stsc_data->sample_description_index : 1 );
+    iterator->samples_per_packet     = isom_get_samples_per_packet( description );
+    iterator->movie_sample_number    = iterator->samples_per_packet;
+    iterator->sample_number_in_chunk = iterator->samples_per_packet;
+    isom_init_fragment_cursor( file, &iterator->fragment );
+    if( iterator->movie_sample_count == 0 && LSMASH_IS_EXISTING_BOX( file->moov->mvex ) )
+    {
+        /* The kind of samples is known by the first sample in the movie fragments. */
+        isom_fragment_cursor_t first = iterator->fragment;
+        uint32_t duration;
+        uint32_t offset;
+        if( isom_get_next_fragment_sample( file, iterator->track_ID, &first, &duration, &offset ) > 0 )
+            description = (isom_sample_entry_t *)lsmash_list_get_entry_data( &stbl->stsd->list, first.sample_description_index );
+    }
+    iterator->lpcm = LSMASH_IS_EXISTING_BOX( description ) && isom_is_lpcm_audio( description );
+    if( iterator->lpcm )
+        return 0;
+    /* Get the composition to decode timeline shift. */
+    isom_ctts_t *ctts = stbl->ctts;
+    if( LSMASH_IS_EXISTING_BOX( ctts ) && ((file->max_isom_version >= 4 && ctts->version == 1) || file->qt_compatible) )
+        for( uint32_t i = 0; i < ctts->entry_count; i++ )
         {
-            isom_sample_info_t *info = (isom_sample_info_t *)entry->data;
-            if( !info )
-            {
-                lsmash_free( ts );
-                return LSMASH_ERR_NAMELESS;
-            }
-            ts[i].dts = dts;
-            ts[i].cts = isom_make_cts( dts, info->offset, timeline->ctd_shift );
-            dts += info->duration;
-            ++i;
+            uint32_t sample_offset = ctts->entries[i].sample_offset;
+            if( sample_offset != ISOM_NON_OUTPUT_SAMPLE_OFFSET && (int32_t)sample_offset < 0 )
+                iterator->ctd_shift = LSMASH_MAX( iterator->ctd_shift, -(int64_t)(int32_t)sample_offset );
         }
-    else
-        for( lsmash_entry_t *entry = timeline->bunch_list->head; entry; entry = entry->next )
+    if( LSMASH_IS_EXISTING_BOX( file->moov->mvex ) )
+        for( lsmash_entry_t *entry = file->moof_list.head; entry; entry = entry->next )
+        {
+            isom_moof_t *moof = (isom_moof_t *)entry->data;
+            isom_fragment_summary_t summary;
+            if( LSMASH_IS_NON_EXISTING_BOX( moof ) )
+                return LSMASH_ERR_INVALID_DATA;
+            int err = isom_skim_fragment( file, moof, iterator->track_ID, &summary );
+            if( err < 0 )
+                return err;
+            iterator->ctd_shift = LSMASH_MAX( iterator->ctd_shift, -(int64_t)summary.min_composition_offset );
+        }
+    return 0;
+}
+
+lsmash_media_ts_iterator_t *lsmash_create_media_ts_iterator( lsmash_root_t *root, uint32_t track_ID )
+{
+    if( isom_check_initializer_present( root ) < 0 || track_ID == 0 )
+        return NULL;
+    lsmash_media_ts_iterator_t *iterator = lsmash_malloc_zero( sizeof(lsmash_media_ts_iterator_t) );
+    if( !iterator )
+        return NULL;
+    iterator->root          = root;
+    iterator->track_ID      = track_ID;
+    iterator->sample_number = 1;
+    if( isom_get_timeline( root, track_ID ) )
+        iterator->timeline_present = 1;
+    else if( isom_setup_media_ts_iterator( iterator ) < 0 )
+    {
+        lsmash_free( iterator );
+        return NULL;
+    }
+    return iterator;
+}
+
+static int isom_get_next_media_timestamps_from_timeline( lsmash_media_ts_iterator_t *iterator, lsmash_media_ts_t *ts, uint32_t max_count )
+{
+    uint32_t sample_number = iterator->sample_number;
+    uint32_t last_number   = sample_number - 1 + LSMASH_MIN( max_count, UINT32_MAX - (sample_number - 1) );
+    isom_timeline_t *timeline;
+    int err = isom_get_extended_timeline_with_cts( iterator->root, iterator->track_ID, sample_number, &timeline );
+    if( err < 0 )
+        return err;
+    /* Walk the following movie fragments one by one rather than skip them since all of them are required. */
+    while( timeline->walker && timeline->walker->moof_entry && timeline->sample_count < last_number )
+        if( (err = isom_timeline_extend( timeline, timeline->sample_count + 1, UINT64_MAX )) < 0 )
+            return err;
+    if( sample_number > timeline->sample_count || !timeline->dts_array )
+        return 0;
+    uint32_t count = LSMASH_MIN( last_number, timeline->sample_count ) - sample_number + 1;
+    err = isom_timeline_walk_skipped_fragments( timeline, sample_number, sample_number + count - 1 );
+    if( err < 0 )
+        return err;
+    /* No skipped movie fragment is left among the samples, so their sample info is contiguous. */
+    uint32_t index;
+    if( !isom_get_sample_info_index( timeline, sample_number, &index, NULL ) || count > timeline->info_count - index )
+        return LSMASH_ERR_NAMELESS;
+    const uint64_t           *dts  = &timeline->dts_array [index];
+    const isom_sample_info_t *info = &timeline->info_array[index];
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        ts[i].dts = dts[i];
+        ts[i].cts = isom_make_cts( dts[i], info[i].offset, timeline->ctd_shift );
+    }
+    return count;
+}
+
+static int isom_get_next_media_timestamps_from_tables( lsmash_media_ts_iterator_t *iterator, lsmash_media_ts_t *ts, uint32_t max_count )
+{
+    if( iterator->lpcm )
+        return 0;
+    isom_stbl_t *stbl = iterator->stbl;
+    isom_stts_t *stts = stbl->stts;
+    isom_ctts_t *ctts = stbl->ctts;
+    isom_stsc_t *stsc = stbl->stsc;
+    uint32_t count = 0;
+    /* Samples in the sample tables */
+    while( count < max_count && iterator->movie_sample_number <= iterator->movie_sample_count )
+    {
+        uint64_t dts    = iterator->dts;
+        uint32_t offset = 0;
+        for( uint32_t i = 0; i < iterator->samples_per_packet; i++ )
         {
-            isom_lpcm_bunch_t *bunch = (isom_lpcm_bunch_t *)entry->data;
-            if( !bunch )
+            if( iterator->stts_index < stts->entry_count )
             {
-                lsmash_free( ts );
-                return LSMASH_ERR_NAMELESS;
+                isom_stts_entry_t *stts_data = &stts->entries[ iterator->stts_index ];
+                isom_increment_sample_number_in_table( &iterator->sample_number_in_stts_entry, &iterator->stts_index, stts_data->sample_count );
+                iterator->last_duration = stts_data->sample_delta;
             }
-            for( uint32_t j = 0; j < bunch->sample_count; j++ )
+            iterator->dts += iterator->last_duration;
+            if( iterator->ctts_index < ctts->entry_count )
             {
-                ts[i].dts = dts;
-                ts[i].cts = isom_make_cts( dts, bunch->offset, timeline->ctd_shift );
-                dts += bunch->duration;
-                ++i;
+                isom_ctts_entry_t *ctts_data = &ctts->entries[ iterator->ctts_index ];
+                isom_increment_sample_number_in_table( &iterator->sample_number_in_ctts_entry, &iterator->ctts_index, ctts_data->sample_count );
+                if( i == 0 )
+                    offset = ctts_data->sample_offset;
             }
         }
-    ts_list->sample_count = sample_count;
-    ts_list->timestamp    = ts;
+        ts[count].dts = dts;
+        ts[count].cts = isom_make_cts( dts, offset, iterator->ctd_shift );
+        ++count;
+        /* Move to the next chunk if this packet is the last in the chunk. */
+        if( iterator->sample_number_in_chunk == iterator->stsc_data->samples_per_chunk )
+        {
+            ++ iterator->chunk_number;
+            while( iterator->next_stsc_index < stsc->entry_count
+                && iterator->chunk_number > stsc->entries[ iterator->next_stsc_index ].first_chunk )
+                ++ iterator->next_stsc_index;   /* broken entry */
+            if( iterator->next_stsc_index < stsc->entry_count
+             && iterator->chunk_number == stsc->entries[ iterator->next_stsc_index ].first_chunk )
+            {
+                iterator->stsc_data = &stsc->entries[ iterator->next_stsc_index ++ ];
+                isom_sample_entry_t *description = (isom_sample_entry_t *)lsmash_list_get_entry_data( &stbl->stsd->list, iterator->stsc_data->sample_description_index );
+                iterator->samples_per_packet = isom_get_samples_per_packet( description );
+            }
+            iterator->sample_number_in_chunk = iterator->samples_per_packet;
+        }
+        else
+            iterator->sample_number_in_chunk += iterator->samples_per_packet;
+        iterator->movie_sample_number += iterator->samples_per_packet;
+    }
+    /* Samples in the movie fragments */
+    while( count < max_count && LSMASH_IS_EXISTING_BOX( iterator->file->moov->mvex ) )
+    {
+        uint32_t duration;
+        uint32_t offset;
+        int ret = isom_get_next_fragment_sample( iterator->file, iterator->track_ID, &iterator->fragment, &duration, &offset );
+        if( ret < 0 )
+            return ret;
+        if( ret == 0 )
+            break;
+        ts[count].dts = iterator->dts;
+        ts[count].cts = isom_make_cts( iterator->dts, offset, iterator->ctd_shift );
+        ++count;
+        iterator->dts += duration;
+    }
+    return count;
+}
+
+int lsmash_get_next_media_timestamps( lsmash_media_ts_iterator_t *iterator, lsmash_media_ts_t *ts, uint32_t max_count )
+{
+    if( !iterator || !ts )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    /* The count is returned as int. */
+    max_count = LSMASH_MIN( max_count, INT32_MAX );
+    int count = iterator->timeline_present
+              ? isom_get_next_media_timestamps_from_timeline( iterator, ts, max_count )
+              : isom_get_next_media_timestamps_from_tables  ( iterator, ts, max_count );
+    if( count > 0 )
+        iterator->sample_number += count;
+    return count;
+}
+
+int lsmash_get_composition_to_decode_shift_from_media_ts_iterator( lsmash_media_ts_iterator_t *iterator, uint32_t *ctd_shift )
+{
+    if( !iterator || !ctd_shift )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    if( iterator->timeline_present )
+        return lsmash_get_composition_to_decode_shift_from_media_timeline( iterator->root, iterator->track_ID, ctd_shift );
+    *ctd_shift = iterator->ctd_shift;
     return 0;
 }
 
-void lsmash_delete_media_timestamps( lsmash_media_ts_list_t *ts_list )
+void lsmash_destroy_media_ts_iterator( lsmash_media_ts_iterator_t *iterator )
 {
-    if( !ts_list )
-        return;
-    lsmash_freep( &ts_list->timestamp );
-    ts_list->sample_count = 0;
+    lsmash_free( iterator );
 }
 
-static int isom_compare_dts( const lsmash_media_ts_t *a, const lsmash_media_ts_t *b )
+/* Timestamps are compared as signed integers like the comparators below,
+ * so flip the sign bit to get keys compared as unsigned integers in the same order. */
+static inline uint64_t isom_get_timestamp_key( const lsmash_media_ts_t *ts, int composition )
 {
-    int64_t diff = (int64_t)(a->dts - b->dts);
-    return diff > 0 ? 1 : (diff == 0 ? 0 : -1);
+    return (composition ? ts->cts : ts->dts) ^ UINT64_C(0x8000000000000000);
 }
 
-void lsmash_sort_timestamps_decoding_order( lsmash_media_ts_list_t *ts_list )
+static int isom_compare_dts( const lsmash_media_ts_t *a, const lsmash_media_ts_t *b )
 {
-    if( !ts_list )
-        return;
-    qsort( ts_list->timestamp, ts_list->sample_count, sizeof(lsmash_media_ts_t), (int(*)( const void *, const void * ))isom_compare_dts );
+    int64_t diff = (int64_t)(a->dts - b->dts);
+    return diff > 0 ? 1 : (diff == 0 ? 0 : -1);
 }
 
 static int isom_compare_cts( const lsmash_media_ts_t *a, const lsmash_media_ts_t *b )
@@ -2046,29 +3853,90 @@ static int isom_compare_cts( const lsmash_media_ts_t *a, const lsmash_media_ts_t
     return diff > 0 ? 1 : (diff == 0 ? 0 : -1);
 }
 
-void lsmash_sort_timestamps_composition_order( lsmash_media_ts_list_t *ts_list )
+/* LSD radix sort by each byte of the keys */
+static int isom_radix_sort_timestamps( lsmash_media_ts_t *ts, uint32_t count, int composition )
 {
-    if( !ts_list )
-        return;
-    qsort( ts_list->timestamp, ts_list->sample_count, sizeof(lsmash_media_ts_t), (int(*)( const void *, const void * ))isom_compare_cts );
+    lsmash_media_ts_t *temp = lsmash_malloc( count * sizeof(lsmash_media_ts_t) );
+    if( !temp )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    uint32_t histogram[8][256] = { { 0 } };
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        uint64_t key = isom_get_timestamp_key( &ts[i], composition );
+        for( int byte = 0; byte < 8; byte++ )
+            ++ histogram[byte][ (key >> (byte * 8)) & 0xff ];
+    }
+    lsmash_media_ts_t *src = ts;
+    lsmash_media_ts_t *dst = temp;
+    for( int byte = 0; byte < 8; byte++ )
+    {
+        int shift = byte * 8;
+        uint32_t *offset = histogram[byte];
+        /* Skip this pass if every key has the same value in this byte. */
+        if( offset[ (isom_get_timestamp_key( &src[0], composition ) >> shift) & 0xff ] == count )
+            continue;
+        uint32_t sum = 0;
+        for( int i = 0; i < 256; i++ )
+        {
+            uint32_t n = offset[i];
+            offset[i] = sum;
+            sum += n;
+        }
+        for( uint32_t i = 0; i < count; i++ )
+            dst[ offset[ (isom_get_timestamp_key( &src[i], composition ) >> shift) & 0xff ]++ ] = src[i];
+        lsmash_media_ts_t *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if( src != ts )
+        memcpy( ts, src, count * sizeof(lsmash_media_ts_t) );
+    lsmash_free( temp );
+    return 0;
 }
 
-int lsmash_get_max_sample_delay( lsmash_media_ts_list_t *ts_list, uint32_t *max_sample_delay )
+/* Sort timestamps stably.
+ * Timestamps are nearly sorted in most cases, e.g. CTSs in decoding order are reordered only within a few samples,
+ * so try insertion sort first, and switch to radix sort if they turn out to be far from sorted. */
+static void isom_sort_timestamps( lsmash_media_ts_t *ts, uint32_t count, int composition )
+{
+    uint64_t budget = (uint64_t)count * MAX_AVERAGE_TS_MOVES;
+    for( uint32_t i = 1; i < count; i++ )
+    {
+        uint64_t key = isom_get_timestamp_key( &ts[i], composition );
+        if( isom_get_timestamp_key( &ts[i - 1], composition ) <= key )
+            continue;
+        lsmash_media_ts_t temp = ts[i];
+        uint32_t j = i;
+        do
+        {
+            ts[j] = ts[j - 1];
+            --j;
+        } while( j && isom_get_timestamp_key( &ts[j - 1], composition ) > key );
+        ts[j] = temp;
+        if( budget < i - j )
+        {
+            if( isom_radix_sort_timestamps( ts, count, composition ) < 0 )
+                qsort( ts, count, sizeof(lsmash_media_ts_t),
+                       (int(*)( const void *, const void * ))(composition ? isom_compare_cts : isom_compare_dts) );
+            return;
+        }
+        budget -= i - j;
+    }
+}
+
+/* Get the maximum sample delay by sorting the samples in composition order. */
+static int isom_get_max_sample_delay_by_sort( lsmash_media_ts_list_t *ts_list, uint32_t *max_sample_delay )
 {
-    if( !ts_list || !max_sample_delay )
-        return LSMASH_ERR_FUNCTION_PARAM;
-    lsmash_media_ts_t *orig_ts = ts_list->timestamp;
     lsmash_media_ts_t *ts = lsmash_malloc( ts_list->sample_count * sizeof(lsmash_media_ts_t) );
     if( !ts )
         return LSMASH_ERR_MEMORY_ALLOC;
-    ts_list->timestamp = ts;
-    *max_sample_delay = 0;
     for( uint32_t i = 0; i < ts_list->sample_count; i++ )
     {
-        ts[i].cts = orig_ts[i].cts;     /* for sorting */
+        ts[i].cts = ts_list->timestamp[i].cts;  /* for sorting */
         ts[i].dts = i;
     }
-    lsmash_sort_timestamps_composition_order( ts_list );
+    isom_sort_timestamps( ts, ts_list->sample_count, 1 );
+    *max_sample_delay = 0;
     for( uint32_t i = 0; i < ts_list->sample_count; i++ )
         if( i < ts[i].dts )
         {
@@ -2076,6 +3944,81 @@ int lsmash_get_max_sample_delay( lsmash_media_ts_list_t *ts_list, uint32_t *max_
             *max_sample_delay = LSMASH_MAX( *max_sample_delay, sample_delay );
         }
     lsmash_free( ts );
-    ts_list->timestamp = orig_ts;
     return 0;
 }
+
+int lsmash_get_max_sample_delay( lsmash_media_ts_list_t *ts_list, uint32_t *max_sample_delay )
+{
+    if( !ts_list || !max_sample_delay )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    *max_sample_delay = 0;
+    uint32_t count = ts_list->sample_count;
+    if( count == 0 )
+        return 0;
+    /* The maximum sample delay is equal to the maximum number of samples which precede a sample in decoding order
+     * and follow it in composition order.
+     * Count them in decoding order while keeping the CTSs of the preceding samples in a window in ascending order.
+     * A CTS which is not larger than any CTS of the following samples leaves the window since it is no longer counted. */
+    lsmash_media_ts_t *ts         = ts_list->timestamp;
+    uint64_t          *suffix_min = lsmash_malloc( count * sizeof(uint64_t) );
+    uint64_t          *window     = lsmash_malloc( 2 * MAX_REORDER_WINDOW * sizeof(uint64_t) );
+    if( !suffix_min || !window )
+    {
+        lsmash_free( suffix_min );
+        lsmash_free( window );
+        return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    suffix_min[count - 1] = isom_get_timestamp_key( &ts[count - 1], 1 );
+    for( uint32_t i = count - 1; i; i-- )
+        suffix_min[i - 1] = LSMASH_MIN( suffix_min[i], isom_get_timestamp_key( &ts[i - 1], 1 ) );
+    uint32_t first = 0;     /* the position of the smallest CTS in the window */
+    uint32_t size  = 0;     /* the number of CTSs in the window */
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        uint64_t key = isom_get_timestamp_key( &ts[i], 1 );
+        uint32_t pos = first + size;
+        while( pos > first && window[pos - 1] > key )
+            --pos;
+        *max_sample_delay = LSMASH_MAX( *max_sample_delay, first + size - pos );
+        if( i + 1 == count )
+            break;
+        if( size == MAX_REORDER_WINDOW )
+        {
+            /* Too far from sorted. */
+            lsmash_free( suffix_min );
+            lsmash_free( window );
+            return isom_get_max_sample_delay_by_sort( ts_list, max_sample_delay );
+        }
+        if( first + size == 2 * MAX_REORDER_WINDOW )
+        {
+            memmove( window, &window[first], size * sizeof(uint64_t) );
+            pos  -= first;
+            first = 0;
+        }
+        memmove( &window[pos + 1], &window[pos], (first + size - pos) * sizeof(uint64_t) );
+        window[pos] = key;
+        ++size;
+        while( size && window[first] <= suffix_min[i + 1] )
+        {
+            ++first;
+            --size;
+        }
+    }
+    lsmash_free( suffix_min );
+    lsmash_free( window );
+    return 0;
+}
+
+void lsmash_sort_timestamps_decoding_order( lsmash_media_ts_list_t *ts_list )
+{
+    if( !ts_list )
+        return;
+    isom_sort_timestamps( ts_list->timestamp, ts_list->sample_count, 0 );
+}
+
+void lsmash_sort_timestamps_composition_order( lsmash_media_ts_list_t *ts_list )
+{
+    if( !ts_list )
+        return;
+    isom_sort_timestamps( ts_list->timestamp, ts_list->sample_count, 1 );
+}
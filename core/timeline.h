@@ -70,6 +70,21 @@ int isom_timeline_set_media_timescale
     uint32_t         media_timescale
 );
 
+uint32_t isom_timeline_get_media_timescale
+(
+    isom_timeline_t *timeline
+);
+
+int isom_timeline_check_retimed
+(
+    isom_timeline_t *timeline
+);
+
+int isom_timeline_complete
+(
+    isom_timeline_t *timeline
+);
+
 int isom_timeline_set_sample_count
 (
     isom_timeline_t *timeline,
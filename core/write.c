@@ -765,14 +765,11 @@ static int isom_write_stsd( lsmash_bs_t *bs, isom_box_t *box )
 static int isom_write_stts( lsmash_bs_t *bs, isom_box_t *box )
 {
     isom_stts_t *stts = (isom_stts_t *)box;
-    assert( stts->list );
     isom_bs_put_box_common( bs, stts );
-    lsmash_bs_put_be32( bs, stts->list->entry_count );
-    for( lsmash_entry_t *entry = stts->list->head; entry; entry = entry->next )
+    lsmash_bs_put_be32( bs, stts->entry_count );
+    for( uint32_t i = 0; i < stts->entry_count; i++ )
     {
-        isom_stts_entry_t *data = (isom_stts_entry_t *)entry->data;
-        if( !data )
-            return LSMASH_ERR_NAMELESS;
+        isom_stts_entry_t *data = &stts->entries[i];
         lsmash_bs_put_be32( bs, data->sample_count );
         lsmash_bs_put_be32( bs, data->sample_delta );
     }
@@ -782,14 +779,11 @@ static int isom_write_stts( lsmash_bs_t *bs, isom_box_t *box )
 static int isom_write_ctts( lsmash_bs_t *bs, isom_box_t *box )
 {
     isom_ctts_t *ctts = (isom_ctts_t *)box;
-    assert( ctts->list );
     isom_bs_put_box_common( bs, ctts );
-    lsmash_bs_put_be32( bs, ctts->list->entry_count );
-    for( lsmash_entry_t *entry = ctts->list->head; entry; entry = entry->next )
+    lsmash_bs_put_be32( bs, ctts->entry_count );
+    for( uint32_t i = 0; i < ctts->entry_count; i++ )
     {
-        isom_ctts_entry_t *data = (isom_ctts_entry_t *)entry->data;
-        if( !data )
-            return LSMASH_ERR_NAMELESS;
+        isom_ctts_entry_t *data = &ctts->entries[i];
         lsmash_bs_put_be32( bs, data->sample_count );
         lsmash_bs_put_be32( bs, data->sample_offset );
     }
@@ -814,14 +808,9 @@ static int isom_write_stsz( lsmash_bs_t *bs, isom_box_t *box )
     isom_bs_put_box_common( bs, stsz );
     lsmash_bs_put_be32( bs, stsz->sample_size );
     lsmash_bs_put_be32( bs, stsz->sample_count );
-    if( stsz->sample_size == 0 && stsz->list )
-        for( lsmash_entry_t *entry = stsz->list->head; entry; entry = entry->next )
-        {
-            isom_stsz_entry_t *data = (isom_stsz_entry_t *)entry->data;
-            if( !data )
-                return LSMASH_ERR_NAMELESS;
-            lsmash_bs_put_be32( bs, data->entry_size );
-        }
+    if( stsz->sample_size == 0 && stsz->entries )
+        for( uint32_t i = 0; i < stsz->entry_count; i++ )
+            lsmash_bs_put_be32( bs, stsz->entries[i].entry_size );
     return 0;
 }
 
@@ -831,37 +820,27 @@ static int isom_write_stz2( lsmash_bs_t *bs, isom_box_t *box )
     isom_bs_put_box_common( bs, stz2 );
     lsmash_bs_put_be32( bs, (stz2->reserved << 8) | stz2->field_size );
     lsmash_bs_put_be32( bs, stz2->sample_count );
+    isom_stsz_entry_t *entries = stz2->entries;
     if( stz2->field_size == 16 )
-        for( lsmash_entry_t *entry = stz2->list->head; entry; entry = entry->next )
+        for( uint32_t i = 0; i < stz2->entry_count; i++ )
         {
-            isom_stsz_entry_t *data = (isom_stsz_entry_t *)entry->data;
-            if( !data )
-                return LSMASH_ERR_NAMELESS;
-            assert( data->entry_size <= 0xffff );
-            lsmash_bs_put_be16( bs, data->entry_size );
+            assert( entries[i].entry_size <= 0xffff );
+            lsmash_bs_put_be16( bs, entries[i].entry_size );
         }
     else if( stz2->field_size == 8 )
-        for( lsmash_entry_t *entry = stz2->list->head; entry; entry = entry->next )
+        for( uint32_t i = 0; i < stz2->entry_count; i++ )
         {
-            isom_stsz_entry_t *data = (isom_stsz_entry_t *)entry->data;
-            if( !data )
-                return LSMASH_ERR_NAMELESS;
-            assert( data->entry_size <= 0xff );
-            lsmash_bs_put_byte( bs, data->entry_size );
+            assert( entries[i].entry_size <= 0xff );
+            lsmash_bs_put_byte( bs, entries[i].entry_size );
         }
     else if( stz2->field_size == 4 )
-    {
-        isom_stsz_entry_t zero_padding = { .entry_size = 0 };
-        for( lsmash_entry_t *entry = stz2->list->head; entry; entry = entry->next ? entry->next->next : entry->next )
+        for( uint32_t i = 0; i < stz2->entry_count; i += 2 )
         {
-            isom_stsz_entry_t *data_o = (isom_stsz_entry_t *)entry->data;
-            isom_stsz_entry_t *data_e = (isom_stsz_entry_t *)(entry->next ? entry->next->data : &zero_padding);
-            if( !data_o || !data_e )
-                return LSMASH_ERR_NAMELESS;
-            assert( data_o->entry_size <= 0xf && data_e->entry_size <= 0xf );
-            lsmash_bs_put_byte( bs, (data_o->entry_size << 4) | data_e->entry_size );
+            uint32_t size_o = entries[i].entry_size;
+            uint32_t size_e = i + 1 < stz2->entry_count ? entries[i + 1].entry_size : 0;    /* zero padding */
+            assert( size_o <= 0xf && size_e <= 0xf );
+            lsmash_bs_put_byte( bs, (size_o << 4) | size_e );
         }
-    }
     else
         return LSMASH_ERR_NAMELESS;
     return 0;
@@ -921,14 +900,11 @@ static int isom_write_sdtp( lsmash_bs_t *bs, isom_box_t *box )
 static int isom_write_stsc( lsmash_bs_t *bs, isom_box_t *box )
 {
     isom_stsc_t *stsc = (isom_stsc_t *)box;
-    assert( stsc->list );
     isom_bs_put_box_common( bs, stsc );
-    lsmash_bs_put_be32( bs, stsc->list->entry_count );
-    for( lsmash_entry_t *entry = stsc->list->head; entry; entry = entry->next )
+    lsmash_bs_put_be32( bs, stsc->entry_count );
+    for( uint32_t i = 0; i < stsc->entry_count; i++ )
     {
-        isom_stsc_entry_t *data = (isom_stsc_entry_t *)entry->data;
-        if( !data )
-            return LSMASH_ERR_NAMELESS;
+        isom_stsc_entry_t *data = &stsc->entries[i];
         lsmash_bs_put_be32( bs, data->first_chunk );
         lsmash_bs_put_be32( bs, data->samples_per_chunk );
         lsmash_bs_put_be32( bs, data->sample_description_index );
@@ -939,16 +915,10 @@ static int isom_write_stsc( lsmash_bs_t *bs, isom_box_t *box )
 static int isom_write_co64( lsmash_bs_t *bs, isom_box_t *box )
 {
     isom_stco_t *co64 = (isom_stco_t *)box;
-    assert( co64->list );
     isom_bs_put_box_common( bs, co64 );
-    lsmash_bs_put_be32( bs, co64->list->entry_count );
-    for( lsmash_entry_t *entry = co64->list->head; entry; entry = entry->next )
-    {
-        isom_co64_entry_t *data = (isom_co64_entry_t *)entry->data;
-        if( !data )
-            return LSMASH_ERR_NAMELESS;
-        lsmash_bs_put_be64( bs, data->chunk_offset );
-    }
+    lsmash_bs_put_be32( bs, co64->entry_count );
+    for( uint32_t i = 0; i < co64->entry_count; i++ )
+        lsmash_bs_put_be64( bs, co64->entries.co64[i].chunk_offset );
     return 0;
 }
 
@@ -957,16 +927,10 @@ static int isom_write_stco( lsmash_bs_t *bs, isom_box_t *box )
     isom_stco_t *stco = (isom_stco_t *)box;
     if( stco->large_presentation )
         return isom_write_co64( bs, box );
-    assert( stco->list );
     isom_bs_put_box_common( bs, stco );
-    lsmash_bs_put_be32( bs, stco->list->entry_count );
-    for( lsmash_entry_t *entry = stco->list->head; entry; entry = entry->next )
-    {
-        isom_stco_entry_t *data = (isom_stco_entry_t *)entry->data;
-        if( !data )
-            return LSMASH_ERR_NAMELESS;
-        lsmash_bs_put_be32( bs, data->chunk_offset );
-    }
+    lsmash_bs_put_be32( bs, stco->entry_count );
+    for( uint32_t i = 0; i < stco->entry_count; i++ )
+        lsmash_bs_put_be32( bs, stco->entries.stco[i].chunk_offset );
     return 0;
 }
 
@@ -1398,6 +1362,21 @@ static int isom_write_mfra( lsmash_bs_t *bs, isom_box_t *box )
     return 0;
 }
 
+static int isom_write_zero_bytes( lsmash_bs_t *bs, uint64_t size )
+{
+    int err = lsmash_bs_flush_buffer( bs );
+    if( err )
+        return err;
+    static const uint8_t zero_bytes[4096] = { 0 };
+    while( size > sizeof(zero_bytes) )
+    {
+        if( (err = lsmash_bs_write_data( bs, zero_bytes, sizeof(zero_bytes) )) < 0 )
+            return err;
+        size -= sizeof(zero_bytes);
+    }
+    return lsmash_bs_write_data( bs, zero_bytes, size );
+}
+
 static int isom_write_mdat( lsmash_bs_t *bs, isom_box_t *box )
 {
     isom_mdat_t   *mdat = (isom_mdat_t *)box;
@@ -1416,7 +1395,9 @@ static int isom_write_mdat( lsmash_bs_t *bs, isom_box_t *box )
             isom_sample_pool_t *pool = (isom_sample_pool_t *)entry->data;
             if( !pool )
                 return LSMASH_ERR_NAMELESS;
-            lsmash_bs_put_bytes( bs, pool->size, pool->data );
+            int err = isom_write_sample_pool( bs, pool );
+            if( err < 0 )
+                return err;
         }
         mdat->media_size = file->fragment->pool_size;
         return 0;
@@ -1448,18 +1429,7 @@ static int isom_write_mdat( lsmash_bs_t *bs, isom_box_t *box )
         /* Write padding zero bytes until end of this box.
          * This code path is invoked when the size of a Media Data Box was reserved. */
         mdat->size = reserved_size;
-        int err = lsmash_bs_flush_buffer( bs );
-        if( err )
-            return err;
-        uint64_t padding_size = reserved_size - actual_size;
-        static const uint8_t zero_bytes[64] = { 0 };
-        while( padding_size > sizeof(zero_bytes) )
-        {
-            if( (err = lsmash_bs_write_data( bs, zero_bytes, sizeof(zero_bytes) )) < 0 )
-                return err;
-            padding_size -= sizeof(zero_bytes);
-        }
-        return lsmash_bs_write_data( bs, zero_bytes, padding_size );
+        return isom_write_zero_bytes( bs, reserved_size - actual_size );
     }
     if( !bs->unseekable )
     {
@@ -1504,6 +1474,14 @@ static int isom_write_free( lsmash_bs_t *bs, isom_box_t *box )
     return 0;
 }
 
+int isom_write_free_space( lsmash_bs_t *bs, uint64_t size )
+{
+    assert( size >= ISOM_BASEBOX_COMMON_SIZE && size <= UINT32_MAX );
+    lsmash_bs_put_be32( bs, size );
+    lsmash_bs_put_be32( bs, ISOM_BOX_TYPE_FREE.fourcc );
+    return isom_write_zero_bytes( bs, size - ISOM_BASEBOX_COMMON_SIZE );
+}
+
 static int isom_write_sidx( lsmash_bs_t *bs, isom_box_t *box )
 {
     isom_sidx_t *sidx = (isom_sidx_t *)box;
@@ -26,4 +26,8 @@
 int isom_write_box( lsmash_bs_t *bs, isom_box_t *box );
 void isom_set_box_writer( isom_box_t *box );
 
+/* Write a Free Space Box filled with zero bytes.
+ * 'size' is including the type and the size fields. */
+int isom_write_free_space( lsmash_bs_t *bs, uint64_t size );
+
 #endif
@@ -187,7 +187,7 @@ static int ac3_importer_get_accessunit( importer_t *importer, uint32_t track_num
         summary->channels   = ac3_get_channel_count( param );
         //summary->layout_tag = ac3_channel_layout_table[ param->acmod ][ param->lfeon ];
     }
-    lsmash_sample_t *sample = lsmash_create_sample( frame_size );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, frame_size );
     if( !sample )
         return LSMASH_ERR_MEMORY_ALLOC;
     *p_sample = sample;
@@ -519,7 +519,7 @@ static int eac3_importer_get_accessunit( importer_t *importer, uint32_t track_nu
         eac3_update_sample_rate( &summary->frequency, &info->dec3_param, &eac3_imp->current_fscod2 );
         eac3_update_channel_count( &summary->channels, &info->dec3_param );
     }
-    lsmash_sample_t *sample = lsmash_create_sample( eac3_imp->au_length );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, eac3_imp->au_length );
     if( !sample )
         return LSMASH_ERR_MEMORY_ALLOC;
     *p_sample = sample;
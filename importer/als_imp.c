@@ -226,7 +226,7 @@ static int mp4a_als_importer_get_accessunit( importer_t *importer, uint32_t trac
     als_specific_config_t *alssc = &als_imp->alssc;
     if( alssc->number_of_ra_units == 0 )
     {
-        lsmash_sample_t *sample = lsmash_create_sample( alssc->access_unit_size );
+        lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, alssc->access_unit_size );
         if( !sample )
             return LSMASH_ERR_MEMORY_ALLOC;
         *p_sample = sample;
@@ -244,7 +244,7 @@ static int mp4a_als_importer_get_accessunit( importer_t *importer, uint32_t trac
     else /* if( alssc->ra_flag == 1 ) */
         /* We don't export ra_unit_size into a sample. */
         au_length = lsmash_bs_get_be32( bs );
-    lsmash_sample_t *sample = lsmash_create_sample( au_length );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, au_length );
     if( !sample )
         return LSMASH_ERR_MEMORY_ALLOC;
     *p_sample = sample;
@@ -115,7 +115,7 @@ static int amr_get_accessunit
         importer->status = IMPORTER_ERROR;
         return read_size < 0 ? LSMASH_ERR_INVALID_DATA : LSMASH_ERR_NAMELESS;
     }
-    lsmash_sample_t *sample = lsmash_create_sample( read_size );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, read_size );
     if( !sample )
         return LSMASH_ERR_MEMORY_ALLOC;
     *p_sample = sample;
@@ -221,7 +221,7 @@ static int dts_importer_get_accessunit( importer_t *importer, uint32_t track_num
         return IMPORTER_EOF;
     if( current_status == IMPORTER_CHANGE )
         summary->max_au_length = 0;
-    lsmash_sample_t *sample = lsmash_create_sample( dts_imp->au_length );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, dts_imp->au_length );
     if( !sample )
         return LSMASH_ERR_MEMORY_ALLOC;
     *p_sample = sample;
@@ -50,6 +50,9 @@ extern const importer_functions hevc_importer;
 extern const importer_functions vc1_importer;
 extern const importer_functions isobm_importer;
 
+/* size of the head of an unseekable stream buffered for probing */
+#define IMPORTER_PROBE_SIZE (64 * 1024)
+
 /******** importer listing table ********/
 static const importer_functions *importer_func_table[] =
 {
@@ -132,16 +135,29 @@ int lsmash_importer_find( importer_t *importer, const char *format, int auto_det
     int err = LSMASH_ERR_NAMELESS;
     if( auto_detect )
     {
+        /* An unseekable stream such as stdin can be rewound after a failed probe only while the data read by
+         * the probe is still held on the buffer. So, buffer the head of the stream before probing. */
+        lsmash_bs_t *bs = importer->bs;
+        if( bs->unseekable && (err = lsmash_bs_read( bs, IMPORTER_PROBE_SIZE )) < 0 )
+            funcs = NULL;
         /* just rely on detector. */
-        for( int i = 0; (funcs = importer_func_table[i]) != NULL; i++ )
-        {
-            importer->class = &funcs->class;
-            if( !funcs->detectable )
-                continue;
-            if( (err = funcs->probe( importer )) == 0
-             || lsmash_bs_read_seek( importer->bs, 0, SEEK_SET ) != 0 )
-                break;
-        }
+        else
+            for( int i = 0; (funcs = importer_func_table[i]) != NULL; i++ )
+            {
+                importer->class = &funcs->class;
+                if( !funcs->detectable )
+                    continue;
+                if( (err = funcs->probe( importer )) == 0 )
+                    break;
+                if( bs->unseekable && (bs->buffer.unseekable || bs->offset != bs->buffer.store) )
+                {
+                    /* The head of the stream has been dropped from the buffer. */
+                    funcs = NULL;
+                    break;
+                }
+                if( lsmash_bs_read_seek( bs, 0, SEEK_SET ) != 0 )
+                    break;
+            }
     }
     else
     {
@@ -167,7 +183,7 @@ int lsmash_importer_find( importer_t *importer, const char *format, int auto_det
     return err;
 }
 
-importer_t *lsmash_importer_open( lsmash_root_t *root, const char *identifier, const char *format )
+static importer_t *importer_open( lsmash_root_t *root, const char *identifier, const char *format, int streaming )
 {
     if( identifier == NULL )
         return NULL;
@@ -176,16 +192,8 @@ importer_t *lsmash_importer_open( lsmash_root_t *root, const char *identifier, c
     if( !importer )
         return NULL;
     importer->is_adhoc_open = 1;
+    importer->streaming     = streaming;
     /* Open an input 'stream'. */
-    if( !strcmp( identifier, "-" ) )
-    {
-        /* special treatment for stdin */
-        if( auto_detect )
-        {
-            lsmash_log( importer, LSMASH_LOG_ERROR, "auto importer detection on stdin is not supported.\n" );
-            goto fail;
-        }
-    }
     if( lsmash_open_file( identifier, 1, &importer->file_param ) < 0 )
     {
         lsmash_log( importer, LSMASH_LOG_ERROR, "failed to open %s.\n", identifier );
@@ -206,6 +214,16 @@ fail:
     return NULL;
 }
 
+importer_t *lsmash_importer_open( lsmash_root_t *root, const char *identifier, const char *format )
+{
+    return importer_open( root, identifier, format, 0 );
+}
+
+importer_t *lsmash_importer_open_stream( lsmash_root_t *root, const char *identifier, const char *format )
+{
+    return importer_open( root, identifier, format, 1 );
+}
+
 /* 0 if success, positive if changed, negative if failed */
 int lsmash_importer_get_access_unit( importer_t *importer, uint32_t track_number, lsmash_sample_t **p_sample )
 {
@@ -76,6 +76,8 @@ struct importer_tag
                                              * framework and ISOBMFF demuxer framework. The importer shall be hidden inside
                                              * the file handling abstraction layer. That'll achieve integration of the muxer
                                              * and the remuxer CLIs. */
+    int                      streaming;     /* If set to 1, the importer derives timestamps on the fly
+                                             * instead of analyzing the whole stream in advance. */
 };
 
 int lsmash_importer_make_fake_movie
@@ -128,6 +130,18 @@ importer_t *lsmash_importer_open
     const char    *format
 );
 
+/* Open an importer which reads the stream only once.
+ * Importers that support it derive timestamps on the fly without analyzing the whole stream in advance,
+ * which enables import from pipes. Otherwise, this is the same as lsmash_importer_open().
+ * "-" as 'identifier' means stdin. The format of an unseekable stream such as stdin is detected from its head
+ * buffered in advance. Importers analyzing the whole stream in advance cannot read an unseekable stream. */
+importer_t *lsmash_importer_open_stream
+(
+    lsmash_root_t *root,
+    const char    *identifier,
+    const char    *format
+);
+
 void lsmash_importer_close
 (
     importer_t *importer
@@ -163,6 +177,47 @@ lsmash_summary_t *lsmash_duplicate_summary
     uint32_t    track_number
 );
 
+/* importing pipeline
+ * A pipeline parses access units of every track of an importer on a worker thread and keeps up to 'queue_length'
+ * of them per track, so that importers of different inputs parse concurrently while the caller appends samples.
+ * While a pipeline runs, its importer shall not be used directly. Importers pipelined at the same time shall not
+ * share a ROOT. Access units parsed ahead are lost when the pipeline is stopped. */
+typedef struct importer_pipeline_tag importer_pipeline_t;
+
+importer_pipeline_t *lsmash_importer_start_pipeline
+(
+    importer_t *importer,
+    uint32_t    queue_length
+);
+
+/* Same as lsmash_importer_get_access_unit(), but wait for the worker to parse the access unit if not yet. */
+int lsmash_importer_pipeline_get_access_unit
+(
+    importer_pipeline_t *pipeline,
+    uint32_t             track_number,
+    lsmash_sample_t    **p_sample
+);
+
+/* Take the summary duplicated when the last access unit got from the pipeline changed the stream's properties.
+ * The caller owns the returned summary. */
+lsmash_summary_t *lsmash_importer_pipeline_take_summary
+(
+    importer_pipeline_t *pipeline,
+    uint32_t             track_number
+);
+
+/* Same as lsmash_importer_get_last_delta(), but available only after the end of the stream is got from the pipeline. */
+uint32_t lsmash_importer_pipeline_get_last_delta
+(
+    importer_pipeline_t *pipeline,
+    uint32_t             track_number
+);
+
+void lsmash_importer_stop_pipeline
+(
+    importer_pipeline_t *pipeline
+);
+
 #endif /* #ifdef LSMASH_IMPORTER_INTERNAL */
 
 #endif /* #ifndef LSMASH_IMPORTER_H */
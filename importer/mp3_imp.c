@@ -310,7 +310,7 @@ static int mp4sys_mp3_get_accessunit( importer_t *importer, uint32_t track_numbe
     lsmash_sample_t *sample = *p_sample;
     if( !sample )
     {
-        sample = lsmash_create_sample( MP4SYS_MP3_MAX_FRAME_LENGTH );
+        sample = lsmash_create_pooled_sample( importer->root, MP4SYS_MP3_MAX_FRAME_LENGTH );
         if( !sample )
             return LSMASH_ERR_MEMORY_ALLOC;
         *p_sample = sample;
@@ -37,6 +37,221 @@
 #include "codecs/h264.h"
 #include "codecs/nalu.h"
 
+typedef struct
+{
+    int64_t  poc;
+    uint32_t delta;
+    uint16_t poc_delta;
+    uint16_t reset;
+} nal_pic_timing_t;
+
+/* Streaming import of NAL unit streams
+ * Instead of analyzing the whole stream in advance, access units are handed over to the bounded reorder window
+ * in decoding order. A picture is output, i.e. gets its CTS, when the number of pictures waiting for output exceeds
+ * the reorder depth given by the first sequence parameter set or when a new coded video sequence starts.
+ * DTSs are derived from CTSs in output order in the same manner as nalu_generate_timestamps_from_poc(). */
+typedef struct
+{
+    lsmash_sample_t        *sample;
+    lsmash_video_summary_t *summary;    /* summary activated from this access unit if any */
+    int64_t                 poc;
+    uint32_t                delta;
+    uint64_t                cts;        /* CTS without the composition delay */
+    uint8_t                 output;
+} nalu_stream_au_t;
+
+typedef struct
+{
+    nalu_stream_au_t *au;                       /* ring buffer of access units in decoding order */
+    uint32_t          au_alloc;
+    uint32_t          au_head;
+    uint32_t          au_count;
+    uint64_t         *dts;                      /* ring buffer of DTSs not yet assigned to any sample */
+    uint32_t          dts_alloc;
+    uint32_t          dts_head;
+    uint32_t          dts_count;
+    uint64_t         *first_cts;                /* CTSs of the first (max_num_reorder + 1) pictures in output order */
+    uint32_t          max_num_reorder;
+    uint32_t          num_waiting;              /* number of pictures waiting for output */
+    uint64_t          num_output;               /* number of pictures output so far */
+    uint64_t          next_cts;
+    uint64_t          composition_delay;
+    uint8_t           composition_delay_fixed;
+    uint32_t          last_delta;
+} nalu_stream_t;
+
+static void nalu_destroy_stream( nalu_stream_t *stream )
+{
+    if( !stream )
+        return;
+    for( uint32_t i = 0; i < stream->au_count; i++ )
+    {
+        nalu_stream_au_t *au = &stream->au[ (stream->au_head + i) % stream->au_alloc ];
+        lsmash_delete_sample( au->sample );
+        lsmash_cleanup_summary( (lsmash_summary_t *)au->summary );
+    }
+    lsmash_free( stream->au );
+    lsmash_free( stream->dts );
+    lsmash_free( stream->first_cts );
+    lsmash_free( stream );
+}
+
+static nalu_stream_t *nalu_create_stream( uint32_t max_num_reorder )
+{
+    nalu_stream_t *stream = lsmash_malloc_zero( sizeof(nalu_stream_t) );
+    if( !stream )
+        return NULL;
+    stream->first_cts = lsmash_malloc( (max_num_reorder + 1) * sizeof(uint64_t) );
+    if( !stream->first_cts )
+    {
+        nalu_destroy_stream( stream );
+        return NULL;
+    }
+    stream->max_num_reorder = max_num_reorder;
+    return stream;
+}
+
+/* Return the new ring buffer with doubled capacity where the oldest element is placed first. */
+static void *nalu_stream_expand_ring( void *ring, uint32_t *alloc, uint32_t *head, uint32_t count, size_t size )
+{
+    uint32_t new_alloc = *alloc ? 2 * *alloc : 16;
+    uint8_t *new_ring = lsmash_malloc( new_alloc * size );
+    if( !new_ring )
+        return NULL;
+    for( uint32_t i = 0; i < count; i++ )
+        memcpy( new_ring + i * size, (uint8_t *)ring + ((*head + i) % *alloc) * size, size );
+    lsmash_free( ring );
+    *alloc = new_alloc;
+    *head  = 0;
+    return new_ring;
+}
+
+static int nalu_stream_push_dts( nalu_stream_t *stream, uint64_t dts )
+{
+    if( stream->dts_count == stream->dts_alloc )
+    {
+        uint64_t *ring = nalu_stream_expand_ring( stream->dts, &stream->dts_alloc, &stream->dts_head,
+                                                  stream->dts_count, sizeof(uint64_t) );
+        if( !ring )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        stream->dts = ring;
+    }
+    stream->dts[ (stream->dts_head + stream->dts_count++) % stream->dts_alloc ] = dts;
+    return 0;
+}
+
+/* Output the picture with the smallest POC among the waiting ones. */
+static int nalu_stream_output_picture( nalu_stream_t *stream )
+{
+    nalu_stream_au_t *picture = NULL;
+    for( uint32_t i = 0; i < stream->au_count; i++ )
+    {
+        nalu_stream_au_t *au = &stream->au[ (stream->au_head + i) % stream->au_alloc ];
+        if( !au->output && (!picture || au->poc < picture->poc) )
+            picture = au;
+    }
+    if( !picture )
+        return 0;
+    picture->cts    = stream->next_cts;
+    picture->output = 1;
+    stream->next_cts += picture->delta;
+    -- stream->num_waiting;
+    /* The DTS of the n-th picture in decoding order is the CTS of the n-th picture in output order
+     * if n is not greater than the reorder depth, otherwise the CTS of the (n - depth)-th picture
+     * plus the composition delay. */
+    uint32_t depth = stream->max_num_reorder;
+    uint64_t k     = stream->num_output++;
+    if( k > depth )
+        return nalu_stream_push_dts( stream, picture->cts + stream->composition_delay );
+    int err;
+    stream->first_cts[k] = picture->cts;
+    if( (err = nalu_stream_push_dts( stream, picture->cts )) < 0 )
+        return err;
+    if( k == depth )
+    {
+        stream->composition_delay       = picture->cts;
+        stream->composition_delay_fixed = 1;
+        for( uint32_t i = 1; i <= depth; i++ )
+            if( (err = nalu_stream_push_dts( stream, stream->first_cts[i] + stream->composition_delay )) < 0 )
+                return err;
+    }
+    return 0;
+}
+
+/* Hand over an access unit in decoding order.
+ * If the access unit starts a new coded video sequence, the pictures of the previous one are output first. */
+static int nalu_stream_append
+(
+    nalu_stream_t          *stream,
+    lsmash_sample_t        *sample,
+    lsmash_video_summary_t *summary,
+    int64_t                 poc,
+    uint32_t                delta,
+    int                     new_sequence
+)
+{
+    int err;
+    while( new_sequence && stream->num_waiting )
+        if( (err = nalu_stream_output_picture( stream )) < 0 )
+            return err;
+    if( stream->au_count == stream->au_alloc )
+    {
+        nalu_stream_au_t *ring = nalu_stream_expand_ring( stream->au, &stream->au_alloc, &stream->au_head,
+                                                          stream->au_count, sizeof(nalu_stream_au_t) );
+        if( !ring )
+            return LSMASH_ERR_MEMORY_ALLOC;
+        stream->au = ring;
+    }
+    nalu_stream_au_t *au = &stream->au[ (stream->au_head + stream->au_count++) % stream->au_alloc ];
+    au->sample  = sample;
+    au->summary = summary;
+    au->poc     = poc;
+    au->delta   = delta;
+    au->cts     = 0;
+    au->output  = 0;
+    ++ stream->num_waiting;
+    while( stream->num_waiting > stream->max_num_reorder )
+        if( (err = nalu_stream_output_picture( stream )) < 0 )
+            return err;
+    return 0;
+}
+
+/* Output all the remaining pictures at the end of the stream. */
+static int nalu_stream_finish( nalu_stream_t *stream )
+{
+    int err;
+    while( stream->num_waiting )
+        if( (err = nalu_stream_output_picture( stream )) < 0 )
+            return err;
+    if( !stream->composition_delay_fixed )
+    {
+        /* The stream is shorter than the reorder depth. */
+        stream->composition_delay       = stream->num_output ? stream->first_cts[ stream->num_output - 1 ] : 0;
+        stream->composition_delay_fixed = 1;
+    }
+    return 0;
+}
+
+/* Take the oldest access unit in decoding order if its timestamps are settled.
+ * Return 1 if taken, otherwise 0. */
+static int nalu_stream_pop( nalu_stream_t *stream, nalu_stream_au_t *dst )
+{
+    if( stream->au_count == 0 || stream->dts_count == 0 || !stream->composition_delay_fixed )
+        return 0;
+    nalu_stream_au_t *au = &stream->au[ stream->au_head ];
+    if( !au->output )
+        return 0;
+    *dst = *au;
+    dst->sample->dts = stream->dts[ stream->dts_head ];
+    dst->sample->cts = au->cts + stream->composition_delay;
+    stream->last_delta = au->delta;
+    stream->au_head  = (stream->au_head  + 1) % stream->au_alloc;
+    stream->dts_head = (stream->dts_head + 1) % stream->dts_alloc;
+    -- stream->au_count;
+    -- stream->dts_count;
+    return 1;
+}
+
 typedef struct
 {
     h264_info_t            info;
@@ -51,21 +266,19 @@ typedef struct
     uint64_t sc_head_pos;
     uint8_t  composition_reordering_present;
     uint8_t  field_pic_present;
+    /* for streaming import */
+    nalu_stream_t *stream;
+    uint32_t timescale_divisor;
+    uint32_t num_parameter_sets;    /* number of parameter sets in the latest summary */
+    uint8_t  sequence_started;      /* the first picture with POC equal to 0 has appeared */
 } h264_importer_t;
 
-typedef struct
-{
-    int64_t  poc;
-    uint32_t delta;
-    uint16_t poc_delta;
-    uint16_t reset;
-} nal_pic_timing_t;
-
 static void remove_h264_importer( h264_importer_t *h264_imp )
 {
     if( !h264_imp )
         return;
     lsmash_list_remove_entries( h264_imp->avcC_list );
+    nalu_destroy_stream( h264_imp->stream );
     h264_cleanup_parser( &h264_imp->info );
     lsmash_free( h264_imp->ts_list.timestamp );
     lsmash_free( h264_imp );
@@ -392,6 +605,212 @@ static inline void h264_importer_check_eof( importer_t *importer, h264_access_un
         importer->status = IMPORTER_OK;
 }
 
+static void h264_set_sample_property
+(
+    h264_importer_t     *h264_imp,
+    lsmash_sample_t     *sample,
+    h264_picture_info_t *picture
+)
+{
+    if( h264_imp->composition_reordering_present && !picture->disposable && !picture->idr )
+        sample->prop.allow_earlier = QT_SAMPLE_EARLIER_PTS_ALLOWED;
+    sample->prop.independent = picture->independent    ? ISOM_SAMPLE_IS_INDEPENDENT : ISOM_SAMPLE_IS_NOT_INDEPENDENT;
+    sample->prop.disposable  = picture->disposable     ? ISOM_SAMPLE_IS_DISPOSABLE  : ISOM_SAMPLE_IS_NOT_DISPOSABLE;
+    sample->prop.redundant   = picture->has_redundancy ? ISOM_SAMPLE_HAS_REDUNDANCY : ISOM_SAMPLE_HAS_NO_REDUNDANCY;
+    sample->prop.post_roll.identifier = picture->frame_num;
+    if( picture->random_accessible )
+    {
+        if( picture->idr )
+            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
+        else if( picture->recovery_frame_cnt )
+        {
+            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_POST_ROLL_START;
+            sample->prop.post_roll.complete = (picture->frame_num + picture->recovery_frame_cnt) % h264_imp->info.sps.MaxFrameNum;
+        }
+        else
+        {
+            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP;
+            if( !picture->broken_link_flag )
+                sample->prop.ra_flags |= QT_SAMPLE_RANDOM_ACCESS_FLAG_PARTIAL_SYNC;
+        }
+    }
+}
+
+/* The leading property depends on CTS, so set it after the other properties and timestamps are settled. */
+static void h264_set_leading_property
+(
+    h264_importer_t *h264_imp,
+    lsmash_sample_t *sample,
+    int              undecodable
+)
+{
+    int independent = (sample->prop.independent == ISOM_SAMPLE_IS_INDEPENDENT);
+    int idr         = (sample->prop.ra_flags & ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC) != 0;
+    if( undecodable )
+        sample->prop.leading = ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
+    else
+        sample->prop.leading =
+              independent                             ? ISOM_SAMPLE_IS_NOT_LEADING
+            : sample->cts >= h264_imp->last_intra_cts ? ISOM_SAMPLE_IS_NOT_LEADING
+            : sample->cts <  h264_imp->last_sync_cts  ? ISOM_SAMPLE_IS_DECODABLE_LEADING
+            :                                           ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
+    if( independent )
+        h264_imp->last_intra_cts = sample->cts;
+    if( idr )
+        h264_imp->last_sync_cts  = sample->cts;
+}
+
+static uint32_t h264_count_parameter_sets( lsmash_h264_specific_parameters_t *param )
+{
+    lsmash_h264_parameter_sets_t *parameter_sets = param->parameter_sets;
+    if( !parameter_sets )
+        return 0;
+    return parameter_sets->sps_list   ->entry_count
+         + parameter_sets->pps_list   ->entry_count
+         + parameter_sets->spsext_list->entry_count;
+}
+
+static int h264_setup_stream( importer_t *importer )
+{
+    h264_importer_t *h264_imp = (h264_importer_t *)importer->info;
+    h264_sps_t      *sps      = &h264_imp->info.sps;
+    /* Each field is an access unit if field coding is allowed. */
+    uint32_t max_num_reorder = sps->max_num_reorder_frames << !sps->frame_mbs_only_flag;
+    h264_imp->stream = nalu_create_stream( max_num_reorder );
+    if( !h264_imp->stream )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    /* Picture timing is in field level. Every picture is a frame lasting 2 ticks
+     * if neither field coding nor picture structure is present. */
+    h264_imp->timescale_divisor = sps->frame_mbs_only_flag && !sps->vui.pic_struct_present_flag && sps->vui.time_scale
+                                ? lsmash_get_gcd( sps->vui.time_scale, 2 )
+                                : 1;
+    h264_imp->composition_reordering_present = (max_num_reorder > 0);
+    if( max_num_reorder )
+        lsmash_log( importer, LSMASH_LOG_INFO, "reorder window: %"PRIu32" pictures\n", max_num_reorder );
+    return 0;
+}
+
+/* Get the next access unit in decoding order and hand it over to the reorder window. */
+static int h264_stream_access_unit( importer_t *importer )
+{
+    h264_importer_t     *h264_imp = (h264_importer_t *)importer->info;
+    h264_info_t         *info     = &h264_imp->info;
+    h264_access_unit_t  *au       = &info->au;
+    h264_picture_info_t *picture  = &au->picture;
+    h264_picture_info_t prev_picture = *picture;
+    int err;
+    if( (err = h264_get_access_unit_internal( importer, 0 ))       < 0
+     || (err = h264_calculate_poc( info, picture, &prev_picture )) < 0 )
+        return err;
+    h264_importer_check_eof( importer, au );
+    if( !h264_imp->stream && (err = h264_setup_stream( importer )) < 0 )
+        return err;
+    if( picture->delta % h264_imp->timescale_divisor )
+    {
+        lsmash_log( importer, LSMASH_LOG_ERROR, "field coding appeared after frame-only coded video sequences.\n" );
+        return LSMASH_ERR_PATCH_WELCOME;
+    }
+    h264_imp->max_au_length = LSMASH_MAX( au->length, h264_imp->max_au_length );
+    /* Parameter sets are stored only in sample descriptions.
+     * So, create a new summary whenever the parameter sets for this access unit change. */
+    lsmash_video_summary_t *summary = NULL;
+    uint32_t num_parameter_sets = h264_count_parameter_sets( &info->avcC_param );
+    if( !info->avcC_pending
+     && (importer->status == IMPORTER_CHANGE || num_parameter_sets != h264_imp->num_parameter_sets) )
+    {
+        summary = h264_create_summary( &info->avcC_param, &info->sps, h264_imp->max_au_length );
+        if( !summary )
+            return LSMASH_ERR_NAMELESS;
+        summary->timescale       /= h264_imp->timescale_divisor;
+        summary->sample_per_field = (h264_imp->timescale_divisor == 1);
+        h264_imp->num_parameter_sets = num_parameter_sets;
+        if( importer->status == IMPORTER_CHANGE )
+            importer->status = IMPORTER_OK;
+    }
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, au->length );
+    if( !sample )
+    {
+        lsmash_cleanup_summary( (lsmash_summary_t *)summary );
+        return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    memcpy( sample->data, au->data, au->length );
+    h264_set_sample_property( h264_imp, sample, picture );
+    /* A picture with memory_management_control_operation equal to 5 starts a new coded video sequence as POC 0. */
+    int new_sequence = (picture->PicOrderCnt == 0 || picture->has_mmco5);
+    h264_imp->sequence_started |= new_sequence;
+    if( !h264_imp->sequence_started )
+        sample->prop.leading = ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
+    if( (err = nalu_stream_append( h264_imp->stream, sample, summary,
+                                   picture->has_mmco5 ? 0 : picture->PicOrderCnt,
+                                   picture->delta / h264_imp->timescale_divisor, new_sequence )) < 0 )
+    {
+        lsmash_delete_sample( sample );
+        lsmash_cleanup_summary( (lsmash_summary_t *)summary );
+        return err;
+    }
+    return 0;
+}
+
+static int h264_stream_get_accessunit
+(
+    importer_t       *importer,
+    lsmash_sample_t **p_sample
+)
+{
+    h264_importer_t *h264_imp = (h264_importer_t *)importer->info;
+    nalu_stream_t   *stream   = h264_imp->stream;
+    nalu_stream_au_t au;
+    int err;
+    while( !nalu_stream_pop( stream, &au ) )
+    {
+        if( importer->status != IMPORTER_EOF )
+        {
+            if( (err = h264_stream_access_unit( importer )) < 0 )
+            {
+                importer->status = IMPORTER_ERROR;
+                return err;
+            }
+        }
+        else if( stream->num_waiting || !stream->composition_delay_fixed )
+        {
+            if( (err = nalu_stream_finish( stream )) < 0 )
+                return err;
+        }
+        else
+            return stream->au_count ? LSMASH_ERR_NAMELESS : IMPORTER_EOF;
+    }
+    lsmash_sample_t *sample = au.sample;
+    h264_set_leading_property( h264_imp, sample, sample->prop.leading == ISOM_SAMPLE_IS_UNDECODABLE_LEADING );
+    *p_sample = sample;
+    if( !au.summary )
+        return IMPORTER_OK;
+    /* Update the active summary. */
+    lsmash_list_remove_entry( importer->summaries, 1 );
+    if( lsmash_list_add_entry( importer->summaries, au.summary ) < 0 )
+    {
+        lsmash_cleanup_summary( (lsmash_summary_t *)au.summary );
+        return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    return IMPORTER_CHANGE;
+}
+
+static int h264_start_stream( importer_t *importer )
+{
+    h264_importer_t *h264_imp = (h264_importer_t *)importer->info;
+    importer->status = IMPORTER_OK;
+    int err = h264_stream_access_unit( importer );
+    if( err < 0 )
+        return err;
+    /* The summary activated from the first access unit is the initial one. */
+    nalu_stream_au_t *au = &h264_imp->stream->au[ h264_imp->stream->au_head ];
+    if( !au->summary )
+        return LSMASH_ERR_INVALID_DATA;
+    if( lsmash_list_add_entry( importer->summaries, au->summary ) < 0 )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    au->summary = NULL;
+    return 0;
+}
+
 static int h264_importer_get_accessunit
 (
     importer_t       *importer,
@@ -408,6 +827,8 @@ static int h264_importer_get_accessunit
     importer_status current_status = importer->status;
     if( current_status == IMPORTER_ERROR )
         return LSMASH_ERR_NAMELESS;
+    if( importer->streaming )
+        return h264_stream_get_accessunit( importer, p_sample );
     if( current_status == IMPORTER_EOF )
         return IMPORTER_EOF;
     int err = h264_get_access_unit_internal( importer, 0 );
@@ -437,48 +858,15 @@ static int h264_importer_get_accessunit
         }
         importer->status = IMPORTER_OK;
     }
-    lsmash_sample_t *sample = lsmash_create_sample( h264_imp->max_au_length );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, h264_imp->max_au_length );
     if( !sample )
         return LSMASH_ERR_MEMORY_ALLOC;
     *p_sample = sample;
-    h264_access_unit_t  *au      = &info->au;
-    h264_picture_info_t *picture = &au->picture;
+    h264_access_unit_t *au = &info->au;
     sample->dts = h264_imp->ts_list.timestamp[ au->number - 1 ].dts;
     sample->cts = h264_imp->ts_list.timestamp[ au->number - 1 ].cts;
-    if( au->number < h264_imp->num_undecodable )
-        sample->prop.leading = ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
-    else
-        sample->prop.leading =
-              picture->independent                    ? ISOM_SAMPLE_IS_NOT_LEADING
-            : sample->cts >= h264_imp->last_intra_cts ? ISOM_SAMPLE_IS_NOT_LEADING
-            : sample->cts <  h264_imp->last_sync_cts  ? ISOM_SAMPLE_IS_DECODABLE_LEADING
-            :                                           ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
-    if( h264_imp->composition_reordering_present && !picture->disposable && !picture->idr )
-        sample->prop.allow_earlier = QT_SAMPLE_EARLIER_PTS_ALLOWED;
-    sample->prop.independent = picture->independent    ? ISOM_SAMPLE_IS_INDEPENDENT : ISOM_SAMPLE_IS_NOT_INDEPENDENT;
-    sample->prop.disposable  = picture->disposable     ? ISOM_SAMPLE_IS_DISPOSABLE  : ISOM_SAMPLE_IS_NOT_DISPOSABLE;
-    sample->prop.redundant   = picture->has_redundancy ? ISOM_SAMPLE_HAS_REDUNDANCY : ISOM_SAMPLE_HAS_NO_REDUNDANCY;
-    sample->prop.post_roll.identifier = picture->frame_num;
-    if( picture->random_accessible )
-    {
-        if( picture->idr )
-            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
-        else if( picture->recovery_frame_cnt )
-        {
-            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_POST_ROLL_START;
-            sample->prop.post_roll.complete = (picture->frame_num + picture->recovery_frame_cnt) % info->sps.MaxFrameNum;
-        }
-        else
-        {
-            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP;
-            if( !picture->broken_link_flag )
-                sample->prop.ra_flags |= QT_SAMPLE_RANDOM_ACCESS_FLAG_PARTIAL_SYNC;
-        }
-    }
-    if( picture->independent )
-        h264_imp->last_intra_cts = sample->cts;
-    if( picture->idr )
-        h264_imp->last_sync_cts  = sample->cts;
+    h264_set_sample_property( h264_imp, sample, &au->picture );
+    h264_set_leading_property( h264_imp, sample, au->number < h264_imp->num_undecodable );
     sample->length = au->length;
     memcpy( sample->data, au->data, au->length );
     return current_status;
@@ -858,6 +1246,19 @@ static int h264_importer_probe( importer_t *importer )
     h264_info_t *info = &h264_imp->info;
     lsmash_bs_read_seek( bs, first_sc_head_pos, SEEK_SET );
     h264_imp->sc_head_pos = first_sc_head_pos;
+    if( importer->streaming )
+    {
+        /* Timestamps are derived on the fly, so start importing here. */
+        if( (err = h264_start_stream( importer )) < 0 )
+            goto fail;
+        return 0;
+    }
+    if( bs->unseekable )
+    {
+        /* The whole stream is analyzed in advance and read again, which requires seeking. */
+        err = LSMASH_ERR_PATCH_WELCOME;
+        goto fail;
+    }
     if( (err = h264_analyze_whole_stream( importer )) < 0 )
         goto fail;
     /* Go back to the start code of the first NALU. */
@@ -892,6 +1293,10 @@ static uint32_t h264_importer_get_last_delta( importer_t *importer, uint32_t tra
     h264_importer_t *h264_imp = (h264_importer_t *)importer->info;
     if( !h264_imp || track_number != 1 || importer->status != IMPORTER_EOF )
         return 0;
+    if( importer->streaming )
+        return h264_imp->stream && h264_imp->stream->num_output
+             ? h264_imp->stream->last_delta
+             : UINT32_MAX;    /* arbitrary */
     return h264_imp->ts_list.sample_count
          ? h264_imp->last_delta
          : UINT32_MAX;    /* arbitrary */
@@ -928,6 +1333,11 @@ typedef struct
     uint8_t  composition_reordering_present;
     uint8_t  field_pic_present;
     uint8_t  max_TemporalId;
+    /* for streaming import */
+    nalu_stream_t *stream;
+    uint32_t timescale_divisor;
+    uint32_t num_parameter_sets;    /* number of parameter sets in the latest summary */
+    uint8_t  sequence_started;      /* the first picture with POC equal to 0 has appeared */
 } hevc_importer_t;
 
 static void remove_hevc_importer( hevc_importer_t *hevc_imp )
@@ -935,6 +1345,7 @@ static void remove_hevc_importer( hevc_importer_t *hevc_imp )
     if( !hevc_imp )
         return;
     lsmash_list_remove_entries( hevc_imp->hvcC_list );
+    nalu_destroy_stream( hevc_imp->stream );
     hevc_cleanup_parser( &hevc_imp->info );
     lsmash_free( hevc_imp->ts_list.timestamp );
     lsmash_free( hevc_imp );
@@ -1260,6 +1671,218 @@ static inline void hevc_importer_check_eof( importer_t *importer, hevc_access_un
         importer->status = IMPORTER_OK;
 }
 
+static void hevc_set_sample_property
+(
+    hevc_importer_t    *hevc_imp,
+    lsmash_sample_t    *sample,
+    hevc_access_unit_t *au
+)
+{
+    hevc_picture_info_t *picture = &au->picture;
+    /* Set property of disposability. */
+    if( picture->sublayer_nonref && au->TemporalId == hevc_imp->max_TemporalId )
+        /* Sub-layer non-reference pictures are not referenced by subsequent pictures of
+         * the same sub-layer in decoding order. */
+        sample->prop.disposable = ISOM_SAMPLE_IS_DISPOSABLE;
+    else
+        sample->prop.disposable = ISOM_SAMPLE_IS_NOT_DISPOSABLE;
+    /* Set property of leading if it is decided by the NAL unit type.
+     * The other leading pictures are found by hevc_set_leading_property(). */
+    if( picture->radl || picture->rasl )
+        sample->prop.leading = picture->radl ? ISOM_SAMPLE_IS_DECODABLE_LEADING : ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
+    /* Set property of independence. */
+    sample->prop.independent = picture->independent ? ISOM_SAMPLE_IS_INDEPENDENT : ISOM_SAMPLE_IS_NOT_INDEPENDENT;
+    sample->prop.redundant   = ISOM_SAMPLE_HAS_NO_REDUNDANCY;
+    sample->prop.post_roll.identifier = picture->poc;
+    if( picture->random_accessible )
+    {
+        if( picture->irap )
+        {
+            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
+            if( picture->closed_rap )
+                sample->prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_CLOSED_RAP;
+            else
+                sample->prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP;
+        }
+        else if( picture->recovery_poc_cnt )
+        {
+            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_POST_ROLL_START;
+            sample->prop.post_roll.complete = picture->poc + picture->recovery_poc_cnt;
+        }
+        else
+            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP;
+    }
+}
+
+/* The leading property depends on CTS, so set it after the other properties and timestamps are settled. */
+static void hevc_set_leading_property
+(
+    hevc_importer_t *hevc_imp,
+    lsmash_sample_t *sample,
+    int              undecodable
+)
+{
+    int independent = (sample->prop.independent == ISOM_SAMPLE_IS_INDEPENDENT);
+    if( sample->prop.leading == ISOM_SAMPLE_LEADING_UNKNOWN )
+    {
+        if( undecodable )
+            sample->prop.leading = ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
+        else if( independent || sample->cts >= hevc_imp->last_intra_cts )
+            sample->prop.leading = ISOM_SAMPLE_IS_NOT_LEADING;
+        else
+            sample->prop.leading = ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
+    }
+    if( independent )
+        hevc_imp->last_intra_cts = sample->cts;
+}
+
+static uint32_t hevc_count_parameter_sets( lsmash_hevc_specific_parameters_t *param )
+{
+    lsmash_hevc_parameter_arrays_t *parameter_arrays = param->parameter_arrays;
+    if( !parameter_arrays )
+        return 0;
+    uint32_t count = 0;
+    for( int i = 0; i < HEVC_DCR_NALU_TYPE_NUM; i++ )
+        count += parameter_arrays->ps_array[i].list->entry_count;
+    return count;
+}
+
+static int hevc_setup_stream( importer_t *importer )
+{
+    hevc_importer_t *hevc_imp = (hevc_importer_t *)importer->info;
+    hevc_sps_t      *sps      = &hevc_imp->info.sps;
+    hevc_imp->stream = nalu_create_stream( sps->max_num_reorder_pics );
+    if( !hevc_imp->stream )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    /* Picture timing is in field level while time_scale is in frame level basically.
+     * Every picture is a frame lasting 2 ticks if neither field coding nor picture structure is present. */
+    hevc_imp->timescale_divisor = !sps->vui.field_seq_flag && !sps->vui.frame_field_info_present_flag ? 2 : 1;
+    hevc_imp->composition_reordering_present = (sps->max_num_reorder_pics > 0);
+    hevc_imp->max_TemporalId                 = sps->max_sub_layers_minus1;
+    if( sps->max_num_reorder_pics )
+        lsmash_log( importer, LSMASH_LOG_INFO, "reorder window: %"PRIu8" pictures\n", sps->max_num_reorder_pics );
+    return 0;
+}
+
+/* Get the next access unit in decoding order and hand it over to the reorder window. */
+static int hevc_stream_access_unit( importer_t *importer )
+{
+    hevc_importer_t     *hevc_imp = (hevc_importer_t *)importer->info;
+    hevc_info_t         *info     = &hevc_imp->info;
+    hevc_access_unit_t  *au       = &info->au;
+    hevc_picture_info_t *picture  = &au->picture;
+    hevc_picture_info_t prev_picture = *picture;
+    int err;
+    if( (err = hevc_get_access_unit_internal( importer, 0 ))       < 0
+     || (err = hevc_calculate_poc( info, picture, &prev_picture )) < 0 )
+        return err;
+    hevc_importer_check_eof( importer, au );
+    if( !hevc_imp->stream && (err = hevc_setup_stream( importer )) < 0 )
+        return err;
+    if( picture->delta % hevc_imp->timescale_divisor )
+    {
+        lsmash_log( importer, LSMASH_LOG_ERROR, "field coding appeared after frame-only coded video sequences.\n" );
+        return LSMASH_ERR_PATCH_WELCOME;
+    }
+    hevc_imp->max_au_length = LSMASH_MAX( au->length, hevc_imp->max_au_length );
+    /* Parameter sets are stored only in sample descriptions.
+     * So, create a new summary whenever the parameter sets for this access unit change. */
+    lsmash_video_summary_t *summary = NULL;
+    uint32_t num_parameter_sets = hevc_count_parameter_sets( &info->hvcC_param );
+    if( !info->hvcC_pending
+     && (importer->status == IMPORTER_CHANGE || num_parameter_sets != hevc_imp->num_parameter_sets) )
+    {
+        summary = hevc_create_summary( &info->hvcC_param, &info->sps, hevc_imp->max_au_length );
+        if( !summary )
+            return LSMASH_ERR_NAMELESS;
+        summary->timescale        = summary->timescale * 2 / hevc_imp->timescale_divisor;
+        summary->sample_per_field = (hevc_imp->timescale_divisor == 1);
+        hevc_imp->num_parameter_sets = num_parameter_sets;
+        if( importer->status == IMPORTER_CHANGE )
+            importer->status = IMPORTER_OK;
+    }
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, au->length );
+    if( !sample )
+    {
+        lsmash_cleanup_summary( (lsmash_summary_t *)summary );
+        return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    memcpy( sample->data, au->data, au->length );
+    hevc_set_sample_property( hevc_imp, sample, au );
+    int new_sequence = (picture->poc == 0);
+    hevc_imp->sequence_started |= new_sequence;
+    if( !hevc_imp->sequence_started && sample->prop.leading == ISOM_SAMPLE_LEADING_UNKNOWN )
+        sample->prop.leading = ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
+    if( (err = nalu_stream_append( hevc_imp->stream, sample, summary, picture->poc,
+                                   picture->delta / hevc_imp->timescale_divisor, new_sequence )) < 0 )
+    {
+        lsmash_delete_sample( sample );
+        lsmash_cleanup_summary( (lsmash_summary_t *)summary );
+        return err;
+    }
+    return 0;
+}
+
+static int hevc_stream_get_accessunit
+(
+    importer_t       *importer,
+    lsmash_sample_t **p_sample
+)
+{
+    hevc_importer_t *hevc_imp = (hevc_importer_t *)importer->info;
+    nalu_stream_t   *stream   = hevc_imp->stream;
+    nalu_stream_au_t au;
+    int err;
+    while( !nalu_stream_pop( stream, &au ) )
+    {
+        if( importer->status != IMPORTER_EOF )
+        {
+            if( (err = hevc_stream_access_unit( importer )) < 0 )
+            {
+                importer->status = IMPORTER_ERROR;
+                return err;
+            }
+        }
+        else if( stream->num_waiting || !stream->composition_delay_fixed )
+        {
+            if( (err = nalu_stream_finish( stream )) < 0 )
+                return err;
+        }
+        else
+            return stream->au_count ? LSMASH_ERR_NAMELESS : IMPORTER_EOF;
+    }
+    lsmash_sample_t *sample = au.sample;
+    hevc_set_leading_property( hevc_imp, sample, 0 );
+    *p_sample = sample;
+    if( !au.summary )
+        return IMPORTER_OK;
+    /* Update the active summary. */
+    lsmash_list_remove_entry( importer->summaries, 1 );
+    if( lsmash_list_add_entry( importer->summaries, au.summary ) < 0 )
+    {
+        lsmash_cleanup_summary( (lsmash_summary_t *)au.summary );
+        return LSMASH_ERR_MEMORY_ALLOC;
+    }
+    return IMPORTER_CHANGE;
+}
+
+static int hevc_start_stream( importer_t *importer )
+{
+    hevc_importer_t *hevc_imp = (hevc_importer_t *)importer->info;
+    importer->status = IMPORTER_OK;
+    int err = hevc_stream_access_unit( importer );
+    if( err < 0 )
+        return err;
+    /* The summary activated from the first access unit is the initial one. */
+    nalu_stream_au_t *au = &hevc_imp->stream->au[ hevc_imp->stream->au_head ];
+    if( !au->summary )
+        return LSMASH_ERR_INVALID_DATA;
+    if( lsmash_list_add_entry( importer->summaries, au->summary ) < 0 )
+        return LSMASH_ERR_MEMORY_ALLOC;
+    au->summary = NULL;
+    return 0;
+}
+
 static int hevc_importer_get_accessunit( importer_t *importer, uint32_t track_number, lsmash_sample_t **p_sample )
 {
     if( !importer->info )
@@ -1271,6 +1894,8 @@ static int hevc_importer_get_accessunit( importer_t *importer, uint32_t track_nu
     importer_status current_status = importer->status;
     if( current_status == IMPORTER_ERROR )
         return LSMASH_ERR_NAMELESS;
+    if( importer->streaming )
+        return hevc_stream_get_accessunit( importer, p_sample );
     if( current_status == IMPORTER_EOF )
         return IMPORTER_EOF;
     int err = hevc_get_access_unit_internal( importer, 0 );
@@ -1300,60 +1925,15 @@ static int hevc_importer_get_accessunit( importer_t *importer, uint32_t track_nu
         }
         importer->status = IMPORTER_OK;
     }
-    lsmash_sample_t *sample = lsmash_create_sample( hevc_imp->max_au_length );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, hevc_imp->max_au_length );
     if( !sample )
         return LSMASH_ERR_MEMORY_ALLOC;
     *p_sample = sample;
-    hevc_access_unit_t  *au      = &info->au;
-    hevc_picture_info_t *picture = &au->picture;
+    hevc_access_unit_t *au = &info->au;
     sample->dts = hevc_imp->ts_list.timestamp[ au->number - 1 ].dts;
     sample->cts = hevc_imp->ts_list.timestamp[ au->number - 1 ].cts;
-    /* Set property of disposability. */
-    if( picture->sublayer_nonref && au->TemporalId == hevc_imp->max_TemporalId )
-        /* Sub-layer non-reference pictures are not referenced by subsequent pictures of
-         * the same sub-layer in decoding order. */
-        sample->prop.disposable = ISOM_SAMPLE_IS_DISPOSABLE;
-    else
-        sample->prop.disposable = ISOM_SAMPLE_IS_NOT_DISPOSABLE;
-    /* Set property of leading. */
-    if( picture->radl || picture->rasl )
-        sample->prop.leading = picture->radl ? ISOM_SAMPLE_IS_DECODABLE_LEADING : ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
-    else
-    {
-        if( au->number < hevc_imp->num_undecodable )
-            sample->prop.leading = ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
-        else
-        {
-            if( picture->independent || sample->cts >= hevc_imp->last_intra_cts )
-                sample->prop.leading = ISOM_SAMPLE_IS_NOT_LEADING;
-            else
-                sample->prop.leading = ISOM_SAMPLE_IS_UNDECODABLE_LEADING;
-        }
-    }
-    if( picture->independent )
-        hevc_imp->last_intra_cts = sample->cts;
-    /* Set property of independence. */
-    sample->prop.independent = picture->independent ? ISOM_SAMPLE_IS_INDEPENDENT : ISOM_SAMPLE_IS_NOT_INDEPENDENT;
-    sample->prop.redundant   = ISOM_SAMPLE_HAS_NO_REDUNDANCY;
-    sample->prop.post_roll.identifier = picture->poc;
-    if( picture->random_accessible )
-    {
-        if( picture->irap )
-        {
-            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC;
-            if( picture->closed_rap )
-                sample->prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_CLOSED_RAP;
-            else
-                sample->prop.ra_flags |= ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP;
-        }
-        else if( picture->recovery_poc_cnt )
-        {
-            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_POST_ROLL_START;
-            sample->prop.post_roll.complete = picture->poc + picture->recovery_poc_cnt;
-        }
-        else
-            sample->prop.ra_flags = ISOM_SAMPLE_RANDOM_ACCESS_FLAG_RAP;
-    }
+    hevc_set_sample_property( hevc_imp, sample, au );
+    hevc_set_leading_property( hevc_imp, sample, au->number < hevc_imp->num_undecodable );
     sample->length = au->length;
     memcpy( sample->data, au->data, au->length );
     return current_status;
@@ -1516,6 +2096,19 @@ static int hevc_importer_probe( importer_t *importer )
     hevc_info_t *info = &hevc_imp->info;
     lsmash_bs_read_seek( bs, first_sc_head_pos, SEEK_SET );
     hevc_imp->sc_head_pos = first_sc_head_pos;
+    if( importer->streaming )
+    {
+        /* Timestamps are derived on the fly, so start importing here. */
+        if( (err = hevc_start_stream( importer )) < 0 )
+            goto fail;
+        return 0;
+    }
+    if( bs->unseekable )
+    {
+        /* The whole stream is analyzed in advance and read again, which requires seeking. */
+        err = LSMASH_ERR_PATCH_WELCOME;
+        goto fail;
+    }
     if( (err = hevc_analyze_whole_stream( importer )) < 0 )
         goto fail;
     /* Go back to the start code of the first NALU. */
@@ -1550,6 +2143,10 @@ static uint32_t hevc_importer_get_last_delta( importer_t *importer, uint32_t tra
     hevc_importer_t *hevc_imp = (hevc_importer_t *)importer->info;
     if( !hevc_imp || track_number != 1 || importer->status != IMPORTER_EOF )
         return 0;
+    if( importer->streaming )
+        return hevc_imp->stream && hevc_imp->stream->num_output
+             ? hevc_imp->stream->last_delta
+             : UINT32_MAX;    /* arbitrary */
     return hevc_imp->ts_list.sample_count
          ? hevc_imp->last_delta
          : UINT32_MAX;    /* arbitrary */
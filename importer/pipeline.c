@@ -0,0 +1,262 @@
+/*****************************************************************************
+ * pipeline.c
+ *****************************************************************************
+ * Copyright (C) 2017 L-SMASH project
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *****************************************************************************/
+
+/* This file is available under an ISC license. */
+
+#include "common/internal.h" /* must be placed first */
+
+#include "importer.h"
+
+/* return values of lsmash_importer_get_access_unit() */
+#define IMPORTER_PIPELINE_CHANGE 1
+#define IMPORTER_PIPELINE_EOF    2
+
+typedef struct
+{
+    lsmash_sample_t  *sample;
+    lsmash_summary_t *summary;  /* summary taken when the properties of the stream changed at this access unit */
+    int               status;   /* return value of lsmash_importer_get_access_unit() */
+} importer_pipeline_entry_t;
+
+typedef struct
+{
+    int                        finished;    /* The worker got the end of the stream or an error from this track. */
+    int                        status;      /* status of the last entry dequeued */
+    uint32_t                   last_delta;  /* taken when the worker got the end of the stream */
+    uint32_t                   head;        /* index of the oldest entry in the queue */
+    uint32_t                   count;       /* number of queued entries */
+    importer_pipeline_entry_t *queue;       /* ring buffer of parsed access units, filled only by the worker
+                                             * and drained only by the consumer */
+    lsmash_summary_t          *summary;     /* summary dequeued last and not taken yet */
+} importer_pipeline_track_t;
+
+static const lsmash_class_t lsmash_importer_pipeline_class =
+{
+    "importer_pipeline"
+};
+
+struct importer_pipeline_tag
+{
+    const lsmash_class_t      *class;
+    importer_t                *importer;
+    uint32_t                   queue_length;    /* maximum number of queued access units per track */
+    uint32_t                   track_count;
+    uint32_t                   next_track;      /* index of the track to be parsed next */
+    importer_pipeline_track_t *track;
+    lsmash_thread_t           *thread;
+    lsmash_mutex_t            *mutex;
+    lsmash_cond_t             *produced;        /* signaled when an access unit is queued */
+    lsmash_cond_t             *consumed;        /* signaled when an access unit is dequeued or the worker is requested to stop */
+    int                        stop;
+};
+
+/* Pick the next track with room in its queue in a round-robin fashion
+ * so that no track of an importer having multiple tracks is starved. */
+static importer_pipeline_track_t *importer_select_pipeline_track( importer_pipeline_t *pipeline, uint32_t *track_number, int *finished )
+{
+    *finished = 1;
+    for( uint32_t i = 0; i < pipeline->track_count; i++ )
+    {
+        uint32_t index = (pipeline->next_track + i) % pipeline->track_count;
+        importer_pipeline_track_t *track = &pipeline->track[index];
+        if( track->finished )
+            continue;
+        *finished = 0;
+        if( track->count < pipeline->queue_length )
+        {
+            pipeline->next_track = (index + 1) % pipeline->track_count;
+            *track_number = index + 1;
+            return track;
+        }
+    }
+    return NULL;
+}
+
+static void *importer_pipeline_main( void *arg )
+{
+    importer_pipeline_t *pipeline = (importer_pipeline_t *)arg;
+    importer_t          *importer = pipeline->importer;
+    lsmash_mutex_lock( pipeline->mutex );
+    while( !pipeline->stop )
+    {
+        int      finished;
+        uint32_t track_number;
+        importer_pipeline_track_t *track = importer_select_pipeline_track( pipeline, &track_number, &finished );
+        if( finished )
+            break;
+        if( !track )
+        {
+            lsmash_cond_wait( pipeline->consumed, pipeline->mutex );
+            continue;
+        }
+        lsmash_mutex_unlock( pipeline->mutex );
+        /* Only this thread touches the importer while the pipeline runs, so parse without the lock. */
+        importer_pipeline_entry_t entry = { NULL, NULL, 0 };
+        uint32_t last_delta = 0;
+        entry.status = lsmash_importer_get_access_unit( importer, track_number, &entry.sample );
+        if( entry.status < 0 || entry.status == IMPORTER_PIPELINE_EOF )
+        {
+            lsmash_delete_sample( entry.sample );
+            entry.sample = NULL;
+            if( entry.status == IMPORTER_PIPELINE_EOF )
+                last_delta = lsmash_importer_get_last_delta( importer, track_number );
+        }
+        else if( entry.status == IMPORTER_PIPELINE_CHANGE
+              && !(entry.summary = lsmash_duplicate_summary( importer, track_number )) )
+        {
+            lsmash_delete_sample( entry.sample );
+            entry.sample = NULL;
+            entry.status = LSMASH_ERR_MEMORY_ALLOC;
+        }
+        lsmash_mutex_lock( pipeline->mutex );
+        track->queue[ (track->head + track->count) % pipeline->queue_length ] = entry;
+        ++ track->count;
+        if( !entry.sample )
+        {
+            track->finished   = 1;
+            track->last_delta = last_delta;
+        }
+        lsmash_cond_signal( pipeline->produced );
+    }
+    /* Tracks still being parsed are never fed anymore. */
+    for( uint32_t i = 0; i < pipeline->track_count; i++ )
+        pipeline->track[i].finished = 1;
+    lsmash_cond_signal( pipeline->produced );
+    lsmash_mutex_unlock( pipeline->mutex );
+    return NULL;
+}
+
+importer_pipeline_t *lsmash_importer_start_pipeline( importer_t *importer, uint32_t queue_length )
+{
+    if( !importer || queue_length == 0 )
+        return NULL;
+    uint32_t track_count = lsmash_importer_get_track_count( importer );
+    if( track_count == 0 )
+        return NULL;
+    importer_pipeline_t *pipeline = lsmash_malloc_zero( sizeof(importer_pipeline_t) );
+    if( !pipeline )
+        return NULL;
+    pipeline->class        = &lsmash_importer_pipeline_class;
+    pipeline->importer     = importer;
+    pipeline->queue_length = queue_length;
+    pipeline->track        = lsmash_malloc_zero( track_count * sizeof(importer_pipeline_track_t) );
+    pipeline->mutex        = lsmash_mutex_create();
+    pipeline->produced     = lsmash_cond_create();
+    pipeline->consumed     = lsmash_cond_create();
+    if( !pipeline->track || !pipeline->mutex || !pipeline->produced || !pipeline->consumed )
+        goto fail;
+    for( uint32_t i = 0; i < track_count; i++ )
+    {
+        pipeline->track[i].queue = lsmash_malloc( queue_length * sizeof(importer_pipeline_entry_t) );
+        if( !pipeline->track[i].queue )
+            goto fail;
+        ++ pipeline->track_count;
+    }
+    pipeline->thread = lsmash_thread_create( importer_pipeline_main, pipeline );
+    if( !pipeline->thread )
+        goto fail;
+    return pipeline;
+fail:
+    lsmash_importer_stop_pipeline( pipeline );
+    return NULL;
+}
+
+int lsmash_importer_pipeline_get_access_unit( importer_pipeline_t *pipeline, uint32_t track_number, lsmash_sample_t **p_sample )
+{
+    if( !pipeline || !p_sample )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    if( track_number == 0 || track_number > pipeline->track_count )
+        return LSMASH_ERR_FUNCTION_PARAM;
+    importer_pipeline_track_t *track = &pipeline->track[track_number - 1];
+    lsmash_mutex_lock( pipeline->mutex );
+    while( track->count == 0 && !track->finished )
+        lsmash_cond_wait( pipeline->produced, pipeline->mutex );
+    if( track->count )
+    {
+        importer_pipeline_entry_t entry = track->queue[ track->head ];
+        track->head = (track->head + 1) % pipeline->queue_length;
+        -- track->count;
+        lsmash_cond_signal( pipeline->consumed );
+        lsmash_mutex_unlock( pipeline->mutex );
+        *p_sample = entry.sample;
+        track->status = entry.status;
+        if( entry.summary )
+        {
+            lsmash_cleanup_summary( track->summary );
+            track->summary = entry.summary;
+        }
+    }
+    else
+    {
+        /* The worker stopped before getting the end of the stream. */
+        lsmash_mutex_unlock( pipeline->mutex );
+        *p_sample = NULL;
+        if( track->status >= 0 && track->status != IMPORTER_PIPELINE_EOF )
+            track->status = LSMASH_ERR_NAMELESS;
+    }
+    return track->status;
+}
+
+lsmash_summary_t *lsmash_importer_pipeline_take_summary( importer_pipeline_t *pipeline, uint32_t track_number )
+{
+    if( !pipeline || track_number == 0 || track_number > pipeline->track_count )
+        return NULL;
+    importer_pipeline_track_t *track = &pipeline->track[track_number - 1];
+    lsmash_summary_t *summary = track->summary;
+    track->summary = NULL;
+    return summary;
+}
+
+uint32_t lsmash_importer_pipeline_get_last_delta( importer_pipeline_t *pipeline, uint32_t track_number )
+{
+    if( !pipeline || track_number == 0 || track_number > pipeline->track_count )
+        return 0;
+    importer_pipeline_track_t *track = &pipeline->track[track_number - 1];
+    return track->status == IMPORTER_PIPELINE_EOF ? track->last_delta : 0;
+}
+
+void lsmash_importer_stop_pipeline( importer_pipeline_t *pipeline )
+{
+    if( !pipeline )
+        return;
+    if( pipeline->thread )
+    {
+        lsmash_mutex_lock( pipeline->mutex );
+        pipeline->stop = 1;
+        lsmash_cond_signal( pipeline->consumed );
+        lsmash_mutex_unlock( pipeline->mutex );
+        lsmash_thread_join( pipeline->thread );
+    }
+    for( uint32_t i = 0; i < pipeline->track_count; i++ )
+    {
+        importer_pipeline_track_t *track = &pipeline->track[i];
+        for( uint32_t j = 0; j < track->count; j++ )
+        {
+            importer_pipeline_entry_t *entry = &track->queue[ (track->head + j) % pipeline->queue_length ];
+            lsmash_delete_sample( entry->sample );
+            lsmash_cleanup_summary( entry->summary );
+        }
+        lsmash_cleanup_summary( track->summary );
+        lsmash_free( track->queue );
+    }
+    lsmash_free( pipeline->track );
+    lsmash_cond_destroy( pipeline->consumed );
+    lsmash_cond_destroy( pipeline->produced );
+    lsmash_mutex_destroy( pipeline->mutex );
+    lsmash_free( pipeline );
+}
@@ -285,7 +285,7 @@ static int vc1_importer_get_accessunit( importer_t *importer, uint32_t track_num
         importer->status = IMPORTER_ERROR;
         return err;
     }
-    lsmash_sample_t *sample = lsmash_create_sample( vc1_imp->max_au_length );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, vc1_imp->max_au_length );
     if( !sample )
         return LSMASH_ERR_MEMORY_ALLOC;
     *p_sample = sample;
@@ -489,6 +489,12 @@ static int vc1_importer_probe( importer_t *importer )
     /* OK. It seems the stream has a sequence header of VC-1. */
     importer->info = vc1_imp;
     vc1_info_t *info = &vc1_imp->info;
+    if( bs->unseekable )
+    {
+        /* The whole stream is analyzed in advance and read again, which requires seeking. */
+        err = LSMASH_ERR_PATCH_WELCOME;
+        goto fail;
+    }
     lsmash_bs_read_seek( bs, first_ebdu_head_pos, SEEK_SET );
     info->ebdu_head_pos = first_ebdu_head_pos;
     if( (err = vc1_analyze_whole_stream( importer )) < 0 )
@@ -131,7 +131,7 @@ static int wave_importer_get_accessunit( importer_t *importer, uint32_t track_nu
         if( wave_imp->au_length == 0 )
             return IMPORTER_EOF;
     }
-    lsmash_sample_t *sample = lsmash_create_sample( wave_imp->au_length );
+    lsmash_sample_t *sample = lsmash_create_pooled_sample( importer->root, wave_imp->au_length );
     if( !sample )
         return LSMASH_ERR_MEMORY_ALLOC;
     *p_sample = sample;
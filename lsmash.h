@@ -47,8 +47,8 @@ extern "C" {
  * Version
  ****************************************************************************/
 #define LSMASH_VERSION_MAJOR  2
-#define LSMASH_VERSION_MINOR 16
-#define LSMASH_VERSION_MICRO  1
+#define LSMASH_VERSION_MINOR 17
+#define LSMASH_VERSION_MICRO  0
 
 #define LSMASH_VERSION_INT( a, b, c ) (((a) << 16) | ((b) << 8) | (c))
 
@@ -108,6 +108,7 @@ typedef enum
     LSMASH_FILE_MODE_MEDIA             = 1<<6,  /* media data */
     LSMASH_FILE_MODE_INDEX             = 1<<7,
     LSMASH_FILE_MODE_SEGMENT           = 1<<8,  /* segment */
+    LSMASH_FILE_MODE_LAZY              = 1<<9,  /* parse movie fragments on demand */
     LSMASH_FILE_MODE_WRITE_FRAGMENTED  = LSMASH_FILE_MODE_WRITE | LSMASH_FILE_MODE_FRAGMENTED,  /* deprecated */
 } lsmash_file_mode;
 
@@ -201,6 +202,12 @@ typedef enum
     ISOM_BRAND_TYPE_SSSS  = LSMASH_4CC( 's', 's', 's', 's' ),   /* Subsegment Index Segment */
 } lsmash_brand_type;
 
+typedef struct
+{
+    uint8_t *data;          /* the start address of the buffer */
+    uint64_t size;          /* the number of bytes in the buffer */
+} lsmash_io_vector_t;
+
 typedef struct
 {
     lsmash_file_mode mode;  /* file modes */
@@ -267,13 +274,15 @@ typedef struct
 
 /* Open a file where the path is given.
  * And if successful, set up the parameters by 'open_mode'.
- * Here, the 'open_mode' parameter is either 0 or 1 as follows:
+ * Here, the 'open_mode' parameter is 0, 1 or 2 as follows:
  *   0: Create a file for output/muxing operations.
  *      If a file with the same name already exists, its contents are discarded and the file is treated as a new file.
  *      If user specifies "-" for 'filename', operations are done on stdout.
  *      The file types or segment types are set up as specified in 'param'.
  *   1: Open a file for input/demuxing operations. The file must exist.
  *      If user specifies "-" for 'filename', operations are done on stdin.
+ *   2: Open a file for input/demuxing operations in the same way as 1, and allow the movie of the file
+ *      to be rewritten in place by lsmash_rewrite_movie(). The file must exist and "-" is not allowed.
  *
  * This function sets up file modes minimally.
  * User can add additional modes and/or remove modes already set later.
@@ -316,6 +325,75 @@ lsmash_file_t *lsmash_set_file
     lsmash_file_parameters_t *param
 );
 
+/* Write the data in 'count' buffers described by 'vec' in that order to the file referenced by 'opaque'.
+ *
+ * Return the total number of bytes written if successful.
+ * Return a negative value otherwise. */
+typedef int64_t (*lsmash_file_writev_callback)( void *opaque, const lsmash_io_vector_t *vec, int count );
+
+/* Set the optional custom I/O callback to write the data in several buffers at a time into a given file.
+ * The callback is called with 'opaque' of the file parameters given to lsmash_set_file().
+ * If not set or set to NULL, each buffer is written by 'write' of the file parameters instead.
+ * For a file opened by lsmash_open_file(), a callback using writev() is set by default if available.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_set_file_writev
+(
+    lsmash_file_t               *file,
+    lsmash_file_writev_callback  writev
+);
+
+/* Move the data from 'offset' to the end of the file referenced by 'opaque' forward by 'shift' bytes.
+ * The contents of the range of 'shift' bytes from 'offset' may be anything after the move since it is overwritten.
+ *
+ * Return the resulting size of the file if successful.
+ * Return LSMASH_ERR_PATCH_WELCOME if not supported, where nothing shall be moved.
+ * Return the other negative value otherwise. */
+typedef int64_t (*lsmash_file_shift_callback)( void *opaque, uint64_t offset, uint64_t shift );
+
+/* Set the optional custom I/O callback to move the data inside a given file when moving boxes to the front.
+ * The callback is called with 'opaque' of the file parameters given to lsmash_set_file().
+ * If not set or set to NULL, or if the callback returns LSMASH_ERR_PATCH_WELCOME, the data is moved through the buffers
+ * described by lsmash_adhoc_remux_t instead.
+ * For a seekable file opened by lsmash_open_file(), a callback moving the data inside the kernel is set by default
+ * if available.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_set_file_shift
+(
+    lsmash_file_t              *file,
+    lsmash_file_shift_callback  shift
+);
+
+/* Write the data into a given file on a background thread instead of the calling thread.
+ * 'queue_length' is the max number of buffers queued for the thread and shall not be 0.
+ * This function shall be called before anything is written into the file, and the file shall be kept open until
+ * lsmash_finish_movie(), lsmash_switch_media_segment() from the file or lsmash_destroy_root() returns.
+ * By default, the data is written on the calling thread.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_set_file_write_queue_length
+(
+    lsmash_file_t *file,
+    uint32_t       queue_length
+);
+
+/* Set the max size of a media segment held on memory for a given file.
+ * If LSMASH_FILE_MODE_INDEX is set for an unseekable stream, each media segment is held until its Segment Index Boxes
+ * are written, and larger ones than 'size' bytes are held in a temporary file.
+ * 64*1024*1024 (64MiB) is default value.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_set_max_segment_buffer_size
+(
+    lsmash_file_t *file,
+    uint64_t       size
+);
+
 /* Read whole boxes in a given file.
  * You can also get file modes and file types or segment types by this function.
  *
@@ -1572,6 +1650,9 @@ typedef struct
     uint64_t                 pos;       /* absolute file offset of sample data (read-only) */
     uint32_t                 index;     /* index of sample description */
     lsmash_sample_property_t prop;
+    void                    *buffer;    /* buffer shared with other samples (read-only)
+                                         * If not NULL, 'data' points into the buffer, which is not allocated for this sample only.
+                                         * Any user must not deallocate or reallocate 'data' of such a sample directly. */
 } lsmash_sample_t;
 
 typedef struct
@@ -1597,6 +1678,21 @@ lsmash_sample_t *lsmash_create_sample
     uint32_t size   /* size of sample data you request */
 );
 
+/* Allocate a sample whose data is allocated by 'size' in the same way as lsmash_create_sample(),
+ * but take both of them from blocks recycled within a given ROOT.
+ * The sample is returned to the ROOT when deallocated by lsmash_delete_sample(), or when written into a file after appended,
+ * and reused for later samples of similar size. This avoids allocating and deallocating memory for each sample.
+ * The sample may be deallocated on any thread, even after the ROOT is destroyed.
+ * Any user must not deallocate or reallocate 'data' of the sample directly, and shall use lsmash_sample_alloc() instead.
+ *
+ * Return the address of an allocated sample if successful.
+ * Return NULL otherwise. */
+lsmash_sample_t *lsmash_create_pooled_sample
+(
+    lsmash_root_t *root,    /* the address of the ROOT the sample is recycled within */
+    uint32_t       size     /* size of sample data you request */
+);
+
 /* Allocate data of a given allocated sample by 'size'.
  * If the sample data is already allocated, reallocate it by 'size'.
  *
@@ -2275,6 +2371,24 @@ int lsmash_finish_movie
     lsmash_adhoc_remux_t *remux
 );
 
+/* Rewrite the movie of a file opened by lsmash_open_file() with 'open_mode' equal to 2 and read by lsmash_read_file()
+ * without copying any media data.
+ * The sample tables of the tracks retimed by lsmash_set_media_timestamps() are rebuilt from their media timelines,
+ * and the durations of these tracks and the movie are updated. The other changes of the movie since reading the file,
+ * such as the explicit timeline maps and the media parameters, are also written.
+ * The new Movie Box overwrites the old one if it fits in the space of the old one and the Free Space Boxes following it,
+ * and the rest of the space is filled with a Free Space Box. Otherwise, the new Movie Box is appended to the end of
+ * the file and then the old one is turned into a Free Space Box.
+ * The boxes in the file shall not be destroyed by lsmash_destroy_children() before calling this function.
+ * Movie fragments are not supported.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_rewrite_movie
+(
+    lsmash_root_t *root
+);
+
 /* Update the modification time of a movie to the most recent.
  * If the creation time of that movie is larger than the modification time,
  * then override the creation one with the modification one.
@@ -2319,6 +2433,24 @@ int lsmash_reserve_media_data_size
     uint64_t       media_data_size
 );
 
+/* Reserve the region for the Movie Box and the Meta Box at the front of a non-fragmented movie.
+ * The reserved region is written as a Free Space Box just before the box enclosing the media data region, and
+ * lsmash_finish_movie() writes the Movie Box and the Meta Box there with a Free Space Box covering the remainder
+ * instead of moving the whole media data region. If the reserved size is too small and 'remux' is given to
+ * lsmash_finish_movie(), the media data region is moved only by the shortage. If 'remux' is not given, the boxes are
+ * written at the end of the file and the reserved region is left as it is.
+ * Note that the specified size is including the type and the size fields of the Free Space Box, shall be equal to 0 or
+ * in the range [8, UINT32_MAX] and this function must be called before any lsmash_append_sample(). The value 0 cancels
+ * the reservation. The output stream must be seekable.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_reserve_movie_size
+(
+    lsmash_root_t *root,
+    uint64_t       movie_size
+);
+
 /****************************************************************************
  * Chapter list
  ****************************************************************************/
@@ -2383,6 +2515,39 @@ int lsmash_create_fragment_movie
     lsmash_root_t *root
 );
 
+/* Flush the current movie fragment as a chunk and continue the movie fragment with the next chunk.
+ * A chunk is a pair of a Movie Fragment Box and a Media Data Box which are written as soon as the chunk is flushed,
+ * and all the chunks until the next lsmash_create_fragment_movie() call make up one subsegment of the Segment Index Box.
+ * This allows output of a movie fragment to start before all of its samples are given, and bounds the memory held for
+ * the pooled samples by the size of a chunk.
+ * Users shall call lsmash_flush_pooled_samples() for each track before calling this function.
+ *
+ * If either limit is set by lsmash_set_fragment_chunk_limits() for the active file, a chunk is flushed
+ * automatically when appending a sample would exceed either limit.
+ * This occurs only while the current chunk has exactly one track fragment, since the duration of the last sample of
+ * the other tracks is unknown at that point.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_create_fragment_chunk
+(
+    lsmash_root_t *root
+);
+
+/* Set the limits of each chunk of the movie fragments in a given file.
+ * 'max_samples' is the max number of samples per chunk, and 'max_duration' is the max duration per chunk in seconds.
+ * 0 means no limit, and is default for both.
+ * See lsmash_create_fragment_chunk() for the details of chunks.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_set_fragment_chunk_limits
+(
+    lsmash_file_t *file,
+    uint32_t       max_samples,
+    double         max_duration
+);
+
 /* Create an empty duration track in the current movie fragment.
  * Don't specify track_ID any track fragment in the current movie fragment has.
  *
@@ -2436,6 +2601,23 @@ int lsmash_copy_timeline_map
 /* Construct the timeline for a track.
  * The constructed timeline can be destructed by lsmash_destruct_timeline().
  *
+ * If the file is read with LSMASH_FILE_MODE_LAZY, the contents of the movie fragments are not parsed when reading
+ * the file, and the timeline is extended only when a sample beyond the ones known so far is accessed through the
+ * functions for the media timeline. Movie fragments before the sample of a given number or at a given decoding time
+ * are skipped by reading only the headers of their track fragments and track runs, and are parsed when any of their
+ * samples is accessed. Skipping requires the Track Fragment Base Media Decode Time Box, and LPCM tracks are never
+ * skipped. Lookups by composition time parse the skipped movie fragments decoded until the given time.
+ * Functions returning the properties of the whole timeline, such as lsmash_get_sample_count_in_media_timeline(),
+ * parse all the rest of the movie fragments.
+ * A skipped movie fragment is kept as a single range of sample numbers, so the memory for it does not depend on the
+ * number of its samples until it is parsed.
+ * Before any composition timestamp is returned, the composition to decode timeline shift is fixed by skimming all
+ * the rest of the movie fragments, where only the composition time offsets are read from the track runs which may
+ * have negative ones.
+ * If any movie fragment fails to be parsed, the functions for the media timeline return its error, not the one as
+ * if no such sample were present, whenever the access requires the samples in or after it.
+ * The timeline in this mode shall not be accessed from multiple threads.
+ *
  * Return 0 if successful.
  * Return a negative value otherwise. */
 int lsmash_construct_timeline
@@ -2451,6 +2633,38 @@ void lsmash_destruct_timeline
     uint32_t       track_ID
 );
 
+/* Write the timelines constructed for the tracks in the ROOT into an index file.
+ * The timelines can be reconstructed from the index by lsmash_read_timeline_index() instead of lsmash_construct_timeline()
+ * as long as the file is not changed. Note that only the construction of the timelines is skipped; the boxes including
+ * the sample tables are still read by lsmash_read_file(). The index records the size and the last modification time of the file and a hash
+ * of the Movie Box to detect any change. The modification time is not recorded for files not opened by lsmash_open_file().
+ * The index also records a hash of itself to detect its corruption, and whether each timeline has been retimed by
+ * lsmash_set_media_timestamps().
+ * Timelines of files read with LSMASH_FILE_MODE_LAZY are completed before being written.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_write_timeline_index
+(
+    lsmash_root_t *root,
+    const char    *filename
+);
+
+/* Construct the timelines for the tracks listed in an index file written by lsmash_write_timeline_index().
+ * The index is read through a memory mapping if possible. Timelines constructed already for the same tracks are replaced.
+ * This function shall be called after lsmash_read_file(), and hashes the whole Movie Box as stored in the file to check
+ * that the index still matches.
+ *
+ * Return 0 if successful.
+ * Return LSMASH_ERR_INVALID_DATA if the index is broken or does not match the file any longer. In this case, construct
+ * the timelines by lsmash_construct_timeline() instead.
+ * Return the other negative value otherwise. */
+int lsmash_read_timeline_index
+(
+    lsmash_root_t *root,
+    const char    *filename
+);
+
 /* Get the duration of the last sample from the media timeline for a track.
  *
  * Return 0 if successful.
@@ -2498,6 +2712,47 @@ int lsmash_get_cts_from_media_timeline
     uint64_t      *cts              /* the address of a variable to which a composition timestamp will be set */
 );
 
+/* Get the sample number of the last sample in decoding order whose decoding timestamp is not greater than a given one
+ * from the media timeline for a track.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_get_sample_number_by_dts_from_media_timeline
+(
+    lsmash_root_t *root,
+    uint32_t       track_ID,
+    uint64_t       dts,             /* a decoding timestamp in media timescale */
+    uint32_t      *sample_number    /* the address of a variable to which a sample number will be set */
+);
+
+/* Get the sample number of the last sample in composition order whose composition timestamp is not greater than a given one,
+ * i.e. the sample presented at a given composition time, from the media timeline for a track.
+ * A given composition timestamp is interpreted in the same way as lsmash_get_cts_from_media_timeline() gives.
+ * Any non-output sample is never returned.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_get_sample_number_by_cts_from_media_timeline
+(
+    lsmash_root_t *root,
+    uint32_t       track_ID,
+    uint64_t       cts,             /* a composition timestamp in media timescale */
+    uint32_t      *sample_number    /* the address of a variable to which a sample number will be set */
+);
+
+/* Get the sample number of the sample presented at a given time on the movie timeline for a track.
+ * The time is mapped to the media timeline through the edits of the track.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise, e.g. a given time is in an empty edit or beyond the end of the presentation. */
+int lsmash_get_sample_number_by_movie_time_from_media_timeline
+(
+    lsmash_root_t *root,
+    uint32_t       track_ID,
+    uint64_t       movie_time,      /* a time in movie timescale */
+    uint32_t      *sample_number    /* the address of a variable to which a sample number will be set */
+);
+
 /* Get the shift of composition timeline to decode timeline from the media timeline for a track.
  *
  * Return 0 if successful.
@@ -2614,6 +2869,22 @@ int lsmash_get_sample_property_from_media_timeline
     lsmash_sample_property_t *prop
 );
 
+/* Set the number of chunks read at a time by lsmash_get_sample_from_media_timeline() for a track.
+ * If set to a non-zero value, the data from a requested sample to the end of its chunk and up to 'chunk_count - 1'
+ * subsequent chunks of the track are read into a buffer at a time, and the data of samples got from the media timeline
+ * refers to this buffer instead of being copied individually. The buffer is deallocated when the timeline and all
+ * the samples referring to it are deleted.
+ * If set to 0, the data of each sample is read individually. This is the default.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_set_read_ahead_chunk_count_in_media_timeline
+(
+    lsmash_root_t *root,
+    uint32_t       track_ID,
+    uint32_t       chunk_count
+);
+
 /* Check if the sample corresponding to a given sample number exists in the media timeline for a track.
  *
  * Return 1 if the sample exists.
@@ -2655,6 +2926,59 @@ void lsmash_delete_media_timestamps
     lsmash_media_ts_list_t *ts_list
 );
 
+typedef struct lsmash_media_ts_iterator_tag lsmash_media_ts_iterator_t;
+
+/* Allocate an iterator over the decoding and composition timestamps of the samples in a track.
+ * The iterator gives the same timestamps as lsmash_get_media_timestamps() in decoding order, but a piece at a time
+ * without allocating any array of timestamps.
+ * If the media timeline of the track is constructed, the timestamps are got from it, and a media timeline through
+ * movie fragments is extended only as far as the iterator has reached. In this case, the media timeline shall not be
+ * destructed while iterating.
+ * Otherwise, the sample tables and the track runs of movie fragments are read directly in constant memory, so the
+ * media timeline is not required. Then, movie fragments not parsed with LSMASH_FILE_MODE_LAZY stay unparsed, and
+ * no timestamps are given for LPCM tracks in the same way as lsmash_get_media_timestamps().
+ *
+ * Return the address of an allocated iterator if successful.
+ * Return NULL otherwise. */
+lsmash_media_ts_iterator_t *lsmash_create_media_ts_iterator
+(
+    lsmash_root_t *root,
+    uint32_t       track_ID
+);
+
+/* Get the timestamps of up to 'max_count' samples following the ones got last time from a given iterator.
+ * If the file is read with LSMASH_FILE_MODE_LAZY and the iterator gets timestamps from the media timeline, the first
+ * call fixes the composition to decode shift of the track before returning any CTS, i.e. the headers of all movie
+ * fragments are read together with the composition time offsets of the track runs that may have negative ones.
+ * The shift got from the media timeline after that call never changes. In this case, the sample info of the samples
+ * iterated over is kept in the media timeline until it is destructed.
+ *
+ * Return the number of timestamps stored into 'ts' if successful. 0 means the end of the samples.
+ * Return a negative value otherwise. */
+int lsmash_get_next_media_timestamps
+(
+    lsmash_media_ts_iterator_t *iterator,
+    lsmash_media_ts_t          *ts,         /* array of at least 'max_count' timestamps */
+    uint32_t                    max_count
+);
+
+/* Get the composition to decode timeline shift of the timestamps given by a given iterator.
+ * Without the media timeline, the shift is fixed when allocating the iterator.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_get_composition_to_decode_shift_from_media_ts_iterator
+(
+    lsmash_media_ts_iterator_t *iterator,
+    uint32_t                   *ctd_shift
+);
+
+/* Deallocate a given iterator. */
+void lsmash_destroy_media_ts_iterator
+(
+    lsmash_media_ts_iterator_t *iterator
+);
+
 /* Get the maximum composition delay derived from composition reordering.
  *
  * Return 0 if successful.
@@ -2677,6 +3001,70 @@ void lsmash_sort_timestamps_composition_order
     lsmash_media_ts_list_t *ts_list
 );
 
+/****************************************************************************
+ * Sample Prefetcher
+ ****************************************************************************/
+typedef struct lsmash_prefetcher_tag lsmash_prefetcher_t;
+
+/* Allocate a prefetcher of samples from the media timelines of tracks in a given ROOT.
+ * A prefetcher reads samples by a worker thread for the ROOT and keeps up to 'queue_length' samples per track
+ * in decoding order. The worker fetches the track whose next sample has the earliest DTS in seconds among
+ * tracks with room in their queues, so the queues can be consumed in any order.
+ * The media timelines of tracks to be prefetched shall be constructed before adding the tracks. While the worker
+ * runs, the caller may get the information of samples from the media timelines but shall not get samples
+ * of the prefetched tracks from them. The media timelines of files read with LSMASH_FILE_MODE_LAZY are completed
+ * when the tracks are added, and the caller shall not construct or access any other media timeline of such files
+ * while the worker runs since it is extended without any lock.
+ *
+ * Return the address of an allocated prefetcher if successful.
+ * Return NULL otherwise. */
+lsmash_prefetcher_t *lsmash_create_prefetcher
+(
+    lsmash_root_t *root,
+    uint32_t       queue_length
+);
+
+/* Add a track to be prefetched from a given sample number.
+ * Tracks can be added only before starting the prefetcher.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_add_prefetch_track
+(
+    lsmash_prefetcher_t *prefetcher,
+    uint32_t             track_ID,
+    uint32_t             start_sample_number
+);
+
+/* Start the worker thread of a prefetcher.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_start_prefetcher
+(
+    lsmash_prefetcher_t *prefetcher
+);
+
+/* Get the next sample of a track from a prefetcher.
+ * This function blocks until a sample is fetched or the worker stops fetching the track.
+ * The gotten sample can be deallocated by lsmash_delete_sample().
+ * If the end of the media timeline is reached, NULL is set to '*sample'.
+ *
+ * Return 0 if successful.
+ * Return a negative value otherwise. */
+int lsmash_get_prefetched_sample
+(
+    lsmash_prefetcher_t *prefetcher,
+    uint32_t             track_ID,
+    lsmash_sample_t    **sample
+);
+
+/* Stop the worker thread of a prefetcher and deallocate the prefetcher and samples not gotten yet. */
+void lsmash_destroy_prefetcher
+(
+    lsmash_prefetcher_t *prefetcher
+);
+
 /****************************************************************************
  * Tools for creating CODEC Specific Information Extensions (Magic Cookies)
  ****************************************************************************/